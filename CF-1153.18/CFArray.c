@@ -1066,7 +1066,7 @@ void CFArraySortValues(CFMutableArrayRef array, CFRange range, CFComparatorFunct
     struct _acompareContext ctx;
     ctx.func = comparator;
     ctx.context = context;
-    CFQSortArray(values, range.length, sizeof(void *), (CFComparatorFunction)__CFArrayCompareValues, &ctx);
+    __CFQSortArrayConcurrently(values, range.length, sizeof(void *), (CFComparatorFunction)__CFArrayCompareValues, &ctx);
     if (!immutable) CFArrayReplaceValues(array, range, values, range.length);
     if (values != buffer) CFAllocatorDeallocate(kCFAllocatorSystemDefault, values);
 }
@@ -652,7 +652,9 @@ void CFArrayExchangeValuesAtIndices(CFMutableArrayRef theArray, CFIndex idx1, CF
 		which the comparator function does not expect or cannot
 		properly compare, the behavior is undefined. The values in
 		the range are sorted from least to greatest according to
-		this function.
+		this function, and values which compare equal keep their
+		order. Large ranges are sorted on several threads at once,
+		so the comparator function may be called concurrently.
 	@param context A pointer-sized user-defined value, which is passed
 		as the third parameter to the comparator function, but is
 		otherwise unused by this function. If the context is not
@@ -34,6 +34,9 @@
 #if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED
 #import <dispatch/dispatch.h>
 #endif
+#if CF_VECTOR_X86
+#import <emmintrin.h>
+#endif
 
 #if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED
 #define __SetLastAllocationEventName(A, B) do { if (__CFOASafe && (A)) __CFSetLastAllocationEventName(A, B); } while (0)
@@ -309,7 +312,7 @@ struct __CFBasicHash {
     CFRuntimeBase base;
     struct { // 192 bits
         uint16_t mutations;
-        uint8_t hash_style:2;
+        uint8_t hash_style:3;
         uint8_t keys_offset:1;
         uint8_t counts_offset:2;
         uint8_t counts_width:2;
@@ -342,6 +345,34 @@ struct __CFBasicHash {
     void *pointers[1];
 };
 
+// Grouped tables have a power of 2 buckets, at least one group of them,
+// and are allowed to become 7/8 full.
+#define __CFBasicHashGroupWidth 16
+#define __CFBasicHashGroupedMaxIndex (__LP64__ ? 36 : 24)
+
+CF_INLINE Boolean __CFBasicHashIsGrouped(CFConstBasicHashRef ht) {
+    return (__kCFBasicHashGroupedHashingValue == ht->bits.hash_style);
+}
+
+CF_INLINE CFIndex __CFBasicHashGetNumBucketsForIndex(CFConstBasicHashRef ht, CFIndex num_buckets_idx) {
+    if (__CFBasicHashIsGrouped(ht)) {
+        return (0 == num_buckets_idx) ? 0 : ((CFIndex)__CFBasicHashGroupWidth << (num_buckets_idx - 1));
+    }
+    return __CFBasicHashTableSizes[num_buckets_idx];
+}
+
+// A grouped table keeps each key beside its value, so the keys pointer
+// is one past the values pointer and both are indexed with a stride of 2.
+CF_INLINE CFIndex __CFBasicHashGetStride(CFConstBasicHashRef ht) {
+    return (__CFBasicHashIsGrouped(ht) && ht->bits.keys_offset) ? 2 : 1;
+}
+
+// The values of a grouped table are allocated together with the control
+// bytes, which come first.
+CF_INLINE void *__CFBasicHashGetValuesAllocation(CFBasicHashValue *values, CFIndex num_buckets, Boolean grouped) {
+    return (grouped && values) ? (void *)((uint8_t *)values - num_buckets) : (void *)values;
+}
+
 static void *CFBasicHashCallBackPtrs[(1UL << 10)];
 static int32_t CFBasicHashCallBackPtrsCount = 0;
 
@@ -490,14 +521,14 @@ CF_INLINE void __CFBasicHashSetCounts(CFBasicHashRef ht, void *ptr) {
 }
 
 CF_INLINE uintptr_t __CFBasicHashGetValue(CFConstBasicHashRef ht, CFIndex idx) {
-    uintptr_t val = __CFBasicHashGetValues(ht)[idx].neutral;
+    uintptr_t val = __CFBasicHashGetValues(ht)[idx * __CFBasicHashGetStride(ht)].neutral;
     if (__CFBasicHashSubABZero == val) return 0UL;
     if (__CFBasicHashSubABOne == val) return ~0UL;
     return val;
 }
 
 CF_INLINE void __CFBasicHashSetValue(CFBasicHashRef ht, CFIndex idx, uintptr_t stack_value, Boolean ignoreOld, Boolean literal) {
-    CFBasicHashValue *valuep = &(__CFBasicHashGetValues(ht)[idx]);
+    CFBasicHashValue *valuep = &(__CFBasicHashGetValues(ht)[idx * __CFBasicHashGetStride(ht)]);
     uintptr_t old_value = ignoreOld ? 0 : valuep->neutral;
     if (!literal) {
         if (0UL == stack_value) stack_value = __CFBasicHashSubABZero;
@@ -515,7 +546,7 @@ CF_INLINE void __CFBasicHashSetValue(CFBasicHashRef ht, CFIndex idx, uintptr_t s
 
 CF_INLINE uintptr_t __CFBasicHashGetKey(CFConstBasicHashRef ht, CFIndex idx) {
     if (ht->bits.keys_offset) {
-        uintptr_t key = __CFBasicHashGetKeys(ht)[idx].neutral;
+        uintptr_t key = __CFBasicHashGetKeys(ht)[idx * __CFBasicHashGetStride(ht)].neutral;
         if (__CFBasicHashSubABZero == key) return 0UL;
         if (__CFBasicHashSubABOne == key) return ~0UL;
         return key;
@@ -529,7 +560,7 @@ CF_INLINE uintptr_t __CFBasicHashGetKey(CFConstBasicHashRef ht, CFIndex idx) {
 
 CF_INLINE void __CFBasicHashSetKey(CFBasicHashRef ht, CFIndex idx, uintptr_t stack_key, Boolean ignoreOld, Boolean literal) {
     if (0 == ht->bits.keys_offset) HALT;
-    CFBasicHashValue *keyp = &(__CFBasicHashGetKeys(ht)[idx]);
+    CFBasicHashValue *keyp = &(__CFBasicHashGetKeys(ht)[idx * __CFBasicHashGetStride(ht)]);
     uintptr_t old_key = ignoreOld ? 0 : keyp->neutral;
     if (!literal) {
         if (0UL == stack_key) stack_key = __CFBasicHashSubABZero;
@@ -546,12 +577,12 @@ CF_INLINE void __CFBasicHashSetKey(CFBasicHashRef ht, CFIndex idx, uintptr_t sta
 }
 
 CF_INLINE uintptr_t __CFBasicHashIsEmptyOrDeleted(CFConstBasicHashRef ht, CFIndex idx) {
-    uintptr_t stack_value = __CFBasicHashGetValues(ht)[idx].neutral;
+    uintptr_t stack_value = __CFBasicHashGetValues(ht)[idx * __CFBasicHashGetStride(ht)].neutral;
     return (0UL == stack_value || ~0UL == stack_value);
 }
 
 CF_INLINE uintptr_t __CFBasicHashIsDeleted(CFConstBasicHashRef ht, CFIndex idx) {
-    uintptr_t stack_value = __CFBasicHashGetValues(ht)[idx].neutral;
+    uintptr_t stack_value = __CFBasicHashGetValues(ht)[idx * __CFBasicHashGetStride(ht)].neutral;
     return (~0UL == stack_value);
 }
 
@@ -573,7 +604,7 @@ CF_INLINE void __CFBasicHashBumpCounts(CFBasicHashRef ht) {
     case 0: {
         uint8_t *counts08 = (uint8_t *)counts;
         ht->bits.counts_width = 1;
-        CFIndex num_buckets = __CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+        CFIndex num_buckets = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
         uint16_t *counts16 = (uint16_t *)__CFBasicHashAllocateMemory(ht, num_buckets, 2, false, false);
         if (!counts16) HALT;
         __SetLastAllocationEventName(counts16, "CFBasicHash (count-store)");
@@ -589,7 +620,7 @@ CF_INLINE void __CFBasicHashBumpCounts(CFBasicHashRef ht) {
     case 1: {
         uint16_t *counts16 = (uint16_t *)counts;
         ht->bits.counts_width = 2;
-        CFIndex num_buckets = __CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+        CFIndex num_buckets = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
         uint32_t *counts32 = (uint32_t *)__CFBasicHashAllocateMemory(ht, num_buckets, 4, false, false);
         if (!counts32) HALT;
         __SetLastAllocationEventName(counts32, "CFBasicHash (count-store)");
@@ -605,7 +636,7 @@ CF_INLINE void __CFBasicHashBumpCounts(CFBasicHashRef ht) {
     case 2: {
         uint32_t *counts32 = (uint32_t *)counts;
         ht->bits.counts_width = 3;
-        CFIndex num_buckets = __CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+        CFIndex num_buckets = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
         uint64_t *counts64 = (uint64_t *)__CFBasicHashAllocateMemory(ht, num_buckets, 8, false, false);
         if (!counts64) HALT;
         __SetLastAllocationEventName(counts64, "CFBasicHash (count-store)");
@@ -693,9 +724,72 @@ CF_INLINE void __CFBasicHashSetHashes(CFBasicHashRef ht, uintptr_t *ptr) {
     __AssignWithWriteBarrier(&ht->pointers[ht->bits.hashes_offset], ptr);
 }
 
+// Each bucket of a grouped table has a control byte, which is either one
+// of these markers or the low 7 bits of the mixed hash code of its key.
+#define __CFBasicHashControlEmpty 0x80
+#define __CFBasicHashControlDeleted 0xFE
+
+CF_INLINE uint8_t *__CFBasicHashGetControls(CFConstBasicHashRef ht) {
+    return (uint8_t *)__CFBasicHashGetValues(ht) - __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
+}
+
+// Hash codes of pointers and small integers have poor low bits, which are
+// all that a power of 2 table would look at, so they are mixed first.
+CF_INLINE uintptr_t __CFBasicHashMixHashCode(CFHashCode hash_code) {
+#if __LP64__
+    uint64_t h = hash_code;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (uintptr_t)h;
+#else
+    uint32_t h = hash_code;
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    return (uintptr_t)h;
+#endif
+}
+
+CF_INLINE void __CFBasicHashSetControl(CFBasicHashRef ht, CFIndex idx, uintptr_t key_hash) {
+    __CFBasicHashGetControls(ht)[idx] = __CFBasicHashMixHashCode(key_hash) & 0x7F;
+}
+
+// Returns a mask with bit i set if byte i of the group is control.
+CF_INLINE uint32_t __CFBasicHashMatchControl(const uint8_t *group, uint8_t control) {
+#if CF_VECTOR_X86
+    __m128i bytes = _mm_loadu_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)control)));
+#else
+    uint32_t match = 0;
+    for (CFIndex idx = 0; idx < __CFBasicHashGroupWidth; idx++) {
+        if (group[idx] == control) match |= (1U << idx);
+    }
+    return match;
+#endif
+}
+
+// Both markers have the high bit set, and control bytes of keys do not.
+CF_INLINE uint32_t __CFBasicHashMatchEmptyOrDeleted(const uint8_t *group) {
+#if CF_VECTOR_X86
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#else
+    uint32_t match = 0;
+    for (CFIndex idx = 0; idx < __CFBasicHashGroupWidth; idx++) {
+        if (group[idx] & 0x80) match |= (1U << idx);
+    }
+    return match;
+#endif
+}
+
 
 // to expose the load factor, expose this function to customization
 CF_INLINE CFIndex __CFBasicHashGetCapacityForNumBuckets(CFConstBasicHashRef ht, CFIndex num_buckets_idx) {
+    if (__CFBasicHashIsGrouped(ht)) {
+        if (__CFBasicHashGroupedMaxIndex < num_buckets_idx) return 0;
+        CFIndex num_buckets = __CFBasicHashGetNumBucketsForIndex(ht, num_buckets_idx);
+        return num_buckets - num_buckets / 8;
+    }
     return __CFBasicHashTableCapacities[num_buckets_idx];
 }
 
@@ -707,8 +801,14 @@ CF_INLINE CFIndex __CFBasicHashGetNumBucketsIndexForCapacity(CFConstBasicHashRef
     return 0;
 }
 
+// Deleted buckets do not end a probe of a grouped table, so they count
+// against its capacity.
+CF_INLINE CFIndex __CFBasicHashGetLoad(CFConstBasicHashRef ht) {
+    return ht->bits.used_buckets + (__CFBasicHashIsGrouped(ht) ? ht->bits.deleted : 0);
+}
+
 CF_PRIVATE CFIndex CFBasicHashGetNumBuckets(CFConstBasicHashRef ht) {
-    return __CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+    return __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
 }
 
 CF_PRIVATE CFIndex CFBasicHashGetCapacity(CFConstBasicHashRef ht) {
@@ -856,12 +956,96 @@ static uintptr_t __CFBasicHashFold(uintptr_t dividend, uint8_t idx) {
 #define FIND_BUCKET_FOR_INDIRECT_KEY	1
 #include "CFBasicHashFindBucket.m"
 
+// Grouped hashing
+// The buckets are divided into groups of 16, and a probe compares the 16
+// control bytes of a group at once, looking only at the keys whose control
+// bytes match. The groups are visited in triangular order, which covers
+// every group of a power of 2 table, until one with an empty bucket.
+// If key_hash is non-0, it is used as the hash code.
+static CFBasicHashBucket ___CFBasicHashFindBucket_Grouped(CFConstBasicHashRef ht, uintptr_t stack_key, uintptr_t key_hash) {
+    uintptr_t num_buckets = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
+    uintptr_t group_mask = num_buckets / __CFBasicHashGroupWidth - 1;
+    CFHashCode hash_code = key_hash ? key_hash : __CFBasicHashHashKey(ht, stack_key);
+    uintptr_t mixed = __CFBasicHashMixHashCode(hash_code);
+    uint8_t control = mixed & 0x7F;
+    uintptr_t group = (mixed >> 7) & group_mask;
+
+    COCOA_HASHTABLE_PROBING_START(ht, num_buckets);
+    const uint8_t *controls = __CFBasicHashGetControls(ht);
+    CFBasicHashValue *keys = (ht->bits.keys_offset) ? __CFBasicHashGetKeys(ht) : __CFBasicHashGetValues(ht);
+    CFIndex stride = __CFBasicHashGetStride(ht);
+    uintptr_t *hashes = (__CFBasicHashHasHashCache(ht)) ? __CFBasicHashGetHashes(ht) : NULL;
+    CFIndex deleted_idx = kCFNotFound;
+    for (uintptr_t probe = 0; probe <= group_mask; probe++) {
+        const uint8_t *group_controls = controls + group * __CFBasicHashGroupWidth;
+        for (uint32_t match = __CFBasicHashMatchControl(group_controls, control); match; match &= match - 1) {
+            CFIndex idx = group * __CFBasicHashGroupWidth + __builtin_ctz(match);
+            COCOA_HASHTABLE_PROBE_VALID(ht, idx);
+            uintptr_t curr_key = keys[idx * stride].neutral;
+            if (__CFBasicHashSubABZero == curr_key) curr_key = 0UL;
+            if (__CFBasicHashSubABOne == curr_key) curr_key = ~0UL;
+            if (ht->bits.indirect_keys) {
+                // curr_key holds the value coming in here
+                curr_key = __CFBasicHashGetIndirectKey(ht, curr_key);
+            }
+            if (curr_key == stack_key || ((!hashes || hashes[idx] == hash_code) && __CFBasicHashTestEqualKey(ht, curr_key, stack_key))) {
+                COCOA_HASHTABLE_PROBING_END(ht, probe + 1);
+                CFBasicHashBucket result;
+                result.idx = idx;
+                result.weak_value = __CFBasicHashGetValue(ht, idx);
+                result.weak_key = curr_key;
+                result.count = (ht->bits.counts_offset) ? __CFBasicHashGetSlotCount(ht, idx) : 1;
+                return result;
+            }
+        }
+        if (kCFNotFound == deleted_idx) {
+            uint32_t deleted = __CFBasicHashMatchControl(group_controls, __CFBasicHashControlDeleted);
+            if (deleted) {
+                deleted_idx = group * __CFBasicHashGroupWidth + __builtin_ctz(deleted);
+                COCOA_HASHTABLE_PROBE_DELETED(ht, deleted_idx);
+            }
+        }
+        uint32_t empty = __CFBasicHashMatchControl(group_controls, __CFBasicHashControlEmpty);
+        if (empty) {
+            CFBasicHashBucket result;
+            result.idx = (kCFNotFound == deleted_idx) ? group * __CFBasicHashGroupWidth + __builtin_ctz(empty) : deleted_idx;
+            result.count = 0;
+            COCOA_HASHTABLE_PROBE_EMPTY(ht, result.idx);
+            COCOA_HASHTABLE_PROBING_END(ht, probe + 1);
+            return result;
+        }
+        group = (group + probe + 1) & group_mask;
+    }
+    COCOA_HASHTABLE_PROBING_END(ht, group_mask + 1);
+    CFBasicHashBucket result;
+    result.idx = deleted_idx;
+    result.count = 0;
+    return result; // all buckets full or deleted, return first deleted element which was found
+}
+
+static CFIndex ___CFBasicHashFindBucket_Grouped_NoCollision(CFConstBasicHashRef ht, uintptr_t stack_key, uintptr_t key_hash) {
+    uintptr_t num_buckets = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
+    uintptr_t group_mask = num_buckets / __CFBasicHashGroupWidth - 1;
+    CFHashCode hash_code = key_hash ? key_hash : __CFBasicHashHashKey(ht, stack_key);
+    uintptr_t group = (__CFBasicHashMixHashCode(hash_code) >> 7) & group_mask;
+    const uint8_t *controls = __CFBasicHashGetControls(ht);
+    for (uintptr_t probe = 0; probe <= group_mask; probe++) {
+        uint32_t available = __CFBasicHashMatchEmptyOrDeleted(controls + group * __CFBasicHashGroupWidth);
+        if (available) return group * __CFBasicHashGroupWidth + __builtin_ctz(available);
+        group = (group + probe + 1) & group_mask;
+    }
+    return kCFNotFound;
+}
+
 
 CF_INLINE CFBasicHashBucket __CFBasicHashFindBucket(CFConstBasicHashRef ht, uintptr_t stack_key) {
     if (0 == ht->bits.num_buckets_idx) {
         CFBasicHashBucket result = {kCFNotFound, 0UL, 0UL, 0};
         return result;
     }
+    if (__CFBasicHashIsGrouped(ht)) {
+        return ___CFBasicHashFindBucket_Grouped(ht, stack_key, 0UL);
+    }
     if (ht->bits.indirect_keys) {
         switch (ht->bits.hash_style) {
         case __kCFBasicHashLinearHashingValue: return ___CFBasicHashFindBucket_Linear_Indirect(ht, stack_key);
@@ -884,6 +1068,9 @@ CF_INLINE CFIndex __CFBasicHashFindBucket_NoCollision(CFConstBasicHashRef ht, ui
     if (0 == ht->bits.num_buckets_idx) {
         return kCFNotFound;
     }
+    if (__CFBasicHashIsGrouped(ht)) {
+        return ___CFBasicHashFindBucket_Grouped_NoCollision(ht, stack_key, key_hash);
+    }
     if (ht->bits.indirect_keys) {
         switch (ht->bits.hash_style) {
         case __kCFBasicHashLinearHashingValue: return ___CFBasicHashFindBucket_Linear_Indirect_NoCollision(ht, stack_key, key_hash);
@@ -901,6 +1088,19 @@ CF_INLINE CFIndex __CFBasicHashFindBucket_NoCollision(CFConstBasicHashRef ht, ui
     return kCFNotFound;
 }
 
+// Finds the bucket for a key which may be about to be added. A grouped
+// table needs the hash code of an added key for its control byte, so the
+// hash code is passed back here rather than computed again by the add;
+// it is 0 if the probe did not compute one.
+CF_INLINE CFBasicHashBucket __CFBasicHashFindBucketForAdd(CFConstBasicHashRef ht, uintptr_t stack_key, uintptr_t *key_hash) {
+    *key_hash = 0UL;
+    if (__CFBasicHashIsGrouped(ht) && 0 != ht->bits.num_buckets_idx) {
+        *key_hash = __CFBasicHashHashKey(ht, stack_key);
+        return ___CFBasicHashFindBucket_Grouped(ht, stack_key, *key_hash);
+    }
+    return __CFBasicHashFindBucket(ht, stack_key);
+}
+
 CF_PRIVATE CFBasicHashBucket CFBasicHashFindBucket(CFConstBasicHashRef ht, uintptr_t stack_key) {
     if (__CFBasicHashSubABZero == stack_key || __CFBasicHashSubABOne == stack_key) {
         CFBasicHashBucket result = {kCFNotFound, 0UL, 0UL, 0};
@@ -918,7 +1118,7 @@ CF_PRIVATE void CFBasicHashUnsuppressRC(CFBasicHashRef ht) {
 }
 
 CF_PRIVATE CFOptionFlags CFBasicHashGetFlags(CFConstBasicHashRef ht) {
-    CFOptionFlags flags = (ht->bits.hash_style << 13);
+    CFOptionFlags flags = __CFBasicHashIsGrouped(ht) ? kCFBasicHashGroupedHashing : (ht->bits.hash_style << 13);
     if (CFBasicHashHasStrongValues(ht)) flags |= kCFBasicHashStrongValues;
     if (CFBasicHashHasStrongKeys(ht)) flags |= kCFBasicHashStrongKeys;
     if (ht->bits.fast_grow) flags |= kCFBasicHashAggressiveGrowth;
@@ -931,7 +1131,7 @@ CF_PRIVATE CFOptionFlags CFBasicHashGetFlags(CFConstBasicHashRef ht) {
 CF_PRIVATE CFIndex CFBasicHashGetCount(CFConstBasicHashRef ht) {
     if (ht->bits.counts_offset) {
         CFIndex total = 0L;
-        CFIndex cnt = (CFIndex)__CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+        CFIndex cnt = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
         for (CFIndex idx = 0; idx < cnt; idx++) {
             total += __CFBasicHashGetSlotCount(ht, idx);
         }
@@ -989,7 +1189,7 @@ CF_PRIVATE Boolean CFBasicHashesAreEqual(CFConstBasicHashRef ht1, CFConstBasicHa
 }
 
 CF_PRIVATE void CFBasicHashApply(CFConstBasicHashRef ht, Boolean (^block)(CFBasicHashBucket)) {
-    CFIndex used = (CFIndex)ht->bits.used_buckets, cnt = (CFIndex)__CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+    CFIndex used = (CFIndex)ht->bits.used_buckets, cnt = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
     for (CFIndex idx = 0; 0 < used && idx < cnt; idx++) {
         CFBasicHashBucket bkt = CFBasicHashGetBucket(ht, idx);
         if (0 < bkt.count) {
@@ -1004,7 +1204,7 @@ CF_PRIVATE void CFBasicHashApply(CFConstBasicHashRef ht, Boolean (^block)(CFBasi
 CF_PRIVATE void CFBasicHashApplyIndexed(CFConstBasicHashRef ht, CFRange range, Boolean (^block)(CFBasicHashBucket)) {
     if (range.length < 0) HALT;
     if (range.length == 0) return;
-    CFIndex cnt = (CFIndex)__CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+    CFIndex cnt = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
     if (cnt < range.location + range.length) HALT;
     for (CFIndex idx = 0; idx < range.length; idx++) {
         CFBasicHashBucket bkt = CFBasicHashGetBucket(ht, range.location + idx);
@@ -1017,7 +1217,7 @@ CF_PRIVATE void CFBasicHashApplyIndexed(CFConstBasicHashRef ht, CFRange range, B
 }
 
 CF_PRIVATE void CFBasicHashGetElements(CFConstBasicHashRef ht, CFIndex bufferslen, uintptr_t *weak_values, uintptr_t *weak_keys) {
-    CFIndex used = (CFIndex)ht->bits.used_buckets, cnt = (CFIndex)__CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+    CFIndex used = (CFIndex)ht->bits.used_buckets, cnt = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
     CFIndex offset = 0;
     for (CFIndex idx = 0; 0 < used && idx < cnt && offset < bufferslen; idx++) {
         CFBasicHashBucket bkt = CFBasicHashGetBucket(ht, idx);
@@ -1039,7 +1239,7 @@ CF_PRIVATE unsigned long __CFBasicHashFastEnumeration(CFConstBasicHashRef ht, st
     }
     state->itemsPtr = (unsigned long *)stackbuffer;
     CFIndex cntx = 0;
-    CFIndex used = (CFIndex)ht->bits.used_buckets, cnt = (CFIndex)__CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+    CFIndex used = (CFIndex)ht->bits.used_buckets, cnt = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
     for (CFIndex idx = (CFIndex)state->state; 0 < used && idx < cnt && cntx < (CFIndex)count; idx++) {
         CFBasicHashBucket bkt = CFBasicHashGetBucket(ht, idx);
         if (0 < bkt.count) {
@@ -1064,7 +1264,9 @@ static void __CFBasicHashDrain(CFBasicHashRef ht, Boolean forFinalization) {
     OSAtomicAdd64Barrier(-1 * (int64_t) CFBasicHashGetSize(ht, true), & __CFBasicHashTotalSize);
 #endif
 
-    CFIndex old_num_buckets = __CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+    CFIndex old_num_buckets = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
+    Boolean old_grouped = __CFBasicHashIsGrouped(ht);
+    CFIndex old_stride = __CFBasicHashGetStride(ht);
 
     CFAllocatorRef allocator = CFGetAllocator(ht);
     Boolean nullify = (!forFinalization || !CF_IS_COLLECTABLE_ALLOCATOR(allocator));
@@ -1096,14 +1298,14 @@ static void __CFBasicHashDrain(CFBasicHashRef ht, Boolean forFinalization) {
     }
     
         for (CFIndex idx = 0; idx < old_num_buckets; idx++) {
-            uintptr_t stack_value = old_values[idx].neutral;
+            uintptr_t stack_value = old_values[idx * old_stride].neutral;
             if (stack_value != 0UL && stack_value != ~0UL) {
                 uintptr_t old_value = stack_value;
                 if (__CFBasicHashSubABZero == old_value) old_value = 0UL;
                 if (__CFBasicHashSubABOne == old_value) old_value = ~0UL;
                 __CFBasicHashEjectValue(ht, old_value);
                 if (old_keys) {
-                    uintptr_t old_key = old_keys[idx].neutral;
+                    uintptr_t old_key = old_keys[idx * old_stride].neutral;
                     if (__CFBasicHashSubABZero == old_key) old_key = 0UL;
                     if (__CFBasicHashSubABOne == old_key) old_key = ~0UL;
                     __CFBasicHashEjectKey(ht, old_key);
@@ -1112,8 +1314,8 @@ static void __CFBasicHashDrain(CFBasicHashRef ht, Boolean forFinalization) {
         }
 
     if (!CF_IS_COLLECTABLE_ALLOCATOR(allocator)) {
-        CFAllocatorDeallocate(allocator, old_values);
-        CFAllocatorDeallocate(allocator, old_keys);
+        CFAllocatorDeallocate(allocator, __CFBasicHashGetValuesAllocation(old_values, old_num_buckets, old_grouped));
+        if (!old_grouped) CFAllocatorDeallocate(allocator, old_keys);
         CFAllocatorDeallocate(allocator, old_counts);
         CFAllocatorDeallocate(allocator, old_hashes);
     }
@@ -1124,7 +1326,10 @@ static void __CFBasicHashDrain(CFBasicHashRef ht, Boolean forFinalization) {
 #endif
 }
 
-static void __CFBasicHashRehash(CFBasicHashRef ht, CFIndex newItemCount) {
+// The old buckets are read with the layout of the table's current hash
+// style and the new buckets written with that of hash_style, which may be
+// different.
+static void __CFBasicHashRehashWithStyle(CFBasicHashRef ht, CFIndex newItemCount, uint8_t hash_style) {
 #if ENABLE_MEMORY_COUNTERS
     OSAtomicAdd64Barrier(-1 * (int64_t) CFBasicHashGetSize(ht, true), & __CFBasicHashTotalSize);
     OSAtomicAdd32Barrier(-1, &__CFBasicHashSizes[ht->bits.num_buckets_idx]);
@@ -1132,8 +1337,17 @@ static void __CFBasicHashRehash(CFBasicHashRef ht, CFIndex newItemCount) {
 
     if (COCOA_HASHTABLE_REHASH_START_ENABLED()) COCOA_HASHTABLE_REHASH_START(ht, CFBasicHashGetNumBuckets(ht), CFBasicHashGetSize(ht, true));
 
+    CFIndex old_num_buckets = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
+    Boolean old_grouped = __CFBasicHashIsGrouped(ht);
+    CFIndex old_stride = __CFBasicHashGetStride(ht);
+
+    Boolean restyle = (hash_style != ht->bits.hash_style);
+    ht->bits.hash_style = hash_style;
+    Boolean new_grouped = __CFBasicHashIsGrouped(ht);
+    CFIndex new_stride = __CFBasicHashGetStride(ht);
+
     CFIndex new_num_buckets_idx = ht->bits.num_buckets_idx;
-    if (0 != newItemCount) {
+    if (0 != newItemCount || restyle) {
         if (newItemCount < 0) newItemCount = 0;
         CFIndex new_capacity_req = ht->bits.used_buckets + newItemCount;
         new_num_buckets_idx = __CFBasicHashGetNumBucketsIndexForCapacity(ht, new_capacity_req);
@@ -1142,23 +1356,35 @@ static void __CFBasicHashRehash(CFBasicHashRef ht, CFIndex newItemCount) {
         }
     }
 
-    CFIndex new_num_buckets = __CFBasicHashTableSizes[new_num_buckets_idx];
-    CFIndex old_num_buckets = __CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+    CFIndex new_num_buckets = __CFBasicHashGetNumBucketsForIndex(ht, new_num_buckets_idx);
 
     CFBasicHashValue *new_values = NULL, *new_keys = NULL;
+    uint8_t *new_controls = NULL;
     void *new_counts = NULL;
     uintptr_t *new_hashes = NULL;
 
     if (0 < new_num_buckets) {
-        new_values = (CFBasicHashValue *)__CFBasicHashAllocateMemory(ht, new_num_buckets, sizeof(CFBasicHashValue), CFBasicHashHasStrongValues(ht), 0);
-        if (!new_values) HALT;
-        __SetLastAllocationEventName(new_values, "CFBasicHash (value-store)");
-        memset(new_values, 0, new_num_buckets * sizeof(CFBasicHashValue));
-        if (ht->bits.keys_offset) {
-            new_keys = (CFBasicHashValue *)__CFBasicHashAllocateMemory(ht, new_num_buckets, sizeof(CFBasicHashValue), CFBasicHashHasStrongKeys(ht), 0);
-            if (!new_keys) HALT;
-            __SetLastAllocationEventName(new_keys, "CFBasicHash (key-store)");
-            memset(new_keys, 0, new_num_buckets * sizeof(CFBasicHashValue));
+        if (new_grouped) {
+            new_controls = (uint8_t *)__CFBasicHashAllocateMemory(ht, new_num_buckets, 1 + new_stride * sizeof(CFBasicHashValue), CFBasicHashHasStrongValues(ht) || CFBasicHashHasStrongKeys(ht), 0);
+            if (!new_controls) HALT;
+            __SetLastAllocationEventName(new_controls, "CFBasicHash (grouped-store)");
+            memset(new_controls, __CFBasicHashControlEmpty, new_num_buckets);
+            new_values = (CFBasicHashValue *)(new_controls + new_num_buckets);
+            memset(new_values, 0, new_num_buckets * new_stride * sizeof(CFBasicHashValue));
+            if (ht->bits.keys_offset) {
+                new_keys = new_values + 1;
+            }
+        } else {
+            new_values = (CFBasicHashValue *)__CFBasicHashAllocateMemory(ht, new_num_buckets, sizeof(CFBasicHashValue), CFBasicHashHasStrongValues(ht), 0);
+            if (!new_values) HALT;
+            __SetLastAllocationEventName(new_values, "CFBasicHash (value-store)");
+            memset(new_values, 0, new_num_buckets * sizeof(CFBasicHashValue));
+            if (ht->bits.keys_offset) {
+                new_keys = (CFBasicHashValue *)__CFBasicHashAllocateMemory(ht, new_num_buckets, sizeof(CFBasicHashValue), CFBasicHashHasStrongKeys(ht), 0);
+                if (!new_keys) HALT;
+                __SetLastAllocationEventName(new_keys, "CFBasicHash (key-store)");
+                memset(new_keys, 0, new_num_buckets * sizeof(CFBasicHashValue));
+            }
         }
         if (ht->bits.counts_offset) {
             new_counts = (uintptr_t *)__CFBasicHashAllocateMemory(ht, new_num_buckets, (1 << ht->bits.counts_width), false, false);
@@ -1198,24 +1424,31 @@ static void __CFBasicHashRehash(CFBasicHashRef ht, CFIndex newItemCount) {
 
     if (0 < old_num_buckets) {
         for (CFIndex idx = 0; idx < old_num_buckets; idx++) {
-            uintptr_t stack_value = old_values[idx].neutral;
+            uintptr_t stack_value = old_values[idx * old_stride].neutral;
             if (stack_value != 0UL && stack_value != ~0UL) {
                 if (__CFBasicHashSubABZero == stack_value) stack_value = 0UL;
                 if (__CFBasicHashSubABOne == stack_value) stack_value = ~0UL;
                 uintptr_t stack_key = stack_value;
                 if (ht->bits.keys_offset) {
-                    stack_key = old_keys[idx].neutral;
+                    stack_key = old_keys[idx * old_stride].neutral;
                     if (__CFBasicHashSubABZero == stack_key) stack_key = 0UL;
                     if (__CFBasicHashSubABOne == stack_key) stack_key = ~0UL;
                 }
                 if (ht->bits.indirect_keys) {
                     stack_key = __CFBasicHashGetIndirectKey(ht, stack_value);
                 }
-                CFIndex bkt_idx = __CFBasicHashFindBucket_NoCollision(ht, stack_key, old_hashes ? old_hashes[idx] : 0UL);
+                uintptr_t key_hash = old_hashes ? old_hashes[idx] : 0UL;
+                if (new_grouped && 0UL == key_hash) {
+                    key_hash = __CFBasicHashHashKey(ht, stack_key);
+                }
+                CFIndex bkt_idx = __CFBasicHashFindBucket_NoCollision(ht, stack_key, key_hash);
                 __CFBasicHashSetValue(ht, bkt_idx, stack_value, false, false);
                 if (old_keys) {
                     __CFBasicHashSetKey(ht, bkt_idx, stack_key, false, false);
                 }
+                if (new_grouped) {
+                    __CFBasicHashSetControl(ht, bkt_idx, key_hash);
+                }
                 if (old_counts) {
                     switch (ht->bits.counts_width) {
                     case 0: ((uint8_t *)new_counts)[bkt_idx] = ((uint8_t *)old_counts)[idx]; break;
@@ -1233,8 +1466,8 @@ static void __CFBasicHashRehash(CFBasicHashRef ht, CFIndex newItemCount) {
 
     CFAllocatorRef allocator = CFGetAllocator(ht);
     if (!CF_IS_COLLECTABLE_ALLOCATOR(allocator)) {
-        CFAllocatorDeallocate(allocator, old_values);
-        CFAllocatorDeallocate(allocator, old_keys);
+        CFAllocatorDeallocate(allocator, __CFBasicHashGetValuesAllocation(old_values, old_num_buckets, old_grouped));
+        if (!old_grouped) CFAllocatorDeallocate(allocator, old_keys);
         CFAllocatorDeallocate(allocator, old_counts);
         CFAllocatorDeallocate(allocator, old_hashes);
     }
@@ -1248,6 +1481,10 @@ static void __CFBasicHashRehash(CFBasicHashRef ht, CFIndex newItemCount) {
 #endif
 }
 
+CF_INLINE void __CFBasicHashRehash(CFBasicHashRef ht, CFIndex newItemCount) {
+    __CFBasicHashRehashWithStyle(ht, newItemCount, ht->bits.hash_style);
+}
+
 CF_PRIVATE void CFBasicHashSetCapacity(CFBasicHashRef ht, CFIndex capacity) {
     if (!CFBasicHashIsMutable(ht)) HALT;
     if (ht->bits.used_buckets < capacity) {
@@ -1256,18 +1493,28 @@ CF_PRIVATE void CFBasicHashSetCapacity(CFBasicHashRef ht, CFIndex capacity) {
     }
 }
 
-static void __CFBasicHashAddValue(CFBasicHashRef ht, CFIndex bkt_idx, uintptr_t stack_key, uintptr_t stack_value) {
+CF_PRIVATE void CFBasicHashSetHashStyle(CFBasicHashRef ht, CFOptionFlags style) {
+    if (!CFBasicHashIsMutable(ht)) HALT;
+    uint8_t hash_style = (style & kCFBasicHashGroupedHashing) ? __kCFBasicHashGroupedHashingValue : ((style >> 13) & 0x3);
+    if (0 == hash_style) HALT;
+    if (__kCFBasicHashGroupedHashingValue == hash_style && CF_IS_COLLECTABLE_ALLOCATOR(CFGetAllocator(ht))) return;
+    if (hash_style == ht->bits.hash_style) return;
+    ht->bits.mutations++;
+    __CFBasicHashRehashWithStyle(ht, 0, hash_style);
+}
+
+// If key_hash is non-0, it is used as the hash code.
+static void __CFBasicHashAddValue(CFBasicHashRef ht, CFIndex bkt_idx, uintptr_t stack_key, uintptr_t stack_value, uintptr_t key_hash) {
     ht->bits.mutations++;
-    if (CFBasicHashGetCapacity(ht) < ht->bits.used_buckets + 1) {
+    if (0UL == key_hash && (__CFBasicHashHasHashCache(ht) || __CFBasicHashIsGrouped(ht))) {
+        key_hash = __CFBasicHashHashKey(ht, stack_key);
+    }
+    if (CFBasicHashGetCapacity(ht) < __CFBasicHashGetLoad(ht) + 1) {
         __CFBasicHashRehash(ht, 1);
-        bkt_idx = __CFBasicHashFindBucket_NoCollision(ht, stack_key, 0);
+        bkt_idx = __CFBasicHashFindBucket_NoCollision(ht, stack_key, key_hash);
     } else if (__CFBasicHashIsDeleted(ht, bkt_idx)) {
         ht->bits.deleted--;
     }
-    uintptr_t key_hash = 0;
-    if (__CFBasicHashHasHashCache(ht)) {
-        key_hash = __CFBasicHashHashKey(ht, stack_key);
-    }
     stack_value = __CFBasicHashImportValue(ht, stack_value);
     if (ht->bits.keys_offset) {
         stack_key = __CFBasicHashImportKey(ht, stack_key);
@@ -1279,6 +1526,9 @@ static void __CFBasicHashAddValue(CFBasicHashRef ht, CFIndex bkt_idx, uintptr_t
     if (ht->bits.counts_offset) {
         __CFBasicHashIncSlotCount(ht, bkt_idx);
     }
+    if (__CFBasicHashIsGrouped(ht)) {
+        __CFBasicHashSetControl(ht, bkt_idx, key_hash);
+    }
     if (__CFBasicHashHasHashCache(ht)) {
         __CFBasicHashGetHashes(ht)[bkt_idx] = key_hash;
     }
@@ -1299,9 +1549,19 @@ static void __CFBasicHashReplaceValue(CFBasicHashRef ht, CFIndex bkt_idx, uintpt
 
 static void __CFBasicHashRemoveValue(CFBasicHashRef ht, CFIndex bkt_idx) {
     ht->bits.mutations++;
-    __CFBasicHashSetValue(ht, bkt_idx, ~0UL, false, true);
+    // A bucket of a grouped table can be made empty again rather than
+    // deleted if its group still has an empty bucket, since every probe
+    // which reached this group stopped in it.
+    uintptr_t marker = ~0UL;
+    if (__CFBasicHashIsGrouped(ht)) {
+        uint8_t *controls = __CFBasicHashGetControls(ht);
+        Boolean group_has_empty = (0 != __CFBasicHashMatchControl(controls + (bkt_idx & ~(CFIndex)(__CFBasicHashGroupWidth - 1)), __CFBasicHashControlEmpty));
+        controls[bkt_idx] = group_has_empty ? __CFBasicHashControlEmpty : __CFBasicHashControlDeleted;
+        if (group_has_empty) marker = 0UL;
+    }
+    __CFBasicHashSetValue(ht, bkt_idx, marker, false, true);
     if (ht->bits.keys_offset) {
-        __CFBasicHashSetKey(ht, bkt_idx, ~0UL, false, true);
+        __CFBasicHashSetKey(ht, bkt_idx, marker, false, true);
     }
     if (ht->bits.counts_offset) {
         __CFBasicHashDecSlotCount(ht, bkt_idx);
@@ -1310,7 +1570,7 @@ static void __CFBasicHashRemoveValue(CFBasicHashRef ht, CFIndex bkt_idx) {
         __CFBasicHashGetHashes(ht)[bkt_idx] = 0;
     }
     ht->bits.used_buckets--;
-    ht->bits.deleted++;
+    if (~0UL == marker) ht->bits.deleted++;
     Boolean do_shrink = false;
     if (ht->bits.fast_grow) { // == slow shrink
         do_shrink = (5 < ht->bits.num_buckets_idx && ht->bits.used_buckets < __CFBasicHashGetCapacityForNumBuckets(ht, ht->bits.num_buckets_idx - 5));
@@ -1321,8 +1581,9 @@ static void __CFBasicHashRemoveValue(CFBasicHashRef ht, CFIndex bkt_idx) {
         __CFBasicHashRehash(ht, -1);
         return;
     }
+    if (0UL == marker) return;
     do_shrink = (0 == ht->bits.deleted); // .deleted roll-over
-    CFIndex num_buckets = __CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+    CFIndex num_buckets = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
     do_shrink = do_shrink || ((20 <= num_buckets) && (num_buckets / 4 <= ht->bits.deleted));
     if (do_shrink) {
         __CFBasicHashRehash(ht, 0);
@@ -1335,7 +1596,8 @@ CF_PRIVATE Boolean CFBasicHashAddValue(CFBasicHashRef ht, uintptr_t stack_key, u
     if (__CFBasicHashSubABOne == stack_key) HALT;
     if (__CFBasicHashSubABZero == stack_value) HALT;
     if (__CFBasicHashSubABOne == stack_value) HALT;
-    CFBasicHashBucket bkt = __CFBasicHashFindBucket(ht, stack_key);
+    uintptr_t key_hash;
+    CFBasicHashBucket bkt = __CFBasicHashFindBucketForAdd(ht, stack_key, &key_hash);
     if (0 < bkt.count) {
         ht->bits.mutations++;
         if (ht->bits.counts_offset && bkt.count < LONG_MAX) { // if not yet as large as a CFIndex can be... otherwise clamp and do nothing
@@ -1343,7 +1605,7 @@ CF_PRIVATE Boolean CFBasicHashAddValue(CFBasicHashRef ht, uintptr_t stack_key, u
             return true;
         }
     } else {
-        __CFBasicHashAddValue(ht, bkt.idx, stack_key, stack_value);
+        __CFBasicHashAddValue(ht, bkt.idx, stack_key, stack_value, key_hash);
         return true;
     }
     return false;
@@ -1367,11 +1629,12 @@ CF_PRIVATE void CFBasicHashSetValue(CFBasicHashRef ht, uintptr_t stack_key, uint
     if (__CFBasicHashSubABOne == stack_key) HALT;
     if (__CFBasicHashSubABZero == stack_value) HALT;
     if (__CFBasicHashSubABOne == stack_value) HALT;
-    CFBasicHashBucket bkt = __CFBasicHashFindBucket(ht, stack_key);
+    uintptr_t key_hash;
+    CFBasicHashBucket bkt = __CFBasicHashFindBucketForAdd(ht, stack_key, &key_hash);
     if (0 < bkt.count) {
         __CFBasicHashReplaceValue(ht, bkt.idx, stack_key, stack_value);
     } else {
-        __CFBasicHashAddValue(ht, bkt.idx, stack_key, stack_value);
+        __CFBasicHashAddValue(ht, bkt.idx, stack_key, stack_value, key_hash);
     }
 }
 
@@ -1421,11 +1684,11 @@ CF_PRIVATE Boolean CFBasicHashAddIntValueAndInc(CFBasicHashRef ht, uintptr_t sta
         ht->bits.mutations++;
     } else {
         // must rehash before renumbering
-        if (CFBasicHashGetCapacity(ht) < ht->bits.used_buckets + 1) {
+        if (CFBasicHashGetCapacity(ht) < __CFBasicHashGetLoad(ht) + 1) {
             __CFBasicHashRehash(ht, 1);
             bkt.idx = __CFBasicHashFindBucket_NoCollision(ht, stack_key, 0);
         }
-        CFIndex cnt = (CFIndex)__CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+        CFIndex cnt = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
         for (CFIndex idx = 0; idx < cnt; idx++) {
             if (!__CFBasicHashIsEmptyOrDeleted(ht, idx)) {
                 uintptr_t stack_value = __CFBasicHashGetValue(ht, idx);
@@ -1436,7 +1699,7 @@ CF_PRIVATE Boolean CFBasicHashAddIntValueAndInc(CFBasicHashRef ht, uintptr_t sta
                 }
             }
         }
-        __CFBasicHashAddValue(ht, bkt.idx, stack_key, int_value);
+        __CFBasicHashAddValue(ht, bkt.idx, stack_key, int_value, 0UL);
         return true;
     }
     return false;
@@ -1447,7 +1710,7 @@ CF_PRIVATE void CFBasicHashRemoveIntValueAndDec(CFBasicHashRef ht, uintptr_t int
     if (__CFBasicHashSubABZero == int_value) HALT;
     if (__CFBasicHashSubABOne == int_value) HALT;
     uintptr_t bkt_idx = ~0UL;
-    CFIndex cnt = (CFIndex)__CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+    CFIndex cnt = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
     for (CFIndex idx = 0; idx < cnt; idx++) {
         if (!__CFBasicHashIsEmptyOrDeleted(ht, idx)) {
             uintptr_t stack_value = __CFBasicHashGetValue(ht, idx);
@@ -1470,10 +1733,10 @@ CF_PRIVATE size_t CFBasicHashGetSize(CFConstBasicHashRef ht, Boolean total) {
     if (ht->bits.counts_offset) size += sizeof(void *);
     if (__CFBasicHashHasHashCache(ht)) size += sizeof(uintptr_t *);
     if (total) {
-        CFIndex num_buckets = __CFBasicHashTableSizes[ht->bits.num_buckets_idx];
+        CFIndex num_buckets = __CFBasicHashGetNumBucketsForIndex(ht, ht->bits.num_buckets_idx);
         if (0 < num_buckets) {
-            size += malloc_size(__CFBasicHashGetValues(ht));
-            if (ht->bits.keys_offset) size += malloc_size(__CFBasicHashGetKeys(ht));
+            size += malloc_size(__CFBasicHashGetValuesAllocation(__CFBasicHashGetValues(ht), num_buckets, __CFBasicHashIsGrouped(ht)));
+            if (ht->bits.keys_offset && !__CFBasicHashIsGrouped(ht)) size += malloc_size(__CFBasicHashGetKeys(ht));
             if (ht->bits.counts_offset) size += malloc_size(__CFBasicHashGetCounts(ht));
             if (__CFBasicHashHasHashCache(ht)) size += malloc_size(__CFBasicHashGetHashes(ht));
         }
@@ -1589,7 +1852,8 @@ CF_PRIVATE CFBasicHashRef CFBasicHashCreate(CFAllocatorRef allocator, CFOptionFl
     if (NULL == ht) return NULL;
 
     ht->bits.finalized = 0;
-    ht->bits.hash_style = (flags >> 13) & 0x3;
+    ht->bits.hash_style = (flags & kCFBasicHashGroupedHashing) ? __kCFBasicHashGroupedHashingValue : ((flags >> 13) & 0x3);
+    if (__CFBasicHashIsGrouped(ht) && CF_IS_COLLECTABLE_ALLOCATOR(allocator)) ht->bits.hash_style = __kCFBasicHashLinearHashingValue;
     ht->bits.fast_grow = (flags & kCFBasicHashAggressiveGrowth) ? 1 : 0;
     ht->bits.counts_width = 0;
     ht->bits.strong_values = (flags & kCFBasicHashStrongValues) ? 1 : 0;
@@ -1655,7 +1919,8 @@ CF_PRIVATE CFBasicHashRef CFBasicHashCreate(CFAllocatorRef allocator, CFOptionFl
 
 CF_PRIVATE CFBasicHashRef CFBasicHashCreateCopy(CFAllocatorRef allocator, CFConstBasicHashRef src_ht) {
     size_t size = CFBasicHashGetSize(src_ht, false) - sizeof(CFRuntimeBase);
-    CFIndex new_num_buckets = __CFBasicHashTableSizes[src_ht->bits.num_buckets_idx];
+    CFIndex new_num_buckets = __CFBasicHashGetNumBucketsForIndex(src_ht, src_ht->bits.num_buckets_idx);
+    CFIndex stride = __CFBasicHashGetStride(src_ht);
     CFBasicHashValue *new_values = NULL, *new_keys = NULL;
     void *new_counts = NULL;
     uintptr_t *new_hashes = NULL;
@@ -1663,13 +1928,24 @@ CF_PRIVATE CFBasicHashRef CFBasicHashCreateCopy(CFAllocatorRef allocator, CFCons
     if (0 < new_num_buckets) {
         Boolean strongValues = CFBasicHashHasStrongValues(src_ht) && !(kCFUseCollectableAllocator && !CF_IS_COLLECTABLE_ALLOCATOR(allocator));
         Boolean strongKeys = CFBasicHashHasStrongKeys(src_ht) && !(kCFUseCollectableAllocator && !CF_IS_COLLECTABLE_ALLOCATOR(allocator));
-        new_values = (CFBasicHashValue *)__CFBasicHashAllocateMemory2(allocator, new_num_buckets, sizeof(CFBasicHashValue), strongValues, 0);
-        if (!new_values) return NULL; // in this unusual circumstance, leak previously allocated blocks for now
-        __SetLastAllocationEventName(new_values, "CFBasicHash (value-store)");
-        if (src_ht->bits.keys_offset) {
-            new_keys = (CFBasicHashValue *)__CFBasicHashAllocateMemory2(allocator, new_num_buckets, sizeof(CFBasicHashValue), strongKeys, false);
-            if (!new_keys) return NULL; // in this unusual circumstance, leak previously allocated blocks for now
-            __SetLastAllocationEventName(new_keys, "CFBasicHash (key-store)");
+        if (__CFBasicHashIsGrouped(src_ht)) {
+            uint8_t *new_controls = (uint8_t *)__CFBasicHashAllocateMemory2(allocator, new_num_buckets, 1 + stride * sizeof(CFBasicHashValue), strongValues || strongKeys, 0);
+            if (!new_controls) return NULL;
+            __SetLastAllocationEventName(new_controls, "CFBasicHash (grouped-store)");
+            memmove(new_controls, __CFBasicHashGetControls(src_ht), new_num_buckets);
+            new_values = (CFBasicHashValue *)(new_controls + new_num_buckets);
+            if (src_ht->bits.keys_offset) {
+                new_keys = new_values + 1;
+            }
+        } else {
+            new_values = (CFBasicHashValue *)__CFBasicHashAllocateMemory2(allocator, new_num_buckets, sizeof(CFBasicHashValue), strongValues, 0);
+            if (!new_values) return NULL; // in this unusual circumstance, leak previously allocated blocks for now
+            __SetLastAllocationEventName(new_values, "CFBasicHash (value-store)");
+            if (src_ht->bits.keys_offset) {
+                new_keys = (CFBasicHashValue *)__CFBasicHashAllocateMemory2(allocator, new_num_buckets, sizeof(CFBasicHashValue), strongKeys, false);
+                if (!new_keys) return NULL; // in this unusual circumstance, leak previously allocated blocks for now
+                __SetLastAllocationEventName(new_keys, "CFBasicHash (key-store)");
+            }
         }
         if (src_ht->bits.counts_offset) {
             new_counts = (uintptr_t *)__CFBasicHashAllocateMemory2(allocator, new_num_buckets, (1 << src_ht->bits.counts_width), false, false);
@@ -1734,14 +2010,14 @@ CF_PRIVATE CFBasicHashRef CFBasicHashCreateCopy(CFAllocatorRef allocator, CFCons
     }
 
     for (CFIndex idx = 0; idx < new_num_buckets; idx++) {
-        uintptr_t stack_value = old_values[idx].neutral;
+        uintptr_t stack_value = old_values[idx * stride].neutral;
         if (stack_value != 0UL && stack_value != ~0UL) {
             uintptr_t old_value = stack_value;
             if (__CFBasicHashSubABZero == old_value) old_value = 0UL;
             if (__CFBasicHashSubABOne == old_value) old_value = ~0UL;
             __CFBasicHashSetValue(ht, idx, __CFBasicHashImportValue(ht, old_value), true, false);
             if (new_keys) {
-                uintptr_t old_key = old_keys[idx].neutral;
+                uintptr_t old_key = old_keys[idx * stride].neutral;
                 if (__CFBasicHashSubABZero == old_key) old_key = 0UL;
                 if (__CFBasicHashSubABOne == old_key) old_key = ~0UL;
                 __CFBasicHashSetKey(ht, idx, __CFBasicHashImportKey(ht, old_key), true, false);
@@ -42,6 +42,7 @@ enum {
     __kCFBasicHashLinearHashingValue = 1,
     __kCFBasicHashDoubleHashingValue = 2,
     __kCFBasicHashExponentialHashingValue = 3,
+    __kCFBasicHashGroupedHashingValue = 4,
 };
 
 enum {
@@ -65,6 +66,8 @@ enum {
     kCFBasicHashExponentialHashing = (__kCFBasicHashExponentialHashingValue << 13),
 
     kCFBasicHashAggressiveGrowth = (1UL << 15),
+
+    kCFBasicHashGroupedHashing = (1UL << 16), // overrides bits 13-14
 };
 
 // Note that for a hash table without keys, the value is treated as the key,
@@ -112,6 +115,7 @@ CFOptionFlags CFBasicHashGetFlags(CFConstBasicHashRef ht);
 CFIndex CFBasicHashGetNumBuckets(CFConstBasicHashRef ht);
 CFIndex CFBasicHashGetCapacity(CFConstBasicHashRef ht);
 void CFBasicHashSetCapacity(CFBasicHashRef ht, CFIndex capacity);
+void CFBasicHashSetHashStyle(CFBasicHashRef ht, CFOptionFlags style);
 
 CFIndex CFBasicHashGetCount(CFConstBasicHashRef ht);
 CFBasicHashBucket CFBasicHashGetBucket(CFConstBasicHashRef ht, CFIndex idx);
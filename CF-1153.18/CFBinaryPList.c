@@ -46,6 +46,9 @@
 #if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED || DEPLOYMENT_TARGET_WINDOWS
 #include <CoreFoundation/CFStream.h>
 #endif
+#if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED || DEPLOYMENT_TARGET_EMBEDDED_MINI || DEPLOYMENT_TARGET_LINUX
+#include <sys/mman.h>
+#endif
 
 typedef struct {
     int64_t high;
@@ -605,19 +608,335 @@ CF_INLINE uint8_t _byteCount(uint64_t count) {
     return size;
 }
 
+static __CFBinaryPlistWriteBuffer *_createWriteBuffer(CFTypeRef stream) {
+    __CFBinaryPlistWriteBuffer *buf = (__CFBinaryPlistWriteBuffer *)CFAllocatorAllocate(kCFAllocatorSystemDefault, sizeof(__CFBinaryPlistWriteBuffer), 0);
+    buf->stream = stream;
+    buf->databytes = NULL;
+    buf->datalen = 0;
+    buf->error = NULL;
+    buf->streamIsData = (CFGetTypeID(stream) == CFDataGetTypeID());
+    buf->written = 0;
+    buf->used = 0;
+    bufferWrite(buf, (uint8_t *)"bplist00", 8);	// header
+    return buf;
+}
+
+// Hands any error in buf to the caller, or releases it if the caller is not interested, and deallocates buf.
+static void _destroyWriteBuffer(__CFBinaryPlistWriteBuffer *buf, CFErrorRef *error) {
+    if (buf->error) {
+	if (error) {
+	    // caller will release error
+	    *error = buf->error;
+	} else {
+	    CFRelease(buf->error);
+	}
+    }
+    CFAllocatorDeallocate(kCFAllocatorSystemDefault, buf);
+}
+
+// Writes the offset table and the trailer after the objects, and returns the total length, or 0 on error. Consumes buf.
+static CFIndex _finishWriting(__CFBinaryPlistWriteBuffer *buf, CFBinaryPlistTrailer *trailer, const uint64_t *offsets, int64_t cnt, CFErrorRef *error) {
+    uint64_t length_so_far = buf->written + buf->used;
+    trailer->_offsetTableOffset = CFSwapInt64HostToBig(length_so_far);
+    trailer->_offsetIntSize = _byteCount(length_so_far);
+    
+    for (int64_t idx = 0; idx < cnt; idx++) {
+	uint64_t swapped = CFSwapInt64HostToBig(offsets[idx]);
+	uint8_t *source = (uint8_t *)&swapped;
+	bufferWrite(buf, source + sizeof(*offsets) - trailer->_offsetIntSize, trailer->_offsetIntSize);
+    }
+    length_so_far += cnt * trailer->_offsetIntSize;
+
+    bufferWrite(buf, (uint8_t *)trailer, sizeof(*trailer));
+    bufferFlush(buf);
+    length_so_far += sizeof(*trailer);
+    if (buf->error) {
+        _destroyWriteBuffer(buf, error);
+	return 0;
+    }
+    _destroyWriteBuffer(buf, error);
+    return (CFIndex)length_so_far;
+}
+
+#pragma mark -
+#pragma mark Dictionary Index
+
+/* With kCFBinaryPlistWriteDictionaryIndex, a hash index for each large dictionary with string keys is written after the last object, before the offset table. Nothing refers to it from the object graph, so readers that don't know about it never look at it. The trailer's first five unused bytes hold its offset, big-endian; zero means there is no index. All integers in it are big-endian:
+
+    "hidx"  uint32 count
+    count x { uint64 offset of dictionary, uint64 offset of its table }	sorted by dictionary offset
+    each table: uint32 bucket count (a power of 2), then that many { uint32 key hash, uint32 key index + 1 }	0 is an empty bucket
+
+Buckets are probed linearly from (hash & (bucket count - 1)). Key hashes are FNV-1a over the UTF-16 characters of the key, which is the same on every platform and release, unlike CFHash.
+
+Leopard rejected binary plists whose unused trailer bytes were not zero; no other release checks them.
+*/
+
+#define DICTIONARY_INDEX_MIN_COUNT 32
+#define DICTIONARY_INDEX_MAX_COUNT (1 << 28)
+
+static uint32_t __CFBinaryPlistHashKey(CFStringRef key) {
+    CFStringInlineBuffer buffer;
+    CFIndex length = CFStringGetLength(key);
+    CFStringInitInlineBuffer(key, &buffer, CFRangeMake(0, length));
+    uint32_t hash = 2166136261U;
+    for (CFIndex idx = 0; idx < length; idx++) {
+        hash = (hash ^ CFStringGetCharacterFromInlineBuffer(&buffer, idx)) * 16777619U;
+    }
+    return hash;
+}
+
+CF_INLINE uint32_t __CFBinaryPlistIndexBucketCount(CFIndex count) {
+    // Keeps the table at most two thirds full
+    uint32_t buckets = 1;
+    while (buckets < count + count / 2) buckets <<= 1;
+    return buckets;
+}
+
+// Only dictionaries big enough for a linear search to hurt, and keyed only by strings, are indexed.
+static Boolean __CFBinaryPlistShouldIndexDictionary(CFDictionaryRef dict) {
+    CFIndex count = CFDictionaryGetCount(dict);
+    if (count < DICTIONARY_INDEX_MIN_COUNT || DICTIONARY_INDEX_MAX_COUNT < count) return false;
+    CFPropertyListRef *keys = (CFPropertyListRef *)CFAllocatorAllocate(kCFAllocatorSystemDefault, count * sizeof(CFTypeRef), __kCFAllocatorGCScannedMemory);
+    CFDictionaryGetKeysAndValues(dict, keys, NULL);
+    Boolean result = true;
+    for (CFIndex idx = 0; idx < count && result; idx++) {
+        if (CFGetTypeID(keys[idx]) != stringtype) result = false;
+    }
+    CFAllocatorDeallocate(kCFAllocatorSystemDefault, keys);
+    return result;
+}
+
+CF_INLINE void _appendIndexInt(__CFBinaryPlistWriteBuffer *buf, uint64_t value, CFIndex size) {
+    uint64_t swapped = CFSwapInt64HostToBig(value);
+    bufferWrite(buf, (uint8_t *)&swapped + sizeof(swapped) - size, size);
+}
+
+// Writes the index for the dictionaries in objlist, whose objects start at offsets, and records where it is in the trailer. Key order in each table is the order _appendObject wrote the keys in.
+static void _appendDictionaryIndex(__CFBinaryPlistWriteBuffer *buf, CFArrayRef objlist, const uint64_t *offsets, CFBinaryPlistTrailer *trailer) {
+    uint64_t start = buf->written + buf->used;
+    if (start >> 40) return;
+    CFIndex cnt = CFArrayGetCount(objlist);
+    CFIndex *indexed = (CFIndex *)CFAllocatorAllocate(kCFAllocatorSystemDefault, cnt * sizeof(CFIndex), 0);
+    CFIndex indexedCount = 0;
+    for (CFIndex idx = 0; idx < cnt; idx++) {
+        CFTypeRef obj = CFArrayGetValueAtIndex(objlist, idx);
+        if (CFGetTypeID(obj) == dicttype && __CFBinaryPlistShouldIndexDictionary((CFDictionaryRef)obj)) indexed[indexedCount++] = idx;
+    }
+    if (0 == indexedCount) {
+        CFAllocatorDeallocate(kCFAllocatorSystemDefault, indexed);
+        return;
+    }
+
+    bufferWrite(buf, (uint8_t *)"hidx", 4);
+    _appendIndexInt(buf, indexedCount, 4);
+    uint64_t tableOffset = start + 8 + indexedCount * 16;
+    for (CFIndex idx = 0; idx < indexedCount; idx++) {
+        CFDictionaryRef dict = (CFDictionaryRef)CFArrayGetValueAtIndex(objlist, indexed[idx]);
+        _appendIndexInt(buf, offsets[indexed[idx]], 8);
+        _appendIndexInt(buf, tableOffset, 8);
+        tableOffset += 4 + 8 * (uint64_t)__CFBinaryPlistIndexBucketCount(CFDictionaryGetCount(dict));
+    }
+    for (CFIndex idx = 0; idx < indexedCount; idx++) {
+        CFDictionaryRef dict = (CFDictionaryRef)CFArrayGetValueAtIndex(objlist, indexed[idx]);
+        CFIndex count = CFDictionaryGetCount(dict);
+        uint32_t buckets = __CFBinaryPlistIndexBucketCount(count);
+        CFPropertyListRef *keys = (CFPropertyListRef *)CFAllocatorAllocate(kCFAllocatorSystemDefault, count * sizeof(CFTypeRef), __kCFAllocatorGCScannedMemory);
+        uint32_t *table = (uint32_t *)CFAllocatorAllocate(kCFAllocatorSystemDefault, 2 * buckets * sizeof(uint32_t), 0);
+        memset(table, 0, 2 * buckets * sizeof(uint32_t));
+        CFDictionaryGetKeysAndValues(dict, keys, NULL);
+        for (CFIndex keyIdx = 0; keyIdx < count; keyIdx++) {
+            uint32_t hash = __CFBinaryPlistHashKey((CFStringRef)keys[keyIdx]);
+            uint32_t bucket = hash & (buckets - 1);
+            while (0 != table[2 * bucket + 1]) bucket = (bucket + 1) & (buckets - 1);
+            table[2 * bucket] = CFSwapInt32HostToBig(hash);
+            table[2 * bucket + 1] = CFSwapInt32HostToBig((uint32_t)keyIdx + 1);
+        }
+        _appendIndexInt(buf, buckets, 4);
+        bufferWrite(buf, (uint8_t *)table, 2 * buckets * sizeof(uint32_t));
+        CFAllocatorDeallocate(kCFAllocatorSystemDefault, table);
+        CFAllocatorDeallocate(kCFAllocatorSystemDefault, keys);
+    }
+    CFAllocatorDeallocate(kCFAllocatorSystemDefault, indexed);
+
+    for (CFIndex idx = 0; idx < 5; idx++) {
+        trailer->_unused[idx] = (uint8_t)(start >> (8 * (4 - idx)));
+    }
+}
+
+#pragma mark -
+#pragma mark Streaming
+
+/* The streaming writer emits each object as soon as everything it refers to has been written, so a container follows its contents and the top object comes last. The only state is the offset table, the object numbers of the containers currently being written, and a small fixed-size cache for uniquing. The size of an object reference has to be fixed before the first container is written; it comes from a counting pass over the property list, which uses no memory. Uniquing can only lower the count, so the size stays big enough. */
+
+#define STREAMING_UNIQUE_SLOTS 4096
+
+typedef struct {
+    CFTypeRef obj;
+    uint64_t refnum;
+} __CFBinaryPlistUniqueSlot;
+
+typedef struct {
+    __CFBinaryPlistWriteBuffer *buf;
+    uint64_t *offsets;
+    uint64_t count;
+    uint64_t capacity;
+    uint8_t objRefSize;
+    uint64_t trueRef;
+    uint64_t falseRef;
+    // Direct-mapped by hash. A collision replaces the older entry, which can cost a duplicate object but never a wrong one.
+    __CFBinaryPlistUniqueSlot unique[STREAMING_UNIQUE_SLOTS];
+} __CFBinaryPlistStreamingWriter;
+
+#define STREAMING_NO_REF UINT64_MAX
+
+static uint64_t _countPlistObjects(CFPropertyListRef plist);
+
+static void _countPlistObjectsApplier(const void *key, const void *value, void *context) {
+    *(uint64_t *)context += _countPlistObjects(key) + _countPlistObjects(value);
+}
+
+// Walks the containers in place rather than copying out their contents, so that counting doesn't allocate.
+static uint64_t _countPlistObjects(CFPropertyListRef plist) {
+    CFTypeID type = CFGetTypeID(plist);
+    uint64_t result = 1;
+    if (dicttype == type) {
+        CFDictionaryApplyFunction((CFDictionaryRef)plist, _countPlistObjectsApplier, &result);
+    } else if (arraytype == type) {
+        CFIndex count = CFArrayGetCount((CFArrayRef)plist);
+        for (CFIndex idx = 0; idx < count; idx++) {
+            result += _countPlistObjects(CFArrayGetValueAtIndex((CFArrayRef)plist, idx));
+        }
+    }
+    return result;
+}
+
+// Records where the next object starts and returns its object number.
+static uint64_t _streamBeginObject(__CFBinaryPlistStreamingWriter *writer) {
+    if (writer->count == writer->capacity) {
+        writer->capacity = writer->capacity ? 2 * writer->capacity : 256;
+        writer->offsets = (uint64_t *)CFAllocatorReallocate(kCFAllocatorSystemDefault, writer->offsets, (CFIndex)(writer->capacity * sizeof(uint64_t)), 0);
+        if (!writer->offsets) HALT; // out of memory
+    }
+    writer->offsets[writer->count] = writer->buf->written + writer->buf->used;
+    return writer->count++;
+}
+
+static void _streamRefs(__CFBinaryPlistStreamingWriter *writer, const uint64_t *refs, CFIndex count) {
+    for (CFIndex idx = 0; idx < count; idx++) {
+        uint64_t swapped = CFSwapInt64HostToBig(refs[idx]);
+        uint8_t *source = (uint8_t *)&swapped;
+        bufferWrite(writer->buf, source + sizeof(swapped) - writer->objRefSize, writer->objRefSize);
+    }
+}
+
+// Writes obj after anything it contains, and returns its object number, or STREAMING_NO_REF if obj is not a property list type.
+static uint64_t _streamObject(__CFBinaryPlistStreamingWriter *writer, CFTypeRef obj) {
+    uint64_t refnum;
+    CFTypeID type = CFGetTypeID(obj);
+    if (dicttype == type || arraytype == type) {
+        // Dictionaries hold their keys then their values, like the object they are written as
+        CFIndex count, total;
+        if (dicttype == type) {
+            count = CFDictionaryGetCount((CFDictionaryRef)obj);
+            total = 2 * count;
+        } else {
+            count = total = CFArrayGetCount((CFArrayRef)obj);
+        }
+        STACK_BUFFER_DECL(CFPropertyListRef, buffer, total <= 128 ? total : 1);
+        STACK_BUFFER_DECL(uint64_t, refBuffer, total <= 128 ? total : 1);
+        CFPropertyListRef *list = (total <= 128) ? buffer : (CFPropertyListRef *)CFAllocatorAllocate(kCFAllocatorSystemDefault, total * sizeof(CFTypeRef), __kCFAllocatorGCScannedMemory);
+        uint64_t *refs = (total <= 128) ? refBuffer : (uint64_t *)CFAllocatorAllocate(kCFAllocatorSystemDefault, total * sizeof(uint64_t), 0);
+        if (dicttype == type) {
+            CFDictionaryGetKeysAndValues((CFDictionaryRef)obj, list, list + count);
+        } else {
+            CFArrayGetValues((CFArrayRef)obj, CFRangeMake(0, count), list);
+        }
+        refnum = 0;
+        for (CFIndex idx = 0; idx < total && STREAMING_NO_REF != refnum; idx++) {
+            refnum = refs[idx] = _streamObject(writer, list[idx]);
+        }
+        if (STREAMING_NO_REF != refnum) {
+            refnum = _streamBeginObject(writer);
+            uint8_t marker = (uint8_t)((dicttype == type ? kCFBinaryPlistMarkerDict : kCFBinaryPlistMarkerArray) | (count < 15 ? count : 0xf));
+            bufferWrite(writer->buf, &marker, 1);
+            if (15 <= count) {
+                _appendInt(writer->buf, (uint64_t)count);
+            }
+            _streamRefs(writer, refs, total);
+        }
+        if (list != buffer) CFAllocatorDeallocate(kCFAllocatorSystemDefault, list);
+        if (refs != refBuffer) CFAllocatorDeallocate(kCFAllocatorSystemDefault, refs);
+        return refnum;
+    }
+
+    uint64_t *known = NULL;
+    __CFBinaryPlistUniqueSlot *slot = NULL;
+    if (booltype == type) {
+        known = CFBooleanGetValue((CFBooleanRef)obj) ? &writer->trueRef : &writer->falseRef;
+        if (STREAMING_NO_REF != *known) return *known;
+    } else if (stringtype == type || numbertype == type || datetype == type) {
+        // Keys repeat far more than anything else, and these are cheap to hash; data can be large and rarely repeats
+        slot = &writer->unique[CFHash(obj) & (STREAMING_UNIQUE_SLOTS - 1)];
+        if (slot->obj && (slot->obj == obj || CFEqual(slot->obj, obj))) return slot->refnum;
+    }
+    refnum = _streamBeginObject(writer);
+    if (!_appendObject(writer->buf, obj, NULL, writer->objRefSize)) return STREAMING_NO_REF;
+    if (known) *known = refnum;
+    if (slot) {
+        slot->obj = obj;
+        slot->refnum = refnum;
+    }
+    return refnum;
+}
+
+static CFIndex __CFBinaryPlistWriteStreaming(CFPropertyListRef plist, CFTypeRef stream, CFErrorRef *error) {
+    CFBinaryPlistTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer._objectRefSize = _byteCount(_countPlistObjects(plist));
+
+    __CFBinaryPlistStreamingWriter *writer = (__CFBinaryPlistStreamingWriter *)CFAllocatorAllocate(kCFAllocatorSystemDefault, sizeof(__CFBinaryPlistStreamingWriter), 0);
+    memset(writer, 0, sizeof(*writer));
+    writer->buf = _createWriteBuffer(stream);
+    writer->objRefSize = trailer._objectRefSize;
+    writer->trueRef = STREAMING_NO_REF;
+    writer->falseRef = STREAMING_NO_REF;
+
+    uint64_t top = _streamObject(writer, plist);
+    __CFBinaryPlistWriteBuffer *buf = writer->buf;
+    uint64_t *offsets = writer->offsets;
+    int64_t cnt = writer->count;
+    CFAllocatorDeallocate(kCFAllocatorSystemDefault, writer);
+
+    CFIndex result = 0;
+    if (STREAMING_NO_REF == top) {
+        _destroyWriteBuffer(buf, error);
+    } else {
+        trailer._numObjects = CFSwapInt64HostToBig(cnt);
+        trailer._topObject = CFSwapInt64HostToBig(top);
+        result = _finishWriting(buf, &trailer, offsets, cnt, error);
+    }
+    if (offsets) CFAllocatorDeallocate(kCFAllocatorSystemDefault, offsets);
+    return result;
+}
+
 // stream can be a CFWriteStreamRef (on supported platforms) or a CFMutableDataRef
-/* Write a property list to a stream, in binary format. plist is the property list to write (one of the basic property list types), stream is the destination of the property list, and estimate is a best-guess at the total number of objects in the property list. The estimate parameter is for efficiency in pre-allocating memory for the uniquing step. Pass in a 0 if no estimate is available. The options flag specifies sort options. If the error parameter is non-NULL and an error occurs, it will be used to return a CFError explaining the problem. It is the callers responsibility to release the error. */
+/* Write a property list to a stream, in binary format. plist is the property list to write (one of the basic property list types), stream is the destination of the property list, and estimate is a best-guess at the total number of objects in the property list. The estimate parameter is for efficiency in pre-allocating memory for the uniquing step. Pass in a 0 if no estimate is available. The options flag specifies sort options, kCFBinaryPlistWriteStreaming to write without building an object table first, and kCFBinaryPlistWriteDictionaryIndex to add a hash index for large dictionaries. If the error parameter is non-NULL and an error occurs, it will be used to return a CFError explaining the problem. It is the callers responsibility to release the error. */
 CFIndex __CFBinaryPlistWrite(CFPropertyListRef plist, CFTypeRef stream, uint64_t estimate, CFOptionFlags options, CFErrorRef *error) {
     CFMutableDictionaryRef objtable = NULL;
     CFMutableArrayRef objlist = NULL;
     CFMutableSetRef uniquingset = NULL;
     CFBinaryPlistTrailer trailer;
-    uint64_t *offsets, length_so_far;
+    uint64_t *offsets;
     int64_t idx, cnt;
     __CFBinaryPlistWriteBuffer *buf;
     
     initStatics();
 
+    if (options & kCFBinaryPlistWriteStreaming) {
+        return __CFBinaryPlistWriteStreaming(plist, stream, error);
+    }
+
     const CFDictionaryKeyCallBacks dictKeyCallbacks = {0, __CFTypeCollectionRetain, __CFTypeCollectionRelease, 0, 0, 0};
     objtable = CFDictionaryCreateMutable(kCFAllocatorSystemDefault, 0, &dictKeyCallbacks, NULL);
     
@@ -641,15 +960,7 @@ CFIndex __CFBinaryPlistWrite(CFPropertyListRef plist, CFTypeRef stream, uint64_t
     cnt = CFArrayGetCount(objlist);
     offsets = (uint64_t *)CFAllocatorAllocate(kCFAllocatorSystemDefault, (CFIndex)(cnt * sizeof(*offsets)), 0);
 
-    buf = (__CFBinaryPlistWriteBuffer *)CFAllocatorAllocate(kCFAllocatorSystemDefault, sizeof(__CFBinaryPlistWriteBuffer), 0);
-    buf->stream = stream;
-    buf->databytes = NULL;
-    buf->datalen = 0;
-    buf->error = NULL;
-    buf->streamIsData = (CFGetTypeID(stream) == CFDataGetTypeID());
-    buf->written = 0;
-    buf->used = 0;
-    bufferWrite(buf, (uint8_t *)"bplist00", 8);	// header
+    buf = _createWriteBuffer(stream);
 
     memset(&trailer, 0, sizeof(trailer));
     trailer._numObjects = CFSwapInt64HostToBig(cnt);
@@ -662,48 +973,20 @@ CFIndex __CFBinaryPlistWrite(CFPropertyListRef plist, CFTypeRef stream, uint64_t
 	if (!success) {
 	    CFRelease(objtable);
 	    CFRelease(objlist);
-	    if (error && buf->error) {
-		// caller will release error
-		*error = buf->error;
-	    } else if (buf->error) {
-		// caller is not interested in error, release it here
-		CFRelease(buf->error);
-	    }
-	    CFAllocatorDeallocate(kCFAllocatorSystemDefault, buf);
+	    _destroyWriteBuffer(buf, error);
             CFAllocatorDeallocate(kCFAllocatorSystemDefault, offsets);
 	    return 0;
 	}
     }
     CFRelease(objtable);
+    if (options & kCFBinaryPlistWriteDictionaryIndex) {
+        _appendDictionaryIndex(buf, objlist, offsets, &trailer);
+    }
     CFRelease(objlist);
     
-    length_so_far = buf->written + buf->used;
-    trailer._offsetTableOffset = CFSwapInt64HostToBig(length_so_far);
-    trailer._offsetIntSize = _byteCount(length_so_far);
-    
-    for (idx = 0; idx < cnt; idx++) {
-	uint64_t swapped = CFSwapInt64HostToBig(offsets[idx]);
-	uint8_t *source = (uint8_t *)&swapped;
-	bufferWrite(buf, source + sizeof(*offsets) - trailer._offsetIntSize, trailer._offsetIntSize);
-    }
-    length_so_far += cnt * trailer._offsetIntSize;
+    CFIndex result = _finishWriting(buf, &trailer, offsets, cnt, error);
     CFAllocatorDeallocate(kCFAllocatorSystemDefault, offsets);
-
-    bufferWrite(buf, (uint8_t *)&trailer, sizeof(trailer));
-    bufferFlush(buf);
-    length_so_far += sizeof(trailer);
-    if (buf->error) {
-	if (error) {
-	    // caller will release error
-	    *error = buf->error;
-	} else {
-	    CFRelease(buf->error);
-	}
-        CFAllocatorDeallocate(kCFAllocatorSystemDefault, buf);
-	return 0;
-    }
-    CFAllocatorDeallocate(kCFAllocatorSystemDefault, buf);
-    return (CFIndex)length_so_far;
+    return result;
 }
 
 
@@ -912,6 +1195,114 @@ bool __CFBinaryPlistGetOffsetForValueFromArray2(const uint8_t *databytes, uint64
     return true;
 }
 
+// Compares key against the key object at off. Returns false if the object can't be read.
+static bool _keyMatchesObjectAtOffset(const uint8_t *databytes, uint64_t datalen, uint64_t off, const CFBinaryPlistTrailer *trailer, CFTypeRef key, const char *keyBufferPtr, CFIndex stringKeyLen, Boolean *match) {
+    uint64_t objectsRangeEnd = trailer->_offsetTableOffset - 1;
+    if (UINT64_MAX == off) FAIL_FALSE;
+    uint8_t marker = *(databytes + off);
+    int32_t err = CF_NO_ERROR;
+    *match = false;
+    // if it is an ASCII string in the data, then we do a memcmp. If the key isn't ASCII, then it won't pass the compare, unless it hits some odd edge case of the ASCII string actually containing the unicode escape sequence.
+    if (keyBufferPtr && (marker & 0xf0) == kCFBinaryPlistMarkerASCIIString) {
+	CFIndex len = marker & 0x0f;
+	// move past the marker
+	const uint8_t *ptr2 = databytes + off;
+	ptr2 = check_ptr_add(ptr2, 1, &err);
+	if (CF_NO_ERROR != err) FAIL_FALSE;
+	
+	// If the key's length is large, and the length we are querying is also large, then we have to read it in. If stringKeyLen is less than 0xf, then len will never be equal to it if it was encoded as large.
+	if (0xf == len && stringKeyLen >= 0xf) {
+	    uint64_t bigint = 0;
+	    if (!_readInt(ptr2, databytes + objectsRangeEnd, &bigint, &ptr2)) FAIL_FALSE;
+	    if (LONG_MAX < bigint) FAIL_FALSE;
+	    len = (CFIndex)bigint;
+	}
+	
+	if (len == stringKeyLen) {                
+	    err = CF_NO_ERROR;
+	    const uint8_t *extent = check_ptr_add(ptr2, len, &err);
+	    if (CF_NO_ERROR != err) FAIL_FALSE;
+	    
+	    if (databytes + trailer->_offsetTableOffset <= extent) FAIL_FALSE;
+	    
+	    // Compare the key to this potential match
+	    if (memcmp(ptr2, keyBufferPtr, stringKeyLen) == 0) {
+		*match = true;
+	    }
+	}
+    } else {
+        // temp object not saved in 'objects', because we don't know what allocator to use
+        // (what allocator __CFBinaryPlistCreateObjectFiltered() or __CFBinaryPlistCreateObject()
+        //  will eventually be called with which results in that object)
+	CFPropertyListRef keyInData = NULL;
+	if (!__CFBinaryPlistCreateObjectFiltered(databytes, datalen, off, trailer, kCFAllocatorSystemDefault, kCFPropertyListImmutable, NULL /*objects*/, NULL, 0, NULL, &keyInData) || !_plistIsPrimitive(keyInData)) {
+	    if (keyInData) CFRelease(keyInData);
+	    FAIL_FALSE;
+	}
+	
+	*match = CFEqual(key, keyInData);            
+        CFRelease(keyInData);
+    }
+    return true;
+}
+
+/* Looks key up in the hash index of the dictionary at startOffset (see _appendDictionaryIndex), whose cnt key refs start at keyRefs. Returns false if the dictionary has no usable index, and the caller should search the keys itself. Otherwise *found says whether the key is in the dictionary and, if it is, *keyIdx and *koffset say where. */
+static bool _lookupDictionaryIndex(const uint8_t *databytes, uint64_t datalen, uint64_t startOffset, const CFBinaryPlistTrailer *trailer, CFStringRef key, const uint8_t *keyRefs, uint64_t cnt, const char *keyBufferPtr, CFIndex stringKeyLen, uint64_t *keyIdx, uint64_t *koffset, bool *found) {
+    uint64_t indexOffset = 0;
+    for (CFIndex idx = 0; idx < 5; idx++) {
+	indexOffset = (indexOffset << 8) | trailer->_unused[idx];
+    }
+    if (0 == indexOffset) FAIL_FALSE;
+    
+    // The index, and each table in it, must lie between the objects and the offset table
+    uint64_t indexEnd = trailer->_offsetTableOffset;
+    if (indexOffset < 8 || indexEnd - 8 < indexOffset) FAIL_FALSE;
+    if (0 != memcmp(databytes + indexOffset, "hidx", 4)) FAIL_FALSE;
+    uint64_t dictCount = _getSizedInt(databytes + indexOffset + 4, 4);
+    if ((indexEnd - indexOffset - 8) / 16 < dictCount) FAIL_FALSE;
+    
+    // Binary search of the dictionaries
+    uint64_t lo = 0, hi = dictCount, tableOffset = 0;
+    while (lo < hi) {
+	uint64_t mid = lo + (hi - lo) / 2;
+	const uint8_t *entry = databytes + indexOffset + 8 + mid * 16;
+	uint64_t dictOffset = _getSizedInt(entry, 8);
+	if (dictOffset == startOffset) {
+	    tableOffset = _getSizedInt(entry + 8, 8);
+	    break;
+	}
+	if (dictOffset < startOffset) lo = mid + 1; else hi = mid;
+    }
+    if (tableOffset < 8 || indexEnd - 4 < tableOffset) FAIL_FALSE;
+    uint64_t buckets = _getSizedInt(databytes + tableOffset, 4);
+    if (0 == buckets || (buckets & (buckets - 1)) || (indexEnd - tableOffset - 4) / 8 < buckets) FAIL_FALSE;
+    
+    const uint8_t *table = databytes + tableOffset + 4;
+    uint32_t hash = __CFBinaryPlistHashKey(key);
+    uint64_t bucket = hash & (buckets - 1);
+    for (uint64_t probe = 0; probe < buckets; probe++) {
+	uint64_t entry = _getSizedInt(table + bucket * 8 + 4, 4);
+	if (0 == entry) {
+	    *found = false;
+	    return true;
+	}
+	if (_getSizedInt(table + bucket * 8, 4) == hash) {
+	    if (cnt < entry) FAIL_FALSE;
+	    uint64_t off = _getOffsetOfRefAt(databytes, keyRefs + (entry - 1) * trailer->_objectRefSize, trailer);
+	    Boolean match = false;
+	    if (!_keyMatchesObjectAtOffset(databytes, datalen, off, trailer, key, keyBufferPtr, stringKeyLen, &match)) FAIL_FALSE;
+	    if (match) {
+		*keyIdx = entry - 1;
+		*koffset = off;
+		*found = true;
+		return true;
+	    }
+	}
+	bucket = (bucket + 1) & (buckets - 1);
+    }
+    FAIL_FALSE;
+}
+
 /* Get the offset for a value in a dictionary in a binary property list.
  @param databytes A pointer to the start of the binary property list data.
  @param datalen The length of the data.
@@ -977,7 +1368,6 @@ bool __CFBinaryPlistGetOffsetForValueFromDictionary3(const uint8_t *databytes, u
     uint64_t totalKeySize = cnt * trailer->_objectRefSize;
     uint64_t off;
     Boolean match = false;
-    CFPropertyListRef keyInData = NULL;
     
 #define KEY_BUFF_SIZE 16    
     char keyBuffer[KEY_BUFF_SIZE];
@@ -994,52 +1384,22 @@ bool __CFBinaryPlistGetOffsetForValueFromDictionary3(const uint8_t *databytes, u
 	}
     }
     
+    // Use the dictionary's hash index if it has one
+    if (stringKeyLen != -1) {
+	uint64_t keyIdx;
+	bool found = false;
+	if (_lookupDictionaryIndex(databytes, datalen, startOffset, trailer, (CFStringRef)key, ptr, cnt, keyBufferPtr, stringKeyLen, &keyIdx, &off, &found)) {
+	    if (!found) FAIL_FALSE;
+	    if (koffset) *koffset = off;
+	    if (voffset) *voffset = _getOffsetOfRefAt(databytes, ptr + totalKeySize + keyIdx * trailer->_objectRefSize, trailer);
+	    return true;
+	}
+    }
+    
     // Perform linear search of the keys
     for (CFIndex idx = 0; idx < cnt; idx++) {
 	off = _getOffsetOfRefAt(databytes, ptr, trailer);
-	marker = *(databytes + off);
-	// if it is an ASCII string in the data, then we do a memcmp. If the key isn't ASCII, then it won't pass the compare, unless it hits some odd edge case of the ASCII string actually containing the unicode escape sequence.
-	if (keyBufferPtr && (marker & 0xf0) == kCFBinaryPlistMarkerASCIIString) {
-	    CFIndex len = marker & 0x0f;
-	    // move past the marker
-	    const uint8_t *ptr2 = databytes + off;
-	    err = CF_NO_ERROR;
-	    ptr2 = check_ptr_add(ptr2, 1, &err);
-	    if (CF_NO_ERROR != err) FAIL_FALSE;
-	    
-	    // If the key's length is large, and the length we are querying is also large, then we have to read it in. If stringKeyLen is less than 0xf, then len will never be equal to it if it was encoded as large.
-	    if (0xf == len && stringKeyLen >= 0xf) {
-		uint64_t bigint = 0;
-		if (!_readInt(ptr2, databytes + objectsRangeEnd, &bigint, &ptr2)) FAIL_FALSE;
-		if (LONG_MAX < bigint) FAIL_FALSE;
-		len = (CFIndex)bigint;
-	    }
-	    
-	    if (len == stringKeyLen) {                
-		err = CF_NO_ERROR;
-		extent = check_ptr_add(ptr2, len, &err);
-		if (CF_NO_ERROR != err) FAIL_FALSE;
-		
-		if (databytes + trailer->_offsetTableOffset <= extent) FAIL_FALSE;
-		
-		// Compare the key to this potential match
-		if (memcmp(ptr2, keyBufferPtr, stringKeyLen) == 0) {
-		    match = true;
-		}
-	    }
-	} else {
-            // temp object not saved in 'objects', because we don't know what allocator to use
-            // (what allocator __CFBinaryPlistCreateObjectFiltered() or __CFBinaryPlistCreateObject()
-            //  will eventually be called with which results in that object)
-	    keyInData = NULL;
-	    if (!__CFBinaryPlistCreateObjectFiltered(databytes, datalen, off, trailer, kCFAllocatorSystemDefault, kCFPropertyListImmutable, NULL /*objects*/, NULL, 0, NULL, &keyInData) || !_plistIsPrimitive(keyInData)) {
-		if (keyInData) CFRelease(keyInData);
-		FAIL_FALSE;
-	    }
-	    
-	    match = CFEqual(key, keyInData);            
-            CFRelease(keyInData);
-	}            
+	if (!_keyMatchesObjectAtOffset(databytes, datalen, off, trailer, key, keyBufferPtr, stringKeyLen, &match)) FAIL_FALSE;
 	
 	if (match) {
 	    if (koffset) *koffset = off;
@@ -1607,3 +1967,244 @@ if (!CFEqual(pl, pl2)) CFLog(3, CFSTR("*** error: plists before and after are no
     FAIL_FALSE;
 }
 
+
+#pragma mark -
+#pragma mark Lazy Reading
+
+/* A _CFBinaryPlistNode stands for one array or dictionary in a binary property list. It keeps the property list's data alive and decodes a value only when asked for it, using the same offset lookups as keypath filtering. Decoded values are cached in the node by offset, so asking again is cheap and the Get rule holds. Child nodes retain the data rather than their parent, so there are no cycles. */
+
+struct __CFBinaryPlistNode {
+    CFRuntimeBase _base;
+    CFDataRef _data;
+    CFBinaryPlistTrailer _trailer;
+    uint64_t _offset;
+    const uint8_t *_refs;	// first object ref; a dictionary's keys come first, then its values
+    CFIndex _count;
+    Boolean _isDictionary;
+    CFLock_t _lock;
+    CFMutableDictionaryRef _values;	// offset -> decoded value, created on first use
+};
+
+static void __CFBinaryPlistNodeDeallocate(CFTypeRef cf) {
+    struct __CFBinaryPlistNode *node = (struct __CFBinaryPlistNode *)cf;
+    if (node->_values) CFRelease(node->_values);
+    CFRelease(node->_data);
+}
+
+static CFStringRef __CFBinaryPlistNodeCopyDescription(CFTypeRef cf) {
+    _CFBinaryPlistNodeRef node = (_CFBinaryPlistNodeRef)cf;
+    return CFStringCreateWithFormat(kCFAllocatorSystemDefault, NULL, CFSTR("<CFBinaryPlistNode %p [%p]>{%s, count = %ld, offset = %llu}"), cf, CFGetAllocator(cf), node->_isDictionary ? "dictionary" : "array", (long)node->_count, (unsigned long long)node->_offset);
+}
+
+static CFTypeID __kCFBinaryPlistNodeTypeID = _kCFRuntimeNotATypeID;
+
+static const CFRuntimeClass __CFBinaryPlistNodeClass = {
+    0,
+    "CFBinaryPlistNode",
+    NULL,	// init
+    NULL,	// copy
+    __CFBinaryPlistNodeDeallocate,
+    NULL,	// equal -- pointer equality only
+    NULL,	// hash -- pointer hashing only
+    NULL,	// copyFormattingDesc
+    __CFBinaryPlistNodeCopyDescription
+};
+
+CFTypeID _CFBinaryPlistNodeGetTypeID(void) {
+    static dispatch_once_t initOnce;
+    dispatch_once(&initOnce, ^{ __kCFBinaryPlistNodeTypeID = _CFRuntimeRegisterClass(&__CFBinaryPlistNodeClass); });
+    return __kCFBinaryPlistNodeTypeID;
+}
+
+// Returns NULL if the object at startOffset is not a well-formed array or dictionary.
+static _CFBinaryPlistNodeRef __CFBinaryPlistNodeCreate(CFAllocatorRef allocator, CFDataRef data, const CFBinaryPlistTrailer *trailer, uint64_t startOffset) {
+    const uint8_t *databytes = CFDataGetBytePtr(data);
+    uint64_t objectsRangeStart = 8, objectsRangeEnd = trailer->_offsetTableOffset - 1;
+    if (startOffset < objectsRangeStart || objectsRangeEnd < startOffset) return NULL;
+    const uint8_t *ptr = databytes + startOffset;
+    uint8_t marker = *ptr;
+    if ((marker & 0xf0) != kCFBinaryPlistMarkerArray && (marker & 0xf0) != kCFBinaryPlistMarkerDict) return NULL;
+    int32_t err = CF_NO_ERROR;
+    ptr = check_ptr_add(ptr, 1, &err);
+    if (CF_NO_ERROR != err) return NULL;
+    uint64_t cnt = (marker & 0x0f);
+    if (0xf == cnt) {
+	uint64_t bigint = 0;
+	if (!_readInt(ptr, databytes + objectsRangeEnd, &bigint, &ptr)) return NULL;
+	if (LONG_MAX / 2 < bigint) return NULL;
+	cnt = bigint;
+    }
+    uint64_t refCount = ((marker & 0xf0) == kCFBinaryPlistMarkerDict) ? 2 * cnt : cnt;
+    size_t byte_cnt = check_size_t_mul(refCount, trailer->_objectRefSize, &err);
+    if (CF_NO_ERROR != err) return NULL;
+    const uint8_t *extent = check_ptr_add(ptr, byte_cnt, &err) - 1;
+    if (CF_NO_ERROR != err) return NULL;
+    if (databytes + objectsRangeEnd < extent) return NULL;
+
+    struct __CFBinaryPlistNode *node = (struct __CFBinaryPlistNode *)_CFRuntimeCreateInstance(allocator, _CFBinaryPlistNodeGetTypeID(), sizeof(struct __CFBinaryPlistNode) - sizeof(CFRuntimeBase), NULL);
+    if (NULL == node) return NULL;
+    node->_data = (CFDataRef)CFRetain(data);
+    node->_trailer = *trailer;
+    node->_offset = startOffset;
+    node->_refs = ptr;
+    node->_count = (CFIndex)cnt;
+    node->_isDictionary = ((marker & 0xf0) == kCFBinaryPlistMarkerDict);
+    node->_lock = CFLockInit;
+    node->_values = NULL;
+    return node;
+}
+
+static CFTypeRef __CFBinaryPlistNodeGetValueAtOffset(_CFBinaryPlistNodeRef cf, uint64_t offset) {
+    struct __CFBinaryPlistNode *node = (struct __CFBinaryPlistNode *)cf;
+    if (UINT64_MAX == offset || (uint64_t)(uintptr_t)offset != offset) return NULL;
+    CFTypeRef result = NULL;
+    __CFLock(&node->_lock);
+    if (node->_values) result = CFDictionaryGetValue(node->_values, (const void *)(uintptr_t)offset);
+    __CFUnlock(&node->_lock);
+    if (result) return result;
+
+    // Decode outside the lock; if another thread gets there first, keep theirs
+    CFAllocatorRef allocator = CFGetAllocator(node);
+    const uint8_t *databytes = CFDataGetBytePtr(node->_data);
+    uint64_t datalen = CFDataGetLength(node->_data);
+    if (offset < 8 || node->_trailer._offsetTableOffset <= offset) return NULL;
+    uint8_t marker = *(databytes + offset);
+    CFTypeRef value = NULL;
+    if ((marker & 0xf0) == kCFBinaryPlistMarkerArray || (marker & 0xf0) == kCFBinaryPlistMarkerDict) {
+        value = __CFBinaryPlistNodeCreate(allocator, node->_data, &node->_trailer, offset);
+    } else if (!__CFBinaryPlistCreateObjectFiltered(databytes, datalen, offset, &node->_trailer, allocator, kCFPropertyListImmutable, NULL, NULL, 0, NULL, &value)) {
+        value = NULL;
+    }
+    if (!value) return NULL;
+
+    __CFLock(&node->_lock);
+    if (!node->_values) node->_values = CFDictionaryCreateMutable(kCFAllocatorSystemDefault, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+    result = CFDictionaryGetValue(node->_values, (const void *)(uintptr_t)offset);
+    if (!result) {
+        CFDictionarySetValue(node->_values, (const void *)(uintptr_t)offset, value);
+        result = value;
+    }
+    __CFUnlock(&node->_lock);
+    CFRelease(value);
+    return result;
+}
+
+_CFBinaryPlistNodeRef _CFBinaryPlistNodeCreateWithData(CFAllocatorRef allocator, CFDataRef data, CFErrorRef *error) {
+    uint8_t marker;
+    CFBinaryPlistTrailer trailer;
+    uint64_t offset;
+    _CFBinaryPlistNodeRef node = NULL;
+    if (__CFBinaryPlistGetTopLevelInfo(CFDataGetBytePtr(data), CFDataGetLength(data), &marker, &offset, &trailer)) {
+        node = __CFBinaryPlistNodeCreate(allocator, data, &trailer, offset);
+    }
+    if (!node && error) {
+        *error = __CFPropertyListCreateError(kCFPropertyListReadCorruptError, CFSTR("Binary data is corrupt, or its top-level object is not an array or dictionary"));
+    }
+    return node;
+}
+
+#if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED || DEPLOYMENT_TARGET_EMBEDDED_MINI || DEPLOYMENT_TARGET_LINUX
+#define BINARY_PLIST_MAPPED 1
+#else
+#define BINARY_PLIST_MAPPED 0
+#endif
+
+typedef struct {
+    void *bytes;
+    CFIndex length;
+} __CFBinaryPlistMapping;
+
+// The deallocator for data created over a mapping: it unmaps rather than frees.
+static void __CFBinaryPlistMappingDeallocate(void *ptr, void *info) {
+    __CFBinaryPlistMapping *mapping = (__CFBinaryPlistMapping *)info;
+#if BINARY_PLIST_MAPPED
+    munmap(mapping->bytes, mapping->length);
+#else
+    free(mapping->bytes);
+#endif
+}
+
+static void __CFBinaryPlistMappingRelease(const void *info) {
+    free((void *)info);
+}
+
+CF_PRIVATE Boolean _CFReadMappedFromFile(CFStringRef path, Boolean map, Boolean uncached, void **outBytes, CFIndex *outLength, CFErrorRef *errorPtr);
+
+_CFBinaryPlistNodeRef _CFBinaryPlistNodeCreateWithContentsOfURL(CFAllocatorRef allocator, CFURLRef url, CFErrorRef *error) {
+    CFStringRef path = CFURLCopyFileSystemPath(url, kCFURLPOSIXPathStyle);
+    if (!path) {
+        if (error) *error = __CFPropertyListCreateError(kCFPropertyListReadCorruptError, CFSTR("URL is not a file path"));
+        return NULL;
+    }
+    void *bytes = NULL;
+    CFIndex length = 0;
+    Boolean success = _CFReadMappedFromFile(path, BINARY_PLIST_MAPPED, false, &bytes, &length, error);
+    CFRelease(path);
+    if (!success) return NULL;
+    if (0 == length) {
+        // Not mapped, even when asked to be
+        free(bytes);
+        if (error) *error = __CFPropertyListCreateError(kCFPropertyListReadCorruptError, CFSTR("Binary data is corrupt, or its top-level object is not an array or dictionary"));
+        return NULL;
+    }
+
+    __CFBinaryPlistMapping *mapping = (__CFBinaryPlistMapping *)malloc(sizeof(__CFBinaryPlistMapping));
+    mapping->bytes = bytes;
+    mapping->length = length;
+    CFAllocatorContext context = {0, mapping, NULL, __CFBinaryPlistMappingRelease, NULL, NULL, NULL, __CFBinaryPlistMappingDeallocate, NULL};
+    CFAllocatorRef deallocator = CFAllocatorCreate(kCFAllocatorSystemDefault, &context);
+    CFDataRef data = CFDataCreateWithBytesNoCopy(kCFAllocatorSystemDefault, (const UInt8 *)bytes, length, deallocator);
+    CFRelease(deallocator);
+
+    _CFBinaryPlistNodeRef node = _CFBinaryPlistNodeCreateWithData(allocator, data, error);
+    CFRelease(data);
+    return node;
+}
+
+Boolean _CFBinaryPlistNodeIsDictionary(_CFBinaryPlistNodeRef node) {
+    __CFGenericValidateType(node, _CFBinaryPlistNodeGetTypeID());
+    return node->_isDictionary;
+}
+
+CFIndex _CFBinaryPlistNodeGetCount(_CFBinaryPlistNodeRef node) {
+    __CFGenericValidateType(node, _CFBinaryPlistNodeGetTypeID());
+    return node->_count;
+}
+
+CFTypeRef _CFBinaryPlistNodeGetValueAtIndex(_CFBinaryPlistNodeRef node, CFIndex idx) {
+    __CFGenericValidateType(node, _CFBinaryPlistNodeGetTypeID());
+    if (idx < 0 || node->_count <= idx) return NULL;
+    uint64_t offset;
+    if (!node->_isDictionary) {
+        if (!__CFBinaryPlistGetOffsetForValueFromArray2(CFDataGetBytePtr(node->_data), CFDataGetLength(node->_data), node->_offset, &node->_trailer, idx, &offset, NULL)) return NULL;
+        return __CFBinaryPlistNodeGetValueAtOffset(node, offset);
+    }
+    const uint8_t *ref = node->_refs + (node->_count + idx) * node->_trailer._objectRefSize;
+    return __CFBinaryPlistNodeGetValueAtOffset(node, _getOffsetOfRefAt(CFDataGetBytePtr(node->_data), ref, &node->_trailer));
+}
+
+CFTypeRef _CFBinaryPlistNodeGetKeyAtIndex(_CFBinaryPlistNodeRef node, CFIndex idx) {
+    __CFGenericValidateType(node, _CFBinaryPlistNodeGetTypeID());
+    if (!node->_isDictionary || idx < 0 || node->_count <= idx) return NULL;
+    const uint8_t *ref = node->_refs + idx * node->_trailer._objectRefSize;
+    return __CFBinaryPlistNodeGetValueAtOffset(node, _getOffsetOfRefAt(CFDataGetBytePtr(node->_data), ref, &node->_trailer));
+}
+
+CFTypeRef _CFBinaryPlistNodeGetValue(_CFBinaryPlistNodeRef node, CFTypeRef key) {
+    __CFGenericValidateType(node, _CFBinaryPlistNodeGetTypeID());
+    uint64_t voffset;
+    if (!node->_isDictionary || !__CFBinaryPlistGetOffsetForValueFromDictionary3(CFDataGetBytePtr(node->_data), CFDataGetLength(node->_data), node->_offset, &node->_trailer, key, NULL, &voffset, false, NULL)) return NULL;
+    return __CFBinaryPlistNodeGetValueAtOffset(node, voffset);
+}
+
+CFPropertyListRef _CFBinaryPlistNodeCreatePropertyList(CFAllocatorRef allocator, _CFBinaryPlistNodeRef node, CFOptionFlags mutabilityOption) {
+    __CFGenericValidateType(node, _CFBinaryPlistNodeGetTypeID());
+    CFPropertyListRef plist = NULL;
+    CFMutableDictionaryRef objects = CFDictionaryCreateMutable(kCFAllocatorSystemDefault, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+    if (!__CFBinaryPlistCreateObjectFiltered(CFDataGetBytePtr(node->_data), CFDataGetLength(node->_data), node->_offset, &node->_trailer, allocator, mutabilityOption, objects, NULL, 0, NULL, &plist)) {
+        plist = NULL;
+    }
+    CFRelease(objects);
+    return plist;
+}
+
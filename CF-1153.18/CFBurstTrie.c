@@ -40,6 +40,7 @@
 #include <unistd.h>
 #include <sys/param.h>
 #include <sys/mman.h>
+#include <sys/file.h>
 #endif
 
 #include <errno.h>
@@ -84,6 +85,7 @@ static int pwrite(int fd, const void *buf, size_t nbyte, off_t offset) {
 #define MAX_KEY_LENGTH              MAX_STRING_SIZE * 4
 #define CHARACTER_SET_SIZE          256
 #define MAX_LIST_SIZE               256 // 64
+#define DELTA_LIST_SIZE             32  // Every lookup in a trie with a delta searches the delta, so its lists are kept short
 #define MAX_BITMAP_SIZE             200
 #define MAX_BUFFER_SIZE             (4096<<2)
 
@@ -207,6 +209,7 @@ typedef struct _CFBurstTrieCursor {
     CompactMapCursor mapCursor;
     CFIndex cursorType;
     CFBurstTrieRef trie;
+    uint32_t mapGeneration;
 } _CFBurstTrieCursor;
 
 // ** Legacy
@@ -251,6 +254,21 @@ typedef struct _fileHeader {
     uint32_t flags;
 } fileHeader;
 // **
+
+// A delta log is a header naming the mapped trie it applies to, followed by one record per term added, all little-endian.
+typedef struct _DeltaLogHeader {
+    uint32_t signature;
+    uint32_t baseCount;
+    uint32_t baseSize;
+    uint32_t reserved;
+} DeltaLogHeader;
+
+typedef struct _DeltaLogRecord {
+    uint32_t weight;
+    uint32_t payload;
+    uint16_t length;
+    UInt8 string[];
+} DeltaLogRecord;
 #pragma pack()
 
 struct _CFBurstTrie {
@@ -270,6 +288,18 @@ struct _CFBurstTrie {
     HANDLE mapHandle;
     HANDLE mappedFileHandle;
 #endif
+    // Terms added to a mapped trie go into the delta, an in-memory trie, and, if the trie has a delta log, are appended to that too.
+    // Readers hold the lock for reading; anything that changes the trie holds updateLock throughout, and the lock for writing
+    // only while it changes what readers can see, so that readers carry on while a compaction writes the merged trie.
+    struct _CFBurstTrie *delta;
+    uint32_t deltaShadowCount;
+    int deltaLogFD;
+    Boolean ownsDeltaLogFD;
+    off_t deltaLogSize;
+    // Counts the maps compaction has swapped in; a cursor set on an earlier map no longer points into the trie
+    uint32_t mapGeneration;
+    pthread_rwlock_t lock;
+    pthread_mutex_t updateLock;
 };
 
 #if 0
@@ -310,6 +340,19 @@ static Boolean burstTrieMappedFind(DiskTrieLevelRef trie, char *map, const UInt8
 static Boolean burstTrieMappedPageFind(StringPage *page, const UInt8 *key, uint32_t length, uint32_t *payload, bool prefix);
 static Boolean burstTrieCompactTrieMappedFind(CompactDiskTrieLevelRef trie, char *map, const UInt8 *key, uint32_t length, uint32_t *payload, bool prefix);
 
+static CFBurstTrieRef allocCFBurstTrie(void);
+static CFBurstTrieRef createCFBurstTrieWithContainerSize(uint32_t containerSize);
+static CFBTInsertCode insertCFBurstTrieTerm(CFBurstTrieRef trie, const uint8_t *key, uint32_t keylen, uint32_t weight, uint32_t payload);
+static Boolean containsCFBurstTrieTerm(CFBurstTrieRef trie, const UInt8 *key, CFIndex length, uint32_t *payload);
+static Boolean serializeCFBurstTrieWithFileDescriptor(CFBurstTrieRef trie, int fd, CFBurstTrieOpts opts);
+
+static CFBTInsertCode addCFBurstTrieDelta(CFBurstTrieRef trie, const uint8_t *key, uint32_t keylen, uint32_t weight, uint32_t payload);
+static void traverseCFBurstTrieAndDelta(CFBurstTrieRef trie, const uint8_t *prefix, uint32_t prefixLen, void *ctx, bool (*callback)(void *, const uint8_t *, uint32_t, bool));
+static Boolean appendCFBurstTrieDeltaLog(CFBurstTrieRef trie, const uint8_t *key, uint32_t keylen, uint32_t weight, uint32_t payload);
+static Boolean replayCFBurstTrieDeltaLog(CFBurstTrieRef trie, int fd);
+static Boolean resetCFBurstTrieDeltaLog(CFBurstTrieRef trie);
+static Boolean compactCFBurstTrie(CFBurstTrieRef trie, int fd, CFBurstTrieOpts opts);
+
 static void destroyCFBurstTrie(CFBurstTrieRef trie);
 static void finalizeCFBurstTrie(TrieLevelRef trie);
 static void finalizeCFBurstTrieList(ListNodeRef node); 
@@ -322,6 +365,7 @@ static bool containsKey(void *context, const uint8_t *key, uint32_t payload, boo
 
 static CFIndex burstTrieConvertCharactersToUTF8(UniChar *chars, CFIndex numChars, UInt8 *buffer);
 
+static Boolean setMapCursorForBytes(CFBurstTrieRef trie, _CFBurstTrieCursor *cursor, const UInt8* bytes, CFIndex length);
 static Boolean advanceMapCursor(CFBurstTrieRef trie, CompactMapCursor *cursor, const UInt8* bytes, CFIndex length);
 static Boolean getMapCursorPayload(CFBurstTrieRef trie, const CompactMapCursor *cursor, uint32_t *payload);
 static void copyMapCursor(const CompactMapCursor *source, CompactMapCursor* destination);
@@ -332,7 +376,7 @@ static Boolean getMapCursorPayloadFromPageEntry(PageEntry *entry, const CompactM
 
 CFBurstTrieRef CFBurstTrieCreateWithOptions(CFDictionaryRef options) {
     CFBurstTrieRef trie = NULL;
-    trie = (CFBurstTrieRef) calloc(1, sizeof(struct _CFBurstTrie));
+    trie = allocCFBurstTrie();
     trie->containerSize = MAX_LIST_SIZE;
 
     CFNumberRef valueAsCFNumber;
@@ -341,7 +385,6 @@ CFBurstTrieRef CFBurstTrieCreateWithOptions(CFDictionaryRef options) {
         CFNumberGetValue(valueAsCFNumber, kCFNumberIntType, &value);
         trie->containerSize = value > 2 && value < 4096 ? value : MAX_LIST_SIZE;
     }
-    trie->retain = 1;
     return trie;
 }
 
@@ -388,13 +431,12 @@ CFBurstTrieRef CFBurstTrieCreateFromFile(CFStringRef path) {
     TrieHeader *header = (TrieHeader *)map;
 
     if (((uint32_t*)map)[0] == 0xbabeface) {
-        trie = (CFBurstTrieRef) calloc(1, sizeof(struct _CFBurstTrie));
+        trie = allocCFBurstTrie();
         trie->mapBase = map;
         trie->mapSize = CFSwapInt32LittleToHost(sb.st_size); 
         trie->mapOffset = CFSwapInt32LittleToHost(((fileHeader*)trie->mapBase)->rootOffset);
         trie->cflags = CFSwapInt32LittleToHost(((fileHeader*)trie->mapBase)->flags);
         trie->count = CFSwapInt32LittleToHost(((fileHeader*)trie->mapBase)->count);
-        trie->retain = 1;
 #if DEPLOYMENT_TARGET_WINDOWS
         trie->mappedFileHandle = mappedFileHandle;
         trie->mapHandle = mapHandle;
@@ -403,12 +445,11 @@ CFBurstTrieRef CFBurstTrieCreateFromFile(CFStringRef path) {
         close(fd);
 #endif
     } else if (header->signature == 0xcafebabe || header->signature == 0x0ddba11) {
-        trie = (CFBurstTrieRef) calloc(1, sizeof(struct _CFBurstTrie));
+        trie = allocCFBurstTrie();
         trie->mapBase = map;
         trie->mapSize = CFSwapInt32LittleToHost(sb.st_size); 
         trie->cflags = CFSwapInt32LittleToHost(header->flags);
         trie->count = CFSwapInt32LittleToHost(header->count);
-        trie->retain = 1;
 #if DEPLOYMENT_TARGET_WINDOWS
         trie->mappedFileHandle = mappedFileHandle;
         trie->mapHandle = mapHandle;
@@ -427,20 +468,18 @@ CFBurstTrieRef CFBurstTrieCreateFromMapBytes(char *mapBase) {
     TrieHeader *header = (TrieHeader *)mapBase;
 
     if (mapBase && ((uint32_t*)mapBase)[0] == 0xbabeface) {
-        trie = (CFBurstTrieRef) malloc(sizeof(struct _CFBurstTrie));
+        trie = allocCFBurstTrie();
         trie->mapBase = mapBase;
         trie->mapSize = CFSwapInt32LittleToHost(((fileHeader*)trie->mapBase)->size);
         trie->mapOffset = CFSwapInt32LittleToHost(((fileHeader*)trie->mapBase)->rootOffset);
         trie->cflags = CFSwapInt32LittleToHost(((fileHeader*)trie->mapBase)->flags);
         trie->count = CFSwapInt32LittleToHost(((fileHeader*)trie->mapBase)->count);
-        trie->retain = 1;
     } else if (mapBase && (header->signature == 0xcafebabe || header->signature == 0x0ddba11)) {
-        trie = (CFBurstTrieRef) malloc(sizeof(struct _CFBurstTrie));
+        trie = allocCFBurstTrie();
         trie->mapBase = mapBase;
         trie->mapSize = CFSwapInt32LittleToHost(header->size);
         trie->cflags = CFSwapInt32LittleToHost(header->flags);
         trie->count = CFSwapInt32LittleToHost(header->count);
-        trie->retain = 1;
     }
     return trie;
 }
@@ -477,7 +516,7 @@ Boolean CFBurstTrieAddWithWeight(CFBurstTrieRef trie, CFStringRef term, CFRange
     Boolean success = false;
     CFIndex size = MAX_STRING_ALLOCATION_SIZE;
     CFIndex bytesize = termRange.length * 4; //** 4-byte max character size
-    if (!trie->mapBase && termRange.length < MAX_STRING_SIZE && payload > 0) {
+    if (termRange.length < MAX_STRING_SIZE && payload > 0) {
         CFIndex length;
         UInt8 buffer[MAX_STRING_ALLOCATION_SIZE + 1];
         UInt8 *key = buffer;
@@ -502,7 +541,7 @@ Boolean CFBurstTrieAddCharactersWithWeight(CFBurstTrieRef trie, UniChar *chars,
     Boolean success = false;
     CFIndex size = MAX_STRING_ALLOCATION_SIZE;
     CFIndex bytesize = numChars * 4; //** 4-byte max character size
-    if (!trie->mapBase && numChars < MAX_STRING_SIZE && payload > 0) {
+    if (numChars < MAX_STRING_SIZE && payload > 0) {
         CFIndex length;
         UInt8 buffer[MAX_STRING_ALLOCATION_SIZE + 1];
         UInt8 *key = buffer;
@@ -526,9 +565,16 @@ Boolean CFBurstTrieInsertUTF8StringWithWeight(CFBurstTrieRef trie, UInt8 *chars,
 Boolean CFBurstTrieAddUTF8StringWithWeight(CFBurstTrieRef trie, UInt8 *chars, CFIndex numChars, uint32_t weight, uint32_t payload) {
     CFBTInsertCode code = FailedInsert;
     
-    if (!trie->mapBase && numChars < MAX_STRING_SIZE*4 && payload > 0) {
-        code = addCFBurstTrieLevel(trie, &trie->root, chars, numChars, weight, payload);
-        if (code == NewTerm) trie->count++;
+    if (numChars < MAX_STRING_SIZE*4 && payload > 0) {
+        pthread_mutex_lock(&trie->updateLock);
+        if (!trie->mapBase) {
+            pthread_rwlock_wrlock(&trie->lock);
+            code = insertCFBurstTrieTerm(trie, chars, numChars, weight, payload);
+            pthread_rwlock_unlock(&trie->lock);
+        } else if (appendCFBurstTrieDeltaLog(trie, chars, numChars, weight, payload)) {
+            code = addCFBurstTrieDelta(trie, chars, numChars, weight, payload);
+        }
+        pthread_mutex_unlock(&trie->updateLock);
     }
     return code > FailedInsert;
 }
@@ -605,21 +651,11 @@ Boolean CFBurstTrieFindUTF8String(CFBurstTrieRef trie, UInt8 *key, CFIndex lengt
 Boolean CFBurstTrieContainsUTF8String(CFBurstTrieRef trie, UInt8 *key, CFIndex length, uint32_t *payload) {
     Boolean success = false;
     if (length < MAX_STRING_SIZE) {
-        if (trie->mapBase && ((fileHeader *)trie->mapBase)->signature == 0xbabeface) {
-            bool prefix = (trie->cflags & kCFBurstTriePrefixCompression);
-            success = burstTrieMappedFind((DiskTrieLevelRef)(trie->mapBase+CFSwapInt32LittleToHost((((uint32_t*)trie->mapBase)[1]))), trie->mapBase, key, length, payload, prefix);
-        } else if (trie->mapBase && trie->cflags & (kCFBurstTriePrefixCompression | kCFBurstTrieSortByKey)) {
-            _CFBurstTrieCursor cursor;
-            if (!CFBurstTrieSetCursorForBytes(trie, &cursor, key, length))
-                return FALSE;
-            return CFBurstTrieCursorGetPayload(&cursor, payload);
-        } else {
-            uint32_t found = 0;
-            void *cursor = 0;
-            traverseCFBurstTrieWithCursor(trie, key, length, &cursor, true, &found, containsKey);
-            if (found) SetPayload(payload, found);
-            success = found > 0;
-        }
+        pthread_rwlock_rdlock(&trie->lock);
+        // The delta holds the latest payload for any term it shares with the mapped trie
+        if (trie->delta) success = containsCFBurstTrieTerm(trie->delta, key, length, payload);
+        if (!success) success = containsCFBurstTrieTerm(trie, key, length, payload);
+        pthread_rwlock_unlock(&trie->lock);
     }
     return success;
 }
@@ -646,6 +682,16 @@ Boolean CFBurstTrieSerialize(CFBurstTrieRef trie, CFStringRef path, CFBurstTrieO
 }
 
 Boolean CFBurstTrieSerializeWithFileDescriptor(CFBurstTrieRef trie, int fd, CFBurstTrieOpts opts) {
+    // Serializing takes the in-memory trie apart as it goes, so readers have to wait for it
+    pthread_mutex_lock(&trie->updateLock);
+    pthread_rwlock_wrlock(&trie->lock);
+    Boolean success = serializeCFBurstTrieWithFileDescriptor(trie, fd, opts);
+    pthread_rwlock_unlock(&trie->lock);
+    pthread_mutex_unlock(&trie->updateLock);
+    return success;
+}
+
+static Boolean serializeCFBurstTrieWithFileDescriptor(CFBurstTrieRef trie, int fd, CFBurstTrieOpts opts) {
     Boolean success = false;
     if (!trie->mapBase && fd >= 0) {
         off_t start_offset = lseek(fd, 0, SEEK_END);
@@ -674,20 +720,23 @@ Boolean CFBurstTrieSerializeWithFileDescriptor(CFBurstTrieRef trie, int fd, CFBu
 }
 
 void CFBurstTrieTraverse(CFBurstTrieRef trie, void *ctx, void (*callback)(void*, const UInt8*, uint32_t, uint32_t)) {
+    pthread_rwlock_rdlock(&trie->lock);
     TrieHeader *header = (TrieHeader *)trie->mapBase;
     if (!trie->mapBase || (header->signature == 0xcafebabe || header->signature == 0x0ddba11)) {
-        void *cursor = 0;
         TraverseContext context;
         context.context = ctx;
         context.callback = callback;
-        traverseCFBurstTrieWithCursor(trie, (const uint8_t *)"", 0, &cursor, false, &context, foundKey);
+        traverseCFBurstTrieAndDelta(trie, (const uint8_t *)"", 0, &context, foundKey);
     }
+    pthread_rwlock_unlock(&trie->lock);
 }
 
 
 void CFBurstTrieTraverseWithCursor(CFBurstTrieRef trie, const uint8_t *prefix, uint32_t prefixLen, void **cursor, void *ctx, bool (*callback)(void *, const uint8_t *, uint32_t, bool))
 {
-    traverseCFBurstTrieWithCursor(trie, prefix, prefixLen, cursor, false, ctx, callback);
+    pthread_rwlock_rdlock(&trie->lock);
+    traverseCFBurstTrieAndDelta(trie, prefix, prefixLen, ctx, callback);
+    pthread_rwlock_unlock(&trie->lock);
 }
 
 void CFBurstTriePrint(CFBurstTrieRef trie) {
@@ -709,32 +758,94 @@ void CFBurstTrieRelease(CFBurstTrieRef trie) {
     return;
 }
 
-Boolean CFBurstTrieSetCursorForBytes(CFBurstTrieRef trie, CFBurstTrieCursorRef cursor, const UInt8* bytes, CFIndex length)
-{
-    if (!trie->mapBase || !(trie->cflags & (kCFBurstTriePrefixCompression | kCFBurstTrieSortByKey))) {
-        //fprintf(stderr, "CFBurstTrieCreateCursorForBytes() only support file based trie in prefix compression format.\n");
-        return FALSE;
+CFIndex CFBurstTrieGetDeltaCount(CFBurstTrieRef trie) {
+    pthread_rwlock_rdlock(&trie->lock);
+    CFIndex count = trie->delta ? trie->delta->count : 0;
+    pthread_rwlock_unlock(&trie->lock);
+    return count;
+}
+
+Boolean CFBurstTrieSetDeltaLog(CFBurstTrieRef trie, CFStringRef path) {
+    int fd;
+    char filename[PATH_MAX];
+    
+    /* Check valid path name */
+    if (!CFStringGetCString(path, filename, PATH_MAX, kCFStringEncodingUTF8)) return false;
+    
+    /* Check if file can be opened */
+    if ((fd=open(filename, CF_OPENFLGS|O_RDWR|O_CREAT, S_IRUSR|S_IWUSR)) < 0) return false;
+    
+    if (!CFBurstTrieSetDeltaLogWithFileDescriptor(trie, fd)) {
+        close(fd);
+        return false;
     }
+    trie->ownsDeltaLogFD = true;
+    return true;
+}
 
-    TrieHeader *header = (TrieHeader*)trie->mapBase;
-    if (length < 0 || !trie)
-        return FALSE;
+Boolean CFBurstTrieSetDeltaLogWithFileDescriptor(CFBurstTrieRef trie, int fd) {
+    Boolean success = false;
+    pthread_mutex_lock(&trie->updateLock);
+    if (trie->mapBase && trie->deltaLogFD < 0 && fd >= 0) {
+#if DEPLOYMENT_TARGET_WINDOWS
+        success = replayCFBurstTrieDeltaLog(trie, fd);
+#else
+        // Two tries appending to one log would interleave their records, so the log is locked for as long as a trie has it
+        if (flock(fd, LOCK_EX|LOCK_NB) == 0) {
+            success = replayCFBurstTrieDeltaLog(trie, fd);
+            if (!success) flock(fd, LOCK_UN);
+        }
+#endif
+    }
+    pthread_mutex_unlock(&trie->updateLock);
+    return success;
+}
 
-    cursor->trie = trie;
-    if (trie->mapBase) {
-        cursor->cursorType = _kCFBurstTrieCursorMapType;
-        cursor->mapCursor.next = header->rootOffset;
-        cursor->mapCursor.isOnPage = FALSE;
-        cursor->mapCursor.entryOffsetInPage = 0;
-        cursor->mapCursor.offsetInEntry = 0;
-        cursor->mapCursor.payload = 0;
-    } else
-        assert(false);
+Boolean CFBurstTrieCompact(CFBurstTrieRef trie, CFStringRef path, CFBurstTrieOpts opts) {
+    int fd;
+    char filename[PATH_MAX];
+    char tempname[PATH_MAX];
+    
+    /* Check valid path name */
+    if (!CFStringGetCString(path, filename, PATH_MAX, kCFStringEncodingUTF8)) return false;
+    if (snprintf(tempname, PATH_MAX, "%s.compact", filename) >= PATH_MAX) return false;
+    
+    // The trie may be mapped from the file at path, so the merged trie is written beside it and renamed over it, which
+    // leaves the old file's pages in place for as long as they are mapped.
+    if ((fd=open(tempname, CF_OPENFLGS|O_RDWR|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR)) < 0) return false;
+    
+    Boolean success = CFBurstTrieCompactWithFileDescriptor(trie, fd, opts);
+    close(fd);
+    if (success && rename(tempname, filename) != 0) success = false;
+    if (!success) unlink(tempname);
+    return success;
+}
 
-    if (!bytes || length == 0)
-        return TRUE;
+Boolean CFBurstTrieCompactWithFileDescriptor(CFBurstTrieRef trie, int fd, CFBurstTrieOpts opts) {
+    Boolean success = false;
+    if (fd >= 0) {
+        pthread_mutex_lock(&trie->updateLock);
+        if (trie->mapBase) {
+            success = compactCFBurstTrie(trie, fd, opts);
+        } else {
+            pthread_rwlock_wrlock(&trie->lock);
+            success = serializeCFBurstTrieWithFileDescriptor(trie, fd, opts);
+            pthread_rwlock_unlock(&trie->lock);
+        }
+        pthread_mutex_unlock(&trie->updateLock);
+    }
+    return success;
+}
 
-    return CFBurstTrieCursorAdvanceForBytes(cursor, bytes, length);
+Boolean CFBurstTrieSetCursorForBytes(CFBurstTrieRef trie, CFBurstTrieCursorRef cursor, const UInt8* bytes, CFIndex length)
+{
+    if (!trie)
+        return FALSE;
+
+    pthread_rwlock_rdlock(&trie->lock);
+    Boolean success = setMapCursorForBytes(trie, cursor, bytes, length);
+    pthread_rwlock_unlock(&trie->lock);
+    return success;
 }
 
 
@@ -764,12 +875,13 @@ CFBurstTrieCursorRef CFBurstTrieCursorCreateByCopy(CFBurstTrieCursorRef cursor)
     }
     newCursor->cursorType = cursor->cursorType;
     newCursor->trie = cursor->trie;
+    newCursor->mapGeneration = cursor->mapGeneration;
     return newCursor;
 }
 
 Boolean CFBurstTrieCursorIsEqual(CFBurstTrieCursorRef lhs, CFBurstTrieCursorRef rhs)
 {
-    if (lhs->trie != rhs->trie || lhs->cursorType != rhs->cursorType)
+    if (lhs->trie != rhs->trie || lhs->cursorType != rhs->cursorType || lhs->mapGeneration != rhs->mapGeneration)
         return FALSE;
 
     if (lhs->cursorType == _kCFBurstTrieCursorMapType)
@@ -780,32 +892,44 @@ Boolean CFBurstTrieCursorIsEqual(CFBurstTrieCursorRef lhs, CFBurstTrieCursorRef
 
 Boolean CFBurstTrieCursorAdvanceForBytes(CFBurstTrieCursorRef cursor, const UInt8* bytes, CFIndex length)
 {
+    Boolean success = FALSE;
     switch (cursor->cursorType) {
         case _kCFBurstTrieCursorMapType: {
-            CompactMapCursor tempCursor;
-            copyMapCursor(&cursor->mapCursor, &tempCursor);
-            if (advanceMapCursor(cursor->trie, (CompactMapCursor*)&cursor->mapCursor, bytes, length))
-                return TRUE;
-            else {
-                copyMapCursor(&tempCursor, &cursor->mapCursor);
-                return FALSE;
+            CFBurstTrieRef trie = cursor->trie;
+            pthread_rwlock_rdlock(&trie->lock);
+            // The map the cursor was set on may have been unmapped by a compaction
+            if (cursor->mapGeneration == trie->mapGeneration) {
+                CompactMapCursor tempCursor;
+                copyMapCursor(&cursor->mapCursor, &tempCursor);
+                success = advanceMapCursor(trie, (CompactMapCursor*)&cursor->mapCursor, bytes, length);
+                if (!success)
+                    copyMapCursor(&tempCursor, &cursor->mapCursor);
             }
+            pthread_rwlock_unlock(&trie->lock);
+            break;
         }
         case _kCFBurstTrieCursorTrieType:
-            return FALSE;
+            break;
     }
-    return FALSE;
+    return success;
 }
 
 Boolean CFBurstTrieCursorGetPayload(CFBurstTrieCursorRef cursor, uint32_t *payload)
 {
+    Boolean success = FALSE;
     switch (cursor->cursorType) {
-        case _kCFBurstTrieCursorMapType:
-            return getMapCursorPayload(cursor->trie, (CompactMapCursor*)&cursor->mapCursor, payload);
+        case _kCFBurstTrieCursorMapType: {
+            CFBurstTrieRef trie = cursor->trie;
+            pthread_rwlock_rdlock(&trie->lock);
+            if (cursor->mapGeneration == trie->mapGeneration)
+                success = getMapCursorPayload(trie, (CompactMapCursor*)&cursor->mapCursor, payload);
+            pthread_rwlock_unlock(&trie->lock);
+            break;
+        }
         case _kCFBurstTrieCursorTrieType:
-            return FALSE;
+            break;
     }
-    return FALSE;
+    return success;
 }
 
 void CFBurstTrieCursorRelease(CFBurstTrieCursorRef cursor)
@@ -826,9 +950,14 @@ void CFBurstTrieTraverseFromCursor(CFBurstTrieCursorRef cursor, void *ctx, CFBur
     Boolean stop = FALSE;
     switch (cursor->cursorType) {
         case _kCFBurstTrieCursorMapType: {
-            CompactMapCursor tempCursor;
-            copyMapCursor(&cursor->mapCursor, &tempCursor);
-            traverseFromMapCursor(cursor->trie, &tempCursor, bytes, capacity,length, &stop, ctx, callback);
+            CFBurstTrieRef trie = cursor->trie;
+            pthread_rwlock_rdlock(&trie->lock);
+            if (cursor->mapGeneration == trie->mapGeneration) {
+                CompactMapCursor tempCursor;
+                copyMapCursor(&cursor->mapCursor, &tempCursor);
+                traverseFromMapCursor(trie, &tempCursor, bytes, capacity,length, &stop, ctx, callback);
+            }
+            pthread_rwlock_unlock(&trie->lock);
             break;
         }
         case _kCFBurstTrieCursorTrieType:
@@ -943,6 +1072,13 @@ static CFBTInsertCode addCFBurstTrieLevel(CFBurstTrieRef trie, TrieLevelRef root
     
     return code;
 }
+
+static CFBTInsertCode insertCFBurstTrieTerm(CFBurstTrieRef trie, const uint8_t *key, uint32_t keylen, uint32_t weight, uint32_t payload)
+{
+    CFBTInsertCode code = addCFBurstTrieLevel(trie, &trie->root, key, keylen, weight, payload);
+    if (code == NewTerm) trie->count++;
+    return code;
+}
 #if 0
 #pragma mark -
 #pragma mark Searching
@@ -1168,19 +1304,14 @@ static void traverseCFBurstTrieCompactMappedLevel(CFBurstTrieRef trie, CompactMa
 
 static void traverseCFBurstTrieWithCursor(CFBurstTrieRef trie, const uint8_t *prefix, uint32_t prefixLen, void **cursor, bool exactmatch, void *ctx, bool (*callback)(void *, const uint8_t *, uint32_t, bool)) {
     if (trie->mapBase) {
-        if (trie->cflags & kCFBurstTriePrefixCompression) {
-            fprintf(stderr, "Please use CFBurstTrieCursorRef API for file based trie.\n");
-            return;
-        } else {
-            TrieHeader *header = (TrieHeader *)trie->mapBase;
-            MapCursor csr;
-            csr.next = header->rootOffset;
-            csr.prefix = prefix;
-            csr.prefixlen = prefixLen;
-            csr.key[0] = 0;
-            csr.keylen = 0;
-            findCFBurstTrieMappedLevel(trie, &csr, exactmatch, ctx, callback);
-        }
+        TrieHeader *header = (TrieHeader *)trie->mapBase;
+        MapCursor csr;
+        csr.next = header->rootOffset;
+        csr.prefix = prefix;
+        csr.prefixlen = prefixLen;
+        csr.key[0] = 0;
+        csr.keylen = 0;
+        findCFBurstTrieMappedLevel(trie, &csr, exactmatch, ctx, callback);
     } else {    
         TrieCursor csr;
         csr.next = ((uintptr_t)&trie->root)|TrieKind;
@@ -1192,6 +1323,30 @@ static void traverseCFBurstTrieWithCursor(CFBurstTrieRef trie, const uint8_t *pr
     }
 }
 
+// Looks the term up in this trie alone, without its delta
+static Boolean containsCFBurstTrieTerm(CFBurstTrieRef trie, const UInt8 *key, CFIndex length, uint32_t *payload) {
+    Boolean success = false;
+    if (length < MAX_STRING_SIZE) {
+        if (trie->mapBase && ((fileHeader *)trie->mapBase)->signature == 0xbabeface) {
+            bool prefix = (trie->cflags & kCFBurstTriePrefixCompression);
+            success = burstTrieMappedFind((DiskTrieLevelRef)(trie->mapBase+CFSwapInt32LittleToHost((((uint32_t*)trie->mapBase)[1]))), trie->mapBase, key, length, payload, prefix);
+        } else if (trie->mapBase && trie->cflags & (kCFBurstTriePrefixCompression | kCFBurstTrieSortByKey)) {
+            _CFBurstTrieCursor cursor;
+            if (!setMapCursorForBytes(trie, &cursor, key, length))
+                return FALSE;
+            return getMapCursorPayload(trie, &cursor.mapCursor, payload);
+        } else {
+            uint32_t found = 0;
+            void *cursor = 0;
+            traverseCFBurstTrieWithCursor(trie, key, length, &cursor, true, &found, containsKey);
+            if (found) SetPayload(payload, found);
+            success = found > 0;
+        }
+    }
+    return success;
+}
+
+
 CF_INLINE uint32_t getPackedPageEntrySize(PageEntryPacked *entry)
 {
     return sizeof(PageEntryPacked) + entry->strlen;
@@ -1430,6 +1585,32 @@ static Boolean advanceCursorMappedLevel(CFBurstTrieRef trie, CompactMapCursor *c
     return advanceMapCursor(trie, cursor, bytes + 1, length - 1);
 }
 
+// Called with the lock held for reading, or with updateLock held
+static Boolean setMapCursorForBytes(CFBurstTrieRef trie, _CFBurstTrieCursor *cursor, const UInt8* bytes, CFIndex length)
+{
+    if (!trie->mapBase || !(trie->cflags & (kCFBurstTriePrefixCompression | kCFBurstTrieSortByKey))) {
+        //fprintf(stderr, "CFBurstTrieCreateCursorForBytes() only support file based trie in prefix compression format.\n");
+        return FALSE;
+    }
+    if (length < 0)
+        return FALSE;
+
+    TrieHeader *header = (TrieHeader*)trie->mapBase;
+    cursor->trie = trie;
+    cursor->cursorType = _kCFBurstTrieCursorMapType;
+    cursor->mapGeneration = trie->mapGeneration;
+    cursor->mapCursor.next = header->rootOffset;
+    cursor->mapCursor.isOnPage = FALSE;
+    cursor->mapCursor.entryOffsetInPage = 0;
+    cursor->mapCursor.offsetInEntry = 0;
+    cursor->mapCursor.payload = 0;
+
+    if (!bytes || length == 0)
+        return TRUE;
+
+    return advanceMapCursor(trie, &cursor->mapCursor, bytes, length);
+}
+
 static Boolean advanceMapCursor(CFBurstTrieRef trie, CompactMapCursor *cursor, const UInt8* bytes, CFIndex length)
 {
     bool result = FALSE;
@@ -1980,6 +2161,265 @@ static size_t serializeCFBurstTrie(CFBurstTrieRef trie, size_t start_offset, int
     return (size_t)(offset-start_offset);
 }
 
+#if 0
+#pragma mark -
+#pragma mark Delta
+#endif
+
+#define DELTA_LOG_SIGNATURE 0xde17a106
+
+static CFBurstTrieRef allocCFBurstTrie(void) {
+    CFBurstTrieRef trie = (CFBurstTrieRef) calloc(1, sizeof(struct _CFBurstTrie));
+    trie->retain = 1;
+    trie->deltaLogFD = -1;
+#if DEPLOYMENT_TARGET_LINUX
+    // glibc lets readers keep taking a read lock while a writer waits, so a steady stream of lookups would hold off updates forever
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&trie->lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+#else
+    pthread_rwlock_init(&trie->lock, NULL);
+#endif
+    pthread_mutex_init(&trie->updateLock, NULL);
+    return trie;
+}
+
+static CFBurstTrieRef createCFBurstTrieWithContainerSize(uint32_t containerSize) {
+    CFBurstTrieRef trie = allocCFBurstTrie();
+    // Tries created from a file don't know the container size they were built with
+    trie->containerSize = containerSize ? containerSize : MAX_LIST_SIZE;
+    return trie;
+}
+
+// Called with updateLock held
+static CFBTInsertCode addCFBurstTrieDelta(CFBurstTrieRef trie, const uint8_t *key, uint32_t keylen, uint32_t weight, uint32_t payload)
+{
+    // Only a thread holding updateLock changes the mapped trie or the delta, so both can be read here without the lock
+    uint32_t basePayload;
+    Boolean inBase = containsCFBurstTrieTerm(trie, key, keylen, &basePayload);
+    CFBurstTrieRef delta = trie->delta ? trie->delta : createCFBurstTrieWithContainerSize(DELTA_LIST_SIZE);
+    
+    pthread_rwlock_wrlock(&trie->lock);
+    trie->delta = delta;
+    CFBTInsertCode code = insertCFBurstTrieTerm(delta, key, keylen, weight, payload);
+    if (code == NewTerm && inBase) trie->deltaShadowCount++;
+    else if (code == NewTerm) trie->count++;
+    pthread_rwlock_unlock(&trie->lock);
+    return code;
+}
+
+typedef struct _DeltaTraverseContext {
+    CFBurstTrieRef delta;
+    void *context;
+    bool (*callback)(void *, const uint8_t *, uint32_t, bool);
+    bool stopped;
+} DeltaTraverseContext;
+
+static bool foundKeyNotInDelta(void *context, const uint8_t *key, uint32_t payload, bool exact)
+{
+    DeltaTraverseContext *ctx = (DeltaTraverseContext *)context;
+    // A term which is also in the delta is reported when the delta is traversed, with its newer payload
+    if (ctx->delta && containsCFBurstTrieTerm(ctx->delta, key, strlen((const char *)key), NULL)) return false;
+    ctx->stopped = ctx->callback(ctx->context, key, payload, exact);
+    return ctx->stopped;
+}
+
+// Called with the lock held for reading
+static void traverseCFBurstTrieAndDelta(CFBurstTrieRef trie, const uint8_t *prefix, uint32_t prefixLen, void *ctx, bool (*callback)(void *, const uint8_t *, uint32_t, bool))
+{
+    void *cursor = 0;
+    if (!trie->delta) {
+        traverseCFBurstTrieWithCursor(trie, prefix, prefixLen, &cursor, false, ctx, callback);
+        return;
+    }
+    
+    DeltaTraverseContext context;
+    // Looking every mapped term up in the delta is only needed if the delta holds some of them
+    context.delta = trie->deltaShadowCount ? trie->delta : NULL;
+    context.context = ctx;
+    context.callback = callback;
+    context.stopped = false;
+    traverseCFBurstTrieWithCursor(trie, prefix, prefixLen, &cursor, false, &context, foundKeyNotInDelta);
+    if (!context.stopped) traverseCFBurstTrieWithCursor(trie->delta, prefix, prefixLen, &cursor, false, ctx, callback);
+}
+
+static bool copyMappedKey(void *context, const uint8_t *key, uint32_t payload, bool exact)
+{
+    // The mapped trie doesn't keep weights, so every term starts over with a weight of 1
+    insertCFBurstTrieTerm((CFBurstTrieRef)context, key, (uint32_t)strlen((const char *)key), 1, payload);
+    return false;
+}
+
+static Boolean copyCFBurstTrieMappedTerms(CFBurstTrieRef trie, CFBurstTrieRef merged)
+{
+    TrieHeader *header = (TrieHeader *)trie->mapBase;
+    if (header->signature != 0xcafebabe && header->signature != 0x0ddba11) return false;
+    
+    void *cursor = 0;
+    traverseCFBurstTrieWithCursor(trie, (const uint8_t *)"", 0, &cursor, false, merged, copyMappedKey);
+    return true;
+}
+
+static void copyCFBurstTrieLevel(CFBurstTrieRef merged, TrieLevelRef root, uint8_t *key, uint32_t keylen)
+{
+    if (root->payload) insertCFBurstTrieTerm(merged, key, keylen, root->weight, root->payload);
+    for (int i=0; i < CHARACTER_SET_SIZE; i++) {
+        NextTrie next = root->slots[i];
+        key[keylen] = i;
+        if (NextTrie_GetKind(next) == TrieKind) {
+            copyCFBurstTrieLevel(merged, (TrieLevelRef)NextTrie_GetPtr(next), key, keylen+1);
+        } else if (NextTrie_GetKind(next) == ListKind) {
+            for (ListNodeRef node = (ListNodeRef)NextTrie_GetPtr(next); node; node = node->next) {
+                memcpy(key+keylen+1, node->string, node->length);
+                insertCFBurstTrieTerm(merged, key, keylen+1+node->length, node->weight, node->payload);
+            }
+        }
+    }
+}
+
+// Called with updateLock held
+static Boolean compactCFBurstTrie(CFBurstTrieRef trie, int fd, CFBurstTrieOpts opts)
+{
+    CFBurstTrieRef merged = createCFBurstTrieWithContainerSize(trie->containerSize);
+    
+    // Readers aren't held up while the merged trie is built and written out, since nothing else can change the trie meanwhile
+    if (!copyCFBurstTrieMappedTerms(trie, merged)) {
+        destroyCFBurstTrie(merged);
+        return false;
+    }
+    if (trie->delta) {
+        uint8_t *key = (uint8_t *)malloc(MAX_KEY_LENGTH + 1);
+        copyCFBurstTrieLevel(merged, &trie->delta->root, key, 0);
+        free(key);
+    }
+    Boolean serialized = serializeCFBurstTrieWithFileDescriptor(merged, fd, opts);
+#if !DEPLOYMENT_TARGET_WINDOWS
+    if (merged->mapBase == MAP_FAILED) serialized = false;
+#endif
+    if (!serialized || !merged->mapBase) {
+        // Serializing freed the merged trie's levels and lists as it wrote them, and left file offsets in its root's slots
+        bzero(&merged->root, sizeof(merged->root));
+        merged->mapBase = NULL;
+        destroyCFBurstTrie(merged);
+        return false;
+    }
+    
+    // Swap the merged trie's map in, and leave the old map and the delta in the merged trie to be destroyed with it
+    pthread_rwlock_wrlock(&trie->lock);
+    char *mapBase = trie->mapBase;
+    uint32_t mapSize = trie->mapSize;
+    trie->mapBase = merged->mapBase;
+    trie->mapSize = merged->mapSize;
+    trie->mapOffset = 0;
+    trie->cflags = merged->cflags;
+    trie->count = merged->count;
+    trie->mapGeneration++;
+    merged->mapBase = mapBase;
+    merged->mapSize = mapSize;
+#if DEPLOYMENT_TARGET_WINDOWS
+    HANDLE mapHandle = trie->mapHandle;
+    HANDLE mappedFileHandle = trie->mappedFileHandle;
+    trie->mapHandle = merged->mapHandle;
+    trie->mappedFileHandle = merged->mappedFileHandle;
+    merged->mapHandle = mapHandle;
+    merged->mappedFileHandle = mappedFileHandle;
+#endif
+    merged->delta = trie->delta;
+    trie->delta = NULL;
+    trie->deltaShadowCount = 0;
+    pthread_rwlock_unlock(&trie->lock);
+    
+    destroyCFBurstTrie(merged);
+    // If this fails, the log still names the old mapped trie, so it won't be replayed onto the new one
+    resetCFBurstTrieDeltaLog(trie);
+    return true;
+}
+
+// Called with updateLock held
+static Boolean appendCFBurstTrieDeltaLog(CFBurstTrieRef trie, const uint8_t *key, uint32_t keylen, uint32_t weight, uint32_t payload)
+{
+    if (trie->deltaLogFD < 0) return true;
+    
+    size_t size = sizeof(DeltaLogRecord) + keylen;
+    char _buffer[MAX_BUFFER_SIZE];
+    char *buffer = size < MAX_BUFFER_SIZE ? _buffer : (char *) malloc(size);
+    DeltaLogRecord *record = (DeltaLogRecord *)buffer;
+    record->weight = CFSwapInt32HostToLittle(weight);
+    record->payload = CFSwapInt32HostToLittle(payload);
+    record->length = CFSwapInt16HostToLittle((uint16_t)keylen);
+    memcpy(record->string, key, keylen);
+    
+    // The term only goes into the delta once it is in the log
+    Boolean success = (pwrite(trie->deltaLogFD, buffer, size, trie->deltaLogSize) == (ssize_t)size);
+    if (success) trie->deltaLogSize += size;
+    if (buffer != _buffer) free(buffer);
+    return success;
+}
+
+static void getCFBurstTrieDeltaLogHeader(CFBurstTrieRef trie, DeltaLogHeader *header)
+{
+    fileHeader *mapHeader = (fileHeader *)trie->mapBase;
+    header->signature = CFSwapInt32HostToLittle(DELTA_LOG_SIGNATURE);
+    header->baseCount = mapHeader->count;
+    header->baseSize = mapHeader->size;
+    header->reserved = 0;
+}
+
+// Called with updateLock held
+static Boolean replayCFBurstTrieDeltaLog(CFBurstTrieRef trie, int fd)
+{
+    struct statinfo sb;
+    if (fstat(fd, &sb) != 0) return false;
+    
+    DeltaLogHeader expected;
+    getCFBurstTrieDeltaLogHeader(trie, &expected);
+    if (sb.st_size < (off_t)sizeof(DeltaLogHeader)) {
+        // A new log, or one whose header never made it out
+        if (ftruncate(fd, 0) != 0 || pwrite(fd, &expected, sizeof(expected), 0) != (ssize_t)sizeof(expected)) return false;
+        trie->deltaLogFD = fd;
+        trie->deltaLogSize = sizeof(expected);
+        return true;
+    }
+    
+    char *log = (char *) malloc(sb.st_size);
+    if (pread(fd, log, sb.st_size, 0) != sb.st_size || memcmp(log, &expected, sizeof(expected)) != 0) {
+        // The log belongs to another trie, or to this one before it was compacted
+        free(log);
+        return false;
+    }
+    
+    off_t offset = sizeof(DeltaLogHeader);
+    while (offset + (off_t)sizeof(DeltaLogRecord) <= sb.st_size) {
+        DeltaLogRecord *record = (DeltaLogRecord *)(log + offset);
+        uint32_t length = CFSwapInt16LittleToHost(record->length);
+        uint32_t payload = CFSwapInt32LittleToHost(record->payload);
+        if (offset + (off_t)sizeof(DeltaLogRecord) + length > sb.st_size || length >= MAX_STRING_SIZE*4 || payload == 0) break;
+        addCFBurstTrieDelta(trie, record->string, length, CFSwapInt32LittleToHost(record->weight), payload);
+        offset += sizeof(DeltaLogRecord) + length;
+    }
+    free(log);
+    
+    // Drop a record left half-written by a crash, so that the next one is appended where it can be read back
+    if (offset < sb.st_size && ftruncate(fd, offset) != 0) return false;
+    trie->deltaLogFD = fd;
+    trie->deltaLogSize = offset;
+    return true;
+}
+
+// Called with updateLock held
+static Boolean resetCFBurstTrieDeltaLog(CFBurstTrieRef trie)
+{
+    if (trie->deltaLogFD < 0) return true;
+    
+    DeltaLogHeader header;
+    getCFBurstTrieDeltaLogHeader(trie, &header);
+    if (ftruncate(trie->deltaLogFD, 0) != 0 || pwrite(trie->deltaLogFD, &header, sizeof(header), 0) != (ssize_t)sizeof(header)) return false;
+    trie->deltaLogSize = sizeof(header);
+    return true;
+}
+
 #if 0
 #pragma mark -
 #pragma mark Release
@@ -1997,6 +2437,13 @@ static void destroyCFBurstTrie(CFBurstTrieRef trie) {
     } else {
         finalizeCFBurstTrie(&trie->root);
     }
+    if (trie->delta) destroyCFBurstTrie(trie->delta);
+#if !DEPLOYMENT_TARGET_WINDOWS
+    if (trie->deltaLogFD >= 0) flock(trie->deltaLogFD, LOCK_UN);
+#endif
+    if (trie->ownsDeltaLogFD) close(trie->deltaLogFD);
+    pthread_rwlock_destroy(&trie->lock);
+    pthread_mutex_destroy(&trie->updateLock);
     free(trie);
     return;
 }
@@ -45,8 +45,8 @@ typedef CF_OPTIONS(CFOptionFlags, CFBurstTrieOpts) {
     
     /*  kCFBurstTrieReadOnly
         When specified, the dictionary file will be serialized in an optimized format so as to be
-        memory-mapped on the next read. Once a trie is serialized as read-only, insertions can no
-        longer occur.
+        memory-mapped on the next read. Once a trie is serialized as read-only, insertions go into a
+        delta kept alongside it until the trie is compacted.
     */
     kCFBurstTrieReadOnly            = 1<<1,
     
@@ -161,6 +161,9 @@ Boolean CFBurstTrieSerializeWithFileDescriptor(CFBurstTrieRef trie, int fd, CFBu
 CF_EXPORT 
 void CFBurstTrieTraverse(CFBurstTrieRef trie, void *ctx, void (*callback)(void*, const UInt8*, uint32_t, uint32_t)) CF_AVAILABLE(10_7, 4_2);
 
+CF_EXPORT
+void CFBurstTrieTraverseWithCursor(CFBurstTrieRef trie, const uint8_t *prefix, uint32_t prefixLen, void **cursor, void *ctx, bool (*callback)(void *, const uint8_t *, uint32_t, bool));
+
 CF_EXPORT 
 CFIndex CFBurstTrieGetCount(CFBurstTrieRef trie) CF_AVAILABLE(10_7, 4_2);
 
@@ -194,6 +197,34 @@ void CFBurstTrieTraverseFromCursor(CFBurstTrieCursorRef cursor, void *ctx, CFBur
 CF_EXPORT
 void CFBurstTrieCursorRelease(CFBurstTrieCursorRef cursor) CF_AVAILABLE(10_8, 6_0);
 
+// Terms added to a trie created from a file or bytes go into a delta kept
+// in memory, which lookups and traversals consult along with the mapped trie.
+// Cursors see only the mapped trie, not terms added since it was opened or
+// last compacted. A delta log, once set, records each of these terms before
+// it is added, so that the delta can be replayed when the trie is next
+// opened; a log can be set on only one trie at a time. Compacting merges the
+// delta into a new file and maps that in its place. Cursors set before a
+// compaction no longer find or traverse anything until they are set again
+// with CFBurstTrieSetCursorForBytes. Weights aren't stored in the file, so
+// every term that was mapped has a weight of 1 in the merged trie. Lookups,
+// traversals and cursors may be used on other threads while terms are added
+// or the trie is compacted, but their callbacks must not call back into the
+// trie.
+CF_EXPORT
+CFIndex CFBurstTrieGetDeltaCount(CFBurstTrieRef trie) CF_AVAILABLE(10_10, 8_0);
+
+CF_EXPORT
+Boolean CFBurstTrieSetDeltaLog(CFBurstTrieRef trie, CFStringRef path) CF_AVAILABLE(10_10, 8_0);
+
+CF_EXPORT
+Boolean CFBurstTrieSetDeltaLogWithFileDescriptor(CFBurstTrieRef trie, int fd) CF_AVAILABLE(10_10, 8_0);
+
+CF_EXPORT
+Boolean CFBurstTrieCompact(CFBurstTrieRef trie, CFStringRef path, CFBurstTrieOpts opts) CF_AVAILABLE(10_10, 8_0);
+
+CF_EXPORT
+Boolean CFBurstTrieCompactWithFileDescriptor(CFBurstTrieRef trie, int fd, CFBurstTrieOpts opts) CF_AVAILABLE(10_10, 8_0);
+
 CF_EXTERN_C_END
 
 #endif /* __COREFOUNDATION_CFBURSTTRIE__ */
@@ -547,6 +547,15 @@ CF_EXPORT void _CFDictionarySetCapacity(CFMutableHashRef hc, CFIndex cap) {
     CFBasicHashSetCapacity((CFBasicHashRef)hc, cap);
 }
 
+// This function is for Foundation's benefit; no one else should use it.
+// Grouped hashing probes sixteen buckets at a time and suits large tables that see many lookups.
+CF_EXPORT void _CFDictionarySetGroupedHashing(CFMutableHashRef hc, Boolean grouped) {
+    if (CF_IS_OBJC(CFDictionaryGetTypeID(), hc)) return;
+    __CFGenericValidateType(hc, CFDictionaryGetTypeID());
+    CFAssert2(CFBasicHashIsMutable((CFBasicHashRef)hc), __kCFLogAssertion, "%s(): immutable collection %p passed to mutating operation", __PRETTY_FUNCTION__, hc);
+    CFBasicHashSetHashStyle((CFBasicHashRef)hc, grouped ? kCFBasicHashGroupedHashing : kCFBasicHashLinearHashing);
+}
+
 CF_INLINE CFIndex __CFDictionaryGetKVOBit(CFHashRef hc) {
     return __CFBitfieldGetValue(((CFRuntimeBase *)hc)->_cfinfo[CF_INFO_BITS], 0, 0);
 }
@@ -127,6 +127,7 @@ CF_EXPORT void _CFMachPortInstallNotifyPort(CFRunLoopRef rl, CFStringRef mode);
 
 
 CF_PRIVATE CFIndex __CFActiveProcessorCount();
+CF_PRIVATE void __CFQSortArrayConcurrently(void *list, CFIndex count, CFIndex elementSize, CFComparatorFunction comparator, void *context);
 
 #ifndef CLANG_ANALYZER_NORETURN
 #if __has_feature(attribute_analyzer_noreturn)
@@ -150,6 +151,24 @@ CF_PRIVATE CFIndex __CFActiveProcessorCount();
     #endif
 #endif
 
+/* Vector code on x86 may use SSE2 unconditionally, since every x86_64 CPU has it, and AVX2 only in functions marked CF_TARGET_AVX2, which must not be called unless __CFHaveAVX2() is true.
+*/
+#if (defined(__i386__) || defined(__x86_64__)) && defined(__SSE2__) && defined(__GNUC__)
+#define CF_VECTOR_X86 1
+#define CF_TARGET_AVX2 __attribute__((target("avx2")))
+
+CF_INLINE Boolean __CFHaveAVX2(void) {
+    static int8_t haveAVX2 = -1;
+    if (haveAVX2 < 0) {
+        __builtin_cpu_init();	// We may be called from a constructor, before the compiler's own has run
+        haveAVX2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return haveAVX2;
+}
+#else
+#define CF_VECTOR_X86 0
+#endif
+
 
 #if defined(DEBUG)
     #define __CFAssert(cond, prio, desc, a1, a2, a3, a4, a5)	\
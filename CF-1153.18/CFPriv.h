@@ -608,6 +608,30 @@ CF_EXPORT bool _CFPropertyListCreateSingleValue(CFAllocatorRef allocator, CFData
 // Returns a subset of the property list, only including the keyPaths in the CFSet. If the top level object is not a dictionary, you will get back an empty dictionary as the result.
 CF_EXPORT bool _CFPropertyListCreateFiltered(CFAllocatorRef allocator, CFDataRef data, CFOptionFlags option, CFSetRef keyPaths, CFPropertyListRef *value, CFErrorRef *error) CF_AVAILABLE(10_8, 6_0);
 
+// A read-only view of an array or dictionary in a binary property list, whose contents are decoded the first time they are asked for. Arrays and dictionaries inside it are returned as further nodes; everything else is returned as the usual immutable CF object. Values follow the Get rule and stay valid as long as the node they came from. Nodes are safe to use from multiple threads.
+typedef const struct __CFBinaryPlistNode * _CFBinaryPlistNodeRef;
+
+CF_EXPORT CFTypeID _CFBinaryPlistNodeGetTypeID(void);
+
+// The top-level object must be an array or a dictionary. The data is retained, not copied.
+CF_EXPORT _CFBinaryPlistNodeRef _CFBinaryPlistNodeCreateWithData(CFAllocatorRef allocator, CFDataRef data, CFErrorRef *error);
+
+// Maps the file read-only rather than reading it, so pages are only touched as values are decoded, and are shared with other processes mapping the same file.
+CF_EXPORT _CFBinaryPlistNodeRef _CFBinaryPlistNodeCreateWithContentsOfURL(CFAllocatorRef allocator, CFURLRef url, CFErrorRef *error);
+
+CF_EXPORT Boolean _CFBinaryPlistNodeIsDictionary(_CFBinaryPlistNodeRef node);
+CF_EXPORT CFIndex _CFBinaryPlistNodeGetCount(_CFBinaryPlistNodeRef node);
+
+// For a dictionary, keys and values are in the order they were written. Returns NULL if idx is out of range or the data is corrupt.
+CF_EXPORT CFTypeRef _CFBinaryPlistNodeGetValueAtIndex(_CFBinaryPlistNodeRef node, CFIndex idx);
+CF_EXPORT CFTypeRef _CFBinaryPlistNodeGetKeyAtIndex(_CFBinaryPlistNodeRef node, CFIndex idx);
+
+// Returns NULL if the node is not a dictionary or has no value for key.
+CF_EXPORT CFTypeRef _CFBinaryPlistNodeGetValue(_CFBinaryPlistNodeRef node, CFTypeRef key);
+
+// Decodes everything beneath the node into ordinary property list objects.
+CF_EXPORT CFPropertyListRef _CFBinaryPlistNodeCreatePropertyList(CFAllocatorRef allocator, _CFBinaryPlistNodeRef node, CFOptionFlags mutabilityOption);
+
 #if (TARGET_OS_MAC && !(TARGET_OS_EMBEDDED || TARGET_OS_IPHONE)) || (TARGET_OS_EMBEDDED || TARGET_OS_IPHONE) || TARGET_OS_WIN32
 
 // Returns a subset of a bundle's Info.plist. The keyPaths follow the same rules as above CFPropertyList function. This function takes platform and product keys into account.
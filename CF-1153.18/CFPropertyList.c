@@ -49,6 +49,9 @@
 #include <math.h>
 #include <time.h>
 #include <ctype.h>
+#if CF_VECTOR_X86
+#include <immintrin.h>
+#endif
 
 
 CF_EXPORT CFNumberType _CFNumberGetType2(CFNumberRef number);
@@ -756,49 +759,98 @@ static UInt32 lineNumber(_CFXMLPlistParseInfo *pInfo) {
     return count;
 }
 
+/* Byte scanners for the reader. The SSE2/AVX2 versions look at 16 or 32 bytes per step and fall back to the scalar loop for the tail, so they never read past end. Everything they look for is ASCII, which never appears inside a multibyte UTF-8 sequence. */
+
+CF_INLINE Boolean __CFPLIsWhitespace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+#if CF_VECTOR_X86
+// Scans whole 32-byte blocks only; returns the first byte that is a or b, or where the blocks ran out.
+CF_TARGET_AVX2 static const char *__CFPLScanForEitherAVX2(const char *p, const char *end, char a, char b) {
+    const __m256i a32 = _mm256_set1_epi8(a), b32 = _mm256_set1_epi8(b);
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        uint32_t found = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, a32), _mm256_cmpeq_epi8(v, b32)));
+        if (found) return p + __builtin_ctz(found);
+        p += 32;
+    }
+    return p;
+}
+#endif
+
+// Returns the first byte in [p, end) that is a or b, or end if there is none.
+static const char *__CFPLScanForEither(const char *p, const char *end, char a, char b) {
+#if CF_VECTOR_X86
+    if (__CFHaveAVX2()) {
+        p = __CFPLScanForEitherAVX2(p, end, a, b);
+        if (p < end && (*p == a || *p == b)) return p;
+    }
+    const __m128i a16 = _mm_set1_epi8(a), b16 = _mm_set1_epi8(b);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        uint32_t found = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, a16), _mm_cmpeq_epi8(v, b16)));
+        if (found) return p + __builtin_ctz(found);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != a && *p != b) p ++;
+    return p;
+}
+
+// Returns the first byte in [p, end) that is not XML white space, or end if there is none.
+static const char *__CFPLScanPastWhitespace(const char *p, const char *end) {
+    // Runs are mostly a newline and a little indentation, often none at all, so check the first byte before going wide. AVX2 doesn't pay for itself here.
+    if (p < end && !__CFPLIsWhitespace(*p)) return p;
+#if CF_VECTOR_X86
+    const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)), _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+        uint32_t other = ~(uint32_t)_mm_movemask_epi8(ws) & 0xFFFF;
+        if (other) return p + __builtin_ctz(other);
+        p += 16;
+    }
+#endif
+    while (p < end && __CFPLIsWhitespace(*p)) p ++;
+    return p;
+}
+
+// Returns the start of the first occurrence of the termLen-byte terminator in [p, end), or NULL. The terminators we look for end in a character that is rare before them ('>'), so memchr does the scanning.
+static const char *__CFPLFindTerminator(const char *p, const char *end, const char *term, CFIndex termLen) {
+    const char last = term[termLen - 1];
+    const char *q = p + termLen - 1;
+    while (q < end && (q = (const char *)memchr(q, last, end - q))) {
+        if (!memcmp(q - (termLen - 1), term, termLen - 1)) return q - (termLen - 1);
+        q ++;
+    }
+    return NULL;
+}
+
 // warning: doesn't have a good idea of Unicode white space
 CF_INLINE void skipWhitespace(_CFXMLPlistParseInfo *pInfo) {
-    while (pInfo->curr < pInfo->end) {
-        switch (*(pInfo->curr)) {
-            case ' ':
-            case '\t':
-            case '\n':
-            case '\r':
-                pInfo->curr ++;
-                continue;
-            default:
-                return;
-        }
-    }
+    pInfo->curr = __CFPLScanPastWhitespace(pInfo->curr, pInfo->end);
 }
 
 /* All of these advance to the end of the given construct and return a pointer to the first character beyond the construct.  If the construct doesn't parse properly, NULL is returned. */
 
 // pInfo should be just past "<!--"
 static void skipXMLComment(_CFXMLPlistParseInfo *pInfo) {
-    const char *p = pInfo->curr;
-    const char *end = pInfo->end - 3; // Need at least 3 characters to compare against
-    while (p < end) {
-        if (*p == '-' && *(p+1) == '-' && *(p+2) == '>') {
-            pInfo->curr = p+3;
-            return;
-        }
-        p ++; 
+    const char *p = __CFPLFindTerminator(pInfo->curr, pInfo->end, "-->", 3);
+    if (p) {
+        pInfo->curr = p+3;
+        return;
     }
     pInfo->error = __CFPropertyListCreateError(kCFPropertyListReadCorruptError, CFSTR("Unterminated comment started on line %d"), lineNumber(pInfo));
 }
 
 // pInfo should be set to the first character after "<?"
 static void skipXMLProcessingInstruction(_CFXMLPlistParseInfo *pInfo) {
-    const char *begin = pInfo->curr, *end = pInfo->end - 2; // Looking for "?>" so we need at least 2 characters
-    while (pInfo->curr < end) {
-        if (*(pInfo->curr) == '?' && *(pInfo->curr+1) == '>') {
-            pInfo->curr += 2;
-            return;
-        }
-        pInfo->curr ++; 
+    const char *p = __CFPLFindTerminator(pInfo->curr, pInfo->end, "?>", 2);
+    if (p) {
+        pInfo->curr = p+2;
+        return;
     }
-    pInfo->curr = begin;
     pInfo->error = __CFPropertyListCreateError(kCFPropertyListReadCorruptError, CFSTR("Encountered unexpected EOF while parsing the processing instruction begun on line %d"), lineNumber(pInfo));
 }
 
@@ -813,14 +865,10 @@ static void skipDTD(_CFXMLPlistParseInfo *pInfo) {
     skipWhitespace(pInfo);
 
     // Look for either the beginning of a complex DTD or the end of the DOCTYPE structure
-    while (pInfo->curr < pInfo->end) {
-        char ch = *(pInfo->curr);
-        if (ch == '[') break; // inline DTD
-        if (ch == '>') {  // End of the DTD
-            pInfo->curr ++;
-            return;
-        }
+    pInfo->curr = __CFPLScanForEither(pInfo->curr, pInfo->end, '[', '>');
+    if (pInfo->curr < pInfo->end && *(pInfo->curr) == '>') {  // End of the DTD
         pInfo->curr ++;
+        return;
     }
     if (pInfo->curr == pInfo->end) {
         pInfo->error = __CFPropertyListCreateError(kCFPropertyListReadCorruptError, CFSTR("Encountered unexpected EOF while parsing DTD"));
@@ -881,15 +929,13 @@ static void skipInlineDTD(_CFXMLPlistParseInfo *pInfo) {
                 } else {
                     // Skip the myriad of DTD declarations of the form "<!string" ... ">"
                     pInfo->curr ++; // Past both '<' and '!'
-                    while (pInfo->curr < pInfo->end) {
-                        if (*(pInfo->curr) == '>') break;
-                        pInfo->curr ++;
-                    }
-                    if (*(pInfo->curr) != '>') {
+                    const char *close = (const char *)memchr(pInfo->curr, '>', pInfo->end - pInfo->curr);
+                    if (!close) {
+                        pInfo->curr = pInfo->end;
                         pInfo->error = __CFPropertyListCreateError(kCFPropertyListReadCorruptError, CFSTR("Encountered unexpected EOF while parsing inline DTD"));
                         return;
                     }
-                    pInfo->curr ++;
+                    pInfo->curr = close + 1;
                 }
             } else {
                 pInfo->error = __CFPropertyListCreateError(kCFPropertyListReadCorruptError, CFSTR("Encountered unexpected character %c on line %d while parsing inline DTD"), ch, lineNumber(pInfo));
@@ -971,15 +1017,12 @@ static void parseCDSect_pl(_CFXMLPlistParseInfo *pInfo, CFMutableDataRef stringD
     }
     pInfo->curr += CDSECT_TAG_LENGTH;
     begin = pInfo->curr; // Marks the first character of the CDATA content
-    end = pInfo->end-2; // So we can safely look 2 characters beyond p
-    while (pInfo->curr < end) {
-        if (*(pInfo->curr) == ']' && *(pInfo->curr+1) == ']' && *(pInfo->curr+2) == '>') {
-            // Found the end!
-            CFDataAppendBytes(stringData, (const UInt8 *)begin, pInfo->curr-begin);
-            pInfo->curr += 3;
-            return;
-        }
-        pInfo->curr ++;
+    end = __CFPLFindTerminator(begin, pInfo->end, "]]>", 3);
+    if (end) {
+        // Found the end!
+        CFDataAppendBytes(stringData, (const UInt8 *)begin, end-begin);
+        pInfo->curr = end + 3;
+        return;
     }
     // Never found the end mark
     pInfo->curr = begin;
@@ -1137,6 +1180,9 @@ static Boolean parseStringTag(_CFXMLPlistParseInfo *pInfo, CFStringRef *out) {
     const char *mark = pInfo->curr;
     CFMutableDataRef stringData = NULL;
     while (!pInfo->error && pInfo->curr < pInfo->end) {
+        // Plain characters are copied in bulk, so only markup and references stop the scan
+        pInfo->curr = __CFPLScanForEither(pInfo->curr, pInfo->end, '<', '&');
+        if (pInfo->curr >= pInfo->end) break;
         char ch = *(pInfo->curr);
         if (ch == '<') {
 	    if (pInfo->curr + 1 >= pInfo->end) break;
@@ -1151,8 +1197,6 @@ static Boolean parseStringTag(_CFXMLPlistParseInfo *pInfo, CFStringRef *out) {
             CFDataAppendBytes(stringData, (const UInt8 *)mark, pInfo->curr - mark);
             parseEntityReference_pl(pInfo, stringData); // TODO: move to return boolean
             mark = pInfo->curr;
-        } else {
-            pInfo->curr ++;
         }
     }
 
@@ -1563,76 +1607,98 @@ static Boolean parseDictTag(_CFXMLPlistParseInfo *pInfo, CFTypeRef *out) {
     return false;
 }
 
-static Boolean parseDataTag(_CFXMLPlistParseInfo *pInfo, CFTypeRef *out) {
-    const char *base = pInfo->curr;
-    static const signed char dataDecodeTable[128] = {
-        /* 000 */ -1, -1, -1, -1, -1, -1, -1, -1,
-        /* 010 */ -1, -1, -1, -1, -1, -1, -1, -1,
-        /* 020 */ -1, -1, -1, -1, -1, -1, -1, -1,
-        /* 030 */ -1, -1, -1, -1, -1, -1, -1, -1,
-        /* ' ' */ -1, -1, -1, -1, -1, -1, -1, -1,
-        /* '(' */ -1, -1, -1, 62, -1, -1, -1, 63,
-        /* '0' */ 52, 53, 54, 55, 56, 57, 58, 59,
-        /* '8' */ 60, 61, -1, -1, -1,  0, -1, -1,
-        /* '@' */ -1,  0,  1,  2,  3,  4,  5,  6,
-        /* 'H' */  7,  8,  9, 10, 11, 12, 13, 14,
-        /* 'P' */ 15, 16, 17, 18, 19, 20, 21, 22,
-        /* 'X' */ 23, 24, 25, -1, -1, -1, -1, -1,
-        /* '`' */ -1, 26, 27, 28, 29, 30, 31, 32,
-        /* 'h' */ 33, 34, 35, 36, 37, 38, 39, 40,
-        /* 'p' */ 41, 42, 43, 44, 45, 46, 47, 48,
-        /* 'x' */ 49, 50, 51, -1, -1, -1, -1, -1
-    };
-    
-    int tmpbufpos = 0;
-    int tmpbuflen = 256;
-    uint8_t *tmpbuf = pInfo->skip ? NULL : (uint8_t *)CFAllocatorAllocate(pInfo->allocator, tmpbuflen, 0);
+// Maps each byte to its base64 digit. '=' decodes as a zero digit but is marked with 0x40 so the fast path leaves padding to the careful one; everything else (white space included) is skipped.
+static const uint8_t __CFPLDataDecodeTable[256] = {
+    /* 000 */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* 010 */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* 020 */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* 030 */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* ' ' */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* '(' */ 0x80, 0x80, 0x80,   62, 0x80, 0x80, 0x80,   63,
+    /* '0' */   52,   53,   54,   55,   56,   57,   58,   59,
+    /* '8' */   60,   61, 0x80, 0x80, 0x80, 0x40, 0x80, 0x80,
+    /* '@' */ 0x80,    0,    1,    2,    3,    4,    5,    6,
+    /* 'H' */    7,    8,    9,   10,   11,   12,   13,   14,
+    /* 'P' */   15,   16,   17,   18,   19,   20,   21,   22,
+    /* 'X' */   23,   24,   25, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* '`' */ 0x80,   26,   27,   28,   29,   30,   31,   32,
+    /* 'h' */   33,   34,   35,   36,   37,   38,   39,   40,
+    /* 'p' */   41,   42,   43,   44,   45,   46,   47,   48,
+    /* 'x' */   49,   50,   51, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* 200 */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* 220 */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* 240 */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* 260 */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* 300 */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* 320 */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* 340 */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    /* 360 */ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+};
+
+// Decodes the base64 in [p, end) into buf, which must have room for 3 bytes per 4 characters. Returns the number of bytes written.
+static CFIndex __CFPLDecodeData(const char *p, const char *end, uint8_t *buf) {
+    uint8_t *out = buf;
+    uint32_t acc = 0;
     int numeq = 0;
-    int acc = 0;
     int cntr = 0;
-    
-    for (; pInfo->curr < pInfo->end; pInfo->curr++) {
-        signed char c = *(pInfo->curr);
-        if (c == '<') {
-            break;
+    while (p < end) {
+        // Whole groups of four plain digits, which is everything but line breaks and the padded tail
+        if (0 == (cntr & 0x3)) {
+            while (end - p >= 4) {
+                uint32_t d0 = __CFPLDataDecodeTable[(uint8_t)p[0]], d1 = __CFPLDataDecodeTable[(uint8_t)p[1]];
+                uint32_t d2 = __CFPLDataDecodeTable[(uint8_t)p[2]], d3 = __CFPLDataDecodeTable[(uint8_t)p[3]];
+                if ((d0 | d1 | d2 | d3) & 0xC0) break;
+                uint32_t group = (d0 << 18) | (d1 << 12) | (d2 << 6) | d3;
+                out[0] = (group >> 16) & 0xff;
+                out[1] = (group >> 8) & 0xff;
+                out[2] = group & 0xff;
+                out += 3;
+                p += 4;
+                numeq = 0;
+            }
+            if (p >= end) break;
         }
+        uint8_t c = *p++;
         if ('=' == c) {
             numeq++;
         } else if (!isspace(c)) {
             numeq = 0;
         }
-        if (dataDecodeTable[c] < 0)
+        uint8_t digit = __CFPLDataDecodeTable[c];
+        if (digit & 0x80)
             continue;
         cntr++;
         acc <<= 6;
-        acc += dataDecodeTable[c];
-        if (!pInfo->skip && 0 == (cntr & 0x3)) {
-            if (tmpbuflen <= tmpbufpos + 2) {
-                if (tmpbuflen < 256 * 1024) {
-                    tmpbuflen *= 4;
-                } else if (tmpbuflen < 16 * 1024 * 1024) {
-                    tmpbuflen *= 2;
-                } else {
-                    // once in this stage, this will be really slow
-                    // and really potentially fragment memory
-                    tmpbuflen += 256 * 1024;
-                }
-                tmpbuf = (uint8_t *)CFAllocatorReallocate(pInfo->allocator, tmpbuf, tmpbuflen, 0);
-                if (!tmpbuf) HALT; // out of memory
-            }
-            tmpbuf[tmpbufpos++] = (acc >> 16) & 0xff;
-            if (numeq < 2) tmpbuf[tmpbufpos++] = (acc >> 8) & 0xff;
-            if (numeq < 1) tmpbuf[tmpbufpos++] = acc & 0xff;
+        acc += digit & 0x3f;
+        if (0 == (cntr & 0x3)) {
+            *out++ = (acc >> 16) & 0xff;
+            if (numeq < 2) *out++ = (acc >> 8) & 0xff;
+            if (numeq < 1) *out++ = acc & 0xff;
         }
     }
-    
+    return out - buf;
+}
+
+static Boolean parseDataTag(_CFXMLPlistParseInfo *pInfo, CFTypeRef *out) {
+    const char *base = pInfo->curr;
+    // Find the end first so the buffer is sized once, rather than grown as we go
+    const char *end = (const char *)memchr(base, '<', pInfo->end - base);
+    if (!end) end = pInfo->end;
+    pInfo->curr = end;
+
     CFDataRef result = NULL;
     if (!pInfo->skip) {
+        CFIndex capacity = (end - base) / 4 * 3;
         if (pInfo->mutabilityOption == kCFPropertyListMutableContainersAndLeaves) {
             result = (CFDataRef)CFDataCreateMutable(pInfo->allocator, 0);
-            CFDataAppendBytes((CFMutableDataRef)result, tmpbuf, tmpbufpos);
-            CFAllocatorDeallocate(pInfo->allocator, tmpbuf);
+            if (result) {
+                CFDataSetLength((CFMutableDataRef)result, capacity);
+                CFDataSetLength((CFMutableDataRef)result, __CFPLDecodeData(base, end, CFDataGetMutableBytePtr((CFMutableDataRef)result)));
+            }
         } else {
+            uint8_t *tmpbuf = (uint8_t *)CFAllocatorAllocate(pInfo->allocator, capacity ? capacity : 1, 0);
+            if (!tmpbuf) HALT; // out of memory
+            CFIndex tmpbufpos = __CFPLDecodeData(base, end, tmpbuf);
             result = CFDataCreateWithBytesNoCopy(pInfo->allocator, tmpbuf, tmpbufpos, pInfo->allocator);
         }
         if (!result) {
@@ -14,7 +14,9 @@
 #if DEPLOYMENT_TARGET_WINDOWS
 #include <typeinfo.h>
 #endif
+#if !DEPLOYMENT_TARGET_LINUX
 #include <checkint.h>
+#endif
 
 #if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED || DEPLOYMENT_TARGET_EMBEDDED_MINI
 #include <sys/param.h>
@@ -42,9 +44,29 @@ DISPATCH_EXPORT void _dispatch_main_queue_callback_4CF(void);
 
 #define AbsoluteTime LARGE_INTEGER 
 
+#elif DEPLOYMENT_TARGET_LINUX
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define MACH_PORT_NULL -1
+#define mach_port_name_t int
+#define mach_port_t int
+
+// The part of <checkint.h> which the timer code uses
+#define CHECKINT_NO_ERROR 0
+#define CHECKINT_OVERFLOW_ERROR (1 << 0)
+
+CF_INLINE uint64_t check_uint64_add(uint64_t x, uint64_t y, int32_t *err) {
+    if (UINT64_MAX - x < y) *err |= CHECKINT_OVERFLOW_ERROR;
+    return x + y;
+}
+
 #endif
 
-#if DEPLOYMENT_TARGET_WINDOWS || DEPLOYMENT_TARGET_IPHONESIMULATOR
+#if DEPLOYMENT_TARGET_WINDOWS || DEPLOYMENT_TARGET_IPHONESIMULATOR || DEPLOYMENT_TARGET_LINUX
 /** pthread_t 一个线程的标识符，线程ID
  * 获取主线程
  */
@@ -54,6 +76,10 @@ CF_EXPORT pthread_t _CF_pthread_main_thread_np(void);
 #define pthread_main_thread_np() _CF_pthread_main_thread_np()
 #endif
 
+#if DEPLOYMENT_TARGET_LINUX
+#define pthread_main_np() pthread_equal(pthread_self(), _CF_pthread_main_thread_np())
+#endif
+
 #include <Block.h>
 #include <Block_private.h>
 
@@ -65,6 +91,13 @@ CF_EXPORT pthread_t _CF_pthread_main_thread_np(void);
 #define USE_MK_TIMER_TOO 1
 #endif
 
+// There is no libdispatch on Linux, so no main queue port to service and no dispatch source for the run timeout
+#if DEPLOYMENT_TARGET_LINUX
+#define USE_LIBDISPATCH 0
+#else
+#define USE_LIBDISPATCH 1
+#endif
+
 
 static int _LogCFRunLoop = 0;
 static void _runLoopTimerWithBlockContext(CFRunLoopTimerRef timer, void *opaqueBlock);
@@ -87,7 +120,7 @@ typedef	int kern_return_t;
 #else
 
 static pthread_t kNilPthreadT = (pthread_t)0;
-#define pthreadPointer(a) a
+#define pthreadPointer(a) ((void *)(a))
 #define lockCount(a) a
 #endif
 
@@ -383,9 +416,75 @@ static kern_return_t __CFPortSetRemove(__CFPort port, __CFPortSet portSet) {
     return KERN_SUCCESS;
 }
 
+#elif DEPLOYMENT_TARGET_LINUX
+
+// A port is an eventfd and a port set is an epoll instance. Both are level-triggered, so whoever is woken by a port must drain it.
+typedef int __CFPort;
+#define CFPORT_NULL MACH_PORT_NULL
+typedef int __CFPortSet;
+typedef int kern_return_t;
+#define KERN_SUCCESS 0
+
+static void __THE_SYSTEM_HAS_NO_PORTS_AVAILABLE__(kern_return_t ret) __attribute__((noinline));
+static void __THE_SYSTEM_HAS_NO_PORTS_AVAILABLE__(kern_return_t ret) { HALT; };
+
+static __CFPort __CFPortAllocate(void) {
+    __CFPort result = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (CFPORT_NULL == result) {
+        char msg[256];
+        snprintf(msg, 256, "*** The system has no file descriptors available for an eventfd. (%d) ***", errno);
+        CRSetCrashLogMessage(msg);
+        __THE_SYSTEM_HAS_NO_PORTS_AVAILABLE__(errno);
+    }
+    return result;
+}
+
+CF_INLINE void __CFPortFree(__CFPort port) {
+    close(port);
+}
+
+// Reads the count out of an eventfd or timerfd, so that it stops polling readable
+CF_INLINE void __CFPortDrain(__CFPort port) {
+    uint64_t count;
+    (void)read(port, &count, sizeof(count));
+}
+
+static void __THE_SYSTEM_HAS_NO_PORT_SETS_AVAILABLE__(kern_return_t ret) __attribute__((noinline));
+static void __THE_SYSTEM_HAS_NO_PORT_SETS_AVAILABLE__(kern_return_t ret) { HALT; };
+
+CF_INLINE __CFPortSet __CFPortSetAllocate(void) {
+    __CFPortSet result = epoll_create1(EPOLL_CLOEXEC);
+    if (CFPORT_NULL == result) { __THE_SYSTEM_HAS_NO_PORT_SETS_AVAILABLE__(errno); }
+    return result;
+}
+
+CF_INLINE kern_return_t __CFPortSetInsert(__CFPort port, __CFPortSet portSet) {
+    if (CFPORT_NULL == port) {
+        return -1;
+    }
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = port;
+    return (0 == epoll_ctl(portSet, EPOLL_CTL_ADD, port, &event)) ? KERN_SUCCESS : errno;
+}
+
+CF_INLINE kern_return_t __CFPortSetRemove(__CFPort port, __CFPortSet portSet) {
+    if (CFPORT_NULL == port) {
+        return -1;
+    }
+    return (0 == epoll_ctl(portSet, EPOLL_CTL_DEL, port, NULL)) ? KERN_SUCCESS : errno;
+}
+
+CF_INLINE void __CFPortSetFree(__CFPortSet portSet) {
+    close(portSet);
+}
+
 #endif
 
-#if !defined(__MACTYPES__) && !defined(_OS_OSTYPES_H)
+#if DEPLOYMENT_TARGET_LINUX
+typedef uint64_t		AbsoluteTime;
+#elif !defined(__MACTYPES__) && !defined(_OS_OSTYPES_H)
 #if defined(__BIG_ENDIAN__)
 typedef	struct UnsignedWide {
     UInt32		hi;
@@ -481,6 +580,46 @@ CF_INLINE LARGE_INTEGER __CFUInt64ToAbsoluteTime(uint64_t desiredFireTime) {
     return result;
 }
 
+#elif DEPLOYMENT_TARGET_LINUX
+
+// The mk timer of a mode is a timerfd on CLOCK_MONOTONIC, armed with an absolute expiry in the same units as mach_absolute_time()
+static int mk_timer_create(void) {
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (timer < 0) CFLog(kCFLogLevelError, CFSTR("CFRunLoop: Unable to create timer: %d"), errno);
+    return timer;
+}
+
+static kern_return_t mk_timer_destroy(int name) {
+    return close(name);
+}
+
+static kern_return_t mk_timer_arm(int name, AbsoluteTime expire_time) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    // An it_value of zero would disarm the timer, so a deadline which is already past is moved up to 1ns
+    if (0 == expire_time) expire_time = 1;
+    spec.it_value.tv_sec = expire_time / 1000000000ULL;
+    spec.it_value.tv_nsec = expire_time % 1000000000ULL;
+    int res = timerfd_settime(name, TFD_TIMER_ABSTIME, &spec, NULL);
+    if (res < 0) CFLog(kCFLogLevelError, CFSTR("CFRunLoop: Unable to set timer: %d"), errno);
+    return res;
+}
+
+static kern_return_t mk_timer_cancel(int name, AbsoluteTime *result_time) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    int res = timerfd_settime(name, 0, &spec, NULL);
+    if (res < 0) CFLog(kCFLogLevelError, CFSTR("CFRunLoop: Unable to cancel timer: %d"), errno);
+    // A timer which has expired but not been read yet would still wake the run loop
+    __CFPortDrain(name);
+    return res;
+}
+
+// The TSR is already CLOCK_MONOTONIC in nanoseconds on Linux
+CF_INLINE AbsoluteTime __CFUInt64ToAbsoluteTime(uint64_t x) {
+    return x;
+}
+
 #endif
 
 #pragma mark -
@@ -498,6 +637,17 @@ static CFTypeID __kCFRunLoopObserverTypeID = _kCFRuntimeNotATypeID;
 static CFTypeID __kCFRunLoopTimerTypeID = _kCFRuntimeNotATypeID;
 typedef struct __CFRunLoopMode *CFRunLoopModeRef;
 
+/* A mode keeps its timers in a binary min-heap ordered by fire TSR; timers
+ * with the same fire TSR are ordered by when they were (re)scheduled, as
+ * they were in the sorted array the heap replaces. The fire TSR is copied
+ * into the entry when the timer is positioned, so a sift touches only the
+ * heap and the timers' heap slots. */
+typedef struct {
+    uint64_t _fireTSR;			/* TSR units */
+    uint64_t _sequence;
+    CFRunLoopTimerRef _timer;		/* retained */
+} __CFRunLoopTimerHeapEntry;
+
 struct __CFRunLoopMode {
     CFRuntimeBase _base;
     pthread_mutex_t _lock;	/* must have the run loop locked before locking this */
@@ -507,7 +657,10 @@ struct __CFRunLoopMode {
     CFMutableSetRef _sources0;// Set 集
     CFMutableSetRef _sources1;// Set 集
     CFMutableArrayRef _observers;// Array
-    CFMutableArrayRef _timers;// Array
+    __CFRunLoopTimerHeapEntry *_timers;// Heap
+    CFIndex _timerCount;
+    CFIndex _timerCapacity;
+    uint64_t _timerSequence;
     CFMutableDictionaryRef _portToV1SourceMap;
     __CFPortSet _portSet;
     CFIndex _observerMask;
@@ -566,7 +719,15 @@ static CFStringRef __CFRunLoopModeCopyDescription(CFTypeRef cf) {
 #if DEPLOYMENT_TARGET_WINDOWS
     CFStringAppendFormat(result, NULL, CFSTR("MSGQ mask = %p, "), rlm->_msgQMask);
 #endif
-    CFStringAppendFormat(result, NULL, CFSTR("\n\tsources0 = %@,\n\tsources1 = %@,\n\tobservers = %@,\n\ttimers = %@,\n\tcurrently %0.09g (%lld) / soft deadline in: %0.09g sec (@ %lld) / hard deadline in: %0.09g sec (@ %lld)\n},\n"), rlm->_sources0, rlm->_sources1, rlm->_observers, rlm->_timers, CFAbsoluteTimeGetCurrent(), mach_absolute_time(), __CFTSRToTimeInterval(rlm->_timerSoftDeadline - mach_absolute_time()), rlm->_timerSoftDeadline, __CFTSRToTimeInterval(rlm->_timerHardDeadline - mach_absolute_time()), rlm->_timerHardDeadline);
+    CFMutableArrayRef timers = NULL;
+    if (NULL != rlm->_timers) {
+        timers = CFArrayCreateMutable(kCFAllocatorSystemDefault, rlm->_timerCount, &kCFTypeArrayCallBacks);
+        for (CFIndex idx = 0; idx < rlm->_timerCount; idx++) {
+            CFArrayAppendValue(timers, rlm->_timers[idx]._timer);
+        }
+    }
+    CFStringAppendFormat(result, NULL, CFSTR("\n\tsources0 = %@,\n\tsources1 = %@,\n\tobservers = %@,\n\ttimers = %@,\n\tcurrently %0.09g (%lld) / soft deadline in: %0.09g sec (@ %lld) / hard deadline in: %0.09g sec (@ %lld)\n},\n"), rlm->_sources0, rlm->_sources1, rlm->_observers, timers, CFAbsoluteTimeGetCurrent(), mach_absolute_time(), __CFTSRToTimeInterval(rlm->_timerSoftDeadline - mach_absolute_time()), rlm->_timerSoftDeadline, __CFTSRToTimeInterval(rlm->_timerHardDeadline - mach_absolute_time()), rlm->_timerHardDeadline);
+    if (NULL != timers) CFRelease(timers);
     return result;
 }
 
@@ -575,7 +736,12 @@ static void __CFRunLoopModeDeallocate(CFTypeRef cf) {
     if (NULL != rlm->_sources0) CFRelease(rlm->_sources0);
     if (NULL != rlm->_sources1) CFRelease(rlm->_sources1);
     if (NULL != rlm->_observers) CFRelease(rlm->_observers);
-    if (NULL != rlm->_timers) CFRelease(rlm->_timers);
+    if (NULL != rlm->_timers) {
+        for (CFIndex idx = 0; idx < rlm->_timerCount; idx++) {
+            CFRelease(rlm->_timers[idx]._timer);
+        }
+        CFAllocatorDeallocate(kCFAllocatorSystemDefault, rlm->_timers);
+    }
     if (NULL != rlm->_portToV1SourceMap) CFRelease(rlm->_portToV1SourceMap);
     CFRelease(rlm->_name);
     __CFPortSetFree(rlm->_portSet);
@@ -821,6 +987,9 @@ static CFRunLoopModeRef __CFRunLoopFindMode(CFRunLoopRef rl, CFStringRef modeNam
     rlm->_sources1 = NULL;
     rlm->_observers = NULL;
     rlm->_timers = NULL;
+    rlm->_timerCount = 0;
+    rlm->_timerCapacity = 0;
+    rlm->_timerSequence = 0;
     rlm->_observerMask = 0;
     rlm->_portSet = __CFPortSetAllocate();
     rlm->_timerSoftDeadline = UINT64_MAX;
@@ -876,11 +1045,13 @@ static Boolean __CFRunLoopModeIsEmpty(CFRunLoopRef rl, CFRunLoopModeRef rlm, CFR
 #if DEPLOYMENT_TARGET_WINDOWS
     if (0 != rlm->_msgQMask) return false;
 #endif
+#if USE_LIBDISPATCH
     Boolean libdispatchQSafe = pthread_main_np() && ((HANDLE_DISPATCH_ON_BASE_INVOCATION_ONLY && NULL == previousMode) || (!HANDLE_DISPATCH_ON_BASE_INVOCATION_ONLY && 0 == _CFGetTSD(__CFTSDKeyIsInGCDMainQ)));
     if (libdispatchQSafe && (CFRunLoopGetMain() == rl) && CFSetContainsValue(rl->_commonModes, rlm->_name)) return false; // represents the libdispatch main queue
+#endif
     if (NULL != rlm->_sources0 && 0 < CFSetGetCount(rlm->_sources0)) return false;
     if (NULL != rlm->_sources1 && 0 < CFSetGetCount(rlm->_sources1)) return false;
-    if (NULL != rlm->_timers && 0 < CFArrayGetCount(rlm->_timers)) return false;
+    if (0 < rlm->_timerCount) return false;
     struct _block_item *item = rl->_blocks_head;
     while (item) {
         struct _block_item *curr = item;
@@ -1021,6 +1192,16 @@ CF_INLINE void __CFRunLoopSourceUnlock(CFRunLoopSourceRef rls) {
     pthread_mutex_unlock(&(rls->_lock));
 }
 
+// On Linux getPort returns the file descriptor of a version 1 source cast to a pointer, or NULL if it has none
+CF_INLINE __CFPort __CFRunLoopSourceGetPort(CFRunLoopSourceRef rls) {	/* DOES CALLOUT */
+#if DEPLOYMENT_TARGET_LINUX
+    void *port = rls->_context.version1.getPort(rls->_context.version1.info);
+    return port ? (__CFPort)(intptr_t)port : CFPORT_NULL;
+#else
+    return rls->_context.version1.getPort(rls->_context.version1.info);
+#endif
+}
+
 #pragma mark Observers
 
 struct __CFRunLoopObserver {
@@ -1102,6 +1283,8 @@ struct __CFRunLoopTimer {
     CFTimeInterval _tolerance;          /* mutable */
     uint64_t _fireTSR;			/* TSR units */
     CFIndex _order;			/* immutable */
+    CFIndex _heapSlotCount;
+    struct __CFRunLoopTimerHeapSlot *_heapSlots;	/* where the timer is in the heap of each of its modes */
     CFRunLoopTimerCallBack _callout;	/* immutable */
     CFRunLoopTimerContext _context;	/* immutable, except invalidation */
 };
@@ -1110,6 +1293,11 @@ struct __CFRunLoopTimer {
 /* Bit 1 of the base reserved bits is used for fired-during-callout state */
 /* Bit 2 of the base reserved bits is used for waking state */
 
+struct __CFRunLoopTimerHeapSlot {
+    CFRunLoopModeRef _mode;
+    CFIndex _index;
+};
+
 CF_INLINE Boolean __CFRunLoopTimerIsFiring(CFRunLoopTimerRef rlt) {
     return (Boolean)__CFBitfieldGetValue(rlt->_bits, 0, 0);
 }
@@ -1220,7 +1408,7 @@ static void __CFRunLoopDeallocateSources(const void *value, void *context) {
                 rls->_context.version0.cancel(rls->_context.version0.info, rl, rlm->_name);	/* CALLOUT */
             }
         } else if (1 == rls->_context.version0.version) {
-            __CFPort port = rls->_context.version1.getPort(rls->_context.version1.info);	/* CALLOUT */
+            __CFPort port = __CFRunLoopSourceGetPort(rls);	/* CALLOUT */
             if (CFPORT_NULL != port) {
                 __CFPortSetRemove(port, rlm->_portSet);
             }
@@ -1253,31 +1441,23 @@ static void __CFRunLoopDeallocateObservers(const void *value, void *context) {
 static void __CFRunLoopDeallocateTimers(const void *value, void *context) {
     CFRunLoopModeRef rlm = (CFRunLoopModeRef)value;
     if (NULL == rlm->_timers) return;
-    void (^deallocateTimers)(CFMutableArrayRef timers) = ^(CFMutableArrayRef timers) {
-        CFIndex idx, cnt;
-        const void **list, *buffer[256];
-        cnt = CFArrayGetCount(timers);
-        list = (const void **)((cnt <= 256) ? buffer : CFAllocatorAllocate(kCFAllocatorSystemDefault, cnt * sizeof(void *), 0));
-        CFArrayGetValues(timers, CFRangeMake(0, CFArrayGetCount(timers)), list);
-        for (idx = 0; idx < cnt; idx++) {
-            CFRetain(list[idx]);
-        }
-        CFArrayRemoveAllValues(timers);
-        for (idx = 0; idx < cnt; idx++) {
-            CFRunLoopTimerRef rlt = (CFRunLoopTimerRef)list[idx];
-            __CFRunLoopTimerLock(rlt);
-            // if the run loop is deallocating, and since a timer can only be in one
-            // run loop, we're going to be removing the timer from all modes, so be
-            // a little heavy-handed and direct
-            CFSetRemoveAllValues(rlt->_rlModes);
-            rlt->_runLoop = NULL;
-            __CFRunLoopTimerUnlock(rlt);
-            CFRelease(list[idx]);
-        }
-        if (list != buffer) CFAllocatorDeallocate(kCFAllocatorSystemDefault, list);
-    };
-    
-    if (rlm->_timers && CFArrayGetCount(rlm->_timers)) deallocateTimers(rlm->_timers);
+    // The heap's references to the timers are released as they are taken
+    // out; emptying it first keeps a timer deallocated here from finding
+    // itself still in the heap.
+    CFIndex cnt = rlm->_timerCount;
+    rlm->_timerCount = 0;
+    for (CFIndex idx = 0; idx < cnt; idx++) {
+        CFRunLoopTimerRef rlt = rlm->_timers[idx]._timer;
+        __CFRunLoopTimerLock(rlt);
+        // if the run loop is deallocating, and since a timer can only be in one
+        // run loop, we're going to be removing the timer from all modes, so be
+        // a little heavy-handed and direct
+        CFSetRemoveAllValues(rlt->_rlModes);
+        rlt->_heapSlotCount = 0;
+        rlt->_runLoop = NULL;
+        __CFRunLoopTimerUnlock(rlt);
+        CFRelease(rlt);
+    }
 }
 
 CF_EXPORT CFRunLoopRef _CFRunLoopGet0b(pthread_t t);
@@ -1677,11 +1857,13 @@ void CFRunLoopAddCommonMode(CFRunLoopRef rl, CFStringRef modeName) {
 }
 
 /// 如果是被dispatch唤醒的，执行所有调用 dispatch_async 等方法放入main queue 的 block
+#if USE_LIBDISPATCH
 static void __CFRUNLOOP_IS_SERVICING_THE_MAIN_DISPATCH_QUEUE__() __attribute__((noinline));
 static void __CFRUNLOOP_IS_SERVICING_THE_MAIN_DISPATCH_QUEUE__(void *msg) {
     _dispatch_main_queue_callback_4CF(msg);
     asm __volatile__(""); // thwart tail-call optimization
 }
+#endif
 
 /// 通知Observers，线程被唤醒
 static void __CFRUNLOOP_IS_CALLING_OUT_TO_AN_OBSERVER_CALLBACK_FUNCTION__() __attribute__((noinline));
@@ -1961,40 +2143,118 @@ static Boolean __CFRunLoopDoSource1(CFRunLoopRef rl, CFRunLoopModeRef rlm, CFRun
     return sourceHandled;
 }
 
-static CFIndex __CFRunLoopInsertionIndexInTimerArray(CFArrayRef array, CFRunLoopTimerRef rlt) __attribute__((noinline));
-static CFIndex __CFRunLoopInsertionIndexInTimerArray(CFArrayRef array, CFRunLoopTimerRef rlt) {
-    CFIndex cnt = CFArrayGetCount(array);
-    if (cnt <= 0) {
-        return 0;
+/* The timer heaps are changed only with the run loop locked, which also
+ * guards the timers' heap slots, since a timer is only ever in one run loop.
+ * Code holding some other run loop's lock must not read the slots; see
+ * __CFRunLoopTimerIsInMode. */
+
+CF_INLINE struct __CFRunLoopTimerHeapSlot *__CFRunLoopTimerGetHeapSlot(CFRunLoopTimerRef rlt, CFRunLoopModeRef rlm) {
+    // A timer is in very few modes, usually one, so a linear search is fine
+    for (CFIndex idx = 0; idx < rlt->_heapSlotCount; idx++) {
+        if (rlt->_heapSlots[idx]._mode == rlm) return &rlt->_heapSlots[idx];
     }
-    if (256 < cnt) {
-        CFRunLoopTimerRef item = (CFRunLoopTimerRef)CFArrayGetValueAtIndex(array, cnt - 1);
-        if (item->_fireTSR <= rlt->_fireTSR) {
-            return cnt;
-        }
-        item = (CFRunLoopTimerRef)CFArrayGetValueAtIndex(array, 0);
-        if (rlt->_fireTSR < item->_fireTSR) {
-            return 0;
-        }
+    return NULL;
+}
+
+CF_INLINE Boolean __CFRunLoopTimerHeapEntryPrecedes(const __CFRunLoopTimerHeapEntry *entry1, const __CFRunLoopTimerHeapEntry *entry2) {
+    return (entry1->_fireTSR < entry2->_fireTSR) || (entry1->_fireTSR == entry2->_fireTSR && entry1->_sequence < entry2->_sequence);
+}
+
+CF_INLINE void __CFRunLoopTimerHeapStore(CFRunLoopModeRef rlm, CFIndex idx, __CFRunLoopTimerHeapEntry entry) {
+    rlm->_timers[idx] = entry;
+    __CFRunLoopTimerGetHeapSlot(entry._timer, rlm)->_index = idx;
+}
+
+// Moves the entry at idx up or down until the heap is ordered again
+static void __CFRunLoopTimerHeapSift(CFRunLoopModeRef rlm, CFIndex idx) {
+    __CFRunLoopTimerHeapEntry entry = rlm->_timers[idx];
+    while (0 < idx) {
+        CFIndex parent = (idx - 1) / 2;
+        if (!__CFRunLoopTimerHeapEntryPrecedes(&entry, &rlm->_timers[parent])) break;
+        __CFRunLoopTimerHeapStore(rlm, idx, rlm->_timers[parent]);
+        idx = parent;
     }
+    for (;;) {
+        CFIndex child = 2 * idx + 1;
+        if (rlm->_timerCount <= child) break;
+        if (child + 1 < rlm->_timerCount && __CFRunLoopTimerHeapEntryPrecedes(&rlm->_timers[child + 1], &rlm->_timers[child])) child++;
+        if (!__CFRunLoopTimerHeapEntryPrecedes(&rlm->_timers[child], &entry)) break;
+        __CFRunLoopTimerHeapStore(rlm, idx, rlm->_timers[child]);
+        idx = child;
+    }
+    __CFRunLoopTimerHeapStore(rlm, idx, entry);
+}
 
-    CFIndex add = (1 << flsl(cnt)) * 2;
-    CFIndex idx = 0;
-    Boolean lastTestLEQ;
-    do {
-        add = add / 2;
-	lastTestLEQ = false;
-        CFIndex testIdx = idx + add;
-        if (testIdx < cnt) {
-            CFRunLoopTimerRef item = (CFRunLoopTimerRef)CFArrayGetValueAtIndex(array, testIdx);
-            if (item->_fireTSR <= rlt->_fireTSR) {
-                idx = testIdx;
-		lastTestLEQ = true;
-            }
-        }
-    } while (0 < add);
+// call with rlm and its run loop locked, and the TSRLock locked; the timer must not be in the heap
+static void __CFRunLoopTimerHeapInsert(CFRunLoopModeRef rlm, CFRunLoopTimerRef rlt) {
+    if (rlm->_timerCount == rlm->_timerCapacity) {
+        rlm->_timerCapacity = (rlm->_timerCapacity < 8) ? 8 : 2 * rlm->_timerCapacity;
+        rlm->_timers = (__CFRunLoopTimerHeapEntry *)CFAllocatorReallocate(kCFAllocatorSystemDefault, rlm->_timers, rlm->_timerCapacity * sizeof(__CFRunLoopTimerHeapEntry), 0);
+    }
+    rlt->_heapSlots = (struct __CFRunLoopTimerHeapSlot *)CFAllocatorReallocate(kCFAllocatorSystemDefault, rlt->_heapSlots, (rlt->_heapSlotCount + 1) * sizeof(struct __CFRunLoopTimerHeapSlot), 0);
+    rlt->_heapSlots[rlt->_heapSlotCount]._mode = rlm;
+    rlt->_heapSlots[rlt->_heapSlotCount]._index = rlm->_timerCount;
+    rlt->_heapSlotCount++;
+    CFRetain(rlt);
+    __CFRunLoopTimerHeapEntry *entry = &rlm->_timers[rlm->_timerCount++];
+    entry->_fireTSR = rlt->_fireTSR;
+    entry->_sequence = rlm->_timerSequence++;
+    entry->_timer = rlt;
+    __CFRunLoopTimerHeapSift(rlm, rlm->_timerCount - 1);
+}
+
+// call with rlm and its run loop locked; returns whether the timer was in the heap, which no longer holds a reference to it
+static Boolean __CFRunLoopTimerHeapRemove(CFRunLoopModeRef rlm, CFRunLoopTimerRef rlt) {
+    struct __CFRunLoopTimerHeapSlot *slot = __CFRunLoopTimerGetHeapSlot(rlt, rlm);
+    if (NULL == slot) return false;
+    CFIndex idx = slot->_index;
+    *slot = rlt->_heapSlots[--rlt->_heapSlotCount];
+    rlm->_timerCount--;
+    if (idx < rlm->_timerCount) {
+        rlm->_timers[idx] = rlm->_timers[rlm->_timerCount];
+        __CFRunLoopTimerHeapSift(rlm, idx);
+    }
+    CFRelease(rlt);
+    return true;
+}
 
-    return lastTestLEQ ? idx + 1 : idx;
+// call with rl and rlm locked; returns whether rlt is in the heap of rlm
+static Boolean __CFRunLoopTimerIsInMode(CFRunLoopRef rl, CFRunLoopModeRef rlm, CFRunLoopTimerRef rlt) {
+    // The heap slots of a timer in another run loop may be changing under
+    // that run loop's lock. A timer can only move to another run loop once
+    // it is out of every mode of this one, which needs our lock.
+    __CFRunLoopTimerLock(rlt);
+    Boolean inRunLoop = (rl == rlt->_runLoop);
+    __CFRunLoopTimerUnlock(rlt);
+    return inRunLoop && NULL != __CFRunLoopTimerGetHeapSlot(rlt, rlm);
+}
+
+// Finds the first timer, in fire order, which is due by limitTSR, is not
+// firing or invalid, comes after the entry after (if any), and was
+// positioned before the sequence number was taken; timers which are
+// rescheduled while the due timers are fired wait for the next pass.
+static Boolean __CFRunLoopTimerHeapGetNextDue(CFRunLoopModeRef rlm, uint64_t limitTSR, uint64_t sequence, const __CFRunLoopTimerHeapEntry *after, __CFRunLoopTimerHeapEntry *next) {
+    // There is at most one subtree waiting for each level of the heap
+    CFIndex pending[8 * sizeof(CFIndex)];
+    CFIndex pendingCount = 0, found = kCFNotFound;
+    if (0 < rlm->_timerCount) pending[pendingCount++] = 0;
+    while (0 < pendingCount) {
+        CFIndex idx = pending[--pendingCount];
+        __CFRunLoopTimerHeapEntry *entry = &rlm->_timers[idx];
+        // Everything below an entry comes after it, so stop at entries which are not due or come after the best found so far
+        if (limitTSR < entry->_fireTSR) continue;
+        if (kCFNotFound != found && !__CFRunLoopTimerHeapEntryPrecedes(entry, &rlm->_timers[found])) continue;
+        CFRunLoopTimerRef rlt = entry->_timer;
+        if (entry->_sequence < sequence && (NULL == after || __CFRunLoopTimerHeapEntryPrecedes(after, entry)) && __CFIsValid(rlt) && !__CFRunLoopTimerIsFiring(rlt)) {
+            found = idx;
+            continue;
+        }
+        if (2 * idx + 2 < rlm->_timerCount) pending[pendingCount++] = 2 * idx + 2;
+        if (2 * idx + 1 < rlm->_timerCount) pending[pendingCount++] = 2 * idx + 1;
+    }
+    if (kCFNotFound == found) return false;
+    *next = rlm->_timers[found];
+    return true;
 }
 
 static void __CFArmNextTimerInMode(CFRunLoopModeRef rlm, CFRunLoopRef rl) {    
@@ -2002,24 +2262,32 @@ static void __CFArmNextTimerInMode(CFRunLoopModeRef rlm, CFRunLoopRef rl) {
     uint64_t nextSoftDeadline = UINT64_MAX;
 
     if (rlm->_timers) {
-        // Look at the list of timers. We will calculate two TSR values; the next soft and next hard deadline.
-        // The next soft deadline is the first time we can fire any timer. This is the fire date of the first timer in our sorted list of timers.
-        // The next hard deadline is the last time at which we can fire the timer before we've moved out of the allowable tolerance of the timers in our list.
-        for (CFIndex idx = 0, cnt = CFArrayGetCount(rlm->_timers); idx < cnt; idx++) {
-            CFRunLoopTimerRef t = (CFRunLoopTimerRef)CFArrayGetValueAtIndex(rlm->_timers , idx);
+        // Look at the heap of timers. We will calculate two TSR values; the next soft and next hard deadline.
+        // The next soft deadline is the first time we can fire any timer. This is the earliest fire date of the timers in our heap.
+        // The next hard deadline is the last time at which we can fire the timer before we've moved out of the allowable tolerance of the timers in our heap.
+        // There is at most one subtree waiting for each level of the heap.
+        CFIndex pending[8 * sizeof(CFIndex)];
+        CFIndex pendingCount = 0;
+        if (0 < rlm->_timerCount) pending[pendingCount++] = 0;
+        while (0 < pendingCount) {
+            CFIndex idx = pending[--pendingCount];
+            CFRunLoopTimerRef t = rlm->_timers[idx]._timer;
+            uint64_t oneTimerSoftDeadline = rlm->_timers[idx]._fireTSR;
+            
+            // We can skip this timer and every timer below it in the heap if its soft deadline exceeds the current hard deadline, since no timer's hard deadline comes before its soft deadline. Otherwise, later timers with lower tolerance could still have earlier hard deadlines.
+            if (oneTimerSoftDeadline > nextHardDeadline) {
+                continue;
+            }
+            if (2 * idx + 2 < rlm->_timerCount) pending[pendingCount++] = 2 * idx + 2;
+            if (2 * idx + 1 < rlm->_timerCount) pending[pendingCount++] = 2 * idx + 1;
+            
             // discount timers currently firing
             if (__CFRunLoopTimerIsFiring(t)) continue;
             
             int32_t err = CHECKINT_NO_ERROR;
-            uint64_t oneTimerSoftDeadline = t->_fireTSR;
-            uint64_t oneTimerHardDeadline = check_uint64_add(t->_fireTSR, __CFTimeIntervalToTSR(t->_tolerance), &err);
+            uint64_t oneTimerHardDeadline = check_uint64_add(oneTimerSoftDeadline, __CFTimeIntervalToTSR(t->_tolerance), &err);
             if (err != CHECKINT_NO_ERROR) oneTimerHardDeadline = UINT64_MAX;
             
-            // We can stop searching if the soft deadline for this timer exceeds the current hard deadline. Otherwise, later timers with lower tolerance could still have earlier hard deadlines.
-            if (oneTimerSoftDeadline > nextHardDeadline) {
-                break;
-            }
-            
             if (oneTimerSoftDeadline < nextSoftDeadline) {
                 nextSoftDeadline = oneTimerSoftDeadline;
             }
@@ -2070,14 +2338,15 @@ static void __CFArmNextTimerInMode(CFRunLoopModeRef rlm, CFRunLoopRef rl) {
             _dispatch_source_set_runloop_timer_4CF(rlm->_timerSource, deadline, DISPATCH_TIME_FOREVER, leeway);
 #endif
 #else
-            if (rlm->_timerPort) {
+            if (MACH_PORT_NULL != rlm->_timerPort) {
                 mk_timer_arm(rlm->_timerPort, __CFUInt64ToAbsoluteTime(nextSoftDeadline));
+                rlm->_mkTimerArmed = true;
             }
 #endif
         } else if (nextSoftDeadline == UINT64_MAX) {
             // Disarm the timers - there is no timer scheduled
             
-            if (rlm->_mkTimerArmed && rlm->_timerPort) {
+            if (rlm->_mkTimerArmed && MACH_PORT_NULL != rlm->_timerPort) {
                 AbsoluteTime dummy;
                 mk_timer_cancel(rlm->_timerPort, &dummy);
                 rlm->_mkTimerArmed = false;
@@ -2100,24 +2369,18 @@ static void __CFRepositionTimerInMode(CFRunLoopModeRef rlm, CFRunLoopTimerRef rl
 static void __CFRepositionTimerInMode(CFRunLoopModeRef rlm, CFRunLoopTimerRef rlt, Boolean isInArray) {
     if (!rlt) return;
     
-    CFMutableArrayRef timerArray = rlm->_timers;
-    if (!timerArray) return;
-    Boolean found = false;
-    
-    // If we know in advance that the timer is not in the array (just being added now) then we can skip this search
+    // If we know in advance that the timer is not in the heap (just being added now) then we can skip this search
     if (isInArray) {
-        CFIndex idx = CFArrayGetFirstIndexOfValue(timerArray, CFRangeMake(0, CFArrayGetCount(timerArray)), rlt);
-        if (kCFNotFound != idx) {
-            CFRetain(rlt);
-            CFArrayRemoveValueAtIndex(timerArray, idx);
-            found = true;
-        }
+        struct __CFRunLoopTimerHeapSlot *slot = __CFRunLoopTimerGetHeapSlot(rlt, rlm);
+        if (NULL == slot) return;
+        __CFRunLoopTimerHeapEntry *entry = &rlm->_timers[slot->_index];
+        entry->_fireTSR = rlt->_fireTSR;
+        entry->_sequence = rlm->_timerSequence++;
+        __CFRunLoopTimerHeapSift(rlm, slot->_index);
+    } else {
+        __CFRunLoopTimerHeapInsert(rlm, rlt);
     }
-    if (!found && isInArray) return;
-    CFIndex newIdx = __CFRunLoopInsertionIndexInTimerArray(timerArray, rlt);
-    CFArrayInsertValueAtIndex(timerArray, newIdx, rlt);
     __CFArmNextTimerInMode(rlm, rlt->_runLoop);
-    if (isInArray) CFRelease(rlt);
 }
 
 
@@ -2258,24 +2521,21 @@ static Boolean __CFRunLoopDoTimer(CFRunLoopRef rl, CFRunLoopModeRef rlm, CFRunLo
 // rl and rlm are locked on entry and exit
 static Boolean __CFRunLoopDoTimers(CFRunLoopRef rl, CFRunLoopModeRef rlm, uint64_t limitTSR) {	/* DOES CALLOUT */
     Boolean timerHandled = false;
-    CFMutableArrayRef timers = NULL;
-    for (CFIndex idx = 0, cnt = rlm->_timers ? CFArrayGetCount(rlm->_timers) : 0; idx < cnt; idx++) {
-        CFRunLoopTimerRef rlt = (CFRunLoopTimerRef)CFArrayGetValueAtIndex(rlm->_timers, idx);
-        
-        if (__CFIsValid(rlt) && !__CFRunLoopTimerIsFiring(rlt)) {
-            if (rlt->_fireTSR <= limitTSR) {
-                if (!timers) timers = CFArrayCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeArrayCallBacks);
-                CFArrayAppendValue(timers, rlt);
-            }
+    // Only the timers which are due when the pass starts are fired; firing a
+    // timer reschedules or removes it, which takes it out of the pass.
+    // A timer which does not fire keeps its entry, so the pass goes on
+    // with the timers after that entry rather than finding it again.
+    uint64_t sequence = rlm->_timerSequence;
+    __CFRunLoopTimerHeapEntry next, skipped;
+    const __CFRunLoopTimerHeapEntry *after = NULL;
+    while (__CFRunLoopTimerHeapGetNextDue(rlm, limitTSR, sequence, after, &next)) {
+        if (__CFRunLoopDoTimer(rl, rlm, next._timer)) {
+            timerHandled = true;
+        } else {
+            skipped = next;
+            after = &skipped;
         }
     }
-    
-    for (CFIndex idx = 0, cnt = timers ? CFArrayGetCount(timers) : 0; idx < cnt; idx++) {
-        CFRunLoopTimerRef rlt = (CFRunLoopTimerRef)CFArrayGetValueAtIndex(timers, idx);
-        Boolean did = __CFRunLoopDoTimer(rl, rlm, rlt);
-        timerHandled = timerHandled || did;
-    }
-    if (timers) CFRelease(timers);
     return timerHandled;
 }
 
@@ -2421,14 +2681,50 @@ static Boolean __CFRunLoopWaitForMultipleObjects(__CFPortSet portSet, HANDLE *on
     return result;
 }
 
+#elif DEPLOYMENT_TARGET_LINUX
+
+#define TIMEOUT_INFINITY (-1)
+
+// The epoll_wait() timeout, in milliseconds, which sleeps until termTSR. It is rounded up so that we never wake before the run loop has timed out.
+static int __CFRunLoopTimeoutUntilTSR(uint64_t termTSR) {
+    if (UINT64_MAX == termTSR) return TIMEOUT_INFINITY;
+    uint64_t now = mach_absolute_time();
+    if (termTSR <= now) return 0;
+    CFTimeInterval ms = ceil(__CFTSRToTimeInterval(termTSR - now) * 1000.0);
+    return (ms < (CFTimeInterval)INT_MAX) ? (int)ms : INT_MAX;
+}
+
+// Waits up to timeout milliseconds for one of the ports in portSet to become readable, and returns it in livePort. Nothing is read from the port here; the caller drains it, or the perform function of a version 1 source reads its own descriptor.
+static Boolean __CFRunLoopServiceFileDescriptors(__CFPortSet portSet, int timeout, __CFPort *livePort) {
+    struct epoll_event event;
+    int ret;
+    if (TIMEOUT_INFINITY == timeout) { CFRUNLOOP_SLEEP(); } else { CFRUNLOOP_POLL(); }
+    ret = epoll_wait(portSet, &event, 1, timeout);
+    CFRUNLOOP_WAKEUP(ret);
+    if (1 == ret) {
+        *livePort = event.data.fd;
+        return true;
+    }
+    // A timeout, or a signal handler ran; either way the run loop goes around again
+    if (0 == ret || EINTR == errno) {
+        *livePort = CFPORT_NULL;
+        return false;
+    }
+    CRASH("*** Unable to wait on the run loop port set. (%d) ***", errno);
+    return false;
+}
+
 #endif
 
 struct __timeout_context {
+#if USE_LIBDISPATCH
     dispatch_source_t ds;
+#endif
     CFRunLoopRef rl;
     uint64_t termTSR;
 };
 
+#if USE_LIBDISPATCH
 /// RunLoop 启动超时时的取消
 static void __CFRunLoopTimeoutCancel(void *arg) {
     struct __timeout_context *context = (struct __timeout_context *)arg;
@@ -2445,6 +2741,7 @@ static void __CFRunLoopTimeout(void *arg) {
     CFRunLoopWakeUp(context->rl);
     // The interval is DISPATCH_TIME_FOREVER, so this won't fire again
 }
+#endif
 
 
 /** 入口函数 : 运行 Runloop
@@ -2475,6 +2772,7 @@ static int32_t __CFRunLoopRun(CFRunLoopRef runLoop, CFRunLoopModeRef theMode, CF
     
     //Mach 端口，在内核中，消息在端口之间传递。 初始为0
     mach_port_name_t dispatchPort = MACH_PORT_NULL;
+#if USE_LIBDISPATCH
     //判断是否为主线程
     Boolean libdispatchQSafe = pthread_main_np() &&
                              ( (HANDLE_DISPATCH_ON_BASE_INVOCATION_ONLY && NULL == previousMode) ||
@@ -2485,6 +2783,7 @@ static int32_t __CFRunLoopRun(CFRunLoopRef runLoop, CFRunLoopModeRef theMode, CF
         //给 mach 端口赋值为主线程收发消息的端口
         dispatchPort = _dispatch_get_main_queue_port_4CF();
     }
+#endif
     
     
 #if USE_DISPATCH_SOURCE_FOR_TIMERS
@@ -2499,12 +2798,15 @@ static int32_t __CFRunLoopRun(CFRunLoopRef runLoop, CFRunLoopModeRef theMode, CF
 #endif
     
     /// 借助 GCD timer，设置 Runloop 的超时时间
+#if USE_LIBDISPATCH
     dispatch_source_t timeout_timer = NULL;
+#endif
     struct __timeout_context *timeout_context = (struct __timeout_context *)malloc(sizeof(*timeout_context));
     if (seconds <= 0.0) { // instant timeout
         seconds = 0.0;
         timeout_context->termTSR = 0ULL;
     } else if (seconds <= TIMER_INTERVAL_LIMIT) {
+#if USE_LIBDISPATCH
         /// seconds为超时时间，超时时执行__CFRunLoopTimeout函数
         dispatch_queue_t queue = pthread_main_np() ? __CFDispatchQueueGetGenericMatchingMain() : __CFDispatchQueueGetGenericBackground();
         timeout_timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
@@ -2520,6 +2822,10 @@ static int32_t __CFRunLoopRun(CFRunLoopRef runLoop, CFRunLoopModeRef theMode, CF
         uint64_t ns_at = (uint64_t)((__CFTSRToTimeInterval(startTSR) + seconds) * 1000000000ULL);
         dispatch_source_set_timer(timeout_timer, dispatch_time(1, ns_at), DISPATCH_TIME_FOREVER, 1000ULL);
         dispatch_resume(timeout_timer);
+#else
+        // The wait below sleeps no later than termTSR instead
+        timeout_context->termTSR = startTSR + __CFTimeIntervalToTSR(seconds);
+#endif
     } else {
         ///永不超时
         seconds = 9999999999.0;
@@ -2545,6 +2851,8 @@ static int32_t __CFRunLoopRun(CFRunLoopRef runLoop, CFRunLoopModeRef theMode, CF
 #elif DEPLOYMENT_TARGET_WINDOWS
         HANDLE livePort = NULL;
         Boolean windowsMessageReceived = false;
+#elif DEPLOYMENT_TARGET_LINUX
+        __CFPort livePort = CFPORT_NULL;
 #endif
         // 取当前mode所需要监听的mach port集合，用于唤醒runloop（__CFPortSet 实际上是unsigned int 类型）
         __CFPortSet waitSet = theMode->_portSet;
@@ -2662,6 +2970,8 @@ static int32_t __CFRunLoopRun(CFRunLoopRef runLoop, CFRunLoopModeRef theMode, CF
 #elif DEPLOYMENT_TARGET_WINDOWS
         // Here, use the app-supplied message queue mask. They will set this if they are interested in having this run loop receive windows messages.
         __CFRunLoopWaitForMultipleObjects(waitSet, NULL, poll ? 0 : TIMEOUT_INFINITY, theMode->_msgQMask, &livePort, &windowsMessageReceived);
+#elif DEPLOYMENT_TARGET_LINUX
+        __CFRunLoopServiceFileDescriptors(waitSet, poll ? 0 : __CFRunLoopTimeoutUntilTSR(timeout_context->termTSR), &livePort);
 #endif
         
         __CFRunLoopLock(runLoop);
@@ -2731,6 +3041,9 @@ static int32_t __CFRunLoopRun(CFRunLoopRef runLoop, CFRunLoopModeRef theMode, CF
 #if DEPLOYMENT_TARGET_WINDOWS
             // Always reset the wake up port, or risk spinning forever
             ResetEvent(runLoop->_wakeUpPort);
+#elif DEPLOYMENT_TARGET_LINUX
+            // Likewise the eventfd
+            __CFPortDrain(runLoop->_wakeUpPort);
 #endif
         }
 #if USE_DISPATCH_SOURCE_FOR_TIMERS
@@ -2745,6 +3058,10 @@ static int32_t __CFRunLoopRun(CFRunLoopRef runLoop, CFRunLoopModeRef theMode, CF
 #if USE_MK_TIMER_TOO
         else if (theMode->_timerPort != MACH_PORT_NULL && livePort == theMode->_timerPort) {
             CFRUNLOOP_WAKEUP_FOR_TIMER();
+#if DEPLOYMENT_TARGET_LINUX
+            __CFPortDrain(theMode->_timerPort);
+            theMode->_mkTimerArmed = false;
+#endif
             // On Windows, we have observed an issue where the timer port is set before the time which we requested it to be set. For example, we set the fire time to be TSR 167646765860, but it is actually observed firing at TSR 167646764145, which is 1715 ticks early. The result is that, when __CFRunLoopDoTimers checks to see if any of the run loop timers should be firing, it appears to be 'too early' for the next timer, and no timers are handled.
             // In this case, the timer port has been automatically reset (since it was returned from MsgWaitForMultipleObjectsEx), and if we do not re-arm it, then no timers will ever be serviced again unless something adjusts the timer list (e.g. adding or removing timers). The fix for the issue is to reset the timer here if CFRunLoopDoTimers did not handle a timer itself. 9308754
             if (!__CFRunLoopDoTimers(runLoop, theMode, mach_absolute_time())) {
@@ -2753,6 +3070,7 @@ static int32_t __CFRunLoopRun(CFRunLoopRef runLoop, CFRunLoopModeRef theMode, CF
             }
         }
 #endif
+#if USE_LIBDISPATCH
         else if (livePort == dispatchPort) {
             CFRUNLOOP_WAKEUP_FOR_DISPATCH();
             __CFRunLoopModeUnlock(theMode);
@@ -2768,11 +3086,15 @@ static int32_t __CFRunLoopRun(CFRunLoopRef runLoop, CFRunLoopModeRef theMode, CF
             __CFRunLoopModeLock(theMode);
             sourceHandledThisLoop = true;
             didDispatchPortLastTime = true;
-        } else {
+        }
+#endif
+        else {
             CFRUNLOOP_WAKEUP_FOR_SOURCE();
             
+#if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED || DEPLOYMENT_TARGET_EMBEDDED_MINI
             // If we received a voucher from this mach_msg, then put a copy of the new voucher into TSD. CFMachPortBoost will look in the TSD for the voucher. By using the value in the TSD we tie the CFMachPortBoost to this received mach_msg explicitly without a chance for anything in between the two pieces of code to set the voucher again.
             voucher_t previousVoucher = _CFSetTSD(__CFTSDKeyMachMessageHasVoucher, (void *)voucherCopy, os_release);
+#endif
 
             // Despite the name, this works for windows handles as well
             CFRunLoopSourceRef rls = __CFRunLoopModeFindSourceForMachPort(runLoop, theMode, livePort);
@@ -2784,13 +3106,15 @@ static int32_t __CFRunLoopRun(CFRunLoopRef runLoop, CFRunLoopModeRef theMode, CF
 		    (void)mach_msg(reply, MACH_SEND_MSG, reply->msgh_size, 0, MACH_PORT_NULL, 0, MACH_PORT_NULL);
 		    CFAllocatorDeallocate(kCFAllocatorSystemDefault, reply);
 		}
-#elif DEPLOYMENT_TARGET_WINDOWS
+#elif DEPLOYMENT_TARGET_WINDOWS || DEPLOYMENT_TARGET_LINUX
                 sourceHandledThisLoop = __CFRunLoopDoSource1(runLoop, theMode, rls) || sourceHandledThisLoop;
 #endif
 	    }
             
+#if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED || DEPLOYMENT_TARGET_EMBEDDED_MINI
             // Restore the previous voucher
             _CFSetTSD(__CFTSDKeyMachMessageHasVoucher, previousVoucher, os_release);
+#endif
             
         } 
 #if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED || DEPLOYMENT_TARGET_EMBEDDED_MINI
@@ -2821,12 +3145,16 @@ static int32_t __CFRunLoopRun(CFRunLoopRef runLoop, CFRunLoopModeRef theMode, CF
 
     } while (0 == retVal);
 
+#if USE_LIBDISPATCH
     if (timeout_timer) {
         dispatch_source_cancel(timeout_timer);
         dispatch_release(timeout_timer);
     } else {
         free(timeout_context);
     }
+#else
+    free(timeout_context);
+#endif
     return retVal;
 }
 
@@ -2893,7 +3221,7 @@ CFAbsoluteTime CFRunLoopGetNextTimerFireDate(CFRunLoopRef rl, CFStringRef modeNa
     __CFRunLoopLock(rl);
     CFRunLoopModeRef rlm = __CFRunLoopFindMode(rl, modeName, false);
     CFAbsoluteTime at = 0.0;
-    CFRunLoopTimerRef nextTimer = (rlm && rlm->_timers && 0 < CFArrayGetCount(rlm->_timers)) ? (CFRunLoopTimerRef)CFArrayGetValueAtIndex(rlm->_timers, 0) : NULL;
+    CFRunLoopTimerRef nextTimer = (rlm && 0 < rlm->_timerCount) ? rlm->_timers[0]._timer : NULL;
     if (nextTimer) {
         at = CFRunLoopTimerGetNextFireDate(nextTimer);
     }
@@ -2926,6 +3254,10 @@ void CFRunLoopWakeUp(CFRunLoopRef rl) {
     if (ret != MACH_MSG_SUCCESS && ret != MACH_SEND_TIMED_OUT) CRASH("*** Unable to send message to wake up port. (%d) ***", ret);
 #elif DEPLOYMENT_TARGET_WINDOWS
     SetEvent(rl->_wakeUpPort);
+#elif DEPLOYMENT_TARGET_LINUX
+    /* The write only fails if the count would overflow, in which
+     * case a wakeup is already pending. */
+    (void)eventfd_write(rl->_wakeUpPort, 1);
 #endif
     __CFRunLoopUnlock(rl);
 }
@@ -3072,7 +3404,7 @@ void CFRunLoopAddSource(CFRunLoopRef rl, CFRunLoopSourceRef rls, CFStringRef mod
 	        CFSetAddValue(rlm->_sources0, rls);
 	    } else if (1 == rls->_context.version0.version) {
 	        CFSetAddValue(rlm->_sources1, rls);
-		__CFPort src_port = rls->_context.version1.getPort(rls->_context.version1.info);
+		__CFPort src_port = __CFRunLoopSourceGetPort(rls);
 		if (CFPORT_NULL != src_port) {
 		    CFDictionarySetValue(rlm->_portToV1SourceMap, (const void *)(uintptr_t)src_port, rls);
 		    __CFPortSetInsert(src_port, rlm->_portSet);
@@ -3125,7 +3457,7 @@ void CFRunLoopRemoveSource(CFRunLoopRef rl, CFRunLoopSourceRef rls, CFStringRef
 	if (NULL != rlm && ((NULL != rlm->_sources0 && CFSetContainsValue(rlm->_sources0, rls)) || (NULL != rlm->_sources1 && CFSetContainsValue(rlm->_sources1, rls)))) {
 	    CFRetain(rls);
 	    if (1 == rls->_context.version0.version) {
-		__CFPort src_port = rls->_context.version1.getPort(rls->_context.version1.info);
+		__CFPort src_port = __CFRunLoopSourceGetPort(rls);
                 if (CFPORT_NULL != src_port) {
 		    CFDictionaryRemoveValue(rlm->_portToV1SourceMap, (const void *)(uintptr_t)src_port);
                     __CFPortSetRemove(src_port, rlm->_portSet);
@@ -3321,10 +3653,7 @@ Boolean CFRunLoopContainsTimer(CFRunLoopRef rl, CFRunLoopTimerRef rlt, CFStringR
     } else {
 	CFRunLoopModeRef rlm = __CFRunLoopFindMode(rl, modeName, false);
 	if (NULL != rlm) {
-            if (NULL != rlm->_timers) {
-                CFIndex idx = CFArrayGetFirstIndexOfValue(rlm->_timers, CFRangeMake(0, CFArrayGetCount(rlm->_timers)), rlt);
-                hasValue = (kCFNotFound != idx);
-            }
+            hasValue = __CFRunLoopTimerIsInMode(rl, rlm, rlt);
 	    __CFRunLoopModeUnlock(rlm);
 	}
     }
@@ -3351,13 +3680,6 @@ void CFRunLoopAddTimer(CFRunLoopRef rl, CFRunLoopTimerRef rlt, CFStringRef modeN
 	}
     } else {
 	CFRunLoopModeRef rlm = __CFRunLoopFindMode(rl, modeName, true);
-	if (NULL != rlm) {
-            if (NULL == rlm->_timers) {
-                CFArrayCallBacks cb = kCFTypeArrayCallBacks;
-                cb.equal = NULL;
-                rlm->_timers = CFArrayCreateMutable(kCFAllocatorSystemDefault, 0, &cb);
-            }
-	}
 	if (NULL != rlm && !CFSetContainsValue(rlt->_rlModes, rlm->_name)) {
             __CFRunLoopTimerLock(rlt);
             if (NULL == rlt->_runLoop) {
@@ -3403,22 +3725,14 @@ void CFRunLoopRemoveTimer(CFRunLoopRef rl, CFRunLoopTimerRef rlt, CFStringRef mo
 	}
     } else {
 	CFRunLoopModeRef rlm = __CFRunLoopFindMode(rl, modeName, false);
-        CFIndex idx = kCFNotFound;
-        CFMutableArrayRef timerList = NULL;
-        if (NULL != rlm) {
-            timerList = rlm->_timers;
-            if (NULL != timerList) {
-                idx = CFArrayGetFirstIndexOfValue(timerList, CFRangeMake(0, CFArrayGetCount(timerList)), rlt);
-            }
-        }
-        if (kCFNotFound != idx) {
+        if (NULL != rlm && __CFRunLoopTimerIsInMode(rl, rlm, rlt)) {
             __CFRunLoopTimerLock(rlt);
             CFSetRemoveValue(rlt->_rlModes, rlm->_name);
             if (0 == CFSetGetCount(rlt->_rlModes)) {
                 rlt->_runLoop = NULL;
             }
             __CFRunLoopTimerUnlock(rlt);
-	    CFArrayRemoveValueAtIndex(timerList, idx);
+	    __CFRunLoopTimerHeapRemove(rlm, rlt);
             __CFArmNextTimerInMode(rlm, rl);
         }
         if (NULL != rlm) {
@@ -3462,7 +3776,7 @@ static CFStringRef __CFRunLoopSourceCopyDescription(CFTypeRef cf) {	/* DOES CALL
     }
     if (NULL == contextDesc) {
 	void *addr = rls->_context.version0.version == 0 ? (void *)rls->_context.version0.perform : (rls->_context.version0.version == 1 ? (void *)rls->_context.version1.perform : NULL);
-#if DEPLOYMENT_TARGET_WINDOWS
+#if DEPLOYMENT_TARGET_WINDOWS || DEPLOYMENT_TARGET_LINUX
 	contextDesc = CFStringCreateWithFormat(kCFAllocatorSystemDefault, NULL, CFSTR("<CFRunLoopSource context>{version = %ld, info = %p, callout = %p}"), rls->_context.version0.version, rls->_context.version0.info, addr);
 #elif DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED || DEPLOYMENT_TARGET_EMBEDDED_MINI
 	Dl_info info;
@@ -3671,6 +3985,8 @@ static CFStringRef __CFRunLoopObserverCopyDescription(CFTypeRef cf) {	/* DOES CA
     Dl_info info;
     const char *name = (dladdr(addr, &info) && info.dli_saddr == addr && info.dli_sname) ? info.dli_sname : "???";
     result = CFStringCreateWithFormat(kCFAllocatorSystemDefault, NULL, CFSTR("<CFRunLoopObserver %p [%p]>{valid = %s, activities = 0x%lx, repeats = %s, order = %ld, callout = %s (%p), context = %@}"), cf, CFGetAllocator(rlo), __CFIsValid(rlo) ? "Yes" : "No", (long)rlo->_activities, __CFRunLoopObserverRepeats(rlo) ? "Yes" : "No", (long)rlo->_order, name, addr, contextDesc);
+#elif DEPLOYMENT_TARGET_LINUX
+    result = CFStringCreateWithFormat(kCFAllocatorSystemDefault, NULL, CFSTR("<CFRunLoopObserver %p [%p]>{valid = %s, activities = 0x%lx, repeats = %s, order = %ld, callout = %p, context = %@}"), cf, CFGetAllocator(rlo), __CFIsValid(rlo) ? "Yes" : "No", (long)rlo->_activities, __CFRunLoopObserverRepeats(rlo) ? "Yes" : "No", (long)rlo->_order, rlo->_callout, contextDesc);
 #endif
     CFRelease(contextDesc);
     return result;
@@ -3872,6 +4188,8 @@ static void __CFRunLoopTimerDeallocate(CFTypeRef cf) {	/* DOES CALLOUT */
     CFRunLoopTimerInvalidate(rlt);	/* DOES CALLOUT */
     CFRelease(rlt->_rlModes);
     rlt->_rlModes = NULL;
+    if (NULL != rlt->_heapSlots) CFAllocatorDeallocate(kCFAllocatorSystemDefault, rlt->_heapSlots);
+    rlt->_heapSlots = NULL;
     pthread_mutex_destroy(&rlt->_lock);
 }
 
@@ -3912,6 +4230,8 @@ CFRunLoopTimerRef CFRunLoopTimerCreate(CFAllocatorRef allocator, CFAbsoluteTime
     memory->_runLoop = NULL;
     memory->_rlModes = CFSetCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeSetCallBacks);
     memory->_order = order;
+    memory->_heapSlotCount = 0;
+    memory->_heapSlots = NULL;
     if (interval < 0.0) interval = 0.0;
     memory->_interval = interval;
     memory->_tolerance = 0.0;
@@ -134,122 +134,187 @@ static void __CFSimpleMergeSort(VALUE_TYPE listp[], INDEX_TYPE cnt, VALUE_TYPE t
 }
 
 #if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED || DEPLOYMENT_TARGET_WINDOWS
-// Excluded from linux for dispatch dependency
 
-// if !right, put the cnt1 smallest values in tmp, else put the cnt2 largest values in tmp
-static void __CFSortIndexesNMerge(VALUE_TYPE listp1[], INDEX_TYPE cnt1, VALUE_TYPE listp2[], INDEX_TYPE cnt2, VALUE_TYPE tmp[], size_t right, COMPARATOR_BLOCK cmp) {
-    // if the last element of listp1 <= the first of listp2, lists are already ordered
-    if (16 < cnt1 + cnt2 && cmp(listp1[cnt1 - 1], listp2[0]) <= 0) {
-        memmove(tmp, (right ? listp2 : listp1), (right ? cnt2 : cnt1) * sizeof(VALUE_TYPE));
+CF_INLINE void __CFSortApply(size_t iterations, void (^block)(size_t)) {
+    dispatch_apply(iterations, __CFDispatchQueueGetGenericMatchingCurrent(), block);
+}
+
+#else
+// There is no dispatch on linux, so the iterations are handed out to a set of worker
+// threads which is started the first time it is needed and kept for the life of the
+// process, with the calling thread taking its share. The workers take one apply at a
+// time; an apply which finds them busy, such as one made from a comparator, runs on
+// its calling thread alone.
+
+struct __CFSortApplyContext {
+    void (^block)(size_t);
+    int32_t iterations;
+    volatile int32_t next;
+    int32_t active;     // workers taking iterations from this apply; guarded by __CFSortApplyLock
+};
+
+static pthread_mutex_t __CFSortApplyLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t __CFSortApplyPosted = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t __CFSortApplyFinished = PTHREAD_COND_INITIALIZER;
+static struct __CFSortApplyContext *__CFSortApplyCurrent = NULL;
+static uint64_t __CFSortApplyGeneration = 0;
+static Boolean __CFSortApplyBusy = false;
+static pthread_once_t __CFSortApplyWorkersOnce = PTHREAD_ONCE_INIT;
+
+static void __CFSortApplyIterate(struct __CFSortApplyContext *context) {
+    for (;;) {
+        int32_t iteration = OSAtomicIncrement32Barrier(&context->next) - 1;
+        if (context->iterations <= iteration) break;
+        context->block((size_t)iteration);
+    }
+}
+
+static void *__CFSortApplyWorker(void *arg) {
+    uint64_t seen = 0;
+    pthread_mutex_lock(&__CFSortApplyLock);
+    for (;;) {
+        while (!__CFSortApplyCurrent || __CFSortApplyGeneration == seen) pthread_cond_wait(&__CFSortApplyPosted, &__CFSortApplyLock);
+        seen = __CFSortApplyGeneration;
+        struct __CFSortApplyContext *context = __CFSortApplyCurrent;
+        context->active++;
+        pthread_mutex_unlock(&__CFSortApplyLock);
+        __CFSortApplyIterate(context);
+        pthread_mutex_lock(&__CFSortApplyLock);
+        if (0 == --context->active) pthread_cond_signal(&__CFSortApplyFinished);
+    }
+    return NULL;
+}
+
+static void __CFSortApplyStartWorkers(void) {
+    CFIndex nthreads = __CFMin(__CFActiveProcessorCount(), 16) - 1;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (CFIndex idx = 0; idx < nthreads; idx++) {
+        pthread_t thread;
+        if (0 != pthread_create(&thread, &attr, __CFSortApplyWorker, NULL)) break;
+    }
+    pthread_attr_destroy(&attr);
+}
+
+static void __CFSortApply(size_t iterations, void (^block)(size_t)) {
+    struct __CFSortApplyContext context = {block, (int32_t)iterations, 0, 0};
+    pthread_once(&__CFSortApplyWorkersOnce, __CFSortApplyStartWorkers);
+    pthread_mutex_lock(&__CFSortApplyLock);
+    if (__CFSortApplyBusy || iterations < 2) {
+        pthread_mutex_unlock(&__CFSortApplyLock);
+        __CFSortApplyIterate(&context);
         return;
     }
+    __CFSortApplyBusy = true;
+    __CFSortApplyCurrent = &context;
+    __CFSortApplyGeneration++;
+    pthread_cond_broadcast(&__CFSortApplyPosted);
+    pthread_mutex_unlock(&__CFSortApplyLock);
 
-    if (right) {
-        VALUE_TYPE *listp1_end = listp1;
-        VALUE_TYPE *listp2_end = listp2;
-        VALUE_TYPE *tmp_end = tmp;
-        listp1 += cnt1 - 1;
-        listp2 += cnt2 - 1;
-        tmp += cnt2;
-        while (tmp_end < tmp) {
-            tmp--;
-            if (listp2 < listp2_end) {
-                listp1--;
-                *tmp = *listp1;
-            } else if (listp1 < listp1_end) {
-                listp2--;
-                *tmp = *listp2;
-            } else {
-                VALUE_TYPE v1 = *listp1, v2 = *listp2;
-                CMP_RESULT_TYPE res = cmp(v1, v2);
-                if (res <= 0) {
-                    *tmp = v2;
-                    listp2--;
-                } else {
-                    *tmp = v1;
-                    listp1--;
-                }
-            }
+    __CFSortApplyIterate(&context);
+
+    // Every iteration has been taken; wait for the workers still running one, and keep late ones from joining
+    pthread_mutex_lock(&__CFSortApplyLock);
+    __CFSortApplyCurrent = NULL;
+    while (0 < context.active) pthread_cond_wait(&__CFSortApplyFinished, &__CFSortApplyLock);
+    __CFSortApplyBusy = false;
+    pthread_mutex_unlock(&__CFSortApplyLock);
+}
+
+#endif
+
+// Returns how many of the first k values of a stable merge of listp1 and listp2 come from listp1
+static INDEX_TYPE __CFSortIndexesNSplit(VALUE_TYPE listp1[], INDEX_TYPE cnt1, VALUE_TYPE listp2[], INDEX_TYPE cnt2, INDEX_TYPE k, COMPARATOR_BLOCK cmp) {
+    INDEX_TYPE lo = (cnt2 < k) ? k - cnt2 : 0, hi = (k < cnt1) ? k : cnt1;
+    while (lo < hi) {
+        INDEX_TYPE mid = lo + (hi - lo) / 2;
+        // listp1[mid] is merged ahead of listp2[k - mid - 1] unless it is strictly greater
+        if (cmp(listp1[mid], listp2[k - mid - 1]) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
-    } else {
-        VALUE_TYPE *listp1_end = listp1 + cnt1;
-        VALUE_TYPE *listp2_end = listp2 + cnt2;
-        VALUE_TYPE *tmp_end = tmp + cnt1;
-        while (tmp < tmp_end) {
-            if (listp2_end <= listp2) {
-                *tmp = *listp1;
-                listp1++;
-            } else if (listp1_end <= listp1) {
-                *tmp = *listp2;
-                listp2++;
-            } else {
-                VALUE_TYPE v1 = *listp1, v2 = *listp2;
-                CMP_RESULT_TYPE res = cmp(v1, v2);
-                if (res <= 0) {
-                    *tmp = v1;
-                    listp1++;
-                } else {
-                    *tmp = v2;
-                    listp2++;
-                }
-            }
-            tmp++;
+    }
+    return lo;
+}
+
+// merges listp1 and listp2 into dst, taking from listp1 on ties
+static void __CFSortIndexesNMerge(VALUE_TYPE listp1[], INDEX_TYPE cnt1, VALUE_TYPE listp2[], INDEX_TYPE cnt2, VALUE_TYPE dst[], COMPARATOR_BLOCK cmp) {
+    VALUE_TYPE *listp1_end = listp1 + cnt1;
+    VALUE_TYPE *listp2_end = listp2 + cnt2;
+    // if the last element of listp1 <= the first of listp2, lists are already ordered
+    if (0 < cnt1 && 0 < cnt2 && 16 < cnt1 + cnt2 && cmp(listp1_end[-1], listp2[0]) <= 0) {
+        memmove(dst, listp1, cnt1 * sizeof(VALUE_TYPE));
+        memmove(dst + cnt1, listp2, cnt2 * sizeof(VALUE_TYPE));
+        return;
+    }
+    while (listp1 < listp1_end && listp2 < listp2_end) {
+        VALUE_TYPE v1 = *listp1, v2 = *listp2;
+        if (cmp(v1, v2) <= 0) {
+            *dst++ = v1;
+            listp1++;
+        } else {
+            *dst++ = v2;
+            listp2++;
         }
     }
+    if (listp1 < listp1_end) memmove(dst, listp1, (listp1_end - listp1) * sizeof(VALUE_TYPE));
+    if (listp2 < listp2_end) memmove(dst, listp2, (listp2_end - listp2) * sizeof(VALUE_TYPE));
 }
 
-/* Merging algorithm based on
-    "A New Parallel Sorting Algorithm based on Odd-Even Mergesort", Ezequiel Herruzo, et al
+/* Parallel merge sort. The array is cut into a power of 2 sections, which are sorted
+   concurrently, and then merged pairwise, back and forth between the array and a
+   buffer, until one section is left. There are fewer merges than cores near the end,
+   so each merge is split into parts which produce equal runs of its output; the split
+   points are found by binary search along the merge path, and respect stability.
 */
-static void __CFSortIndexesN(VALUE_TYPE listp[], INDEX_TYPE count, int32_t ncores, CMP_RESULT_TYPE (^cmp)(INDEX_TYPE, INDEX_TYPE)) {
-    /* Divide the array up into up to ncores, multiple-of-16-sized, chunks */
-    INDEX_TYPE sz = ((((count + ncores - 1) / ncores) + 15) / 16) * 16;
-    INDEX_TYPE num_sect = (count + sz - 1) / sz;
-    INDEX_TYPE last_sect_len = count + sz - sz * num_sect;
-
-    STACK_BUFFER_DECL(VALUE_TYPE *, stack_tmps, num_sect);
-    for (INDEX_TYPE idx = 0; idx < num_sect; idx++) {
-        stack_tmps[idx] = (VALUE_TYPE *)malloc(sz * sizeof(VALUE_TYPE));
-    }
-    VALUE_TYPE **tmps = stack_tmps;
+// Returns false, having done nothing, if the buffer can't be allocated.
+static Boolean __CFSortIndexesN(VALUE_TYPE listp[], INDEX_TYPE count, int32_t ncores, CMP_RESULT_TYPE (^cmp)(INDEX_TYPE, INDEX_TYPE)) {
+    INDEX_TYPE num_sect = 1;
+    while (num_sect < ncores) num_sect *= 2;
+    VALUE_TYPE *tmp = (VALUE_TYPE *)malloc(count * sizeof(VALUE_TYPE));
+    if (!tmp) return false;
 
-    dispatch_queue_t q = __CFDispatchQueueGetGenericMatchingCurrent();
-    dispatch_apply(num_sect, q, ^(size_t sect) {
-            INDEX_TYPE sect_len = (sect < num_sect - 1) ? sz : last_sect_len;
-            __CFSimpleMergeSort(listp + sect * sz, sect_len, tmps[sect], cmp); // naturally stable
+    __CFSortApply(num_sect, ^(size_t sect) {
+            INDEX_TYPE lo = count * sect / num_sect, hi = count * (sect + 1) / num_sect;
+            __CFSimpleMergeSort(listp + lo, hi - lo, tmp + lo, cmp); // naturally stable
         });
 
-    INDEX_TYPE even_phase_cnt = ((num_sect / 2) * 2);
-    INDEX_TYPE odd_phase_cnt = (((num_sect - 1) / 2) * 2);
-    for (INDEX_TYPE idx = 0; idx < (num_sect + 1) / 2; idx++) {
-        dispatch_apply(even_phase_cnt, q, ^(size_t sect) { // merge even
-                size_t right = sect & (size_t)0x1;
-                VALUE_TYPE *left_base = listp + sect * sz - (right ? sz : 0);
-                VALUE_TYPE *right_base = listp + sect * sz + (right ? 0 : sz);
-                INDEX_TYPE sect2_len = (sect + 1 + (right ? 0 : 1) == num_sect) ? last_sect_len : sz;
-                __CFSortIndexesNMerge(left_base, sz, right_base, sect2_len, tmps[sect], right, cmp);
+    VALUE_TYPE *src = listp, *dst = tmp;
+    for (INDEX_TYPE width = 1; width < num_sect; width *= 2) {
+        INDEX_TYPE num_merges = num_sect / (2 * width);
+        INDEX_TYPE num_parts = (ncores + num_merges - 1) / num_merges;
+        VALUE_TYPE *from = src, *to = dst;
+        __CFSortApply(num_merges * num_parts, ^(size_t task) {
+                INDEX_TYPE merge = task / num_parts, part = task % num_parts;
+                INDEX_TYPE lo = count * (merge * 2 * width) / num_sect;
+                INDEX_TYPE mid = count * (merge * 2 * width + width) / num_sect;
+                INDEX_TYPE hi = count * (merge * 2 * width + 2 * width) / num_sect;
+                INDEX_TYPE cnt1 = mid - lo, cnt2 = hi - mid;
+                INDEX_TYPE out_lo = (cnt1 + cnt2) * part / num_parts, out_hi = (cnt1 + cnt2) * (part + 1) / num_parts;
+                INDEX_TYPE split_lo = __CFSortIndexesNSplit(from + lo, cnt1, from + mid, cnt2, out_lo, cmp);
+                INDEX_TYPE split_hi = __CFSortIndexesNSplit(from + lo, cnt1, from + mid, cnt2, out_hi, cmp);
+                __CFSortIndexesNMerge(from + lo + split_lo, split_hi - split_lo, from + mid + (out_lo - split_lo), (out_hi - split_hi) - (out_lo - split_lo), to + lo + out_lo, cmp);
             });
-        if (num_sect & 0x1) {
-            memmove(tmps[num_sect - 1], listp + (num_sect - 1) * sz, last_sect_len * sizeof(VALUE_TYPE));
-        }
-        dispatch_apply(odd_phase_cnt, q, ^(size_t sect) { // merge odd
-                size_t right = sect & (size_t)0x1;
-                VALUE_TYPE *left_base = tmps[sect + (right ? 0 : 1)];
-                VALUE_TYPE *right_base = tmps[sect + (right ? 1 : 2)];
-                INDEX_TYPE sect2_len = (sect + 1 + (right ? 1 : 2) == num_sect) ? last_sect_len : sz;
-                __CFSortIndexesNMerge(left_base, sz, right_base, sect2_len, listp + sect * sz + sz, right, cmp);
+        src = to;
+        dst = from;
+    }
+    if (src != listp) {
+        INDEX_TYPE chunk = (count + ncores - 1) / ncores;
+        __CFSortApply(ncores, ^(size_t n) {
+                INDEX_TYPE lo = __CFMin(n * chunk, count), hi = __CFMin(lo + chunk, count);
+                memmove(listp + lo, src + lo, (hi - lo) * sizeof(VALUE_TYPE));
             });
-        memmove(listp + 0 * sz, tmps[0], sz * sizeof(VALUE_TYPE));
-        if (!(num_sect & 0x1)) {
-            memmove(listp + (num_sect - 1) * sz, tmps[num_sect - 1], last_sect_len * sizeof(VALUE_TYPE));
-        }
     }
+    free(tmp);
+    return true;
+}
 
-    for (INDEX_TYPE idx = 0; idx < num_sect; idx++) {
-        free(stack_tmps[idx]);
-    }
+static void __CFSortHandleOutOfMemory(size_t numBytes) {
+    CFLog(kCFLogLevelCritical, CFSTR("Attempt to allocate %lu bytes for sorting failed"), (unsigned long)numBytes);
+    HALT;
 }
-#endif
 
 // fills an array of indexes (of length count) giving the indexes 0 - count-1, as sorted by the comparator block
 void CFSortIndexes(CFIndex *indexBuffer, CFIndex count, CFOptionFlags opts, CFComparisonResult (^cmp)(CFIndex, CFIndex)) {
@@ -271,48 +336,53 @@ void CFSortIndexes(CFIndex *indexBuffer, CFIndex count, CFOptionFlags opts, CFCo
             ncores = 16;
         }
     }
-#if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED || DEPLOYMENT_TARGET_WINDOWS
     if (count <= 65536) {
         for (CFIndex idx = 0; idx < count; idx++) indexBuffer[idx] = idx;
     } else {
         /* Specifically hard-coded to 8; the count has to be very large before more chunks and/or cores is worthwhile. */
         CFIndex sz = ((((size_t)count + 15) / 16) * 16) / 8;
-        dispatch_apply(8, __CFDispatchQueueGetGenericMatchingCurrent(), ^(size_t n) {
+        __CFSortApply(8, ^(size_t n) {
                 CFIndex idx = n * sz, lim = __CFMin(idx + sz, count);
                 for (; idx < lim; idx++) indexBuffer[idx] = idx;
             });
     }
-#else
-    for (CFIndex idx = 0; idx < count; idx++) indexBuffer[idx] = idx;
-#endif
-#if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED || DEPLOYMENT_TARGET_WINDOWS
-    if (opts & kCFSortConcurrent) {
-        __CFSortIndexesN(indexBuffer, count, ncores, cmp); // naturally stable
+    if ((opts & kCFSortConcurrent) && __CFSortIndexesN(indexBuffer, count, ncores, cmp)) { // naturally stable
         return;
     }
-#endif
     STACK_BUFFER_DECL(VALUE_TYPE, local, count <= 4096 ? count : 1);
     VALUE_TYPE *tmp = (count <= 4096) ? local : (VALUE_TYPE *)malloc(count * sizeof(VALUE_TYPE));
+    if (!tmp) __CFSortHandleOutOfMemory(count * sizeof(VALUE_TYPE));
     __CFSimpleMergeSort(indexBuffer, count, tmp, cmp); // naturally stable
     if (local != tmp) free(tmp);
 }
 
-/* Comparator is passed the address of the values. */
-void CFQSortArray(void *list, CFIndex count, CFIndex elementSize, CFComparatorFunction comparator, void *context) {
+static void __CFSortArray(void *list, CFIndex count, CFIndex elementSize, CFComparatorFunction comparator, void *context, CFOptionFlags opts) {
     if (count < 2 || elementSize < 1) return;
     STACK_BUFFER_DECL(CFIndex, locali, count <= 4096 ? count : 1);
     CFIndex *indexes = (count <= 4096) ? locali : (CFIndex *)malloc(count * sizeof(CFIndex));
-    CFSortIndexes(indexes, count, 0, ^(CFIndex a, CFIndex b) { return comparator((char *)list + a * elementSize, (char *)list + b * elementSize, context); });
+    if (!indexes) __CFSortHandleOutOfMemory(count * sizeof(CFIndex));
+    CFSortIndexes(indexes, count, opts, ^(CFIndex a, CFIndex b) { return comparator((char *)list + a * elementSize, (char *)list + b * elementSize, context); });
     STACK_BUFFER_DECL(uint8_t, locals, count <= (16 * 1024 / elementSize) ? count * elementSize : 1);
     void *store = (count <= (16 * 1024 / elementSize)) ? locals : malloc(count * elementSize);
-    for (CFIndex idx = 0; idx < count; idx++) {
-        if (sizeof(uintptr_t) == elementSize) {
-            uintptr_t *a = (uintptr_t *)list + indexes[idx];
-            uintptr_t *b = (uintptr_t *)store + idx;
-            *b = *a;
-        } else {
-            memmove((char *)store + idx * elementSize, (char *)list + indexes[idx] * elementSize, elementSize);
+    if (!store) __CFSortHandleOutOfMemory(count * elementSize);
+    void (^gather)(size_t) = ^(size_t n) {
+        CFIndex idx = n * 65536, lim = __CFMin(idx + 65536, count);
+        for (; idx < lim; idx++) {
+            if (sizeof(uintptr_t) == elementSize) {
+                uintptr_t *a = (uintptr_t *)list + indexes[idx];
+                uintptr_t *b = (uintptr_t *)store + idx;
+                *b = *a;
+            } else {
+                memmove((char *)store + idx * elementSize, (char *)list + indexes[idx] * elementSize, elementSize);
+            }
         }
+    };
+    // the gather reads the list in sorted order, which is random order, so large ones are spread over the cores too
+    size_t chunks = (count + 65535) / 65536;
+    if (1 < chunks) {
+        __CFSortApply(chunks, gather);
+    } else {
+        gather(0);
     }
     // no swapping or modification of the original list has occurred until this point
     objc_memmove_collectable(list, store, count * elementSize);
@@ -321,26 +391,19 @@ void CFQSortArray(void *list, CFIndex count, CFIndex elementSize, CFComparatorFu
 }
 
 /* Comparator is passed the address of the values. */
-void CFMergeSortArray(void *list, CFIndex count, CFIndex elementSize, CFComparatorFunction comparator, void *context) {
-    if (count < 2 || elementSize < 1) return;
-    STACK_BUFFER_DECL(CFIndex, locali, count <= 4096 ? count : 1);
-    CFIndex *indexes = (count <= 4096) ? locali : (CFIndex *)malloc(count * sizeof(CFIndex));
-    CFSortIndexes(indexes, count, kCFSortStable, ^(CFIndex a, CFIndex b) { return comparator((char *)list + a * elementSize, (char *)list + b * elementSize, context); });
-    STACK_BUFFER_DECL(uint8_t, locals, count <= (16 * 1024 / elementSize) ? count * elementSize : 1);
-    void *store = (count <= (16 * 1024 / elementSize)) ? locals : malloc(count * elementSize);
-    for (CFIndex idx = 0; idx < count; idx++) {
-        if (sizeof(uintptr_t) == elementSize) {
-            uintptr_t *a = (uintptr_t *)list + indexes[idx];
-            uintptr_t *b = (uintptr_t *)store + idx;
-            *b = *a;
-        } else {
-            memmove((char *)store + idx * elementSize, (char *)list + indexes[idx] * elementSize, elementSize);
-        }
-    }
-    // no swapping or modification of the original list has occurred until this point
-    objc_memmove_collectable(list, store, count * elementSize);
-    if (locals != store) free(store);
-    if (locali != indexes) free(indexes);
+void CFQSortArray(void *list, CFIndex count, CFIndex elementSize, CFComparatorFunction comparator, void *context) {
+    __CFSortArray(list, count, elementSize, comparator, context, 0);
 }
 
+// Arrays at least this long are sorted on several threads, so the comparator must be safe to call concurrently.
+#define __CFSortArrayConcurrentThreshold 65536
 
+/* Comparator is passed the address of the values. For CFArraySortValues(), whose documentation allows concurrent comparator calls. */
+CF_PRIVATE void __CFQSortArrayConcurrently(void *list, CFIndex count, CFIndex elementSize, CFComparatorFunction comparator, void *context) {
+    __CFSortArray(list, count, elementSize, comparator, context, (__CFSortArrayConcurrentThreshold <= count) ? kCFSortConcurrent : 0);
+}
+
+/* Comparator is passed the address of the values. */
+void CFMergeSortArray(void *list, CFIndex count, CFIndex elementSize, CFComparatorFunction comparator, void *context) {
+    __CFSortArray(list, count, elementSize, comparator, context, kCFSortStable);
+}
@@ -48,6 +48,9 @@
 #if DEPLOYMENT_TARGET_MACOSX || DEPLOYMENT_TARGET_EMBEDDED || DEPLOYMENT_TARGET_LINUX || DEPLOYMENT_TARGET_FREEBSD
 #include <unistd.h>
 #endif
+#if CF_VECTOR_X86
+#include <immintrin.h>
+#endif
 
 #if defined(__GNUC__)
 #define LONG_DOUBLE_SUPPORT 1
@@ -109,6 +112,8 @@ typedef Boolean (*UNI_CHAR_FUNC)(UInt32 flags, UInt8 ch, UniChar *unicodeChar);
 extern size_t malloc_good_size(size_t size);
 #endif
 extern void __CFStrConvertBytesToUnicode(const uint8_t *bytes, UniChar *buffer, CFIndex numChars);
+extern CFIndex __CFStrUniCharsASCIILength(const UniChar *chars, CFIndex numChars);
+extern void __CFStrNarrowToEightBit(const UniChar *chars, uint8_t *bytes, CFIndex numChars);
 
 static void __CFStringAppendFormatCore(CFMutableStringRef outputString, CFStringRef (*copyDescFunc)(void *, const void *), CFStringRef (*contextDescFunc)(void *, const void *, const void *, bool, bool *), CFDictionaryRef formatOptions, CFDictionaryRef stringsDictConfig, CFStringRef formatString, CFIndex initialArgPosition, const void *origValues, CFIndex originalValuesSize, va_list args);
 
@@ -539,6 +544,22 @@ CFStringEncoding __CFStringComputeEightBitStringEncoding(void) {
 /* Returns whether the provided bytes can be stored in ASCII
 */
 CF_INLINE Boolean __CFBytesInASCII(const uint8_t *bytes, CFIndex len) {
+#if CF_VECTOR_X86
+    /* Go by 64s and 16s with SSE2 first */
+    while (len >= 64) {
+        __m128i val = _mm_or_si128(_mm_loadu_si128((const __m128i *)bytes), _mm_loadu_si128((const __m128i *)(bytes + 16)));
+        val = _mm_or_si128(val, _mm_or_si128(_mm_loadu_si128((const __m128i *)(bytes + 32)), _mm_loadu_si128((const __m128i *)(bytes + 48))));
+        if (_mm_movemask_epi8(val)) return false;
+        bytes += 64;
+        len -= 64;
+    }
+
+    while (len >= 16) {
+        if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)bytes))) return false;
+        bytes += 16;
+        len -= 16;
+    }
+#endif
 #if __LP64__
     /* A bit of unrolling; go by 32s, 16s, and 8s first */
     while (len >= 32) {
@@ -1046,6 +1067,62 @@ Hash function was changed between Panther and Tiger, and Tiger and Leopard.
 #define HashNextUniChar(accessStart, accessEnd, pointer) \
     {result = result * 257 + (accessStart 0 accessEnd); pointer++;}
 
+#if CF_VECTOR_X86 && __LP64__
+/* The AVX2 versions of the loops below hash 32 characters at a time. Each HashNextFourUniChars step adds the four products as 32-bit ints, which can wrap, so the vector code does the same: the products are taken in 32-bit lanes and sign-extended before the four of each group are summed. The eight group sums are then multiplied by the powers of 67503105 that the scalar loop would have applied, modulo 2^64, so the results are bit-identical. SSE2 has no 32-bit multiply to match, so without AVX2 the scalar loops are used.
+*/
+#define HashM1 67503105ULL
+#define HashM2 (HashM1 * HashM1)
+#define HashM4 (HashM2 * HashM2)
+#define HashPowM(g) (((g) & 1 ? HashM1 : 1ULL) * ((g) & 2 ? HashM2 : 1ULL) * ((g) & 4 ? HashM4 : 1ULL) * ((g) & 8 ? HashM4 * HashM4 : 1ULL))
+
+// Low 64 bits of the products of the 64-bit lanes of a and b
+CF_TARGET_AVX2 static inline __m256i __CFStrHashMultiply64(__m256i a, __m256i b) {
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+}
+
+// Returns the sums of the two groups of four characters in chars, which holds 8 characters zero-extended to 32 bits
+CF_TARGET_AVX2 static inline __m128i __CFStrHashSumGroups(__m256i chars) {
+    __m256i products = _mm256_mullo_epi32(chars, _mm256_setr_epi32(16974593, 66049, 257, 1, 16974593, 66049, 257, 1));
+    __m256i first = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(products));
+    __m256i second = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(products, 1));
+    __m256i pairs = _mm256_add_epi64(_mm256_unpacklo_epi64(first, second), _mm256_unpackhi_epi64(first, second));
+    return _mm_add_epi64(_mm256_castsi256_si128(pairs), _mm256_extracti128_si256(pairs, 1));
+}
+
+CF_TARGET_AVX2 static CFHashCode __CFStrHashThirtyTwo(CFHashCode result, __m256i chars0, __m256i chars1, __m256i chars2, __m256i chars3) {
+    __m256i groups0 = _mm256_inserti128_si256(_mm256_castsi128_si256(__CFStrHashSumGroups(chars0)), __CFStrHashSumGroups(chars1), 1);
+    __m256i groups1 = _mm256_inserti128_si256(_mm256_castsi128_si256(__CFStrHashSumGroups(chars2)), __CFStrHashSumGroups(chars3), 1);
+    __m256i sums = _mm256_add_epi64(__CFStrHashMultiply64(groups0, _mm256_setr_epi64x(HashPowM(7), HashPowM(6), HashPowM(5), HashPowM(4))), __CFStrHashMultiply64(groups1, _mm256_setr_epi64x(HashPowM(3), HashPowM(2), HashPowM(1), 1)));
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    return result * HashPowM(8) + (CFHashCode)_mm_cvtsi128_si64(sum) + (CFHashCode)_mm_cvtsi128_si64(_mm_unpackhi_epi64(sum, sum));
+}
+
+CF_TARGET_AVX2 static CFHashCode __CFStrHashThirtyTwoUniChars(CFHashCode result, const UniChar *chars) {
+    return __CFStrHashThirtyTwo(result, _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)chars)), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(chars + 8))), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(chars + 16))), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(chars + 24))));
+}
+
+// Bytes are taken as UniChars with the same value; callers map high bytes themselves when they need to.
+CF_TARGET_AVX2 static CFHashCode __CFStrHashThirtyTwoBytes(CFHashCode result, const uint8_t *bytes) {
+    return __CFStrHashThirtyTwo(result, _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)bytes)), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(bytes + 8))), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(bytes + 16))), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(bytes + 24))));
+}
+
+#define HashNextThirtyTwoUniChars(pointer) \
+    {result = __CFStrHashThirtyTwoUniChars(result, pointer); pointer += 32;}
+
+#define HashNextThirtyTwoBytes(pointer) \
+    {result = __CFStrHashThirtyTwoBytes(result, pointer); pointer += 32;}
+
+// Eight-bit strings can use the bytes directly unless there are high bytes, and the table maps them to something else
+#define HashNextThirtyTwoEightBitChars(pointer) \
+    if (!__CFCharToUniCharFunc || __CFBytesInASCII(pointer, 32)) HashNextThirtyTwoBytes(pointer) \
+    else {const uint8_t *end32 = pointer + 32; while (pointer < end32) HashNextFourUniChars(__CFCharToUniCharTable[pointer[, ]], pointer);}
+
+#define __CF_HASH_THIRTY_TWO 1
+#else
+#define __CF_HASH_THIRTY_TWO 0
+#endif
+
 
 /* In this function, actualLen is the length of the original string; but len is the number of characters in buffer. The buffer is expected to contain the parts of the string relevant to hashing.
 */
@@ -1054,9 +1131,26 @@ CF_INLINE CFHashCode __CFStrHashCharacters(const UniChar *uContents, CFIndex len
     if (len <= HashEverythingLimit) {
         const UniChar *end4 = uContents + (len & ~3);
         const UniChar *end = uContents + len;
+#if __CF_HASH_THIRTY_TWO
+        if (__CFHaveAVX2()) {
+            const UniChar *end32 = uContents + (len & ~31);
+            while (uContents < end32) {HashNextThirtyTwoUniChars(uContents);}	// Count in 32s while we can
+        }
+#endif
         while (uContents < end4) HashNextFourUniChars(uContents[, ], uContents); 	// First count in fours
         while (uContents < end) HashNextUniChar(uContents[, ], uContents);		// Then for the last <4 chars, count in ones...
     } else {
+#if __CF_HASH_THIRTY_TWO
+        if (__CFHaveAVX2()) {
+            const UniChar *contents = uContents;
+            HashNextThirtyTwoUniChars(contents);
+            contents = uContents + (len >> 1) - 16;
+            HashNextThirtyTwoUniChars(contents);
+            contents = uContents + len - 32;
+            HashNextThirtyTwoUniChars(contents);
+            return result + (result << (actualLen & 31));
+        }
+#endif
         const UniChar *contents, *end;
 	contents = uContents;
         end = contents + 32;
@@ -1095,9 +1189,26 @@ CF_INLINE CFHashCode __CFStrHashEightBit(const uint8_t *cContents, CFIndex len)
     if (len <= HashEverythingLimit) {
         const uint8_t *end4 = cContents + (len & ~3);
         const uint8_t *end = cContents + len;
+#if __CF_HASH_THIRTY_TWO
+        if (__CFHaveAVX2()) {
+            const uint8_t *end32 = cContents + (len & ~31);
+            while (cContents < end32) {HashNextThirtyTwoEightBitChars(cContents);}	// Count in 32s while we can
+        }
+#endif
         while (cContents < end4) HashNextFourUniChars(__CFCharToUniCharTable[cContents[, ]], cContents); 	// First count in fours
         while (cContents < end) HashNextUniChar(__CFCharToUniCharTable[cContents[, ]], cContents);		// Then for the last <4 chars, count in ones...
     } else {
+#if __CF_HASH_THIRTY_TWO
+        if (__CFHaveAVX2()) {
+            const uint8_t *contents = cContents;
+            HashNextThirtyTwoEightBitChars(contents);
+            contents = cContents + (len >> 1) - 16;
+            HashNextThirtyTwoEightBitChars(contents);
+            contents = cContents + len - 32;
+            HashNextThirtyTwoEightBitChars(contents);
+            return result + (result << (len & 31));
+        }
+#endif
 	const uint8_t *contents, *end;
 	contents = cContents;
         end = contents + 32;
@@ -1122,9 +1233,26 @@ CFHashCode CFStringHashISOLatin1CString(const uint8_t *bytes, CFIndex len) {
     if (len <= HashEverythingLimit) {
         const uint8_t *end4 = bytes + (len & ~3);
         const uint8_t *end = bytes + len;
+#if __CF_HASH_THIRTY_TWO
+        if (__CFHaveAVX2()) {
+            const uint8_t *end32 = bytes + (len & ~31);
+            while (bytes < end32) {HashNextThirtyTwoBytes(bytes);}	// Count in 32s while we can
+        }
+#endif
         while (bytes < end4) HashNextFourUniChars(bytes[, ], bytes); 	// First count in fours
         while (bytes < end) HashNextUniChar(bytes[, ], bytes);		// Then for the last <4 chars, count in ones...
     } else {
+#if __CF_HASH_THIRTY_TWO
+        if (__CFHaveAVX2()) {
+            const uint8_t *contents = bytes;
+            HashNextThirtyTwoBytes(contents);
+            contents = bytes + (len >> 1) - 16;
+            HashNextThirtyTwoBytes(contents);
+            contents = bytes + len - 32;
+            HashNextThirtyTwoBytes(contents);
+            return result + (result << (len & 31));
+        }
+#endif
         const uint8_t *contents, *end;
 	contents = bytes;
         end = contents + 32;
@@ -1351,14 +1479,8 @@ CF_PRIVATE CFStringRef __CFStringCreateImmutableFunnel3(
 	// At this point, all necessary input arguments have been changed to reflect the new state
 
     } else if (encoding == kCFStringEncodingUnicode && tryToReduceUnicode) {	// Check to see if we can reduce Unicode to ASCII
-        CFIndex cnt;
         CFIndex len = numBytes / sizeof(UniChar);
-        Boolean allASCII = true;
-
-        for (cnt = 0; cnt < len; cnt++) if (((const UniChar *)bytes)[cnt] > 127) {
-            allASCII = false;
-            break;
-        }
+        Boolean allASCII = (__CFStrUniCharsASCIILength((const UniChar *)bytes, len) == len);
 
         if (allASCII) {	// Yes we can!
             uint8_t *ptr, *mem;
@@ -1376,7 +1498,7 @@ CF_PRIVATE CFStringRef __CFStringCreateImmutableFunnel3(
 		hasLengthByte = newHasLengthByte;
 		hasNullByte = true;
 		if (hasLengthByte) *ptr++ = (uint8_t)len;
-		for (cnt = 0; cnt < len; cnt++) ptr[cnt] = (uint8_t)(((const UniChar *)bytes)[cnt]);
+		__CFStrNarrowToEightBit((const UniChar *)bytes, ptr, len);
 		ptr[len] = 0;
 		if (noCopy && (contentsDeallocator != kCFAllocatorNull)) {
 		    CFAllocatorDeallocate(contentsDeallocator, (void *)bytes);
@@ -34,6 +34,9 @@
 #include <CoreFoundation/CFStringEncodingConverterExt.h>
 #include <CoreFoundation/CFUniChar.h>
 #include <CoreFoundation/CFUnicodeDecomposition.h>
+#if CF_VECTOR_X86
+#include <immintrin.h>
+#endif
 #if (TARGET_OS_MAC && !(TARGET_OS_EMBEDDED || TARGET_OS_IPHONE)) || (TARGET_OS_EMBEDDED || TARGET_OS_IPHONE)
 #include <stdlib.h>
 #include <fcntl.h>
@@ -91,9 +94,110 @@ CF_PRIVATE void __CFSetCharToUniCharFunc(Boolean (*func)(UInt32 flags, UInt8 ch,
     }
 }
 
-CF_PRIVATE void __CFStrConvertBytesToUnicode(const uint8_t *bytes, UniChar *buffer, CFIndex numChars) {
+#if CF_VECTOR_X86
+/* The AVX2 versions below do as much of the work as goes evenly into 32 bytes (or 16 UniChars) and return how much that was; the SSE2 versions, and then the scalar code, finish up.
+*/
+CF_TARGET_AVX2 static CFIndex __CFStrWidenLatin1AVX2(const uint8_t *bytes, UniChar *chars, CFIndex numChars) {
+    CFIndex idx;
+    for (idx = 0; idx + 32 <= numChars; idx += 32) {
+        __m256i lo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(bytes + idx)));
+        __m256i hi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(bytes + idx + 16)));
+        _mm256_storeu_si256((__m256i *)(chars + idx), lo);
+        _mm256_storeu_si256((__m256i *)(chars + idx + 16), hi);
+    }
+    return idx;
+}
+
+CF_TARGET_AVX2 static CFIndex __CFStrConvertBytesToUnicodeAVX2(const uint8_t *bytes, UniChar *buffer, CFIndex numChars) {
     CFIndex idx;
-    for (idx = 0; idx < numChars; idx++) buffer[idx] = __CFCharToUniCharTable[bytes[idx]];
+    for (idx = 0; idx + 32 <= numChars; idx += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(bytes + idx));
+        if (_mm256_movemask_epi8(v)) {	// High bytes go through the table
+            for (CFIndex cnt = idx; cnt < idx + 32; cnt++) buffer[cnt] = __CFCharToUniCharTable[bytes[cnt]];
+        } else {
+            _mm256_storeu_si256((__m256i *)(buffer + idx), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+            _mm256_storeu_si256((__m256i *)(buffer + idx + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+        }
+    }
+    return idx;
+}
+
+CF_TARGET_AVX2 static CFIndex __CFStrUniCharsASCIILengthAVX2(const UniChar *chars, CFIndex numChars) {
+    const __m256i mask = _mm256_set1_epi16((short)0xFF80);
+    CFIndex idx;
+    for (idx = 0; idx + 32 <= numChars; idx += 32) {
+        __m256i v = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(chars + idx)), _mm256_loadu_si256((const __m256i *)(chars + idx + 16)));
+        if (!_mm256_testz_si256(v, mask)) break;
+    }
+    return idx;
+}
+#endif
+
+/* Converts ISO Latin 1 (or ASCII) bytes to UniChars, which is just widening.
+*/
+CF_PRIVATE void __CFStrWidenLatin1(const uint8_t *bytes, UniChar *chars, CFIndex numChars) {
+    CFIndex idx = 0;
+#if CF_VECTOR_X86
+    if (__CFHaveAVX2()) idx = __CFStrWidenLatin1AVX2(bytes, chars, numChars);
+    for (; idx + 16 <= numChars; idx += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bytes + idx));
+        _mm_storeu_si128((__m128i *)(chars + idx), _mm_unpacklo_epi8(v, _mm_setzero_si128()));
+        _mm_storeu_si128((__m128i *)(chars + idx + 8), _mm_unpackhi_epi8(v, _mm_setzero_si128()));
+    }
+#endif
+    for (; idx < numChars; idx++) chars[idx] = (UniChar)bytes[idx];
+}
+
+CF_PRIVATE void __CFStrConvertBytesToUnicode(const uint8_t *bytes, UniChar *buffer, CFIndex numChars) {
+    CFIndex idx = 0;
+    // With no __CFCharToUniCharFunc the table maps every byte to itself
+    if (!__CFCharToUniCharFunc) {
+        __CFStrWidenLatin1(bytes, buffer, numChars);
+        return;
+    }
+#if CF_VECTOR_X86
+    if (__CFHaveAVX2()) idx = __CFStrConvertBytesToUnicodeAVX2(bytes, buffer, numChars);
+    for (; idx + 16 <= numChars; idx += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(bytes + idx));
+        if (_mm_movemask_epi8(v)) {	// High bytes go through the table
+            for (CFIndex cnt = idx; cnt < idx + 16; cnt++) buffer[cnt] = __CFCharToUniCharTable[bytes[cnt]];
+        } else {
+            _mm_storeu_si128((__m128i *)(buffer + idx), _mm_unpacklo_epi8(v, _mm_setzero_si128()));
+            _mm_storeu_si128((__m128i *)(buffer + idx + 8), _mm_unpackhi_epi8(v, _mm_setzero_si128()));
+        }
+    }
+#endif
+    for (; idx < numChars; idx++) buffer[idx] = __CFCharToUniCharTable[bytes[idx]];
+}
+
+/* Returns the number of UniChars at the start of chars which are ASCII.
+*/
+CF_PRIVATE CFIndex __CFStrUniCharsASCIILength(const UniChar *chars, CFIndex numChars) {
+    CFIndex idx = 0;
+#if CF_VECTOR_X86
+    if (__CFHaveAVX2()) idx = __CFStrUniCharsASCIILengthAVX2(chars, numChars);
+    const __m128i mask = _mm_set1_epi16((short)0xFF80);
+    for (; idx + 8 <= numChars; idx += 8) {
+        __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i *)(chars + idx)), mask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(v, _mm_setzero_si128())) != 0xFFFF) break;
+    }
+#endif
+    while (idx < numChars && chars[idx] < 0x80) idx++;
+    return idx;
+}
+
+/* Converts UniChars to bytes by dropping the high byte, which must be zero.
+*/
+CF_PRIVATE void __CFStrNarrowToEightBit(const UniChar *chars, uint8_t *bytes, CFIndex numChars) {
+    CFIndex idx = 0;
+#if CF_VECTOR_X86
+    for (; idx + 16 <= numChars; idx += 16) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(chars + idx));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(chars + idx + 8));
+        _mm_storeu_si128((__m128i *)(bytes + idx), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; idx < numChars; idx++) bytes[idx] = (uint8_t)chars[idx];
 }
 
 
@@ -174,6 +278,7 @@ Boolean __CFStringDecodeByteStream3(const uint8_t *bytes, CFIndex len, CFStringE
                 const UTF16Char *characters = src;
                 UTF16Char mask = (swap ? 0x80FF : 0xFF80);
     
+                if (!swap) characters += __CFStrUniCharsASCIILength(characters, limit - characters);
                 while (characters < limit) {
                     if (*(characters++) & mask) {
                         buffer->isASCII = false;
@@ -198,7 +303,7 @@ Boolean __CFStringDecodeByteStream3(const uint8_t *bytes, CFIndex len, CFStringE
                 if (swap) {
                     while (src < limit) *(dst++) = (*(src++) >> 8);
                 } else {
-                    while (src < limit) *(dst++) = (uint8_t)*(src++);
+                    __CFStrNarrowToEightBit(src, dst, limit - src);
                 }
             } else {
                 UTF16Char *dst;
@@ -442,7 +547,7 @@ Boolean __CFStringDecodeByteStream3(const uint8_t *bytes, CFIndex len, CFStringE
 		if (!buffer->chars.unicode) goto memoryErrorExit;
                 buffer->numChars = len;
                 if (kCFStringEncodingASCII == encoding || kCFStringEncodingISOLatin1 == encoding) {
-                    for (idx = 0; idx < len; idx++) buffer->chars.unicode[idx] = (UniChar)chars[idx];
+                    __CFStrWidenLatin1(chars, buffer->chars.unicode, len);
                 } else {
                     for (idx = 0; idx < len; idx++) {
                         if (chars[idx] < 0x80 && isASCIISuperset) {
@@ -75,6 +75,7 @@
 #include <string.h>
 #include <pthread.h>
 #include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 /* Comparator is passed the address of the values. */
@@ -404,6 +405,9 @@ CF_PRIVATE CFIndex __CFActiveProcessorCount() {
     if (result != 0) {
         pcnt = 0;
     }
+#elif DEPLOYMENT_TARGET_LINUX
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    pcnt = (0 < online) ? (int32_t)online : 1;
 #else
     // Assume the worst
     pcnt = 1;
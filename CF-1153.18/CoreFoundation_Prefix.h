@@ -186,6 +186,14 @@ void OSMemoryBarrier();
 CF_INLINE size_t malloc_size(void *memblock) {
     return malloc_usable_size(memblock);
 }
+
+#include <time.h>
+// The TSR on Linux is CLOCK_MONOTONIC in nanoseconds, which is also the clock of the run loop's timerfds
+CF_INLINE uint64_t mach_absolute_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
     
 // substitute for dispatch_once
 typedef pthread_once_t dispatch_once_t;
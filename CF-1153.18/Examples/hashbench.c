@@ -0,0 +1,203 @@
+// Linux: make -f MakefileLinux hashbench && CF-Objects/normal/hashbench
+// Mac OS X: clang -O2 -F<path-to-CFLite-framework> -framework CoreFoundation Examples/hashbench.c -o hashbench
+
+/*
+ This example compares the default linear probing of CFDictionary and CFSet with grouped probing, which is turned on per collection with _CFDictionarySetGroupedHashing and _CFSetSetGroupedHashing. For each size it times:
+    insert - adding every key to an empty collection, including the growth of the table
+    hit    - CFDictionaryGetValue or CFSetContainsValue for every key, in a random order
+    miss   - the same for keys which are not in the collection
+    remove - removing every key, in a random order
+ Pointer keys use NULL callbacks, so the time is all probing; string keys use the CFType callbacks, so each probe also hashes and compares CFStrings. String keys stop at a million entries to keep the memory use down. Each collection is checked against its keys before it is timed, and the best of the runs is reported, in nanoseconds per key.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// _CFDictionarySetGroupedHashing and _CFSetSetGroupedHashing are only declared in ForFoundationOnly.h
+#define NSBUILDINGFOUNDATION 1
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <CoreFoundation/ForFoundationOnly.h>
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    CFIndex count;
+    Boolean strings;
+    const void **keys;		// in insertion order
+    const void **shuffled;	// the same keys, in a random order
+    const void **missing;	// keys which are never inserted
+} Keys;
+
+static volatile uintptr_t sink;
+
+static const void *makeKey(Boolean strings, CFIndex i) {
+    if (!strings) return (const void *)(uintptr_t)((i + 1) * 16);
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "key-%ld", (long)i);
+    return CFStringCreateWithCString(kCFAllocatorSystemDefault, buffer, kCFStringEncodingASCII);
+}
+
+static void shuffle(const void **keys, CFIndex count) {
+    for (CFIndex i = count - 1; 0 < i; i--) {
+        CFIndex j = random() % (i + 1);
+        const void *tmp = keys[i];
+        keys[i] = keys[j];
+        keys[j] = tmp;
+    }
+}
+
+static void createKeys(Keys *keys, CFIndex count, Boolean strings) {
+    keys->count = count;
+    keys->strings = strings;
+    keys->keys = malloc(count * sizeof(void *));
+    keys->shuffled = malloc(count * sizeof(void *));
+    keys->missing = malloc(count * sizeof(void *));
+    for (CFIndex i = 0; i < count; i++) {
+        keys->keys[i] = keys->shuffled[i] = makeKey(strings, i);
+        keys->missing[i] = makeKey(strings, count + i);
+    }
+    shuffle(keys->shuffled, count);
+    shuffle(keys->missing, count);
+}
+
+static void destroyKeys(Keys *keys) {
+    if (keys->strings) {
+        for (CFIndex i = 0; i < keys->count; i++) {
+            CFRelease(keys->keys[i]);
+            CFRelease(keys->missing[i]);
+        }
+    }
+    free(keys->keys);
+    free(keys->shuffled);
+    free(keys->missing);
+}
+
+static CFMutableDictionaryRef createDictionary(Keys *keys, Boolean grouped) {
+    CFMutableDictionaryRef dict = CFDictionaryCreateMutable(kCFAllocatorSystemDefault, 0, keys->strings ? &kCFTypeDictionaryKeyCallBacks : NULL, NULL);
+    _CFDictionarySetGroupedHashing(dict, grouped);
+    return dict;
+}
+
+static CFMutableSetRef createSet(Keys *keys, Boolean grouped) {
+    CFMutableSetRef set = CFSetCreateMutable(kCFAllocatorSystemDefault, 0, keys->strings ? &kCFTypeSetCallBacks : NULL);
+    _CFSetSetGroupedHashing(set, grouped);
+    return set;
+}
+
+static Boolean checkDictionary(CFDictionaryRef dict, Keys *keys) {
+    if (CFDictionaryGetCount(dict) != keys->count) return false;
+    for (CFIndex i = 0; i < keys->count; i++) {
+        if (CFDictionaryGetValue(dict, keys->keys[i]) != (const void *)(uintptr_t)(i + 1)) return false;
+        if (CFDictionaryContainsKey(dict, keys->missing[i])) return false;
+    }
+    return true;
+}
+
+static Boolean checkSet(CFSetRef set, Keys *keys) {
+    if (CFSetGetCount(set) != keys->count) return false;
+    for (CFIndex i = 0; i < keys->count; i++) {
+        if (CFSetGetValue(set, keys->keys[i]) != keys->keys[i]) return false;
+        if (CFSetContainsValue(set, keys->missing[i])) return false;
+    }
+    return true;
+}
+
+typedef struct {
+    double insert, hit, miss, remove;
+} Times;
+
+static void keepBest(Times *best, Times *times, int run) {
+    if (run == 0 || times->insert < best->insert) best->insert = times->insert;
+    if (run == 0 || times->hit < best->hit) best->hit = times->hit;
+    if (run == 0 || times->miss < best->miss) best->miss = times->miss;
+    if (run == 0 || times->remove < best->remove) best->remove = times->remove;
+}
+
+static Boolean timeDictionary(Keys *keys, Boolean grouped, int runs, Times *best) {
+    Boolean ok = true;
+    for (int run = 0; run < runs; run++) {
+        Times times;
+        CFIndex count = keys->count;
+        CFMutableDictionaryRef dict = createDictionary(keys, grouped);
+        double start = now();
+        for (CFIndex i = 0; i < count; i++) CFDictionaryAddValue(dict, keys->keys[i], (const void *)(uintptr_t)(i + 1));
+        times.insert = (now() - start) / count;
+        if (run == 0) ok = checkDictionary(dict, keys);
+        start = now();
+        for (CFIndex i = 0; i < count; i++) sink += (uintptr_t)CFDictionaryGetValue(dict, keys->shuffled[i]);
+        times.hit = (now() - start) / count;
+        start = now();
+        for (CFIndex i = 0; i < count; i++) sink += (uintptr_t)CFDictionaryGetValue(dict, keys->missing[i]);
+        times.miss = (now() - start) / count;
+        start = now();
+        for (CFIndex i = 0; i < count; i++) CFDictionaryRemoveValue(dict, keys->shuffled[i]);
+        times.remove = (now() - start) / count;
+        if (CFDictionaryGetCount(dict) != 0) ok = false;
+        CFRelease(dict);
+        keepBest(best, &times, run);
+    }
+    return ok;
+}
+
+static Boolean timeSet(Keys *keys, Boolean grouped, int runs, Times *best) {
+    Boolean ok = true;
+    for (int run = 0; run < runs; run++) {
+        Times times;
+        CFIndex count = keys->count;
+        CFMutableSetRef set = createSet(keys, grouped);
+        double start = now();
+        for (CFIndex i = 0; i < count; i++) CFSetAddValue(set, keys->keys[i]);
+        times.insert = (now() - start) / count;
+        if (run == 0) ok = checkSet(set, keys);
+        start = now();
+        for (CFIndex i = 0; i < count; i++) sink += CFSetContainsValue(set, keys->shuffled[i]);
+        times.hit = (now() - start) / count;
+        start = now();
+        for (CFIndex i = 0; i < count; i++) sink += CFSetContainsValue(set, keys->missing[i]);
+        times.miss = (now() - start) / count;
+        start = now();
+        for (CFIndex i = 0; i < count; i++) CFSetRemoveValue(set, keys->shuffled[i]);
+        times.remove = (now() - start) / count;
+        if (CFSetGetCount(set) != 0) ok = false;
+        CFRelease(set);
+        keepBest(best, &times, run);
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    CFIndex sizes[] = {1000, 10000, 100000, 1000000, 10000000};
+    srandom(1);
+    printf("%-10s %-7s %-8s %9s %9s %9s %9s %9s\n", "collection", "keys", "probing", "size", "insert", "hit", "miss", "remove");
+    for (int strings = 0; strings < 2; strings++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            if (strings && 1000000 < sizes[s]) continue;
+            Keys keys;
+            createKeys(&keys, sizes[s], strings);
+            // Keep the total work per row roughly constant, but always take at least a few runs.
+            int runs = sizes[s] < 1000000 ? (int)(2000000 / sizes[s]) : 3;
+            if (10 < runs) runs = 10;
+            for (int collection = 0; collection < 2; collection++) {
+                for (int grouped = 0; grouped < 2; grouped++) {
+                    Times best;
+                    Boolean correct = collection == 0 ? timeDictionary(&keys, grouped, runs, &best) : timeSet(&keys, grouped, runs, &best);
+                    if (!correct) {
+                        printf("%s with %s probing lost keys at size %ld\n", collection == 0 ? "dictionary" : "set", grouped ? "grouped" : "linear", (long)sizes[s]);
+                        ok = false;
+                    }
+                    printf("%-10s %-7s %-8s %9ld %9.1f %9.1f %9.1f %9.1f\n", collection == 0 ? "dictionary" : "set", strings ? "string" : "pointer", grouped ? "grouped" : "linear", (long)sizes[s], best.insert * 1e9, best.hit * 1e9, best.miss * 1e9, best.remove * 1e9);
+                }
+            }
+            destroyKeys(&keys);
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+// Linux: make -f MakefileLinux plindex && CF-Objects/normal/plindex
+// Mac OS X: clang -O2 -F<path-to-CFLite-framework> -framework CoreFoundation Examples/plindex.c -o plindex
+
+/*
+ This example writes binary property lists with the dictionary hash index that kCFBinaryPlistWriteDictionaryIndex adds, and checks that they read back the same. The property list is an array of dictionaries of 10, 32, 1000 and 100000 string keys, so that some dictionaries are indexed and some are too small to be. For each way of writing it:
+    - CFPropertyListCreateWithData reads it back, and CFEqual checks it against the original
+    - every key of every dictionary, and some keys that aren't there, are looked up through _CFBinaryPlistNodeGetValue and checked against the original
+    - the trailer is checked to point at an index only when the option was given
+ It then times random lookups in the largest dictionary with __CFBinaryPlistGetOffsetForValueFromDictionary3, with and without the index.
+*/
+
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// The binary property list writer options and reader functions are only declared in ForFoundationOnly.h
+#define NSBUILDINGFOUNDATION 1
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <CoreFoundation/CFPriv.h>
+#include <CoreFoundation/ForFoundationOnly.h>
+
+#define LOOKUPS 100000
+#define RUNS 5
+
+static const int sizes[] = {10, 32, 1000, 100000};
+#define DICTS (sizeof(sizes) / sizeof(sizes[0]))
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static CFStringRef createString(const char *format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    return CFStringCreateWithCString(kCFAllocatorSystemDefault, buf, kCFStringEncodingUTF8);
+}
+
+static CFPropertyListRef createDictionaries(void) {
+    CFMutableArrayRef array = CFArrayCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeArrayCallBacks);
+    for (int dictIdx = 0; dictIdx < (int)DICTS; dictIdx++) {
+        CFMutableDictionaryRef dict = CFDictionaryCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+        for (int idx = 0; idx < sizes[dictIdx]; idx++) {
+            CFStringRef key = createString("key %d", idx);
+            CFTypeRef value = (idx % 2) ? (CFTypeRef)createString("value %d of %d", idx, sizes[dictIdx]) : (CFTypeRef)CFNumberCreate(kCFAllocatorSystemDefault, kCFNumberIntType, &idx);
+            CFDictionarySetValue(dict, key, value);
+            CFRelease(key);
+            CFRelease(value);
+        }
+        CFArrayAppendValue(array, dict);
+        CFRelease(dict);
+    }
+    return array;
+}
+
+// Returns whether the trailer of a binary property list points at a dictionary index.
+static bool hasIndex(CFDataRef data) {
+    uint8_t marker;
+    uint64_t offset;
+    CFBinaryPlistTrailer trailer;
+    if (!__CFBinaryPlistGetTopLevelInfo(CFDataGetBytePtr(data), CFDataGetLength(data), &marker, &offset, &trailer)) return false;
+    for (int idx = 0; idx < 5; idx++) {
+        if (trailer._unused[idx]) return true;
+    }
+    return false;
+}
+
+static bool check(const char *name, CFPropertyListRef plist, CFDataRef data, bool indexed) {
+    bool ok = true;
+    CFPropertyListRef readBack = CFPropertyListCreateWithData(kCFAllocatorSystemDefault, data, kCFPropertyListImmutable, NULL, NULL);
+    if (!readBack || !CFEqual(readBack, plist)) {
+        printf("%s: CFPropertyListCreateWithData did not read back what was written\n", name);
+        ok = false;
+    }
+    if (readBack) CFRelease(readBack);
+    if (hasIndex(data) != indexed) {
+        printf("%s: the trailer %s an index\n", name, indexed ? "does not point at" : "points at");
+        ok = false;
+    }
+
+    _CFBinaryPlistNodeRef node = _CFBinaryPlistNodeCreateWithData(kCFAllocatorSystemDefault, data, NULL);
+    if (!node) {
+        printf("%s: could not create a node from the data\n", name);
+        return false;
+    }
+    for (CFIndex dictIdx = 0; dictIdx < (CFIndex)DICTS; dictIdx++) {
+        CFDictionaryRef expected = (CFDictionaryRef)CFArrayGetValueAtIndex((CFArrayRef)plist, dictIdx);
+        _CFBinaryPlistNodeRef dict = (_CFBinaryPlistNodeRef)_CFBinaryPlistNodeGetValueAtIndex(node, dictIdx);
+        if (!dict) {
+            ok = false;
+            continue;
+        }
+        // Walk past the end, so that missing keys are looked up as well
+        for (int idx = 0; idx < sizes[dictIdx] + 100; idx++) {
+            CFStringRef key = createString("key %d", idx);
+            CFTypeRef value = _CFBinaryPlistNodeGetValue(dict, key);
+            CFTypeRef expectedValue = CFDictionaryGetValue(expected, key);
+            if (expectedValue ? (!value || !CFEqual(value, expectedValue)) : (value != NULL)) {
+                printf("%s: wrong value for key %d of dictionary %ld\n", name, idx, (long)dictIdx);
+                ok = false;
+            }
+            CFRelease(key);
+        }
+    }
+    CFRelease(node);
+    return ok;
+}
+
+// Returns the best time in nanoseconds for one lookup in the last dictionary.
+static double timeLookups(CFDataRef data, CFStringRef *keys) {
+    const uint8_t *bytes = CFDataGetBytePtr(data);
+    uint64_t length = CFDataGetLength(data);
+    uint8_t marker;
+    uint64_t offset, dictOffset, koffset, voffset;
+    CFBinaryPlistTrailer trailer;
+    if (!__CFBinaryPlistGetTopLevelInfo(bytes, length, &marker, &offset, &trailer)) return 0.0;
+    if (!__CFBinaryPlistGetOffsetForValueFromArray2(bytes, length, offset, &trailer, DICTS - 1, &dictOffset, NULL)) return 0.0;
+
+    double best = 0.0;
+    for (int run = 0; run < RUNS; run++) {
+        int found = 0;
+        double start = now();
+        for (int idx = 0; idx < LOOKUPS; idx++) {
+            if (__CFBinaryPlistGetOffsetForValueFromDictionary3(bytes, length, dictOffset, &trailer, keys[idx], &koffset, &voffset, false, NULL)) found++;
+        }
+        double elapsed = now() - start;
+        if (found != LOOKUPS) return 0.0;
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    return best * 1e9 / LOOKUPS;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    CFPropertyListRef plist = createDictionaries();
+    CFDataRef plain = CFPropertyListCreateData(kCFAllocatorSystemDefault, plist, kCFPropertyListBinaryFormat_v1_0, 0, NULL);
+    CFDataRef indexed = CFPropertyListCreateData(kCFAllocatorSystemDefault, plist, kCFPropertyListBinaryFormat_v1_0, kCFBinaryPlistWriteDictionaryIndex, NULL);
+    if (!plain || !indexed) {
+        printf("could not write the property list\n");
+        return 1;
+    }
+    ok = check("plain", plist, plain, false) && ok;
+    ok = check("indexed", plist, indexed, true) && ok;
+
+    int largest = sizes[DICTS - 1];
+    CFStringRef *keys = (CFStringRef *)malloc(LOOKUPS * sizeof(CFStringRef));
+    srandom(1);
+    for (int idx = 0; idx < LOOKUPS; idx++) {
+        keys[idx] = createString("key %ld", random() % largest);
+    }
+    double plainTime = timeLookups(plain, keys);
+    double indexedTime = timeLookups(indexed, keys);
+    if (plainTime == 0.0 || indexedTime == 0.0) {
+        printf("a timed lookup did not find its key\n");
+        ok = false;
+    }
+    printf("%-10s %10s %12s\n", "", "bytes", "lookup ns");
+    printf("%-10s %10ld %12.1f\n", "plain", (long)CFDataGetLength(plain), plainTime);
+    printf("%-10s %10ld %12.1f\n", "indexed", (long)CFDataGetLength(indexed), indexedTime);
+    printf("%s\n", ok ? "ok" : "MISMATCH");
+
+    for (int idx = 0; idx < LOOKUPS; idx++) CFRelease(keys[idx]);
+    free(keys);
+    CFRelease(plain);
+    CFRelease(indexed);
+    CFRelease(plist);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+// Linux: make -f MakefileLinux plistbench && CF-Objects/normal/plistbench
+// Mac OS X: clang -O2 -F<path-to-CFLite-framework> -framework CoreFoundation Examples/plistbench.c -o plistbench
+
+/*
+ This example measures how fast CFPropertyListCreateWithData reads large XML property lists. With no arguments it builds a corpus in memory:
+    strings - one dictionary of short keys and string values, some needing entity references
+    data    - an array of large <data> blobs, which is nearly all base64
+    mixed   - an array of small records using every property list type
+ Any arguments are read as property list files and measured as well. Each input is parsed once and compared against the original before it is timed, and the best of the runs is reported.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <CoreFoundation/CoreFoundation.h>
+
+#define RUNS 10
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static CFStringRef createString(const char *format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    return CFStringCreateWithCString(kCFAllocatorSystemDefault, buf, kCFStringEncodingUTF8);
+}
+
+static CFDataRef createRandomData(CFIndex length) {
+    CFMutableDataRef data = CFDataCreateMutable(kCFAllocatorSystemDefault, length);
+    CFDataSetLength(data, length);
+    UInt8 *bytes = CFDataGetMutableBytePtr(data);
+    for (CFIndex i = 0; i < length; i++) bytes[i] = random();
+    return data;
+}
+
+static CFPropertyListRef createStringsCorpus(void) {
+    CFMutableDictionaryRef dict = CFDictionaryCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+    for (int i = 0; i < 50000; i++) {
+        CFStringRef key = createString("key%d", i);
+        CFStringRef value;
+        switch (i % 4) {
+            case 0: value = createString("A plain value of moderate length, number %d, with nothing to escape in it at all", i); break;
+            case 1: value = createString("Tom & Jerry <%d> \"quoted\"", i); break;
+            case 2: value = createString("Gr\xc3\xbc\xc3\x9f" "e aus M\xc3\xbcnchen %d", i); break;
+            default: value = createString("%d", i); break;
+        }
+        CFDictionarySetValue(dict, key, value);
+        CFRelease(key);
+        CFRelease(value);
+    }
+    return dict;
+}
+
+static CFPropertyListRef createDataCorpus(void) {
+    CFMutableArrayRef array = CFArrayCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeArrayCallBacks);
+    for (int i = 0; i < 64; i++) {
+        CFDataRef data = createRandomData(256 * 1024 + i);
+        CFArrayAppendValue(array, data);
+        CFRelease(data);
+    }
+    return array;
+}
+
+static CFPropertyListRef createMixedCorpus(void) {
+    CFMutableArrayRef array = CFArrayCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeArrayCallBacks);
+    for (int i = 0; i < 5000; i++) {
+        CFMutableDictionaryRef record = CFDictionaryCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+        CFStringRef name = createString("Record %d", i);
+        CFNumberRef identifier = CFNumberCreate(kCFAllocatorSystemDefault, kCFNumberIntType, &i);
+        double score = i / 7.0;
+        CFNumberRef real = CFNumberCreate(kCFAllocatorSystemDefault, kCFNumberDoubleType, &score);
+        CFDateRef created = CFDateCreate(kCFAllocatorSystemDefault, 400000000.0 + i);
+        CFDataRef thumbnail = createRandomData(1024);
+        CFMutableArrayRef tags = CFArrayCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeArrayCallBacks);
+        for (int t = 0; t < 4; t++) {
+            CFStringRef tag = createString("tag%d", (i + t) % 32);
+            CFArrayAppendValue(tags, tag);
+            CFRelease(tag);
+        }
+        CFDictionarySetValue(record, CFSTR("Name"), name);
+        CFDictionarySetValue(record, CFSTR("Identifier"), identifier);
+        CFDictionarySetValue(record, CFSTR("Score"), real);
+        CFDictionarySetValue(record, CFSTR("Enabled"), (i & 1) ? kCFBooleanTrue : kCFBooleanFalse);
+        CFDictionarySetValue(record, CFSTR("Created"), created);
+        CFDictionarySetValue(record, CFSTR("Thumbnail"), thumbnail);
+        CFDictionarySetValue(record, CFSTR("Tags"), tags);
+        CFArrayAppendValue(array, record);
+        CFRelease(name);
+        CFRelease(identifier);
+        CFRelease(real);
+        CFRelease(created);
+        CFRelease(thumbnail);
+        CFRelease(tags);
+        CFRelease(record);
+    }
+    return array;
+}
+
+static CFDataRef createDataFromFile(const char *fname) {
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) return NULL;
+    CFMutableDataRef res = CFDataCreateMutable(kCFAllocatorSystemDefault, 0);
+    char buf[65536];
+    ssize_t amountRead;
+    while ((amountRead = read(fd, buf, sizeof(buf))) > 0) {
+        CFDataAppendBytes(res, (const UInt8 *)buf, amountRead);
+    }
+    close(fd);
+    return res;
+}
+
+// Returns false if the data doesn't read back as a property list, or reads back as something other than expected (when given).
+static bool measure(const char *name, CFDataRef xml, CFPropertyListRef expected) {
+    CFErrorRef err = NULL;
+    CFPropertyListRef plist = CFPropertyListCreateWithData(kCFAllocatorSystemDefault, xml, kCFPropertyListImmutable, NULL, &err);
+    if (!plist) {
+        printf("%-10s could not be read\n", name);
+        if (err) CFRelease(err);
+        return false;
+    }
+    bool same = !expected || CFEqual(plist, expected);
+    CFRelease(plist);
+    if (!same) {
+        printf("%-10s did not read back as written\n", name);
+        return false;
+    }
+
+    double best = 0;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now();
+        plist = CFPropertyListCreateWithData(kCFAllocatorSystemDefault, xml, kCFPropertyListImmutable, NULL, NULL);
+        double elapsed = now() - start;
+        CFRelease(plist);
+        if (run == 0 || elapsed < best) best = elapsed;
+    }
+    double megabytes = CFDataGetLength(xml) / (1024.0 * 1024.0);
+    printf("%-10s %9.2f MB %9.2f ms %9.1f MB/s\n", name, megabytes, best * 1000, megabytes / best);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    srandom(1);
+    printf("%-10s %12s %12s %14s\n", "input", "size", "best", "throughput");
+    if (argc == 1) {
+        struct {
+            const char *name;
+            CFPropertyListRef (*create)(void);
+        } corpus[] = {
+            { "strings", createStringsCorpus },
+            { "data", createDataCorpus },
+            { "mixed", createMixedCorpus },
+        };
+        for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); i++) {
+            CFPropertyListRef plist = corpus[i].create();
+            CFDataRef xml = CFPropertyListCreateData(kCFAllocatorSystemDefault, plist, kCFPropertyListXMLFormat_v1_0, 0, NULL);
+            ok = measure(corpus[i].name, xml, plist) && ok;
+            CFRelease(xml);
+            CFRelease(plist);
+        }
+    }
+    for (int i = 1; i < argc; i++) {
+        CFDataRef xml = createDataFromFile(argv[i]);
+        if (!xml) {
+            printf("Unable to create data from file name: %s\n", argv[i]);
+            ok = false;
+            continue;
+        }
+        const char *name = strrchr(argv[i], '/');
+        ok = measure(name ? name + 1 : argv[i], xml, NULL) && ok;
+        CFRelease(xml);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+// Linux: make -f MakefileLinux plnode && CF-Objects/normal/plnode [directory]
+// Mac OS X: clang -O2 -F<path-to-CFLite-framework> -framework CoreFoundation Examples/plnode.c -o plnode
+
+/*
+ This example reads a binary property list through _CFBinaryPlistNode, which decodes values only when they are asked for. It builds a dictionary of ten thousand records, each a dictionary holding a string, a number, a date, a data and an array, writes it in the binary format, and then:
+    - reads it back with CFPropertyListCreateWithData and checks it with CFEqual
+    - walks a node made from the same data, by index and by key, and checks every value against the original
+    - checks that _CFBinaryPlistNodeCreatePropertyList gives back a property list equal to the original
+    - writes the data to a file in the directory given as the argument, or in /tmp, and looks up a few records through a node that maps the file
+ It prints how long a full parse takes, and how long the node takes to find one record.
+*/
+
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <CoreFoundation/CFPriv.h>
+
+#define RECORDS 10000
+#define LOOKUPS 1000
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static CFStringRef createString(const char *format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    return CFStringCreateWithCString(kCFAllocatorSystemDefault, buf, kCFStringEncodingUTF8);
+}
+
+static void setValue(CFMutableDictionaryRef dict, CFStringRef key, CFTypeRef value) {
+    CFDictionarySetValue(dict, key, value);
+    CFRelease(value);
+}
+
+static CFPropertyListRef createRecords(void) {
+    CFMutableDictionaryRef records = CFDictionaryCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+    for (int idx = 0; idx < RECORDS; idx++) {
+        CFMutableDictionaryRef record = CFDictionaryCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+        UInt8 bytes[16];
+        memset(bytes, idx, sizeof(bytes));
+        setValue(record, CFSTR("name"), createString("record number %d", idx));
+        setValue(record, CFSTR("number"), CFNumberCreate(kCFAllocatorSystemDefault, kCFNumberIntType, &idx));
+        setValue(record, CFSTR("date"), CFDateCreate(kCFAllocatorSystemDefault, idx * 60.0));
+        setValue(record, CFSTR("data"), CFDataCreate(kCFAllocatorSystemDefault, bytes, sizeof(bytes)));
+        CFMutableArrayRef tags = CFArrayCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeArrayCallBacks);
+        for (int tag = 0; tag < idx % 5; tag++) {
+            CFStringRef str = createString("tag %d", tag);
+            CFArrayAppendValue(tags, str);
+            CFRelease(str);
+        }
+        CFArrayAppendValue(tags, (idx & 1) ? kCFBooleanTrue : kCFBooleanFalse);
+        setValue(record, CFSTR("tags"), tags);
+        CFStringRef key = createString("key %d", idx);
+        setValue(records, key, record);
+        CFRelease(key);
+    }
+    return records;
+}
+
+// Returns whether value, which may be a node, holds the same property list as expected.
+static bool nodeMatches(CFTypeRef value, CFPropertyListRef expected) {
+    if (!value) return false;
+    if (CFGetTypeID(value) != _CFBinaryPlistNodeGetTypeID()) return CFEqual(value, expected);
+
+    _CFBinaryPlistNodeRef node = (_CFBinaryPlistNodeRef)value;
+    if (_CFBinaryPlistNodeIsDictionary(node)) {
+        if (CFGetTypeID(expected) != CFDictionaryGetTypeID()) return false;
+        CFIndex count = _CFBinaryPlistNodeGetCount(node);
+        if (count != CFDictionaryGetCount((CFDictionaryRef)expected)) return false;
+        for (CFIndex idx = 0; idx < count; idx++) {
+            CFTypeRef key = _CFBinaryPlistNodeGetKeyAtIndex(node, idx);
+            CFTypeRef expectedValue = key ? CFDictionaryGetValue((CFDictionaryRef)expected, key) : NULL;
+            if (!expectedValue) return false;
+            if (!nodeMatches(_CFBinaryPlistNodeGetValueAtIndex(node, idx), expectedValue)) return false;
+            // Looking the key up has to find the same value as walking by index
+            if (_CFBinaryPlistNodeGetValue(node, key) != _CFBinaryPlistNodeGetValueAtIndex(node, idx)) return false;
+        }
+    } else {
+        if (CFGetTypeID(expected) != CFArrayGetTypeID()) return false;
+        CFIndex count = _CFBinaryPlistNodeGetCount(node);
+        if (count != CFArrayGetCount((CFArrayRef)expected)) return false;
+        for (CFIndex idx = 0; idx < count; idx++) {
+            if (!nodeMatches(_CFBinaryPlistNodeGetValueAtIndex(node, idx), CFArrayGetValueAtIndex((CFArrayRef)expected, idx))) return false;
+        }
+        if (_CFBinaryPlistNodeGetValueAtIndex(node, count)) return false;
+    }
+    return true;
+}
+
+static bool writeFile(CFDataRef data, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) return false;
+    bool ok = fwrite(CFDataGetBytePtr(data), 1, CFDataGetLength(data), file) == (size_t)CFDataGetLength(data);
+    return (fclose(file) == 0) && ok;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    const char *dir = (argc > 1) ? argv[1] : "/tmp";
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/plnode.%d.plist", dir, (int)getpid());
+
+    CFPropertyListRef records = createRecords();
+    CFDataRef data = CFPropertyListCreateData(kCFAllocatorSystemDefault, records, kCFPropertyListBinaryFormat_v1_0, 0, NULL);
+    if (!data) {
+        printf("could not write the property list\n");
+        return 1;
+    }
+
+    double start = now();
+    CFPropertyListRef readBack = CFPropertyListCreateWithData(kCFAllocatorSystemDefault, data, kCFPropertyListImmutable, NULL, NULL);
+    double parsed = now() - start;
+    if (!readBack || !CFEqual(readBack, records)) {
+        printf("CFPropertyListCreateWithData did not read back what was written\n");
+        ok = false;
+    }
+    if (readBack) CFRelease(readBack);
+
+    CFErrorRef error = NULL;
+    _CFBinaryPlistNodeRef node = _CFBinaryPlistNodeCreateWithData(kCFAllocatorSystemDefault, data, &error);
+    if (!node) {
+        printf("could not create a node from the data\n");
+        if (error) CFRelease(error);
+        return 1;
+    }
+    if (!nodeMatches(node, records)) {
+        printf("walking the node did not give back what was written\n");
+        ok = false;
+    }
+    CFPropertyListRef realized = _CFBinaryPlistNodeCreatePropertyList(kCFAllocatorSystemDefault, node, kCFPropertyListImmutable);
+    if (!realized || !CFEqual(realized, records)) {
+        printf("_CFBinaryPlistNodeCreatePropertyList did not give back what was written\n");
+        ok = false;
+    }
+    if (realized) CFRelease(realized);
+    CFRelease(node);
+
+    double lookup = 0.0;
+    CFURLRef url = CFURLCreateFromFileSystemRepresentation(kCFAllocatorSystemDefault, (const UInt8 *)path, strlen(path), false);
+    if (!writeFile(data, path)) {
+        printf("could not write %s\n", path);
+        ok = false;
+    } else {
+        node = _CFBinaryPlistNodeCreateWithContentsOfURL(kCFAllocatorSystemDefault, url, NULL);
+        if (!node) {
+            printf("could not map %s\n", path);
+            ok = false;
+        } else {
+            start = now();
+            for (int idx = 0; idx < LOOKUPS; idx++) {
+                CFStringRef key = createString("key %d", (idx * 7919) % RECORDS);
+                CFTypeRef record = _CFBinaryPlistNodeGetValue(node, key);
+                if (!nodeMatches(record, CFDictionaryGetValue((CFDictionaryRef)records, key))) ok = false;
+                CFRelease(key);
+            }
+            lookup = (now() - start) / LOOKUPS;
+            if (_CFBinaryPlistNodeGetValue(node, CFSTR("no such key"))) ok = false;
+            CFRelease(node);
+        }
+        unlink(path);
+    }
+    CFRelease(url);
+
+    printf("%d records, %ld bytes: parsed in %.1f ms, one record found and checked through a mapped node in %.1f us\n", RECORDS, (long)CFDataGetLength(data), parsed * 1e3, lookup * 1e6);
+    printf("%s\n", ok ? "ok" : "MISMATCH");
+    CFRelease(data);
+    CFRelease(records);
+    return ok ? 0 : 1;
+}
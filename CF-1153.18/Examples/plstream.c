@@ -0,0 +1,161 @@
+// Linux: make -f MakefileLinux plstream && CF-Objects/normal/plstream [files]
+// Mac OS X: clang -O2 -F<path-to-CFLite-framework> -framework CoreFoundation Examples/plstream.c -o plstream
+
+/*
+ This example writes binary property lists with the streaming writer that kCFBinaryPlistWriteStreaming selects, reads each one back with CFPropertyListCreateWithData, and checks with CFEqual that it matches what was written. With no arguments it builds its own property lists:
+    flat   - one dictionary of a hundred thousand string keys and number values
+    nested - arrays and dictionaries nested twenty deep, with every property list type at each level
+    shared - an array in which the same strings, numbers, dates and booleans appear many times, so the writer has to unique them
+ Any arguments are read as property list files and written out again the same way. For each input the size of the default and the streaming output is printed, along with the time each writer took.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// The binary property list writer options are only declared in ForFoundationOnly.h
+#define NSBUILDINGFOUNDATION 1
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <CoreFoundation/ForFoundationOnly.h>
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static CFStringRef createString(const char *format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    return CFStringCreateWithCString(kCFAllocatorSystemDefault, buf, kCFStringEncodingUTF8);
+}
+
+static void addValue(CFMutableArrayRef array, CFTypeRef value) {
+    CFArrayAppendValue(array, value);
+    CFRelease(value);
+}
+
+static CFPropertyListRef createFlat(void) {
+    CFMutableDictionaryRef dict = CFDictionaryCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+    for (int idx = 0; idx < 100000; idx++) {
+        CFStringRef key = createString("key %d", idx);
+        CFNumberRef value = CFNumberCreate(kCFAllocatorSystemDefault, kCFNumberIntType, &idx);
+        CFDictionarySetValue(dict, key, value);
+        CFRelease(key);
+        CFRelease(value);
+    }
+    return dict;
+}
+
+static CFPropertyListRef createNested(int depth) {
+    CFMutableArrayRef array = CFArrayCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeArrayCallBacks);
+    double real = depth / 3.0;
+    UInt8 bytes[64];
+    memset(bytes, depth, sizeof(bytes));
+    addValue(array, createString("level %d", depth));
+    addValue(array, CFNumberCreate(kCFAllocatorSystemDefault, kCFNumberIntType, &depth));
+    addValue(array, CFNumberCreate(kCFAllocatorSystemDefault, kCFNumberDoubleType, &real));
+    addValue(array, CFDateCreate(kCFAllocatorSystemDefault, depth * 86400.0));
+    addValue(array, CFDataCreate(kCFAllocatorSystemDefault, bytes, depth));
+    CFArrayAppendValue(array, (depth & 1) ? kCFBooleanTrue : kCFBooleanFalse);
+    if (depth < 20) {
+        CFMutableDictionaryRef dict = CFDictionaryCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+        CFPropertyListRef child = createNested(depth + 1);
+        CFDictionarySetValue(dict, CFSTR("child"), child);
+        CFDictionarySetValue(dict, CFSTR("empty"), CFSTR(""));
+        CFRelease(child);
+        addValue(array, dict);
+    }
+    return array;
+}
+
+static CFPropertyListRef createShared(void) {
+    CFMutableArrayRef array = CFArrayCreateMutable(kCFAllocatorSystemDefault, 0, &kCFTypeArrayCallBacks);
+    for (int idx = 0; idx < 100000; idx++) {
+        int small = idx % 100;
+        switch (idx % 4) {
+            case 0: addValue(array, createString("shared %d", small)); break;
+            case 1: addValue(array, CFNumberCreate(kCFAllocatorSystemDefault, kCFNumberIntType, &small)); break;
+            case 2: addValue(array, CFDateCreate(kCFAllocatorSystemDefault, small)); break;
+            case 3: CFArrayAppendValue(array, (small & 1) ? kCFBooleanTrue : kCFBooleanFalse); break;
+        }
+    }
+    return array;
+}
+
+static CFPropertyListRef createFromFile(const char *fname) {
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) return NULL;
+    CFMutableDataRef data = CFDataCreateMutable(kCFAllocatorSystemDefault, 0);
+    char buf[65536];
+    ssize_t amountRead;
+    while ((amountRead = read(fd, buf, sizeof(buf))) > 0) {
+        CFDataAppendBytes(data, (const UInt8 *)buf, amountRead);
+    }
+    close(fd);
+    CFPropertyListRef plist = CFPropertyListCreateWithData(kCFAllocatorSystemDefault, data, kCFPropertyListImmutable, NULL, NULL);
+    CFRelease(data);
+    return plist;
+}
+
+static bool check(const char *name, CFPropertyListRef plist) {
+    double start = now();
+    CFDataRef plain = CFPropertyListCreateData(kCFAllocatorSystemDefault, plist, kCFPropertyListBinaryFormat_v1_0, 0, NULL);
+    double plainTime = now() - start;
+    start = now();
+    CFErrorRef error = NULL;
+    CFDataRef streamed = CFPropertyListCreateData(kCFAllocatorSystemDefault, plist, kCFPropertyListBinaryFormat_v1_0, kCFBinaryPlistWriteStreaming, &error);
+    double streamedTime = now() - start;
+    if (!plain || !streamed) {
+        printf("%-10s could not be written\n", name);
+        if (plain) CFRelease(plain);
+        if (streamed) CFRelease(streamed);
+        if (error) CFRelease(error);
+        return false;
+    }
+
+    CFPropertyListRef readBack = CFPropertyListCreateWithData(kCFAllocatorSystemDefault, streamed, kCFPropertyListImmutable, NULL, NULL);
+    bool ok = readBack && CFEqual(readBack, plist);
+    printf("%-10s %10ld %10ld %10.1f %10.1f  %s\n", name, (long)CFDataGetLength(plain), (long)CFDataGetLength(streamed), plainTime * 1e3, streamedTime * 1e3, ok ? "ok" : "MISMATCH");
+    if (readBack) CFRelease(readBack);
+    CFRelease(plain);
+    CFRelease(streamed);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    printf("%-10s %10s %10s %10s %10s\n", "", "bytes", "streamed", "ms", "streamed");
+    if (argc < 2) {
+        CFPropertyListRef flat = createFlat();
+        CFPropertyListRef nested = createNested(0);
+        CFPropertyListRef shared = createShared();
+        ok = check("flat", flat) && ok;
+        ok = check("nested", nested) && ok;
+        ok = check("shared", shared) && ok;
+        CFRelease(flat);
+        CFRelease(nested);
+        CFRelease(shared);
+    }
+    for (int idx = 1; idx < argc; idx++) {
+        CFPropertyListRef plist = createFromFile(argv[idx]);
+        if (!plist) {
+            printf("%s could not be read\n", argv[idx]);
+            ok = false;
+            continue;
+        }
+        ok = check(argv[idx], plist) && ok;
+        CFRelease(plist);
+    }
+    return ok ? 0 : 1;
+}
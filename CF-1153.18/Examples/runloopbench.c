@@ -0,0 +1,284 @@
+// Linux: make -f MakefileLinux runloopbench && CF-Objects/normal/runloopbench
+// Mac OS X: clang -O2 -F<path-to-CFLite-framework> -framework CoreFoundation Examples/runloopbench.c -o runloopbench
+
+/*
+ This example measures three things about CFRunLoop:
+    wakeup     - a run loop on a second thread sleeps with a version 0 source in its mode; the main thread signals the source and calls CFRunLoopWakeUp, and the time until the perform function runs on the second thread is the wakeup latency
+    sources0   - a run loop runs version 0 sources whose perform functions signal themselves again, so each pass of the run loop performs every source; the rate is in performs per second
+    timer      - a one-shot CFRunLoopTimer is scheduled a few milliseconds out, and is checked to fire, and not before its fire date
+    reschedule - a mode holds many timers, as it would with a timeout for each request in flight, and CFRunLoopTimerSetNextFireDate moves random ones to random dates; the time is in nanoseconds per call
+    fire       - the same number of one-shot timers with fire dates spread over the next few milliseconds are run, and checked to fire in the order of their fire dates
+ The wakeup latencies are reported as the median and the 99th percentile, in microseconds.
+*/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <CoreFoundation/CoreFoundation.h>
+
+#define WAKEUPS 20000
+#define PERFORMS 2000000
+#define SOURCES 4
+#define RUNS 3
+#define TIMERS 10000
+#define RESCHEDULES 1000000
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+
+typedef struct {
+    CFRunLoopRef runLoop;
+    CFRunLoopSourceRef source;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    Boolean ready;
+    long performed;
+    double performTime;
+} Sleeper;
+
+static void sleeperPerform(void *info) {
+    Sleeper *sleeper = (Sleeper *)info;
+    double t = now();
+    pthread_mutex_lock(&sleeper->lock);
+    sleeper->performTime = t;
+    sleeper->performed++;
+    pthread_cond_signal(&sleeper->cond);
+    pthread_mutex_unlock(&sleeper->lock);
+}
+
+static void *sleeperMain(void *arg) {
+    Sleeper *sleeper = (Sleeper *)arg;
+    CFRunLoopSourceContext context = {0, sleeper, NULL, NULL, NULL, NULL, NULL, NULL, NULL, sleeperPerform};
+    sleeper->source = CFRunLoopSourceCreate(kCFAllocatorSystemDefault, 0, &context);
+    CFRunLoopAddSource(CFRunLoopGetCurrent(), sleeper->source, kCFRunLoopDefaultMode);
+    pthread_mutex_lock(&sleeper->lock);
+    sleeper->runLoop = (CFRunLoopRef)CFRetain(CFRunLoopGetCurrent());
+    sleeper->ready = true;
+    pthread_cond_signal(&sleeper->cond);
+    pthread_mutex_unlock(&sleeper->lock);
+    CFRunLoopRun();
+    return NULL;
+}
+
+static Boolean timeWakeups(double *median, double *p99) {
+    Sleeper sleeper = {0};
+    pthread_t thread;
+    pthread_mutex_init(&sleeper.lock, NULL);
+    pthread_cond_init(&sleeper.cond, NULL);
+    pthread_create(&thread, NULL, sleeperMain, &sleeper);
+    pthread_mutex_lock(&sleeper.lock);
+    while (!sleeper.ready) pthread_cond_wait(&sleeper.cond, &sleeper.lock);
+    pthread_mutex_unlock(&sleeper.lock);
+
+    double *latencies = malloc(WAKEUPS * sizeof(double));
+    for (long idx = 0; idx < WAKEUPS; idx++) {
+        // Give the run loop time to go back to sleep, so that every wakeup comes out of epoll_wait or mach_msg
+        usleep(50);
+        double start = now();
+        CFRunLoopSourceSignal(sleeper.source);
+        CFRunLoopWakeUp(sleeper.runLoop);
+        pthread_mutex_lock(&sleeper.lock);
+        while (sleeper.performed <= idx) pthread_cond_wait(&sleeper.cond, &sleeper.lock);
+        latencies[idx] = sleeper.performTime - start;
+        pthread_mutex_unlock(&sleeper.lock);
+    }
+
+    CFRunLoopStop(sleeper.runLoop);
+    pthread_join(thread, NULL);
+    Boolean ok = (sleeper.performed == WAKEUPS);
+    qsort(latencies, WAKEUPS, sizeof(double), compareDoubles);
+    *median = latencies[WAKEUPS / 2];
+    *p99 = latencies[WAKEUPS * 99 / 100];
+    free(latencies);
+    CFRunLoopSourceInvalidate(sleeper.source);
+    CFRelease(sleeper.source);
+    CFRelease(sleeper.runLoop);
+    return ok;
+}
+
+
+typedef struct {
+    CFRunLoopSourceRef source;
+    long *remaining;
+    long performed;
+} Spinner;
+
+static void spinnerPerform(void *info) {
+    Spinner *spinner = (Spinner *)info;
+    // The sources signalled in the last pass still run after the one which stops the run loop
+    if (0 == *spinner->remaining) return;
+    spinner->performed++;
+    if (0 < --*spinner->remaining) {
+        CFRunLoopSourceSignal(spinner->source);
+    } else {
+        CFRunLoopStop(CFRunLoopGetCurrent());
+    }
+}
+
+static Boolean timeSources0(double *rate) {
+    Boolean ok = true;
+    for (int run = 0; run < RUNS; run++) {
+        long remaining = PERFORMS;
+        Spinner spinners[SOURCES];
+        for (int idx = 0; idx < SOURCES; idx++) {
+            CFRunLoopSourceContext context = {0, &spinners[idx], NULL, NULL, NULL, NULL, NULL, NULL, NULL, spinnerPerform};
+            spinners[idx].remaining = &remaining;
+            spinners[idx].performed = 0;
+            spinners[idx].source = CFRunLoopSourceCreate(kCFAllocatorSystemDefault, 0, &context);
+            CFRunLoopAddSource(CFRunLoopGetCurrent(), spinners[idx].source, kCFRunLoopDefaultMode);
+            CFRunLoopSourceSignal(spinners[idx].source);
+        }
+        double start = now();
+        CFRunLoopRunInMode(kCFRunLoopDefaultMode, 60.0, false);
+        double elapsed = now() - start;
+        long performed = 0;
+        for (int idx = 0; idx < SOURCES; idx++) {
+            performed += spinners[idx].performed;
+            CFRunLoopSourceInvalidate(spinners[idx].source);
+            CFRelease(spinners[idx].source);
+        }
+        if (performed != PERFORMS) ok = false;
+        if (run == 0 || *rate < performed / elapsed) *rate = performed / elapsed;
+    }
+    return ok;
+}
+
+
+static void timerFired(CFRunLoopTimerRef timer, void *info) {
+    *(CFAbsoluteTime *)info = CFAbsoluteTimeGetCurrent();
+    CFRunLoopStop(CFRunLoopGetCurrent());
+}
+
+static Boolean checkTimer(double *late) {
+    CFAbsoluteTime firedAt = 0.0;
+    CFRunLoopTimerContext context = {0, &firedAt, NULL, NULL, NULL};
+    CFAbsoluteTime fireDate = CFAbsoluteTimeGetCurrent() + 0.005;
+    CFRunLoopTimerRef timer = CFRunLoopTimerCreate(kCFAllocatorSystemDefault, fireDate, 0.0, 0, 0, timerFired, &context);
+    CFRunLoopAddTimer(CFRunLoopGetCurrent(), timer, kCFRunLoopDefaultMode);
+    CFRunLoopRunInMode(kCFRunLoopDefaultMode, 1.0, false);
+    CFRunLoopTimerInvalidate(timer);
+    CFRelease(timer);
+    *late = firedAt - fireDate;
+    // Fire dates are converted to the monotonic clock when the timer is scheduled, so allow a few microseconds of skew against the absolute time
+    return (0.0 < firedAt) && (-10e-6 <= *late);
+}
+
+
+static void timerNeverFires(CFRunLoopTimerRef timer, void *info) {
+}
+
+static Boolean timeReschedules(double *perCall) {
+    CFRunLoopTimerRef *timers = malloc(TIMERS * sizeof(CFRunLoopTimerRef));
+    CFAbsoluteTime base = CFAbsoluteTimeGetCurrent() + 3600.0;
+    for (long idx = 0; idx < TIMERS; idx++) {
+        timers[idx] = CFRunLoopTimerCreate(kCFAllocatorSystemDefault, base + random() % 3600, 0.0, 0, 0, timerNeverFires, NULL);
+        CFRunLoopAddTimer(CFRunLoopGetCurrent(), timers[idx], kCFRunLoopDefaultMode);
+    }
+    for (int run = 0; run < RUNS; run++) {
+        double start = now();
+        for (long idx = 0; idx < RESCHEDULES; idx++) {
+            CFRunLoopTimerSetNextFireDate(timers[random() % TIMERS], base + random() % 3600);
+        }
+        double elapsed = (now() - start) / RESCHEDULES;
+        if (run == 0 || elapsed < *perCall) *perCall = elapsed;
+    }
+    // The earliest timer must be the one the run loop reports
+    CFAbsoluteTime earliest = 0.0;
+    for (long idx = 0; idx < TIMERS; idx++) {
+        CFAbsoluteTime fireDate = CFRunLoopTimerGetNextFireDate(timers[idx]);
+        if (idx == 0 || fireDate < earliest) earliest = fireDate;
+    }
+    Boolean ok = (CFRunLoopGetNextTimerFireDate(CFRunLoopGetCurrent(), kCFRunLoopDefaultMode) == earliest);
+    for (long idx = 0; idx < TIMERS; idx++) {
+        CFRunLoopTimerInvalidate(timers[idx]);
+        CFRelease(timers[idx]);
+    }
+    free(timers);
+    return ok;
+}
+
+
+typedef struct {
+    long fired;
+    CFAbsoluteTime lastFireDate;
+    Boolean inOrder;
+} FireLog;
+
+static void timerLogsFire(CFRunLoopTimerRef timer, void *info) {
+    FireLog *log = (FireLog *)info;
+    CFAbsoluteTime fireDate = CFRunLoopTimerGetNextFireDate(timer);
+    // Fire dates are converted to the monotonic clock one timer at a time, so allow a few microseconds of skew between them
+    if (fireDate < log->lastFireDate - 5e-6) log->inOrder = false;
+    log->lastFireDate = fireDate;
+    if (++log->fired == TIMERS) CFRunLoopStop(CFRunLoopGetCurrent());
+}
+
+static Boolean checkFireOrder(double *elapsed) {
+    FireLog log = {0, 0.0, true};
+    CFRunLoopTimerContext context = {0, &log, NULL, NULL, NULL};
+    CFRunLoopTimerRef *timers = malloc(TIMERS * sizeof(CFRunLoopTimerRef));
+    CFAbsoluteTime base = CFAbsoluteTimeGetCurrent() + 0.005;
+    for (long idx = 0; idx < TIMERS; idx++) {
+        timers[idx] = CFRunLoopTimerCreate(kCFAllocatorSystemDefault, base + (random() % 500) * 10e-6, 0.0, 0, 0, timerLogsFire, &context);
+        CFRunLoopAddTimer(CFRunLoopGetCurrent(), timers[idx], kCFRunLoopDefaultMode);
+    }
+    double start = now();
+    CFRunLoopRunInMode(kCFRunLoopDefaultMode, 10.0, false);
+    *elapsed = now() - start;
+    for (long idx = 0; idx < TIMERS; idx++) {
+        CFRunLoopTimerInvalidate(timers[idx]);
+        CFRelease(timers[idx]);
+    }
+    free(timers);
+    return (log.fired == TIMERS) && log.inOrder;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    double median = 0.0, p99 = 0.0, rate = 0.0, late = 0.0, perCall = 0.0, elapsed = 0.0;
+    srandom(1);
+
+    if (!timeWakeups(&median, &p99)) {
+        printf("the sleeping run loop missed some of its wakeups\n");
+        ok = false;
+    }
+    printf("wakeup    median %8.1f us   99%% %8.1f us   (%d wakeups)\n", median * 1e6, p99 * 1e6, WAKEUPS);
+
+    if (!timeSources0(&rate)) {
+        printf("the run loop performed the wrong number of version 0 sources\n");
+        ok = false;
+    }
+    printf("sources0  %12.0f performs/s  (%d sources)\n", rate, SOURCES);
+
+    if (!checkTimer(&late)) {
+        printf("the timer did not fire, or fired early\n");
+        ok = false;
+    }
+    printf("timer     fired %.1f us after its fire date\n", late * 1e6);
+
+    if (!timeReschedules(&perCall)) {
+        printf("the run loop lost track of its earliest timer\n");
+        ok = false;
+    }
+    printf("reschedule %9.1f ns/call  (%d timers)\n", perCall * 1e9, TIMERS);
+
+    if (!checkFireOrder(&elapsed)) {
+        printf("the timers did not all fire, or fired out of order\n");
+        ok = false;
+    }
+    printf("fire      %d timers in %.1f ms\n", TIMERS, elapsed * 1e3);
+    return ok ? 0 : 1;
+}
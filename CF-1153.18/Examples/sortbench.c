@@ -0,0 +1,93 @@
+// Linux: make -f MakefileLinux sortbench && CF-Objects/normal/sortbench [largest-count]
+// Mac OS X: clang -O2 -F<path-to-CFLite-framework> -framework CoreFoundation Examples/sortbench.c -o sortbench
+
+/*
+ This example times CFArraySortValues, which sorts arrays of 65536 or more values on all of the cores, against the C library's qsort of the same values on one thread. The arrays hold integers with NULL callbacks, and the comparator looks each one up in a table of keys, so a compare costs a random memory access much as comparing objects would. There are about four values per key, so many compare equal; after each sort the array is checked to be in order and to keep equal values in their original order.
+ The counts go from a million up to a hundred million values, or to the count given as the argument. A hundred million values need about 4GB of memory. The best of the runs is reported, in milliseconds.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <CoreFoundation/CoreFoundation.h>
+
+#define RUNS 3
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Values are 1-based indexes into the key table, so that none of them is NULL.
+static uint32_t *keys;
+
+static CFComparisonResult compareValues(const void *val1, const void *val2, void *context) {
+    uint32_t key1 = keys[(uintptr_t)val1 - 1], key2 = keys[(uintptr_t)val2 - 1];
+    return (key1 < key2) ? kCFCompareLessThan : (key1 > key2) ? kCFCompareGreaterThan : kCFCompareEqualTo;
+}
+
+static int qsortCompare(const void *a, const void *b) {
+    return (int)compareValues(*(const void **)a, *(const void **)b, NULL);
+}
+
+static Boolean isSortedAndStable(const void **values, CFIndex count) {
+    for (CFIndex idx = 1; idx < count; idx++) {
+        CFComparisonResult order = compareValues(values[idx - 1], values[idx], NULL);
+        if (order == kCFCompareGreaterThan) return false;
+        if (order == kCFCompareEqualTo && (uintptr_t)values[idx] < (uintptr_t)values[idx - 1]) return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    CFIndex largest = (1 < argc) ? strtol(argv[1], NULL, 10) : 100000000;
+    srandom(1);
+    printf("%10s %12s %12s\n", "count", "CF ms", "qsort ms");
+    for (CFIndex count = 1000000; count <= largest; count *= 10) {
+        keys = malloc(count * sizeof(uint32_t));
+        const void **shuffled = malloc(count * sizeof(void *));
+        const void **values = malloc(count * sizeof(void *));
+        if (!keys || !shuffled || !values) {
+            printf("not enough memory for %ld values\n", (long)count);
+            ok = false;
+            break;
+        }
+        for (CFIndex idx = 0; idx < count; idx++) {
+            keys[idx] = (uint32_t)(random() % (count / 4 + 1));
+            shuffled[idx] = (const void *)(uintptr_t)(idx + 1);
+        }
+
+        double cfBest = 0, qsortBest = 0;
+        for (int run = 0; run < RUNS; run++) {
+            CFMutableArrayRef array = CFArrayCreateMutable(kCFAllocatorSystemDefault, count, NULL);
+            for (CFIndex idx = 0; idx < count; idx++) CFArrayAppendValue(array, shuffled[idx]);
+            double start = now();
+            CFArraySortValues(array, CFRangeMake(0, count), compareValues, NULL);
+            double elapsed = now() - start;
+            if (run == 0 || elapsed < cfBest) cfBest = elapsed;
+            CFArrayGetValues(array, CFRangeMake(0, count), values);
+            if (!isSortedAndStable(values, count)) {
+                printf("CFArraySortValues of %ld values is out of order or unstable\n", (long)count);
+                ok = false;
+            }
+            CFRelease(array);
+
+            memcpy(values, shuffled, count * sizeof(void *));
+            start = now();
+            qsort(values, count, sizeof(void *), qsortCompare);
+            elapsed = now() - start;
+            if (run == 0 || elapsed < qsortBest) qsortBest = elapsed;
+        }
+        printf("%10ld %12.1f %12.1f\n", (long)count, cfBest * 1e3, qsortBest * 1e3);
+
+        free(keys);
+        free(shuffled);
+        free(values);
+    }
+    return ok ? 0 : 1;
+}
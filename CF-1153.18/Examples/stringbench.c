@@ -0,0 +1,171 @@
+// Linux: make -f MakefileLinux stringbench && CF-Objects/normal/stringbench
+// Mac OS X: clang -O2 -F<path-to-CFLite-framework> -framework CoreFoundation Examples/stringbench.c -o stringbench
+
+/*
+ This example measures the character loops under CFString against plain scalar versions of the same loops, written out below the way CFString had them:
+    hash     - CFStringHashCharacters and CFStringHashISOLatin1CString, which CFHash uses for every string key
+    widen    - CFStringGetCharacters on an eight-bit string, which converts bytes to UniChars
+    reduce   - CFStringCreateWithCharacters on ASCII characters, which checks for ASCII and stores the string as bytes
+    detect   - CFStringCreateWithBytes of ASCII in UTF-8, which checks for ASCII before storing the bytes as they are
+ The hashes are compared with the scalar ones before they are timed, since they must not change. The reduce and detect rows time whole string creations on the CF side, so they include allocation; the scalar side is only the loop. The best of the runs is reported, in nanoseconds per call.
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// CFStringHashCharacters and CFStringHashISOLatin1CString are only declared in ForFoundationOnly.h
+#define NSBUILDINGFOUNDATION 1
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <CoreFoundation/ForFoundationOnly.h>
+
+#define RUNS 10
+#define CALLS 200000
+#define STRINGS 64
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The hash as CFString computes it, 4 characters at a time. The products are added as ints, and wrap.
+#define HashNextFour(c) result = result * 67503105 + (CFHashCode)(int)((unsigned)(c)[0] * 16974593U) + (CFHashCode)(int)((unsigned)(c)[1] * 66049U) + (c)[2] * 257 + (c)[3]
+
+static CFHashCode scalarHashCharacters(const UniChar *chars, CFIndex len) {
+    CFHashCode result = len;
+    if (len <= 96) {
+        CFIndex idx;
+        for (idx = 0; idx + 4 <= len; idx += 4) HashNextFour(chars + idx);
+        for (; idx < len; idx++) result = result * 257 + chars[idx];
+    } else {
+        const UniChar *starts[3] = {chars, chars + (len >> 1) - 16, chars + len - 32};
+        for (int part = 0; part < 3; part++) {
+            for (CFIndex idx = 0; idx < 32; idx += 4) HashNextFour(starts[part] + idx);
+        }
+    }
+    return result + (result << (len & 31));
+}
+
+static CFHashCode scalarHashLatin1(const uint8_t *bytes, CFIndex len) {
+    CFHashCode result = len;
+    if (len <= 96) {
+        CFIndex idx;
+        for (idx = 0; idx + 4 <= len; idx += 4) HashNextFour(bytes + idx);
+        for (; idx < len; idx++) result = result * 257 + bytes[idx];
+    } else {
+        const uint8_t *starts[3] = {bytes, bytes + (len >> 1) - 16, bytes + len - 32};
+        for (int part = 0; part < 3; part++) {
+            for (CFIndex idx = 0; idx < 32; idx += 4) HashNextFour(starts[part] + idx);
+        }
+    }
+    return result + (result << (len & 31));
+}
+
+static void scalarWiden(const uint8_t *bytes, UniChar *chars, CFIndex len) {
+    for (CFIndex idx = 0; idx < len; idx++) chars[idx] = bytes[idx];
+}
+
+static Boolean scalarReduce(const UniChar *chars, uint8_t *bytes, CFIndex len) {
+    for (CFIndex idx = 0; idx < len; idx++) if (chars[idx] > 127) return false;
+    for (CFIndex idx = 0; idx < len; idx++) bytes[idx] = (uint8_t)chars[idx];
+    return true;
+}
+
+static Boolean scalarDetect(const uint8_t *bytes, CFIndex len) {
+    for (CFIndex idx = 0; idx < len; idx++) if (bytes[idx] & 0x80) return false;
+    return true;
+}
+
+typedef struct {
+    CFIndex length;
+    uint8_t *bytes[STRINGS];
+    UniChar *chars[STRINGS];
+    CFStringRef strings[STRINGS];
+    uint8_t *scratchBytes;
+    UniChar *scratchChars;
+} Corpus;
+
+static volatile uintptr_t sink;
+
+typedef void (*Operation)(Corpus *corpus, int which);
+
+static void cfHashChars(Corpus *c, int i) { sink += CFStringHashCharacters(c->chars[i], c->length); }
+static void scalarHashChars(Corpus *c, int i) { sink += scalarHashCharacters(c->chars[i], c->length); }
+static void cfHashBytes(Corpus *c, int i) { sink += CFStringHashISOLatin1CString(c->bytes[i], c->length); }
+static void scalarHashBytes(Corpus *c, int i) { sink += scalarHashLatin1(c->bytes[i], c->length); }
+static void cfWiden(Corpus *c, int i) { CFStringGetCharacters(c->strings[i], CFRangeMake(0, c->length), c->scratchChars); sink += c->scratchChars[0]; }
+static void scalarWidenOp(Corpus *c, int i) { scalarWiden(c->bytes[i], c->scratchChars, c->length); sink += c->scratchChars[0]; }
+static void cfReduce(Corpus *c, int i) { CFStringRef str = CFStringCreateWithCharacters(kCFAllocatorSystemDefault, c->chars[i], c->length); sink += (uintptr_t)str; CFRelease(str); }
+static void scalarReduceOp(Corpus *c, int i) { sink += scalarReduce(c->chars[i], c->scratchBytes, c->length); }
+static void cfDetect(Corpus *c, int i) { CFStringRef str = CFStringCreateWithBytes(kCFAllocatorSystemDefault, c->bytes[i], c->length, kCFStringEncodingUTF8, false); sink += (uintptr_t)str; CFRelease(str); }
+static void scalarDetectOp(Corpus *c, int i) { sink += scalarDetect(c->bytes[i], c->length); }
+
+static double best(Operation op, Corpus *corpus) {
+    double result = 0;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now();
+        for (int call = 0; call < CALLS; call++) op(corpus, call % STRINGS);
+        double elapsed = (now() - start) / CALLS;
+        if (run == 0 || elapsed < result) result = elapsed;
+    }
+    return result * 1e9;
+}
+
+static void createCorpus(Corpus *corpus, CFIndex length) {
+    corpus->length = length;
+    for (int i = 0; i < STRINGS; i++) {
+        corpus->bytes[i] = malloc(length);
+        corpus->chars[i] = malloc(length * sizeof(UniChar));
+        for (CFIndex idx = 0; idx < length; idx++) corpus->chars[i][idx] = corpus->bytes[i][idx] = ' ' + random() % 95;
+        corpus->strings[i] = CFStringCreateWithBytes(kCFAllocatorSystemDefault, corpus->bytes[i], length, kCFStringEncodingASCII, false);
+    }
+    corpus->scratchBytes = malloc(length);
+    corpus->scratchChars = malloc(length * sizeof(UniChar));
+}
+
+static void destroyCorpus(Corpus *corpus) {
+    for (int i = 0; i < STRINGS; i++) {
+        free(corpus->bytes[i]);
+        free(corpus->chars[i]);
+        CFRelease(corpus->strings[i]);
+    }
+    free(corpus->scratchBytes);
+    free(corpus->scratchChars);
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    CFIndex lengths[] = {8, 32, 96, 1024, 16384};
+    struct {
+        const char *name;
+        Operation cf;
+        Operation scalar;
+    } operations[] = {
+        { "hash chars", cfHashChars, scalarHashChars },
+        { "hash bytes", cfHashBytes, scalarHashBytes },
+        { "widen", cfWiden, scalarWidenOp },
+        { "reduce", cfReduce, scalarReduceOp },
+        { "detect", cfDetect, scalarDetectOp },
+    };
+    srandom(1);
+    printf("%-12s %8s %12s %12s\n", "operation", "length", "CF ns", "scalar ns");
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        Corpus corpus;
+        createCorpus(&corpus, lengths[l]);
+        for (int i = 0; i < STRINGS; i++) {
+            if (CFStringHashCharacters(corpus.chars[i], corpus.length) != scalarHashCharacters(corpus.chars[i], corpus.length) || CFStringHashISOLatin1CString(corpus.bytes[i], corpus.length) != scalarHashLatin1(corpus.bytes[i], corpus.length) || CFHash(corpus.strings[i]) != scalarHashLatin1(corpus.bytes[i], corpus.length)) {
+                printf("hash of length %ld differs from the scalar hash\n", (long)corpus.length);
+                ok = false;
+                break;
+            }
+        }
+        for (size_t o = 0; o < sizeof(operations) / sizeof(operations[0]); o++) {
+            printf("%-12s %8ld %12.1f %12.1f\n", operations[o].name, (long)corpus.length, best(operations[o].cf, &corpus), best(operations[o].scalar, &corpus));
+        }
+        destroyCorpus(&corpus);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+// Linux: make -f MakefileLinux triebench && CF-Objects/normal/triebench [directory]
+// Mac OS X: clang -O2 -F<path-to-CFLite-framework> -framework CoreFoundation Examples/triebench.c -o triebench
+
+/*
+ This example measures a CFBurstTrie that is serialized to a file, memory-mapped, and then updated:
+    lookup  - every word is looked up with CFBurstTrieContainsUTF8String; the time is in nanoseconds per lookup
+    prefix  - random prefixes of one to three letters are searched with CFBurstTrieTraverseWithCursor, and every match counted; the time is in microseconds per search
+    add     - new words, and some of the mapped words again, are added to the mapped trie, which puts them in its delta and appends them to a delta log, while other threads keep looking up words; the time is in nanoseconds per word added
+    replay  - the trie is mapped again from the same file and, once the first trie has released it, its delta log replayed
+    compact - CFBurstTrieCompact merges the replayed delta into a new file and maps that in its place
+ The lookups and prefix searches are timed on the mapped trie, with the delta, and after compaction. Each prefix search is checked against a count made from the sorted word list, and every word is checked to be found with its payload. The files are written to the directory given as the argument, or to /tmp. The best of the runs is reported.
+*/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <CoreFoundation/CFBurstTrie.h>
+
+#define WORDS 1000000
+#define ADDED 100000
+#define READDED 10000
+#define PREFIXES 2000
+#define READERS 3
+#define RUNS 3
+#define WORD_SIZE 24
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Word i has payload i + 1; the first WORDS are serialized, and the rest are added to the mapped trie along with the first READDED again.
+static char (*words)[WORD_SIZE];
+static char (*sorted)[WORD_SIZE];
+static char prefixes[PREFIXES][4];
+
+static void makeWord(char *word, long idx) {
+    int length = 2 + random() % 9;
+    for (int i = 0; i < length; i++) word[i] = 'a' + random() % 26;
+    // Five letters of index on the end keep the words distinct without changing how their prefixes are spread
+    for (int i = 0; i < 5; i++, idx /= 26) word[length++] = 'a' + idx % 26;
+    word[length] = 0;
+}
+
+static int compareWords(const void *a, const void *b) {
+    return strcmp((const char *)a, (const char *)b);
+}
+
+static long countWithPrefix(long count, const char *prefix) {
+    size_t length = strlen(prefix);
+    long lo = 0, hi = count;
+    while (lo < hi) {
+        long mid = (lo + hi) / 2;
+        if (strncmp(sorted[mid], prefix, length) < 0) lo = mid + 1; else hi = mid;
+    }
+    long matches = 0;
+    while (lo + matches < count && strncmp(sorted[lo + matches], prefix, length) == 0) matches++;
+    return matches;
+}
+
+static bool countMatch(void *context, const uint8_t *key, uint32_t payload, bool exact) {
+    (*(long *)context)++;
+    return false;
+}
+
+static long lookupAll(CFBurstTrieRef trie, long count) {
+    long found = 0;
+    for (long idx = 0; idx < count; idx++) {
+        uint32_t payload = 0;
+        if (CFBurstTrieContainsUTF8String(trie, (UInt8 *)words[idx], strlen(words[idx]), &payload) && payload == idx + 1) found++;
+    }
+    return found;
+}
+
+static bool measure(CFBurstTrieRef trie, long count, const char *label) {
+    bool ok = true;
+    double lookupBest = 0, prefixBest = 0;
+    long matches = 0;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now();
+        long found = lookupAll(trie, count);
+        double elapsed = now() - start;
+        if (run == 0 || elapsed < lookupBest) lookupBest = elapsed;
+        if (found != count) {
+            printf("%s: found %ld of %ld words\n", label, found, count);
+            ok = false;
+        }
+
+        matches = 0;
+        start = now();
+        for (int idx = 0; idx < PREFIXES; idx++) {
+            void *cursor = NULL;
+            CFBurstTrieTraverseWithCursor(trie, (const uint8_t *)prefixes[idx], strlen(prefixes[idx]), &cursor, &matches, countMatch);
+        }
+        elapsed = now() - start;
+        if (run == 0 || elapsed < prefixBest) prefixBest = elapsed;
+    }
+
+    long expected = 0;
+    for (int idx = 0; idx < PREFIXES; idx++) expected += countWithPrefix(count, prefixes[idx]);
+    if (matches != expected || CFBurstTrieGetCount(trie) != count) {
+        printf("%s: %ld prefix matches instead of %ld, %ld words instead of %ld\n", label, matches, expected, (long)CFBurstTrieGetCount(trie), count);
+        ok = false;
+    }
+    printf("%-10s %10ld %10ld %12.1f %12.1f %14.1f\n", label, count, (long)CFBurstTrieGetDeltaCount(trie), lookupBest * 1e9 / count, prefixBest * 1e6 / PREFIXES, (double)matches / PREFIXES);
+    return ok;
+}
+
+static CFBurstTrieRef shared;
+static volatile bool adding;
+
+static void *readWords(void *arg) {
+    long lookups = 0;
+    while (adding) {
+        lookupAll(shared, 10000);
+        lookups += 10000;
+    }
+    return (void *)lookups;
+}
+
+int main(int argc, char **argv) {
+    bool ok = true;
+    const char *directory = (1 < argc) ? argv[1] : "/tmp";
+    char trieFile[1024], logFile[1024];
+    snprintf(trieFile, sizeof(trieFile), "%s/triebench.%d.trie", directory, (int)getpid());
+    snprintf(logFile, sizeof(logFile), "%s/triebench.%d.log", directory, (int)getpid());
+    CFStringRef triePath = CFStringCreateWithCString(kCFAllocatorSystemDefault, trieFile, kCFStringEncodingUTF8);
+    CFStringRef logPath = CFStringCreateWithCString(kCFAllocatorSystemDefault, logFile, kCFStringEncodingUTF8);
+
+    words = malloc((WORDS + ADDED) * sizeof(*words));
+    sorted = malloc((WORDS + ADDED) * sizeof(*sorted));
+    srandom(1);
+    for (long idx = 0; idx < WORDS + ADDED; idx++) makeWord(words[idx], idx);
+    for (int idx = 0; idx < PREFIXES; idx++) {
+        int length = 1 + random() % 3;
+        for (int i = 0; i < length; i++) prefixes[idx][i] = 'a' + random() % 26;
+        prefixes[idx][length] = 0;
+    }
+
+    CFBurstTrieRef trie = CFBurstTrieCreate();
+    double start = now();
+    for (long idx = 0; idx < WORDS; idx++) CFBurstTrieAddUTF8StringWithWeight(trie, (UInt8 *)words[idx], strlen(words[idx]), 1, (uint32_t)(idx + 1));
+    double built = now() - start;
+    start = now();
+    ok = CFBurstTrieSerialize(trie, triePath, 0) && ok;
+    double serialized = now() - start;
+    CFBurstTrieRelease(trie);
+    printf("built %d words in %.1f ms, serialized in %.1f ms\n\n", WORDS, built * 1e3, serialized * 1e3);
+
+    memcpy(sorted, words, WORDS * sizeof(*words));
+    qsort(sorted, WORDS, sizeof(*sorted), compareWords);
+    printf("%-10s %10s %10s %12s %12s %14s\n", "", "words", "delta", "lookup ns", "prefix us", "matches/prefix");
+    trie = CFBurstTrieCreateFromFile(triePath);
+    if (!trie) {
+        printf("could not map %s\n", trieFile);
+        return 1;
+    }
+    ok = measure(trie, WORDS, "mapped") && ok;
+
+    unlink(logFile);
+    ok = CFBurstTrieSetDeltaLog(trie, logPath) && ok;
+    shared = trie;
+    adding = true;
+    pthread_t readers[READERS];
+    for (int idx = 0; idx < READERS; idx++) pthread_create(&readers[idx], NULL, readWords, NULL);
+    start = now();
+    for (long idx = WORDS; idx < WORDS + ADDED; idx++) {
+        if (!CFBurstTrieAddUTF8StringWithWeight(trie, (UInt8 *)words[idx], strlen(words[idx]), 1, (uint32_t)(idx + 1))) ok = false;
+    }
+    // A mapped word that is added again is found in the delta, and a prefix search has to report it only once
+    for (long idx = 0; idx < READDED; idx++) {
+        if (!CFBurstTrieAddUTF8StringWithWeight(trie, (UInt8 *)words[idx], strlen(words[idx]), 2, (uint32_t)(idx + 1))) ok = false;
+    }
+    double added = now() - start;
+    adding = false;
+    long lookups = 0;
+    for (int idx = 0; idx < READERS; idx++) {
+        void *result;
+        pthread_join(readers[idx], &result);
+        lookups += (long)result;
+    }
+    printf("added %d words in %.1f ns each, while %d threads made %.1f million lookups a second\n", ADDED + READDED, added * 1e9 / (ADDED + READDED), READERS, lookups / added / 1e6);
+
+    memcpy(sorted, words, (WORDS + ADDED) * sizeof(*words));
+    qsort(sorted, WORDS + ADDED, sizeof(*sorted), compareWords);
+    ok = measure(trie, WORDS + ADDED, "delta") && ok;
+
+    // The delta log can't be set on a second trie while the first one has it
+    CFBurstTrieRef replayed = CFBurstTrieCreateFromFile(triePath);
+    if (CFBurstTrieSetDeltaLog(replayed, logPath)) {
+        printf("the delta log was set on two tries at once\n");
+        ok = false;
+    }
+    CFBurstTrieRelease(trie);
+    start = now();
+    ok = CFBurstTrieSetDeltaLog(replayed, logPath) && ok;
+    printf("replayed the delta log in %.1f ms\n", (now() - start) * 1e3);
+    ok = measure(replayed, WORDS + ADDED, "replayed") && ok;
+    trie = replayed;
+
+    start = now();
+    ok = CFBurstTrieCompact(trie, triePath, 0) && ok;
+    printf("compacted in %.1f ms\n", (now() - start) * 1e3);
+    ok = measure(trie, WORDS + ADDED, "compacted") && ok;
+    CFBurstTrieRelease(trie);
+
+    // The log was emptied by the compaction, so the file holds every word
+    trie = CFBurstTrieCreateFromFile(triePath);
+    ok = CFBurstTrieSetDeltaLog(trie, logPath) && ok;
+    ok = measure(trie, WORDS + ADDED, "reopened") && ok;
+    CFBurstTrieRelease(trie);
+
+    unlink(trieFile);
+    unlink(logFile);
+    CFRelease(triePath);
+    CFRelease(logPath);
+    free(words);
+    free(sorted);
+    return ok ? 0 : 1;
+}
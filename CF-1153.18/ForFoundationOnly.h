@@ -416,6 +416,15 @@ CF_EXPORT bool __CFBinaryPlistGetTopLevelInfo(const uint8_t *databytes, uint64_t
 CF_EXPORT bool __CFBinaryPlistGetOffsetForValueFromArray2(const uint8_t *databytes, uint64_t datalen, uint64_t startOffset, const CFBinaryPlistTrailer *trailer, CFIndex idx, uint64_t *offset, CFMutableDictionaryRef objects);
 CF_EXPORT bool __CFBinaryPlistGetOffsetForValueFromDictionary3(const uint8_t *databytes, uint64_t datalen, uint64_t startOffset, const CFBinaryPlistTrailer *trailer, CFTypeRef key, uint64_t *koffset, uint64_t *voffset, Boolean unused, CFMutableDictionaryRef objects);
 CF_EXPORT bool __CFBinaryPlistCreateObject(const uint8_t *databytes, uint64_t datalen, uint64_t startOffset, const CFBinaryPlistTrailer *trailer, CFAllocatorRef allocator, CFOptionFlags mutabilityOption, CFMutableDictionaryRef objects, CFPropertyListRef *plist);
+// Option for __CFBinaryPlistWrite, and for CFPropertyListWrite and CFPropertyListCreateData when writing the binary format. Objects are written as they are visited, children before their containers, instead of after the whole graph has been flattened into an object table. Memory use then follows the depth of the property list rather than its size, apart from the offset table. Only recently written strings, numbers and dates are uniqued, so the output may be somewhat larger.
+enum {
+    kCFBinaryPlistWriteStreaming = (1UL << 16)
+};
+// Option for __CFBinaryPlistWrite, and for CFPropertyListWrite and CFPropertyListCreateData when writing the binary format. Adds a hash index for each dictionary of 32 or more string keys, which __CFBinaryPlistGetOffsetForValueFromDictionary3 uses to find a key without comparing it to every other key. The output is still readable by earlier releases, except Leopard. Ignored by the streaming writer, which keeps nothing about dictionaries it has written.
+enum {
+    kCFBinaryPlistWriteDictionaryIndex = (1UL << 17)
+};
+
 CF_EXPORT CFIndex __CFBinaryPlistWriteToStream(CFPropertyListRef plist, CFTypeRef stream);
 CF_EXPORT CFIndex __CFBinaryPlistWriteToStreamWithEstimate(CFPropertyListRef plist, CFTypeRef stream, uint64_t estimate); // will be removed soon
 CF_EXPORT CFIndex __CFBinaryPlistWriteToStreamWithOptions(CFPropertyListRef plist, CFTypeRef stream, uint64_t estimate, CFOptionFlags options); // will be removed soon
@@ -478,6 +487,12 @@ CF_EXPORT void _CFBagSetCapacity(CFMutableBagRef bag, CFIndex cap);
 CF_EXPORT void _CFDictionarySetCapacity(CFMutableDictionaryRef dict, CFIndex cap);
 CF_EXPORT void _CFSetSetCapacity(CFMutableSetRef set, CFIndex cap);
 
+// Switches a mutable bag, dictionary or set between the default linear probing and grouped probing, which
+// compares sixteen stored hash fragments at a time and is faster for lookups in large collections.
+CF_EXPORT void _CFBagSetGroupedHashing(CFMutableBagRef bag, Boolean grouped);
+CF_EXPORT void _CFDictionarySetGroupedHashing(CFMutableDictionaryRef dict, Boolean grouped);
+CF_EXPORT void _CFSetSetGroupedHashing(CFMutableSetRef set, Boolean grouped);
+
 CF_EXPORT void CFCharacterSetCompact(CFMutableCharacterSetRef theSet);
 CF_EXPORT void CFCharacterSetFast(CFMutableCharacterSetRef theSet);
 
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2019 Apple Inc.  All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+/**
+ * @file bench-densemap.cpp
+ *
+ * objc::DenseMap in the shape of the side table's RefcountMap, with
+ * std::unordered_map as a baseline.
+ */
+
+#include "hostbench.h"
+#include "llvm-DenseMap.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+using namespace hostbench;
+
+namespace {
+
+// Same as NSObject.mm.
+struct RefcountMapValuePurgeable {
+    static inline bool isPurgeable(size_t x) {
+        return x == 0;
+    }
+};
+
+typedef objc::DenseMap<DisguisedPtr<objc_object>,size_t,RefcountMapValuePurgeable> RefcountMap;
+
+// Rough footprint of a node-based map: the bucket array plus one
+// allocation per entry holding the next pointer, the hash and the pair.
+template <typename Map>
+static double unorderedBytesPerEntry(const Map& map)
+{
+    size_t node = sizeof(void *) + sizeof(size_t) + sizeof(typename Map::value_type);
+    node = (node + 15) & ~(size_t)15;
+    return (double)(map.bucket_count() * sizeof(void *) + map.size() * node)
+        / map.size();
+}
+
+static void runDenseMap(size_t count)
+{
+    std::vector<objc_object *> objects = makeObjects(count);
+    std::vector<objc_object *> others = makeObjects(count);
+    std::vector<objc_object *> shuffled = objects;
+    Random random(count);
+    for (size_t i = count - 1; i > 0; i--) {
+        std::swap(shuffled[i], shuffled[random.next() % (i + 1)]);
+    }
+
+    RefcountMap map;
+    uint64_t start = nanoseconds();
+    for (auto obj : objects) map[obj] += 2;
+    uint64_t insertTime = nanoseconds() - start;
+    report("densemap", "insert", count, count, insertTime,
+           (double)map.getMemorySize() / map.size());
+
+    size_t found = 0;
+    start = nanoseconds();
+    for (auto obj : shuffled) {
+        auto it = map.find(obj);
+        if (it != map.end()) found += it->second;
+    }
+    report("densemap", "find (hit, random order)", count, count, 
+           nanoseconds() - start);
+    if (found != count * 2) _objc_fatal("densemap lost entries");
+
+    start = nanoseconds();
+    for (auto obj : others) {
+        if (map.find(obj) != map.end()) found++;
+    }
+    report("densemap", "find (miss)", count, count, nanoseconds() - start);
+    if (found != count * 2) _objc_fatal("densemap found missing keys");
+
+    start = nanoseconds();
+    for (auto obj : shuffled) {
+        auto it = map.find(obj);
+        it->second -= 2;
+        if (it->second == 0) map.erase(it);
+    }
+    report("densemap", "erase", count, count, nanoseconds() - start);
+    if (map.size() != 0) _objc_fatal("densemap kept entries");
+
+    // Retain/release churn: the table stays small but entries come and go.
+    start = nanoseconds();
+    size_t churn = count * 4;
+    for (size_t i = 0; i < churn; i++) {
+        objc_object *obj = objects[random.next() % count];
+        auto& refcnt = map[obj];
+        refcnt += 2;
+        if (i % 2) map.erase(obj);
+    }
+    report("densemap", "insert/erase churn", map.size(), churn, 
+           nanoseconds() - start);
+
+    std::unordered_map<objc_object *, size_t> baseline;
+    start = nanoseconds();
+    for (auto obj : objects) baseline[obj] += 2;
+    report("unordered", "insert", count, count, nanoseconds() - start,
+           unorderedBytesPerEntry(baseline));
+
+    start = nanoseconds();
+    for (auto obj : shuffled) {
+        auto it = baseline.find(obj);
+        if (it != baseline.end()) found += it->second;
+    }
+    report("unordered", "find (hit, random order)", count, count,
+           nanoseconds() - start);
+    if (found != count * 4) _objc_fatal("unordered_map lost entries");
+
+    start = nanoseconds();
+    for (auto obj : shuffled) baseline.erase(obj);
+    report("unordered", "erase", count, count, nanoseconds() - start);
+
+    freeObjects(objects);
+    freeObjects(others);
+}
+
+};
+
+void hostbench::benchDenseMap()
+{
+    for (size_t count : { 1000, 100000, 1000000 }) {
+        runDenseMap(scaled(count));
+    }
+}
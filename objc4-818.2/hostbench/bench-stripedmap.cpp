@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2019 Apple Inc.  All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+/**
+ * @file bench-stripedmap.cpp
+ *
+ * Side-table-style reference counting from several threads: a
+ * StripedMap of locked RefcountMaps, as NSObject.mm uses, against a
+ * single locked RefcountMap.
+ */
+
+#include "hostbench.h"
+#include "llvm-DenseMap.h"
+
+using namespace hostbench;
+
+namespace {
+
+// Same as NSObject.mm.
+struct RefcountMapValuePurgeable {
+    static inline bool isPurgeable(size_t x) {
+        return x == 0;
+    }
+};
+
+typedef objc::DenseMap<DisguisedPtr<objc_object>,size_t,RefcountMapValuePurgeable> RefcountMap;
+
+struct HostSideTable {
+    spinlock_t slock;
+    RefcountMap refcnts;
+};
+
+struct ContentionContext {
+    StripedMap<HostSideTable> *striped;
+    HostSideTable *single;
+    std::vector<objc_object *> *objects;
+    size_t objectsPerThread;  // 0: all threads share all objects
+    size_t perThread;
+};
+
+static void retainRelease(unsigned index, void *arg)
+{
+    auto ctx = (ContentionContext *)arg;
+    auto& objects = *ctx->objects;
+    size_t base = 0, range = objects.size();
+    if (ctx->objectsPerThread) {
+        base = index * ctx->objectsPerThread;
+        range = ctx->objectsPerThread;
+    }
+
+    Random random(index + 1);
+    for (size_t i = 0; i < ctx->perThread; i++) {
+        objc_object *obj = objects[base + random.next() % range];
+        HostSideTable& table = ctx->striped ? (*ctx->striped)[obj] : *ctx->single;
+        // retain, then release, each under the table lock
+        table.slock.lock();
+        table.refcnts[obj] += 4;
+        table.slock.unlock();
+        table.slock.lock();
+        auto it = table.refcnts.find(obj);
+        it->second -= 4;
+        if (it->second == 0) table.refcnts.erase(it);
+        table.slock.unlock();
+    }
+}
+
+static void runContention(bool shared)
+{
+    size_t perThread = scaled(1000000);
+    size_t objectsPerThread = 1024;
+    auto striped = new StripedMap<HostSideTable>;
+    auto single = new HostSideTable;
+
+    for (unsigned threads = 1; threads <= options.threads; threads *= 2) {
+        std::vector<objc_object *> objects = makeObjects(objectsPerThread * threads);
+        ContentionContext ctx = { 
+            striped, nullptr, &objects, shared ? 0 : objectsPerThread, perThread 
+        };
+        char name[48];
+
+        uint64_t ns = runThreads(threads, retainRelease, &ctx);
+        snprintf(name, sizeof(name), "striped %s x%u threads", 
+                 shared ? "shared" : "private", threads);
+        report("stripedmap", name, objects.size(), perThread * threads * 2, ns);
+
+        ctx.striped = nullptr;
+        ctx.single = single;
+        ns = runThreads(threads, retainRelease, &ctx);
+        snprintf(name, sizeof(name), "1 lock %s x%u threads", 
+                 shared ? "shared" : "private", threads);
+        report("stripedmap", name, objects.size(), perThread * threads * 2, ns);
+
+        freeObjects(objects);
+    }
+
+    delete striped;
+    delete single;
+}
+
+};
+
+void hostbench::benchStripedMap()
+{
+    // Threads touching only their own objects contend only where
+    // objects share a stripe; threads sharing objects contend for real.
+    runContention(false);
+    runContention(true);
+}
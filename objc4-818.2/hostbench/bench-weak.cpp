@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2019 Apple Inc.  All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+/**
+ * @file bench-weak.cpp
+ *
+ * The weak reference table from objc-weak.mm: registering, clearing
+ * and unregistering weak variables, with objects that have few enough
+ * referrers to stay inline and objects that go out of line.
+ */
+
+#include "hostbench.h"
+#include "objc-weak.h"
+
+using namespace hostbench;
+
+namespace {
+
+static objc_class HostClass;
+
+static double weakBytesPerEntry(weak_table_t *table)
+{
+    if (table->num_entries == 0) return 0;
+    size_t bytes = (table->mask + 1) * sizeof(weak_entry_t);
+    for (size_t i = 0; i <= table->mask; i++) {
+        weak_entry_t *entry = &table->weak_entries[i];
+        if (entry->referent  &&  entry->out_of_line()) {
+            bytes += (entry->mask + 1) * sizeof(weak_referrer_t);
+        }
+    }
+    return (double)bytes / table->num_entries;
+}
+
+static void runWeak(size_t count, unsigned referrers)
+{
+    std::vector<objc_object *> objects = makeObjects(count);
+    for (auto obj : objects) obj->isa = &HostClass;
+    std::vector<id> slots(count * referrers);
+    weak_table_t table = {};
+
+    char name[32];
+    size_t ops = count * referrers;
+
+    uint64_t start = nanoseconds();
+    for (unsigned r = 0; r < referrers; r++) {
+        for (size_t i = 0; i < count; i++) {
+            id *slot = &slots[i * referrers + r];
+            *slot = (id)objects[i];
+            weak_register_no_lock(&table, *slot, slot, ReturnNilIfDeallocating);
+        }
+    }
+    snprintf(name, sizeof(name), "register (%u per object)", referrers);
+    report("weak", name, count, ops, nanoseconds() - start,
+           weakBytesPerEntry(&table));
+
+    // Unregister half the referrers of every object...
+    start = nanoseconds();
+    size_t unregistered = 0;
+    for (unsigned r = 0; r < referrers; r += 2) {
+        for (size_t i = 0; i < count; i++) {
+            id *slot = &slots[i * referrers + r];
+            weak_unregister_no_lock(&table, *slot, slot);
+            *slot = nil;
+            unregistered++;
+        }
+    }
+    snprintf(name, sizeof(name), "unregister (%u per object)", 
+             (referrers + 1) / 2);
+    report("weak", name, count, unregistered, nanoseconds() - start);
+
+    // ...then clear the rest as the objects deallocate.
+    start = nanoseconds();
+    for (size_t i = 0; i < count; i++) {
+        weak_clear_no_lock(&table, (id)objects[i]);
+    }
+    report("weak", "clear (object deallocated)", count, count, 
+           nanoseconds() - start);
+
+    if (table.num_entries != 0) _objc_fatal("weak table kept entries");
+    for (auto slot : slots) {
+        if (slot) _objc_fatal("weak variable not cleared");
+    }
+
+    free(table.weak_entries);
+    freeObjects(objects);
+}
+
+};
+
+void hostbench::benchWeakTable()
+{
+    for (size_t count : { 1000, 100000 }) {
+        runWeak(scaled(count), 1);
+        runWeak(scaled(count), WEAK_INLINE_COUNT);
+        runWeak(scaled(count), 16);
+    }
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2019 Apple Inc.  All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+/**
+ * @file bench-zalloc.cpp
+ *
+ * objc::zalloc() for element sizes that are not a multiple of the
+ * malloc alignment, against calloc(), on one thread and on several
+ * threads sharing the zone's lock-free free list.
+ */
+
+#include "hostbench.h"
+#include "objc-zalloc.cpp"
+
+#include <malloc.h>
+
+using namespace hostbench;
+
+namespace {
+
+// Sizes of class_rw_t and class_rw_ext_t on LP64.
+struct Element24 { void *words[3]; };
+struct Element40 { void *words[5]; };
+
+};
+
+namespace objc {
+template class Zone<Element24, false>;
+template class Zone<Element40, false>;
+};
+
+namespace {
+
+template <typename T>
+struct ChurnContext {
+    size_t perThread;
+    bool useZone;
+};
+
+template <typename T>
+static void churn(unsigned index, void *arg)
+{
+    auto ctx = (ChurnContext<T> *)arg;
+    std::vector<T *> live(64);
+    Random random(index + 1);
+    for (size_t i = 0; i < ctx->perThread; i++) {
+        T *&slot = live[random.next() % live.size()];
+        if (slot) {
+            if (ctx->useZone) objc::zfree(slot);
+            else free(slot);
+        }
+        slot = ctx->useZone ? objc::zalloc<T>() : (T *)calloc(1, sizeof(T));
+    }
+    for (auto e : live) {
+        if (ctx->useZone) objc::zfree(e);
+        else free(e);
+    }
+}
+
+template <typename T>
+static void runZalloc(const char *type, size_t count)
+{
+    std::vector<T *> elements(count);
+    char name[48];
+
+    uint64_t start = nanoseconds();
+    for (size_t i = 0; i < count; i++) elements[i] = objc::zalloc<T>();
+    snprintf(name, sizeof(name), "zalloc<%s>", type);
+    report("zalloc", name, count, count, nanoseconds() - start, sizeof(T));
+
+    start = nanoseconds();
+    for (size_t i = 0; i < count; i++) objc::zfree(elements[i]);
+    snprintf(name, sizeof(name), "zfree<%s>", type);
+    report("zalloc", name, count, count, nanoseconds() - start);
+
+    start = nanoseconds();
+    for (size_t i = 0; i < count; i++) {
+        elements[i] = (T *)calloc(1, sizeof(T));
+    }
+    uint64_t callocTime = nanoseconds() - start;
+    // glibc keeps a size word in front of every chunk.
+    snprintf(name, sizeof(name), "calloc(%zu)", sizeof(T));
+    report("calloc", name, count, count, callocTime,
+           malloc_usable_size(elements[0]) + sizeof(size_t));
+
+    start = nanoseconds();
+    for (size_t i = 0; i < count; i++) free(elements[i]);
+    snprintf(name, sizeof(name), "free(%zu)", sizeof(T));
+    report("calloc", name, count, count, nanoseconds() - start);
+
+    for (unsigned threads = 2; threads <= options.threads; threads *= 2) {
+        ChurnContext<T> ctx = { count, true };
+        uint64_t ns = runThreads(threads, churn<T>, &ctx);
+        snprintf(name, sizeof(name), "churn<%s> x%u threads", type, threads);
+        report("zalloc", name, count, count * threads, ns);
+
+        ctx.useZone = false;
+        ns = runThreads(threads, churn<T>, &ctx);
+        snprintf(name, sizeof(name), "churn(%zu) x%u threads", sizeof(T), threads);
+        report("calloc", name, count, count * threads, ns);
+    }
+}
+
+};
+
+void hostbench::benchZalloc()
+{
+    for (size_t count : { 10000, 1000000 }) {
+        runZalloc<Element24>("24", scaled(count));
+        runZalloc<Element40>("40", scaled(count));
+    }
+}
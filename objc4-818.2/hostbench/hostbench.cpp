@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2019 Apple Inc.  All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+/**
+ * @file hostbench.cpp
+ *
+ * Driver for the host-side runtime data structure benchmarks, and the
+ * runtime functions the benchmarked files call.
+ *
+ * usage: hostbench [-t threads] [-s scale%] [densemap|weak|zalloc|stripedmap]...
+ */
+
+#include "hostbench.h"
+
+#include <stdarg.h>
+#include <unistd.h>
+#include <atomic>
+
+namespace hostbench {
+
+Options options = { 8, 100 };
+
+void report(const char *bench, const char *op, size_t entries,
+            size_t ops, uint64_t ns, double bytesPerEntry)
+{
+    double nsPerOp = ops ? (double)ns / ops : 0;
+    double mops = ns ? ops * 1000.0 / ns : 0;
+    if (bytesPerEntry > 0) {
+        printf("%-12s %-28s %10zu %9.1f %9.2f %10.1f\n",
+               bench, op, entries, nsPerOp, mops, bytesPerEntry);
+    } else {
+        printf("%-12s %-28s %10zu %9.1f %9.2f\n",
+               bench, op, entries, nsPerOp, mops);
+    }
+    fflush(stdout);
+}
+
+std::vector<objc_object *> makeObjects(size_t count)
+{
+    std::vector<objc_object *> objects(count);
+    for (size_t i = 0; i < count; i++) {
+        // Mix of the small sizes most objects have.
+        objects[i] = (objc_object *)calloc(1, 16 << (i % 3));
+    }
+    return objects;
+}
+
+void freeObjects(std::vector<objc_object *>& objects)
+{
+    for (auto obj : objects) free(obj);
+    objects.clear();
+}
+
+struct ThreadStart {
+    void (*fn)(unsigned, void *);
+    void *ctx;
+    unsigned index;
+    std::atomic<unsigned> *ready;
+    std::atomic<bool> *go;
+};
+
+static void *threadMain(void *arg)
+{
+    auto start = (ThreadStart *)arg;
+    start->ready->fetch_add(1);
+    while (!start->go->load(std::memory_order_acquire)) { }
+    start->fn(start->index, start->ctx);
+    return nullptr;
+}
+
+uint64_t runThreads(unsigned count, void (*fn)(unsigned, void *), void *ctx)
+{
+    std::vector<pthread_t> threads(count);
+    std::vector<ThreadStart> starts(count);
+    std::atomic<unsigned> ready{0};
+    std::atomic<bool> go{false};
+
+    for (unsigned i = 0; i < count; i++) {
+        starts[i] = ThreadStart{fn, ctx, i, &ready, &go};
+        pthread_create(&threads[i], nullptr, threadMain, &starts[i]);
+    }
+    while (ready.load() != count) { }
+
+    uint64_t start = nanoseconds();
+    go.store(true, std::memory_order_release);
+    for (unsigned i = 0; i < count; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+    return nanoseconds() - start;
+}
+
+};
+
+using namespace hostbench;
+
+
+// Runtime functions called by the benchmarked files.
+
+void _objc_fatal(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "objc[%d]: ", getpid());
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+    abort();
+}
+
+void _objc_inform(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "objc[%d]: ", getpid());
+    vfprintf(stderr, fmt, ap);
+    fprintf(stderr, "\n");
+    va_end(ap);
+}
+
+SEL sel_registerName(const char *name)
+{
+    return (SEL)name;
+}
+
+const char *object_getClassName(id obj __unused)
+{
+    return "HostObject";
+}
+
+void _objc_msgForward(void)
+{
+    _objc_fatal("_objc_msgForward called");
+}
+
+IMP lookUpImpOrForwardTryCache(id obj __unused, SEL sel __unused, 
+                               Class cls __unused)
+{
+    return _objc_msgForward;
+}
+
+
+static const struct {
+    const char *name;
+    void (*fn)();
+} Benchmarks[] = {
+    { "densemap",   benchDenseMap },
+    { "weak",       benchWeakTable },
+    { "zalloc",     benchZalloc },
+    { "stripedmap", benchStripedMap },
+};
+
+static void usage()
+{
+    fprintf(stderr, "usage: hostbench [-t threads] [-s scale%%] "
+            "[densemap|weak|zalloc|stripedmap]...\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int ch;
+    while ((ch = getopt(argc, argv, "t:s:")) != -1) {
+        switch (ch) {
+        case 't': options.threads = (unsigned)atoi(optarg); break;
+        case 's': options.scale = (unsigned)atoi(optarg); break;
+        default: usage();
+        }
+    }
+    if (options.threads == 0 || options.scale == 0) usage();
+    argc -= optind;
+    argv += optind;
+
+    for (int i = 0; i < argc; i++) {
+        bool known = false;
+        for (auto& bench : Benchmarks) {
+            if (0 == strcmp(argv[i], bench.name)) known = true;
+        }
+        if (!known) usage();
+    }
+
+    printf("%-12s %-28s %10s %9s %9s %10s\n",
+           "bench", "operation", "entries", "ns/op", "Mops/s", "bytes/ent");
+
+    for (auto& bench : Benchmarks) {
+        bool selected = (argc == 0);
+        for (int i = 0; i < argc; i++) {
+            if (0 == strcmp(argv[i], bench.name)) selected = true;
+        }
+        if (selected) bench.fn();
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019 Apple Inc.  All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+/**
+ * @file hostbench.h
+ *
+ * Shared helpers for the host-side runtime data structure benchmarks.
+ */
+
+#ifndef _HOSTBENCH_H
+#define _HOSTBENCH_H
+
+#include "objc-private.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+namespace hostbench {
+
+// Command line settings.
+struct Options {
+    unsigned threads;   // maximum thread count for contention runs
+    unsigned scale;     // percent of the default operation counts
+};
+extern Options options;
+
+static inline uint64_t nanoseconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline size_t scaled(size_t count)
+{
+    size_t result = count * options.scale / 100;
+    return result ? result : 1;
+}
+
+// Prints one result row. bytesPerEntry of 0 leaves the column blank.
+void report(const char *bench, const char *op, size_t entries,
+            size_t ops, uint64_t ns, double bytesPerEntry = 0);
+
+// Fake objects with malloc-like addresses, so pointer hashes see the
+// same low-bit patterns they see in the runtime.
+std::vector<objc_object *> makeObjects(size_t count);
+void freeObjects(std::vector<objc_object *>& objects);
+
+// Runs fn(thread index) on count threads started together.
+// Returns the wall time from release to the last thread finishing.
+uint64_t runThreads(unsigned count, void (*fn)(unsigned, void *), void *ctx);
+
+// Deterministic per-thread random numbers.
+struct Random {
+    uint64_t state;
+    Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) { }
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+void benchDenseMap();
+void benchWeakTable();
+void benchZalloc();
+void benchStripedMap();
+
+};
+
+#endif
@@ -0,0 +1,22 @@
+/*
+ * TargetConditionals.h for hostbench.
+ * Linux host: no Apple platform is the target.
+ */
+
+#ifndef __TARGETCONDITIONALS__
+#define __TARGETCONDITIONALS__
+
+#define TARGET_OS_MAC               0
+#define TARGET_OS_OSX               0
+#define TARGET_OS_IPHONE            0
+#define TARGET_OS_IOS               0
+#define TARGET_OS_WATCH             0
+#define TARGET_OS_TV                0
+#define TARGET_OS_BRIDGE            0
+#define TARGET_OS_MACCATALYST       0
+#define TARGET_OS_SIMULATOR         0
+#define TARGET_OS_EMBEDDED          0
+#define TARGET_OS_WIN32             0
+#define TARGET_OS_LINUX             1
+
+#endif
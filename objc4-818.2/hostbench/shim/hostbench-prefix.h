@@ -0,0 +1,25 @@
+/*
+ * hostbench-prefix.h
+ * Included before every hostbench source file. Fills in the compiler
+ * and libc extensions the runtime sources expect from clang and Darwin.
+ */
+
+#ifndef _HOSTBENCH_PREFIX_H
+#define _HOSTBENCH_PREFIX_H
+
+#include <sys/param.h>  // powerof2
+#include <malloc.h>
+
+#ifndef __has_feature
+// Features not listed here are reported as missing.
+#   define __has_feature(x) __hostbench_has_feature_##x
+#   define __hostbench_has_feature_cxx_alignas 1
+#endif
+
+#ifndef __unused
+#   define __unused __attribute__((unused))
+#endif
+
+#define malloc_size(p) malloc_usable_size((void *)(p))
+
+#endif
@@ -0,0 +1,4 @@
+/*
+ * libkern/OSAtomic.h for hostbench.
+ * Nothing the benchmarked runtime files use is declared here.
+ */
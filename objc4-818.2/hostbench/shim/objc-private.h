@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2019 Apple Inc.  All Rights Reserved.
+ *
+ * @APPLE_LICENSE_HEADER_START@
+ *
+ * This file contains Original Code and/or Modifications of Original Code
+ * as defined in and that are subject to the Apple Public Source License
+ * Version 2.0 (the 'License'). You may not use this file except in
+ * compliance with the License. Please obtain a copy of the License at
+ * http://www.opensource.apple.com/apsl/ and read it before using this
+ * file.
+ *
+ * The Original Code and all software distributed under the License are
+ * distributed on an 'AS IS' basis, WITHOUT WARRANTY OF ANY KIND, EITHER
+ * EXPRESS OR IMPLIED, AND APPLE HEREBY DISCLAIMS ALL SUCH WARRANTIES,
+ * INCLUDING WITHOUT LIMITATION, ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, QUIET ENJOYMENT OR NON-INFRINGEMENT.
+ * Please see the License for the specific language governing rights and
+ * limitations under the License.
+ *
+ * @APPLE_LICENSE_HEADER_END@
+ */
+
+/**
+ * @file objc-private.h (hostbench)
+ *
+ * Stands in for runtime/objc-private.h when hostbench compiles the
+ * runtime's data structures on a non-Darwin host. The build copies it
+ * next to the runtime files so their #include "objc-private.h" finds
+ * it instead of the real one.
+ *
+ * Declarations here mirror the runtime's. ptr_hash() and DisguisedPtr
+ * must stay identical to objc-private.h or the numbers mean nothing.
+ */
+
+#ifndef _OBJC_PRIVATE_H_
+#define _OBJC_PRIVATE_H_
+
+#include <TargetConditionals.h>
+#include <objc/objc.h>
+#include "objc-config.h"
+
+#include <cstddef>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+// An assert that's disabled for release builds but still ensures the expression compiles.
+#ifdef NDEBUG
+#define ASSERT(x) (void)sizeof(!(x))
+#else
+#define ASSERT(x) assert(x)
+#endif
+
+#define fastpath(x) (__builtin_expect(bool(x), 1))
+#define slowpath(x) (__builtin_expect(bool(x), 0))
+
+#define BREAKPOINT_FUNCTION(prototype)                             \
+    OBJC_EXTERN __attribute__((noinline, used, visibility("hidden"))) \
+    prototype { asm(""); }
+
+extern "C" void _objc_fatal(const char *fmt, ...)
+    __attribute__((noreturn, format(printf, 1, 2)));
+extern "C" void _objc_inform(const char *fmt, ...)
+    __attribute__((format(printf, 1, 2)));
+
+static inline void
+lockdebug_lock_precedes_lock(const void *, const void *) { }
+
+
+// Objects as the weak table sees them. hostbench objects are never
+// tagged, never deallocating, and have no custom retain/release.
+struct objc_class;
+
+struct objc_object {
+    Class isa;
+
+    bool isTaggedPointerOrNil() { return (uintptr_t)this == 0; }
+    Class ISA() { return isa; }
+    Class getIsa() { return isa; }
+    bool rootIsDeallocating() { return false; }
+};
+
+struct objc_class : objc_object {
+    bool hasCustomRR() { return false; }
+};
+
+extern "C" SEL sel_registerName(const char *name);
+extern "C" const char *object_getClassName(id obj);
+extern "C" void _objc_msgForward(void);
+extern IMP lookUpImpOrForwardTryCache(id obj, SEL sel, Class cls);
+
+
+// spinlock_t is os_unfair_lock in the runtime. The nearest host lock
+// is a default pthread mutex, which also spins briefly in user space
+// before sleeping in the kernel.
+class mutex_tt {
+    pthread_mutex_t mLock;
+
+  public:
+    constexpr mutex_tt() : mLock(PTHREAD_MUTEX_INITIALIZER) { }
+
+    void lock() { pthread_mutex_lock(&mLock); }
+    void unlock() { pthread_mutex_unlock(&mLock); }
+    void forceReset() { mLock = PTHREAD_MUTEX_INITIALIZER; }
+
+    class locker {
+        mutex_tt& lock;
+      public:
+        locker(mutex_tt& newLock) : lock(newLock) { lock.lock(); }
+        ~locker() { lock.unlock(); }
+    };
+};
+
+using spinlock_t = mutex_tt;
+using mutex_t = mutex_tt;
+using mutex_locker_t = mutex_tt::locker;
+
+
+static __inline uint32_t _objc_strhash(const char *s) {
+    uint32_t hash = 0;
+    for (;;) {
+    int a = *s++;
+    if (0 == a) break;
+    hash += (hash << 8) + a;
+    }
+    return hash;
+}
+
+// Pointer hash function.
+// This is not a terrific hash, but it is fast
+// and not outrageously flawed for our purposes.
+
+// Based on principles from http://locklessinc.com/articles/fast_hash/
+// and evaluation ideas from http://floodyberry.com/noncryptohashzoo/
+#if __LP64__
+static inline uint32_t ptr_hash(uint64_t key)
+{
+    key ^= key >> 4;
+    key *= 0x8a970be7488fda55;
+    key ^= __builtin_bswap64(key);
+    return (uint32_t)key;
+}
+#else
+static inline uint32_t ptr_hash(uint32_t key)
+{
+    key ^= key >> 4;
+    key *= 0x5052acdb;
+    key ^= __builtin_bswap32(key);
+    return key;
+}
+#endif
+
+
+#include "objc-stripedmap.h"
+
+
+// DisguisedPtr<T> acts like pointer type T*, except the
+// stored value is disguised to hide it from tools like `leaks`.
+// nil is disguised as itself so zero-filled memory works as expected,
+// which means 0x80..00 is also disguised as itself but we don't care.
+// Note that weak_entry_t knows about this encoding.
+template <typename T>
+class DisguisedPtr {
+    uintptr_t value;
+
+    static uintptr_t disguise(T* ptr) {
+        return -(uintptr_t)ptr;
+    }
+
+    static T* undisguise(uintptr_t val) {
+        return (T*)-val;
+    }
+
+ public:
+    DisguisedPtr() { }
+    DisguisedPtr(T* ptr)
+        : value(disguise(ptr)) { }
+    DisguisedPtr(const DisguisedPtr<T>& ptr)
+        : value(ptr.value) { }
+
+    DisguisedPtr<T>& operator = (T* rhs) {
+        value = disguise(rhs);
+        return *this;
+    }
+    DisguisedPtr<T>& operator = (const DisguisedPtr<T>& rhs) {
+        value = rhs.value;
+        return *this;
+    }
+
+    operator T* () const {
+        return undisguise(value);
+    }
+    T* operator -> () const {
+        return undisguise(value);
+    }
+    T& operator * () const {
+        return *undisguise(value);
+    }
+    T& operator [] (size_t i) const {
+        return undisguise(value)[i];
+    }
+
+    // pointer arithmetic operators omitted
+    // because we don't currently use them anywhere
+};
+
+#endif
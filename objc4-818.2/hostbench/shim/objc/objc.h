@@ -0,0 +1,26 @@
+/*
+ * objc/objc.h for hostbench.
+ * Just enough of the public types for the runtime's data structures.
+ */
+
+#ifndef _OBJC_OBJC_H_
+#define _OBJC_OBJC_H_
+
+#include <sys/cdefs.h>
+#include <stdbool.h>
+
+typedef struct objc_class *Class;
+typedef struct objc_object *id;
+typedef struct objc_selector *SEL;
+typedef void (*IMP)(void);
+typedef bool BOOL;
+
+#define YES true
+#define NO  false
+#define nil nullptr
+#define Nil nullptr
+
+#define OBJC_EXTERN extern "C"
+#define OBJC_EXPORT extern "C"
+
+#endif
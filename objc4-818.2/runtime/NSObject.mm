@@ -37,6 +37,7 @@
 #include <sys/mman.h>
 #include <Block.h>
 #include <map>
+#include <algorithm>
 #include <execinfo.h>
 #include "NSObject-internal.h"
 //#include <os/feature_private.h>
@@ -119,8 +120,18 @@ static void _initializeSwiftRefcountingThenCallRelease(id objc) {
 
 namespace objc {
     extern int PageCountWarning;
+    extern unsigned PoolPageCacheSize;
 }
 
+// for _objc_autoreleasePoolGetStatistics()
+static struct {
+    std::atomic<size_t> allocated;
+    std::atomic<size_t> freed;
+    std::atomic<size_t> reused;
+    std::atomic<size_t> inUse;
+    std::atomic<size_t> highWater;
+} PoolPageStats;
+
 namespace {
 
 #if TARGET_OS_IPHONE && !TARGET_OS_SIMULATOR
@@ -164,6 +175,7 @@ struct SideTable {
     }
 
     void lock() { slock.lock(); }
+    bool tryLock() { return slock.tryLock(); }
     void unlock() { slock.unlock(); }
     void forceReset() { slock.forceReset(); }
 
@@ -267,6 +279,21 @@ void SideTableLocksSucceedLocks(StripedMap<spinlock_t>& oldlocks) {
     }
 }
 
+// Objects with weak references and weak table entries allocated, 
+// summed over all side tables. For _objc_getPerformanceCounters().
+void weak_table_getSizes(size_t *referents, size_t *capacity) {
+    *referents = 0;
+    *capacity = 0;
+    SideTables().forEach([&](SideTable& table) {
+        table.lock();
+        *referents += table.weak_table.num_entries;
+        if (table.weak_table.weak_entries) {
+            *capacity += table.weak_table.mask + 1;
+        }
+        table.unlock();
+    });
+}
+
 // Call out to the _setWeaklyReferenced method on obj, if implemented.
 static void callSetWeaklyReferenced(id obj) {
     if (!obj)
@@ -713,10 +740,24 @@ private:
 
     // SIZE-sizeof(*this) bytes of contents follow
 
+    // Page statistics are process-wide atomics rather than per-thread 
+    // data, so that pages are counted on every thread, including during 
+    // thread teardown, without allocating anything to count them.
     static void * operator new(size_t size) {
+        size_t inUse = 
+            PoolPageStats.inUse.fetch_add(1, std::memory_order_relaxed) + 1;
+        PoolPageStats.allocated.fetch_add(1, std::memory_order_relaxed);
+        size_t highWater = 
+            PoolPageStats.highWater.load(std::memory_order_relaxed);
+        while (inUse > highWater  &&  
+               !PoolPageStats.highWater.compare_exchange_weak
+               (highWater, inUse, std::memory_order_relaxed))
+            ;
         return malloc_zone_memalign(malloc_default_zone(), SIZE, SIZE);
     }
     static void operator delete(void * p) {
+        PoolPageStats.inUse.fetch_sub(1, std::memory_order_relaxed);
+        PoolPageStats.freed.fetch_add(1, std::memory_order_relaxed);
         return free(p);
     }
 
@@ -851,6 +892,47 @@ private:
         return (next - begin() < (end() - begin()) / 2);
     }
 
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+    // Try to fold obj into one of the most recent entries on this page 
+    // by bumping that entry's count. This also works on a full page.
+    // Returns the entry used, or nil if obj needs an entry of its own.
+    // The page must be unprotected.
+    id *coalesce(id obj)
+    {
+        if (DisableAutoreleaseCoalescing && DisableAutoreleaseCoalescingLRU) {
+            return nil;
+        }
+        if (empty() || (obj == POOL_BOUNDARY)) {
+            return nil;
+        }
+
+        AutoreleasePoolEntry *topEntry = (AutoreleasePoolEntry *)next - 1;
+        if (!DisableAutoreleaseCoalescingLRU) {
+            for (uintptr_t offset = 0; offset < 4; offset++) {
+                AutoreleasePoolEntry *offsetEntry = topEntry - offset;
+                if (offsetEntry <= (AutoreleasePoolEntry*)begin() || *(id *)offsetEntry == POOL_BOUNDARY) {
+                    break;
+                }
+                if (offsetEntry->ptr == (uintptr_t)obj && offsetEntry->count < AutoreleasePoolEntry::maxCount) {
+                    if (offset > 0) {
+                        AutoreleasePoolEntry found = *offsetEntry;
+                        memmove(offsetEntry, offsetEntry + 1, offset * sizeof(*offsetEntry));
+                        *topEntry = found;
+                    }
+                    topEntry->count++;
+                    return (id *)topEntry;
+                }
+            }
+        } else {
+            if (topEntry->ptr == (uintptr_t)obj && topEntry->count < AutoreleasePoolEntry::maxCount) {
+                topEntry->count++;
+                return (id *)topEntry;
+            }
+        }
+        return nil;
+    }
+#endif
+
     id *add(id obj)
     {
         ASSERT(!full());
@@ -858,37 +940,8 @@ private:
         id *ret;
 
 #if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
-        if (!DisableAutoreleaseCoalescing || !DisableAutoreleaseCoalescingLRU) {
-            if (!DisableAutoreleaseCoalescingLRU) {
-                if (!empty() && (obj != POOL_BOUNDARY)) {
-                    AutoreleasePoolEntry *topEntry = (AutoreleasePoolEntry *)next - 1;
-                    for (uintptr_t offset = 0; offset < 4; offset++) {
-                        AutoreleasePoolEntry *offsetEntry = topEntry - offset;
-                        if (offsetEntry <= (AutoreleasePoolEntry*)begin() || *(id *)offsetEntry == POOL_BOUNDARY) {
-                            break;
-                        }
-                        if (offsetEntry->ptr == (uintptr_t)obj && offsetEntry->count < AutoreleasePoolEntry::maxCount) {
-                            if (offset > 0) {
-                                AutoreleasePoolEntry found = *offsetEntry;
-                                memmove(offsetEntry, offsetEntry + 1, offset * sizeof(*offsetEntry));
-                                *topEntry = found;
-                            }
-                            topEntry->count++;
-                            ret = (id *)topEntry;  // need to reset ret
-                            goto done;
-                        }
-                    }
-                }
-            } else {
-                if (!empty() && (obj != POOL_BOUNDARY)) {
-                    AutoreleasePoolEntry *prevEntry = (AutoreleasePoolEntry *)next - 1;
-                    if (prevEntry->ptr == (uintptr_t)obj && prevEntry->count < AutoreleasePoolEntry::maxCount) {
-                        prevEntry->count++;
-                        ret = (id *)prevEntry;  // need to reset ret
-                        goto done;
-                    }
-                }
-            }
+        if ((ret = coalesce(obj))) {
+            goto done;
         }
 #endif
         ret = next;  // faster than `return next-1` because of aliasing
@@ -959,6 +1012,19 @@ private:
 #endif
     }
 
+    // Keep up to `keep` empty children of this page for reuse 
+    // and free the rest.
+    void trimChildren(size_t keep)
+    {
+        AutoreleasePoolPage *page = this;
+        while (keep > 0  &&  page->child) {
+            ASSERT(page->child->empty());
+            page = page->child;
+            keep--;
+        }
+        if (page->child) page->child->kill();
+    }
+
     void kill() 
     {
         // Not recursive: we don't want to blow out the stack 
@@ -1083,8 +1149,22 @@ private:
         ASSERT(page == hotPage());
         ASSERT(page->full()  ||  DebugPoolAllocation);
 
+#if SUPPORT_AUTORELEASEPOOL_DEDUP_PTRS
+        // A repeated autorelease of the same object can still be 
+        // folded into the full page instead of starting the next one.
+        if (page->full()) {
+            page->unprotect();
+            id *ret = page->coalesce(obj);
+            page->protect();
+            if (ret) return ret;
+        }
+#endif
+
         do {
-            if (page->child) page = page->child;
+            if (page->child) {
+                page = page->child;
+                PoolPageStats.reused.fetch_add(1, std::memory_order_relaxed);
+            }
             else page = new AutoreleasePoolPage(page);
         } while (page->full());
 
@@ -1222,13 +1302,11 @@ public:
             page->kill();
             setHotPage(nil);
         } else if (page->child) {
-            // hysteresis: keep one empty child if page is more than half full
-            if (page->lessThanHalfFull()) {
-                page->child->kill();
-            }
-            else if (page->child->child) {
-                page->child->child->kill();
-            }
+            // hysteresis: keep up to PoolPageCacheSize empty children, 
+            // one fewer if page is less than half full
+            size_t keep = objc::PoolPageCacheSize;
+            if (keep > 0  &&  page->lessThanHalfFull()) keep--;
+            page->trimChildren(keep);
         }
     }
 
@@ -1636,6 +1714,23 @@ objc_object::sidetable_retain(bool locked)
 }
 
 
+// Same as sidetable_retain(), for callers that hold the side table lock 
+// and keep holding it afterwards.
+void
+objc_object::sidetable_retain_nolock()
+{
+#if SUPPORT_NONPOINTER_ISA
+    ASSERT(!isa.nonpointer);
+#endif
+    SideTable& table = SideTables()[this];
+
+    size_t& refcntStorage = table.refcnts[this];
+    if (! (refcntStorage & SIDE_TABLE_RC_PINNED)) {
+        refcntStorage += SIDE_TABLE_RC_ONE;
+    }
+}
+
+
 bool
 objc_object::sidetable_tryRetain()
 {
@@ -1746,6 +1841,178 @@ objc_object::sidetable_setWeaklyReferenced_nolock()
 }
 
 
+/***********************************************************************
+* Deferred side table releases
+* With OBJC_DEFER_SIDE_TABLE_RELEASES, a release that needs its SideTable 
+* and finds the lock held by another thread records the release in a 
+* per-thread buffer instead of waiting. That is every release of a raw-isa 
+* object, and a release of a nonpointer isa object whose inline extra_rc 
+* underflows into the side table. The buffer is applied later with 
+* one lock acquisition per side table: when it fills, when the thread 
+* pops an autorelease pool, when it calls _objc_flushDeferredReleases(), 
+* and when it exits.
+*
+* Retains are never deferred, so a pending release only keeps an object 
+* alive longer. The object is deallocated by whichever thread applies 
+* its last release, possibly at that thread's next flush.
+*
+* The buffer lives in the thread's objc pthread data, and a release never 
+* creates that data: a thread without it waits for the lock as usual. 
+* Otherwise a release during thread teardown could resurrect the data.
+**********************************************************************/
+
+struct DeferredReleases {
+    enum { Capacity = 16 };
+
+    struct Entry {
+        objc_object *obj;
+        uintptr_t count;
+    };
+
+    unsigned used;
+    Entry entries[Capacity];
+};
+
+static DeferredReleases *deferredReleases(bool create)
+{
+    _objc_pthread_data *data = _objc_fetch_pthread_data(false);
+    if (!data) return nil;
+
+    DeferredReleases *buffer = data->deferredReleases;
+    if (!buffer  &&  create) {
+        buffer = (DeferredReleases *)calloc(1, sizeof(DeferredReleases));
+        data->deferredReleases = buffer;
+    }
+    return buffer;
+}
+
+// Apply count releases to a raw-isa object's side table entry.
+// Returns true if the object should now be deallocated.
+static bool
+sidetable_releaseMany_nolock(SideTable& table, objc_object *obj, 
+                             uintptr_t count)
+{
+    auto it = table.refcnts.try_emplace(obj, 0);
+    auto &refcnt = it.first->second;
+    if (refcnt & (SIDE_TABLE_DEALLOCATING | SIDE_TABLE_RC_PINNED)) {
+        return false;
+    }
+    if ((refcnt >> SIDE_TABLE_RC_SHIFT) >= count) {
+        refcnt -= count << SIDE_TABLE_RC_SHIFT;
+        return false;
+    }
+    // SIDE_TABLE_WEAKLY_REFERENCED may be set. Don't change it.
+    refcnt = (refcnt & SIDE_TABLE_FLAG_MASK) | SIDE_TABLE_DEALLOCATING;
+    return true;
+}
+
+// Apply count releases to any object, with its side table locked.
+// Returns true if the object should now be deallocated.
+static bool
+releaseMany_nolock(SideTable& table, objc_object *obj, uintptr_t count)
+{
+    if (!obj->hasNonpointerIsa()) {
+        return sidetable_releaseMany_nolock(table, obj, count);
+    }
+
+    bool dealloc = false;
+    while (count--) {
+        if (obj->rootReleaseLocked()) dealloc = true;
+    }
+    return dealloc;
+}
+
+static void flushDeferredReleases(DeferredReleases *buffer)
+{
+    // Copy out the entries first: -dealloc may release more objects
+    // and defer them into this same buffer.
+    DeferredReleases::Entry entries[DeferredReleases::Capacity];
+    unsigned count = buffer->used;
+    memcpy(entries, buffer->entries, count * sizeof(entries[0]));
+    buffer->used = 0;
+
+    objc_object *dealloc[DeferredReleases::Capacity];
+    unsigned deallocCount = 0;
+
+    // Apply the releases one side table at a time.
+    while (count > 0) {
+        SideTable& table = SideTables()[entries[0].obj];
+        table.lock();
+        unsigned kept = 0;
+        for (unsigned i = 0; i < count; i++) {
+            if (&SideTables()[entries[i].obj] != &table) {
+                entries[kept++] = entries[i];
+            } else if (releaseMany_nolock(table, entries[i].obj, 
+                                          entries[i].count)) 
+            {
+                dealloc[deallocCount++] = entries[i].obj;
+            }
+        }
+        table.unlock();
+        count = kept;
+    }
+
+    for (unsigned i = 0; i < deallocCount; i++) {
+        ((void(*)(objc_object *, SEL))objc_msgSend)(dealloc[i], @selector(dealloc));
+    }
+}
+
+// Returns false if this thread can't defer releases.
+static bool deferRelease(objc_object *obj)
+{
+    DeferredReleases *buffer = deferredReleases(true);
+    if (!buffer) return false;
+
+    for (unsigned i = 0; i < buffer->used; i++) {
+        if (buffer->entries[i].obj == obj) {
+            buffer->entries[i].count++;
+            return true;
+        }
+    }
+
+    if (buffer->used == DeferredReleases::Capacity) {
+        flushDeferredReleases(buffer);
+    }
+    buffer->entries[buffer->used++] = { obj, 1 };
+    return true;
+}
+
+// Lock this object's side table for a release, or if another thread 
+// holds the lock, defer the release instead.
+// Returns false if the release was deferred.
+bool
+objc_object::sidetable_lockOrDeferRelease()
+{
+    SideTable& table = SideTables()[this];
+    if (table.tryLock()) return true;
+    if (deferRelease(this)) return false;
+    table.lock();
+    return true;
+}
+
+static inline void flushDeferredReleasesIfNeeded()
+{
+    if (slowpath(DeferSideTableReleases)) {
+        DeferredReleases *buffer = deferredReleases(false);
+        if (buffer  &&  buffer->used) flushDeferredReleases(buffer);
+    }
+}
+
+void _objc_flushDeferredReleases(void)
+{
+    flushDeferredReleasesIfNeeded();
+}
+
+void _destroyDeferredReleases(struct DeferredReleases *buffer)
+{
+    if (buffer) {
+        // -dealloc may defer more releases into the buffer being flushed.
+        while (buffer->used) flushDeferredReleases(buffer);
+        free(buffer);
+    }
+}
+
+
 // rdar://20206767
 // return uintptr_t instead of bool so that the various raw-isa 
 // -release paths all return zero in eax
@@ -1759,7 +2026,13 @@ objc_object::sidetable_release(bool locked, bool performDealloc)
 
     bool do_dealloc = false;
 
-    if (!locked) table.lock();
+    if (!locked) {
+        if (slowpath(DeferSideTableReleases)  &&  performDealloc) {
+            if (!sidetable_lockOrDeferRelease()) return false;
+        } else {
+            table.lock();
+        }
+    }
     auto it = table.refcnts.try_emplace(this, SIDE_TABLE_DEALLOCATING);
     auto &refcnt = it.first->second;
     if (it.second) {
@@ -1779,6 +2052,34 @@ objc_object::sidetable_release(bool locked, bool performDealloc)
 }
 
 
+// Same as sidetable_release(performDealloc=false), for callers that 
+// hold the side table lock and keep holding it afterwards.
+// Returns true if the object should now be deallocated.
+bool
+objc_object::sidetable_release_nolock()
+{
+#if SUPPORT_NONPOINTER_ISA
+    ASSERT(!isa.nonpointer);
+#endif
+    SideTable& table = SideTables()[this];
+
+    bool do_dealloc = false;
+
+    auto it = table.refcnts.try_emplace(this, SIDE_TABLE_DEALLOCATING);
+    auto &refcnt = it.first->second;
+    if (it.second) {
+        do_dealloc = true;
+    } else if (refcnt < SIDE_TABLE_DEALLOCATING) {
+        // SIDE_TABLE_WEAKLY_REFERENCED may be set. Don't change it.
+        do_dealloc = true;
+        refcnt |= SIDE_TABLE_DEALLOCATING;
+    } else if (! (refcnt & SIDE_TABLE_RC_PINNED)) {
+        refcnt -= SIDE_TABLE_RC_ONE;
+    }
+    return do_dealloc;
+}
+
+
 void 
 objc_object::sidetable_clearDeallocating()
 {
@@ -1833,6 +2134,104 @@ objc_autorelease(id obj)
 }
 
 
+
+/***********************************************************************
+* Batched retain/release: objc_retainArray(), objc_releaseArray()
+* Elements are handled in chunks of RR_BATCH_SIZE. Nil and tagged 
+* pointers are filtered out first. Each remaining object gets the 
+* inline isa fastpath. Objects that need the side table (raw isa, 
+* extra_rc overflow or underflow) are deferred, sorted by side table, 
+* and finished with one lock acquisition per side table.
+**********************************************************************/
+
+#define RR_BATCH_SIZE 256
+
+namespace {
+struct RRBatchEntry {
+    SideTable *table;
+    objc_object *obj;
+};
+};
+
+// Copy the objects that are neither nil nor tagged pointers to dst.
+// This is branch-free so that arrays mixing tagged pointers 
+// and real objects don't suffer mispredictions.
+static ALWAYS_INLINE size_t
+rrBatchFilter(id *dst, id const *src, size_t count)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        id obj = src[i];
+        dst[n] = obj;
+        n += !obj->isTaggedPointerOrNil();
+    }
+    return n;
+}
+
+template <bool isRetain>
+static void
+rrBatch(id const *objs, size_t count)
+{
+    id live[RR_BATCH_SIZE];
+    RRBatchEntry deferred[RR_BATCH_SIZE];
+
+    while (count > 0) {
+        size_t chunk = MIN(count, (size_t)RR_BATCH_SIZE);
+        size_t liveCount = rrBatchFilter(live, objs, chunk);
+        objs += chunk;
+        count -= chunk;
+
+        size_t deferredCount = 0;
+        for (size_t i = 0; i < liveCount; i++) {
+            objc_object *obj = live[i];
+            bool done = isRetain ? obj->retainBatched() : obj->releaseBatched();
+            if (slowpath(!done)) {
+                deferred[deferredCount++] = { &SideTables()[obj], obj };
+            }
+        }
+        if (fastpath(deferredCount == 0)) continue;
+
+        std::sort(deferred, deferred + deferredCount, 
+                  [](const RRBatchEntry& a, const RRBatchEntry& b) {
+                      return (uintptr_t)a.table < (uintptr_t)b.table;
+                  });
+
+        // live[] is reused for objects that must be deallocated.
+        // -dealloc can't be called with a side table locked.
+        size_t deallocCount = 0;
+        for (size_t i = 0; i < deferredCount; ) {
+            SideTable *table = deferred[i].table;
+            table->lock();
+            do {
+                objc_object *obj = deferred[i].obj;
+                if (isRetain) {
+                    obj->rootRetainLocked();
+                } else if (obj->rootReleaseLocked()) {
+                    live[deallocCount++] = (id)obj;
+                }
+            } while (++i < deferredCount  &&  deferred[i].table == table);
+            table->unlock();
+        }
+
+        for (size_t i = 0; i < deallocCount; i++) {
+            ((void(*)(objc_object *, SEL))objc_msgSend)(live[i], @selector(dealloc));
+        }
+    }
+}
+
+void
+objc_retainArray(id const *objs, size_t count)
+{
+    rrBatch<true>(objs, count);
+}
+
+void
+objc_releaseArray(id const *objs, size_t count)
+{
+    rrBatch<false>(objs, count);
+}
+
+
 // OBJC2
 #else
 // not OBJC2
@@ -1842,6 +2241,13 @@ id objc_retain(id obj) { return [obj retain]; }
 void objc_release(id obj) { [obj release]; }
 id objc_autorelease(id obj) { return [obj autorelease]; }
 
+void objc_retainArray(id const *objs, size_t count) {
+    for (size_t i = 0; i < count; i++) [objs[i] retain];
+}
+void objc_releaseArray(id const *objs, size_t count) {
+    for (size_t i = 0; i < count; i++) [objs[i] release];
+}
+
 
 #endif
 
@@ -2091,6 +2497,7 @@ void
 objc_autoreleasePoolPop(void *ctxt)
 {
     AutoreleasePoolPage::pop(ctxt);
+    flushDeferredReleasesIfNeeded();
 }
 
 
@@ -2112,6 +2519,23 @@ _objc_autoreleasePoolPrint(void)
     AutoreleasePoolPage::printAll();
 }
 
+void
+_objc_autoreleasePoolGetStatistics(objc_autoreleasepool_stats_t *stats)
+{
+    stats->pagesAllocated = 
+        PoolPageStats.allocated.load(std::memory_order_relaxed);
+    stats->pagesFreed = PoolPageStats.freed.load(std::memory_order_relaxed);
+    stats->pagesReused = PoolPageStats.reused.load(std::memory_order_relaxed);
+    stats->highWaterPages = 
+        PoolPageStats.highWater.load(std::memory_order_relaxed);
+}
+
+void
+_objc_autoreleasePoolSetPageCacheLimit(unsigned int limit)
+{
+    objc::PoolPageCacheSize = limit;
+}
+
 
 // Same as objc_release but suitable for tail-calling 
 // if you need the value back and don't want to push a frame before this point.
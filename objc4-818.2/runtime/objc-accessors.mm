@@ -25,6 +25,7 @@
 #include <stddef.h>
 
 #include <libkern/OSAtomic.h>
+#include <sys/ulock.h>
 
 #include "objc-private.h"
 #include "runtime.h"
@@ -39,7 +40,92 @@
 - (id)mutableCopyWithZone:(void *)zone;
 @end
 
-StripedMap<spinlock_t> PropertyLocks;
+/***********************************************************************
+* PropertyReaders
+* Atomic object property getters don't take a lock. A getter announces 
+* itself in the stripe for the property's address while it loads and 
+* retains the value. A setter swaps the new value in and then waits 
+* for getters that might have loaded the old value to finish retaining 
+* it before it releases the old value.
+* 
+* Each stripe has two reader counts. New getters use the one selected 
+* by `current`. A setter waiting for a busy count steers new getters 
+* to the other one, so a steady stream of getters can't starve it.
+* 
+* The wait is usually only as long as one objc_retain(), so the setter 
+* spins briefly. If the getter was preempted, the setter then sets 
+* Waiting in the count and sleeps on it, so that it doesn't spin at 
+* high priority against the getter it waits for. The last getter to 
+* leave clears Waiting and wakes it.
+* 
+* As with the spinlocks this replaced, a custom -retain must not set an 
+* atomic property whose address shares its stripe.
+**********************************************************************/
+class PropertyReaders {
+    static constexpr uint32_t Waiting = 1u << 31;
+    static constexpr unsigned SpinLimit = 1000;
+
+    std::atomic<unsigned> current{0};
+    std::atomic<uint32_t> readers[2]{};
+
+public:
+    unsigned enter() {
+        unsigned which = current.load(std::memory_order_relaxed);
+        // Ordered before the getter's load of the property.
+        readers[which].fetch_add(1, std::memory_order_seq_cst);
+        return which;
+    }
+
+    void leave(unsigned which) {
+        uint32_t old = readers[which].fetch_sub(1, std::memory_order_release);
+        if (slowpath(old == (Waiting | 1))) {
+            readers[which].fetch_and(~Waiting, std::memory_order_relaxed);
+            __ulock_wake(UL_COMPARE_AND_WAIT | ULF_WAKE_ALL, 
+                         &readers[which], 0);
+        }
+    }
+
+    // Called after the setter's exchange. Returns when every getter 
+    // that could have loaded the old value has retained it.
+    void synchronize() {
+        for (unsigned which = 0; which < 2; which++) {
+            auto& count = readers[which];
+            if ((count.load(std::memory_order_seq_cst) & ~Waiting) == 0) {
+                continue;
+            }
+
+            current.store(which ^ 1, std::memory_order_relaxed);
+            unsigned spins = 0;
+            while (true) {
+                uint32_t value = count.load(std::memory_order_seq_cst);
+                if ((value & ~Waiting) == 0) break;
+                if (spins < SpinLimit) {
+                    spins++;
+                } else if (!(value & Waiting)) {
+                    count.fetch_or(Waiting, std::memory_order_seq_cst);
+                } else {
+                    // Returns at once if the count changed since the load.
+                    __ulock_wait(UL_COMPARE_AND_WAIT, &count, value, 0);
+                }
+            }
+        }
+    }
+
+    // Getters on other threads don't survive fork().
+    void forceReset() {
+        current.store(0, std::memory_order_relaxed);
+        readers[0].store(0, std::memory_order_relaxed);
+        readers[1].store(0, std::memory_order_relaxed);
+    }
+};
+
+static StripedMap<PropertyReaders> PropertyReaderStripes;
+
+void PropertyReadersForceResetAll()
+{
+    PropertyReaderStripes.forceResetAll();
+}
+
 StripedMap<spinlock_t> StructLocks;
 StripedMap<spinlock_t> CppObjectLocks;
 
@@ -55,12 +141,13 @@ id objc_getProperty(id self, SEL _cmd, ptrdiff_t offset, BOOL atomic) {
     if (!atomic) return *slot;
         
     // Atomic retain release world
-    spinlock_t& slotlock = PropertyLocks[slot];
-    slotlock.lock();
-    id value = objc_retain(*slot);
-    slotlock.unlock();
+    PropertyReaders& readers = PropertyReaderStripes[slot];
+    unsigned which = readers.enter();
+    id value = (id)__c11_atomic_load((_Atomic(uintptr_t) *)slot, __ATOMIC_SEQ_CST);
+    value = objc_retain(value);
+    readers.leave(which);
     
-    // for performance, we (safely) issue the autorelease OUTSIDE of the spinlock.
+    // for performance, we (safely) issue the autorelease OUTSIDE of the reader count.
     return objc_autoreleaseReturnValue(value);
 }
 
@@ -90,11 +177,10 @@ static inline void reallySetProperty(id self, SEL _cmd, id newValue, ptrdiff_t o
         oldValue = *slot;
         *slot = newValue;
     } else {
-        spinlock_t& slotlock = PropertyLocks[slot];
-        slotlock.lock();
-        oldValue = *slot;
-        *slot = newValue;        
-        slotlock.unlock();
+        oldValue = (id)__c11_atomic_exchange((_Atomic(uintptr_t) *)slot, 
+                                             (uintptr_t)newValue, __ATOMIC_SEQ_CST);
+        // Getters may still be retaining the old value.
+        if (oldValue) PropertyReaderStripes[slot].synchronize();
     }
 
     objc_release(oldValue);
@@ -31,6 +31,7 @@
  **********************************************************************/
 #include "objc-private.h"
 #include "runtime.h"
+#include "DenseMapExtras.h"
 
 #include <Block.h>
 #include <Block_private.h>
@@ -233,11 +234,14 @@ struct TrampolineBlockPageGroup
 
     const void * TrampolinePtrauth const text;  // text VM region; stored only for the benefit of the leaks tool
 
+    bool isAvailable;  // on the AvailablePageGroups list
+
     TrampolineBlockPageGroup()
         : nextPageGroup(nil)
         , nextAvailablePage(nil)
         , nextAvailable(startIndex())
         , text((const void *)((uintptr_t)this + Trampolines.dataSize()))
+        , isAvailable(false)
     { }
     
     // Payload data: block pointers and free list.
@@ -328,6 +332,15 @@ struct TrampolineBlockPageGroup
 };
 
 static TrampolineBlockPageGroup *HeadPageGroup;
+static TrampolineBlockPageGroup *TailPageGroup;
+
+// Page groups with free slots, most recently freed into first.
+static TrampolineBlockPageGroup *AvailablePageGroups;
+
+// Trampoline text page => its page group, for imp_getBlock() and
+// imp_removeBlock(). Keyed by PAGE_MIN_SIZE page so every text page
+// maps to exactly one group whatever the process's page size.
+static objc::LazyInitDenseMap<uintptr_t, TrampolineBlockPageGroup *> PageGroupsByTextPage;
 
 #pragma mark Utility Functions
 
@@ -358,7 +371,7 @@ static TrampolineBlockPageGroup *_allocateTrampolinesAndData()
     // We assume that our code begins on the second TEXT page, but are robust
     // against other additions to the end of the TEXT segment.
 
-    ASSERT(HeadPageGroup == nil  ||  HeadPageGroup->nextAvailablePage == nil);
+    ASSERT(AvailablePageGroups == nil);
 
     auto textSource = Trampolines.textSegment();
     auto textSourceSize = Trampolines.textSegmentSize();
@@ -388,16 +401,26 @@ static TrampolineBlockPageGroup *_allocateTrampolinesAndData()
 
     auto *pageGroup = new ((void*)dataAddress) TrampolineBlockPageGroup;
     
-    if (HeadPageGroup) {
-        TrampolineBlockPageGroup *lastPageGroup = HeadPageGroup;
-        while(lastPageGroup->nextPageGroup) {
-            lastPageGroup = lastPageGroup->nextPageGroup;
-        }
-        lastPageGroup->nextPageGroup = pageGroup;
-        HeadPageGroup->nextAvailablePage = pageGroup;
+    if (TailPageGroup) {
+        TailPageGroup->nextPageGroup = pageGroup;
     } else {
         HeadPageGroup = pageGroup;
     }
+    TailPageGroup = pageGroup;
+
+    auto *textPages = PageGroupsByTextPage.get(true);
+    for (int aMode = 0; aMode < ArgumentModeCount; aMode++) {
+        uintptr_t base = pageGroup->trampolinesForMode(aMode);
+        for (uintptr_t page = base; 
+             page < base + TRAMPOLINE_PAGE_SIZE; 
+             page += PAGE_MIN_SIZE)
+        {
+            (*textPages)[page / PAGE_MIN_SIZE] = pageGroup;
+        }
+    }
+
+    pageGroup->isAvailable = true;
+    AvailablePageGroups = pageGroup;
     
     return pageGroup;
 }
@@ -407,15 +430,8 @@ getOrAllocatePageGroupWithNextAvailable()
 {
     runtimeLock.assertLocked();
     
-    if (!HeadPageGroup)
-        return _allocateTrampolinesAndData();
-    
-    // make sure head page is filled first
-    if (HeadPageGroup->nextAvailable != HeadPageGroup->endIndex())
-        return HeadPageGroup;
-    
-    if (HeadPageGroup->nextAvailablePage) // check if there is a page w/a hole
-        return HeadPageGroup->nextAvailablePage;
+    if (AvailablePageGroups) // check if there is a page w/a hole
+        return AvailablePageGroups;
     
     return _allocateTrampolinesAndData(); // tack on a new one
 }
@@ -430,18 +446,18 @@ pageAndIndexContainingIMP(IMP anImp, uintptr_t *outIndex)
             (uintptr_t)ptrauth_auth_data((const char *)anImp,
                                          ptrauth_key_function_pointer, 0);
 
-    for (TrampolineBlockPageGroup *pageGroup = HeadPageGroup; 
-         pageGroup;
-         pageGroup = pageGroup->nextPageGroup)
-    {
-        uintptr_t index = pageGroup->indexForTrampoline(trampAddress);
-        if (index) {
-            if (outIndex) *outIndex = index;
-            return pageGroup;
-        }
-    }
-    
-    return nil;
+    auto *textPages = PageGroupsByTextPage.get(false);
+    if (!textPages) return nil;
+
+    auto it = textPages->find(trampAddress / PAGE_MIN_SIZE);
+    if (it == textPages->end()) return nil;
+
+    TrampolineBlockPageGroup *pageGroup = it->second;
+    uintptr_t index = pageGroup->indexForTrampoline(trampAddress);
+    if (!index) return nil;
+
+    if (outIndex) *outIndex = index;
+    return pageGroup;
 }
 
 
@@ -508,15 +524,11 @@ _imp_implementationWithBlockNoCopy(id block)
     pageGroup->nextAvailable = nextAvailableIndex;
     if (nextAvailableIndex == pageGroup->endIndex()) {
         // PageGroup is now full (free list or wilderness exhausted)
-        // Remove from available page linked list
-        TrampolineBlockPageGroup *iterator = HeadPageGroup;
-        while(iterator && (iterator->nextAvailablePage != pageGroup)) {
-            iterator = iterator->nextAvailablePage;
-        }
-        if (iterator) {
-            iterator->nextAvailablePage = pageGroup->nextAvailablePage;
-            pageGroup->nextAvailablePage = nil;
-        }
+        // Remove from available page linked list. It is always first.
+        ASSERT(AvailablePageGroups == pageGroup);
+        AvailablePageGroups = pageGroup->nextAvailablePage;
+        pageGroup->nextAvailablePage = nil;
+        pageGroup->isAvailable = false;
     }
     
     payload->block = block;
@@ -524,6 +536,41 @@ _imp_implementationWithBlockNoCopy(id block)
 }
 
 
+// Returns the block to release, or nil if anImp is not a block IMP.
+static id
+_imp_removeBlock_nolock(IMP anImp)
+{
+    runtimeLock.assertLocked();
+
+    uintptr_t index;
+    TrampolineBlockPageGroup *pageGroup =
+        pageAndIndexContainingIMP(anImp, &index);
+    
+    if (!pageGroup) {
+        return nil;
+    }
+    
+    TrampolineBlockPageGroup::Payload *payload = pageGroup->payload(index);
+    if (payload->nextAvailable <= TrampolineBlockPageGroup::endIndex()) {
+        // unallocated
+        return nil;
+    }
+    id block = payload->block;
+    
+    payload->nextAvailable = pageGroup->nextAvailable;
+    pageGroup->nextAvailable = index;
+    
+    // make sure this page is on available linked list
+    if (!pageGroup->isAvailable) {
+        pageGroup->nextAvailablePage = AvailablePageGroups;
+        AvailablePageGroups = pageGroup;
+        pageGroup->isAvailable = true;
+    }
+
+    return block;
+}
+
+
 #pragma mark Public API
 IMP imp_implementationWithBlock(id block) 
 {
@@ -541,6 +588,29 @@ IMP imp_implementationWithBlock(id block)
 }
 
 
+void _imp_implementationWithBlocks(id const *blocks, IMP *imps, unsigned count)
+{
+    if (count == 0) return;
+
+    // Same as imp_implementationWithBlock(), with one lock round trip.
+    id *copies = (id *)malloc(count * sizeof(id));
+    for (unsigned i = 0; i < count; i++) {
+        copies[i] = Block_copy(blocks[i]);
+    }
+
+    Trampolines.Initialize();
+
+    {
+        mutex_locker_t lock(runtimeLock);
+        for (unsigned i = 0; i < count; i++) {
+            imps[i] = _imp_implementationWithBlockNoCopy(copies[i]);
+        }
+    }
+
+    free(copies);
+}
+
+
 id imp_getBlock(IMP anImp) {
     uintptr_t index;
     TrampolineBlockPageGroup *pageGroup;
@@ -573,41 +643,39 @@ BOOL imp_removeBlock(IMP anImp) {
     
     {
         mutex_locker_t lock(runtimeLock);
-    
-        uintptr_t index;
-        TrampolineBlockPageGroup *pageGroup =
-            pageAndIndexContainingIMP(anImp, &index);
-        
-        if (!pageGroup) {
-            return NO;
-        }
-        
-        TrampolineBlockPageGroup::Payload *payload = pageGroup->payload(index);
-        block = payload->block;
+        block = _imp_removeBlock_nolock(anImp);
         // block is released below, outside the lock
-        
-        payload->nextAvailable = pageGroup->nextAvailable;
-        pageGroup->nextAvailable = index;
-        
-        // make sure this page is on available linked list
-        TrampolineBlockPageGroup *pageGroupIterator = HeadPageGroup;
-        
-        // see if page is the next available page for any existing pages
-        while (pageGroupIterator->nextAvailablePage && 
-               pageGroupIterator->nextAvailablePage != pageGroup)
-        {
-            pageGroupIterator = pageGroupIterator->nextAvailablePage;
-        }
-        
-        if (! pageGroupIterator->nextAvailablePage) {
-            // if iteration stopped because nextAvail was nil
-            // add to end of list.
-            pageGroupIterator->nextAvailablePage = pageGroup;
-            pageGroup->nextAvailablePage = nil;
-        }
     }
 
+    if (!block) return NO;
+
     // do this AFTER dropping the lock
     Block_release(block);
     return YES;
 }
+
+
+unsigned _imp_removeBlocks(IMP const *imps, unsigned count)
+{
+    if (count == 0) return 0;
+
+    unsigned removed = 0;
+    id *blocks = (id *)malloc(count * sizeof(id));
+
+    {
+        mutex_locker_t lock(runtimeLock);
+        for (unsigned i = 0; i < count; i++) {
+            if (!imps[i]) continue;
+            if (id block = _imp_removeBlock_nolock(imps[i])) {
+                blocks[removed++] = block;
+            }
+        }
+    }
+
+    // do this AFTER dropping the lock
+    for (unsigned i = 0; i < removed; i++) {
+        Block_release(blocks[i]);
+    }
+    free(blocks);
+    return removed;
+}
@@ -180,6 +180,10 @@ static unsigned int cache_counts[16];
 static size_t cache_allocations;
 static size_t cache_collections;
 
+// Number of cache entries discarded by flushes, for
+// _objc_flushedCacheBucketCount(). Protected by the cache update lock.
+static size_t cache_flushed_buckets;
+
 static void recordNewCache(mask_t capacity)
 {
     size_t bucket = log2u(capacity);
@@ -868,6 +872,7 @@ void cache_t::insert(SEL sel, IMP imp, id receiver)
             capacity = MAX_CACHE_SIZE;
         }
         reallocate(oldCapacity, capacity, true);
+        objc::countPerfEvent(objc::PerfCacheGrows);
     }
 
     bucket_t *b = buckets();
@@ -959,11 +964,88 @@ void cache_t::eraseNolock(const char *func)
         auto oldBuckets = buckets();
         auto buckets = emptyBucketsForCapacity(capacity);
 
+        cache_flushed_buckets += occupied();
+        objc::countPerfEvent(objc::PerfCacheFlushes);
         setBucketsAndMask(buckets, capacity - 1); // also clears occupied
         collect_free(oldBuckets, capacity);
     }
 }
 
+// Remove only the entries for the given selectors, which must be sorted
+// by address. Entries can't be cleared in place because a concurrent
+// objc_msgSend could be partway through a probe sequence, so the
+// surviving entries are rehashed into new buckets of the same size
+// and the old buckets are collected like any other dead cache.
+void cache_t::eraseNolock(const char *func, const SEL *sels, uint32_t count)
+{
+#if CONFIG_USE_CACHE_LOCK
+    cacheUpdateLock.assertLocked();
+#else
+    runtimeLock.assertLocked();
+#endif
+
+    if (isConstantOptimizedCache()) {
+        // Read-only. Drop the whole thing.
+        eraseNolock(func);
+        return;
+    }
+    if (occupied() == 0) return;
+
+    auto erases = [sels, count](SEL sel) {
+        return std::binary_search(sels, sels + count, sel,
+                                  [](SEL a, SEL b) {
+            return (uintptr_t)a < (uintptr_t)b;
+        });
+    };
+
+    bucket_t *oldBuckets = buckets();
+    unsigned capacity = this->capacity();
+    mask_t m = capacity - 1;
+    Class cls = this->cls();
+
+    mask_t found = 0;
+    for (unsigned i = 0; i < capacity; i++) {
+        SEL sel = oldBuckets[i].sel();
+        if (sel  &&  erases(sel)) found++;
+    }
+    if (found == 0) return;
+    if (found == occupied()) {
+        eraseNolock(func);
+        return;
+    }
+
+    bucket_t *newBuckets = allocateBuckets(capacity);
+    mask_t kept = 0;
+    for (unsigned i = 0; i < capacity; i++) {
+        SEL sel = oldBuckets[i].sel();
+        if (!sel  ||  erases(sel)) continue;
+#if CACHE_END_MARKER
+        if (&oldBuckets[i] == endMarker(oldBuckets, capacity)) continue;
+#endif
+        IMP imp = oldBuckets[i].imp(oldBuckets, cls);
+        mask_t j = cache_hash(sel, m);
+        while (newBuckets[j].sel()) j = cache_next(j, m);
+        newBuckets[j].set<NotAtomic, Encoded>(newBuckets, sel, imp, cls);
+        kept++;
+    }
+
+    if (PrintCaches) {
+        _objc_inform("CACHES: %sclass %s: erasing %u of %u entries (from %s)",
+                     cls->isMetaClass() ? "meta" : "",
+                     cls->nameForLogging(), (unsigned)found,
+                     (unsigned)occupied(), func);
+    }
+
+    cache_flushed_buckets += found;
+    objc::countPerfEvent(objc::PerfCacheFlushes);
+
+    // Make the new entries visible before the buckets pointer.
+    std::atomic_thread_fence(std::memory_order_release);
+    setBucketsAndMask(newBuckets, m); // also clears occupied
+    _occupied = kept;
+    collect_free(oldBuckets, capacity);
+}
+
 
 void cache_t::destroy()
 {
@@ -1071,6 +1153,8 @@ void cache_t::init()
 
 static int _collecting_in_critical(void)
 {
+    objc::countPerfEvent(objc::PerfCollectingScans);
+
 #if TARGET_OS_WIN32
     return TRUE;
 #elif HAVE_TASK_RESTARTABLE_RANGES
@@ -1538,6 +1622,11 @@ static kern_return_t objc_task_threads
 // DEBUG_TASK_THREADS
 #endif
 
+size_t _objc_flushedCacheBucketCount(void)
+{
+    return cache_flushed_buckets;
+}
+
 OBJC_EXPORT bucket_t * objc_cache_buckets(const cache_t * cache) {
     return cache->buckets();
 }
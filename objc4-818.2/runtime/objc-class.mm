@@ -158,6 +158,7 @@
 
 #include "objc-private.h"
 #include "objc-abi.h"
+#include "objc-zalloc.h"
 #include <objc/message.h>
 #if !TARGET_OS_WIN32
 #include <os/linker_set.h>
@@ -843,29 +844,54 @@ unsigned
 _class_createInstancesFromZone(Class cls, size_t extraBytes, void *zone, 
                                id *results, unsigned num_requested)
 {
-    unsigned num_allocated;
+    unsigned num_allocated = 0;
     if (!cls) return 0;
 
     size_t size = cls->instanceSize(extraBytes);
 
-    num_allocated = 
-        malloc_zone_batch_malloc((malloc_zone_t *)(zone ? zone : malloc_default_zone()), 
-                                 size, (void**)results, num_requested);
-    for (unsigned i = 0; i < num_allocated; i++) {
-        bzero(results[i], size);
+#if __OBJC2__
+    if (!zone  &&  cls->usesSlabAllocator()  &&
+        objc::SlabAllocator::canAllocate(size))
+    {
+        // Already zeroed.
+        num_allocated = objc::SlabAllocator::allocBatch(size, (void**)results,
+                                                        num_requested);
+    }
+#endif
+    if (num_allocated < num_requested) {
+        unsigned more =
+            malloc_zone_batch_malloc((malloc_zone_t *)(zone ? zone : malloc_default_zone()), 
+                                     size, (void**)results + num_allocated,
+                                     num_requested - num_allocated);
+        for (unsigned i = num_allocated; i < num_allocated + more; i++) {
+            bzero(results[i], size);
+        }
+        num_allocated += more;
+    }
+
+    // Set every isa at once, then construct each object
+    // and delete any that fail construction.
+
+#if __OBJC2__
+    if (!zone  &&  cls->canAllocNonpointer()) {
+        objc_object::initInstanceIsas(results, num_allocated,
+                                      cls, cls->hasCxxDtor());
+    } else
+#endif
+    {
+        // Use raw pointer isa on the assumption that they might be
+        // doing something weird with the zone or RR.
+        for (unsigned i = 0; i < num_allocated; i++) {
+            results[i]->initIsa(cls);
+        }
     }
 
-    // Construct each object, and delete any that fail construction.
+    if (!cls->hasCxxCtor()) return num_allocated;
 
     unsigned shift = 0;
-    bool ctor = cls->hasCxxCtor();
     for (unsigned i = 0; i < num_allocated; i++) {
-        id obj = results[i];
-        obj->initIsa(cls);    // fixme allow nonpointer
-        if (ctor) {
-            obj = object_cxxConstructFromClass(obj, cls,
-                                               OBJECT_CONSTRUCT_FREE_ONFAILURE);
-        }
+        id obj = object_cxxConstructFromClass(results[i], cls,
+                                              OBJECT_CONSTRUCT_FREE_ONFAILURE);
         if (obj) {
             results[i-shift] = obj;
         } else {
@@ -4,6 +4,7 @@
 
 OPTION( PrintImages,              OBJC_PRINT_IMAGES,               "log image and library names as they are loaded")
 OPTION( PrintImageTimes,          OBJC_PRINT_IMAGE_TIMES,          "measure duration of image loading steps")
+OPTION( PrintImagePhases,         OBJC_PRINT_IMAGE_PHASES,         "log total duration and work of each image loading step")
 OPTION( PrintLoading,             OBJC_PRINT_LOAD_METHODS,         "log calls to class and category +load methods")
 OPTION( PrintInitializing,        OBJC_PRINT_INITIALIZE_METHODS,   "log calls to class +initialize methods")
 OPTION( PrintResolving,           OBJC_PRINT_RESOLVED_METHODS,     "log methods created by +resolveClassMethod: and +resolveInstanceMethod:")
@@ -37,6 +38,9 @@ OPTION( DebugPoolAllocation,      OBJC_DEBUG_POOL_ALLOCATION,      "halt when au
 OPTION( DebugDuplicateClasses,    OBJC_DEBUG_DUPLICATE_CLASSES,    "halt when multiple classes with the same name are present")
 OPTION( DebugDontCrash,           OBJC_DEBUG_DONT_CRASH,           "halt the process by exiting instead of crashing")
 OPTION( DebugPoolDepth,           OBJC_DEBUG_POOL_DEPTH,           "log fault when at least a set number of autorelease pages has been allocated")
+OPTION( RecordClassCacheMisses,   OBJC_RECORD_CLASS_CACHE_MISSES,  "count method cache misses per class for _class_getCacheMissCount()")
+OPTION( PoolPageCacheLimit,       OBJC_POOL_PAGE_CACHE_LIMIT,      "keep up to a set number of empty autorelease pool pages per thread for reuse")
+OPTION( DeferSideTableReleases,   OBJC_DEFER_SIDE_TABLE_RELEASES,  "batch releases that find their side table lock busy; objects may deallocate at the releasing thread's next autorelease pool pop")
 
 OPTION( DisableVtables,           OBJC_DISABLE_VTABLES,            "disable vtable dispatch")
 OPTION( DisablePreopt,            OBJC_DISABLE_PREOPTIMIZATION,    "disable preoptimization courtesy of dyld shared cache")
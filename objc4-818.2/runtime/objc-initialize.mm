@@ -97,11 +97,16 @@
 #include "objc-initialize.h"
 #include "DenseMapExtras.h"
 
-/* classInitLock protects CLS_INITIALIZED and CLS_INITIALIZING, and 
- * is signalled when any class is done initializing. 
- * Threads that are waiting for a class to finish initializing wait on this. */
+/* classInitLock protects CLS_INITIALIZED and CLS_INITIALIZING. 
+ * Threads that are waiting for a class to finish initializing wait on 
+ * that class's ClassInitWaiters monitor instead, so the threads 
+ * initializing unrelated classes don't wake each other. */
 monitor_t classInitLock;
 
+/* ClassInitWaiters is signalled when a class in its stripe is done 
+ * initializing. Taken after classInitLock, if both are held. */
+StripedMap<monitor_t> ClassInitWaiters;
+
 
 struct _objc_willInitializeClassCallback {
     _objc_func_willInitializeClass f;
@@ -112,17 +117,28 @@ static GlobalSmallVector<_objc_willInitializeClassCallback, 1> willInitializeFun
 
 /***********************************************************************
 * struct _objc_initializing_classes
-* Per-thread list of classes currently being initialized by that thread. 
+* Per-thread set of classes currently being initialized by that thread. 
 * During initialization, that thread is allowed to send messages to that 
 * class, but other threads have to wait.
-* The list is a simple array of metaclasses (the metaclass stores 
-* the initialization state). 
+* The set is an open-addressed hash table of metaclasses (the metaclass 
+* stores the initialization state), so membership checks don't depend 
+* on how deep a +initialize chain is. 
 **********************************************************************/
 typedef struct _objc_initializing_classes {
-    int classesAllocated;
-    Class *metaclasses;
+    unsigned count;        // number of metaclasses in the table
+    unsigned mask;         // table size - 1; table size is a power of 2
+    Class *metaclasses;    // nil means empty slot
 } _objc_initializing_classes;
 
+// Start with room for 4 simultaneous class inits on this thread.
+#define INITIALIZING_CLASSES_MIN_SIZE 8
+
+static inline unsigned _initializingClassSlot(_objc_initializing_classes *list,
+                                              Class meta)
+{
+    return ptr_hash((uintptr_t)meta) & list->mask;
+}
+
 
 /***********************************************************************
 * _fetchInitializingClassList
@@ -134,7 +150,6 @@ static _objc_initializing_classes *_fetchInitializingClassList(bool create)
 {
     _objc_pthread_data *data;
     _objc_initializing_classes *list;
-    Class *classes;
 
     data = _objc_fetch_pthread_data(create);
     if (data == nil) return nil;
@@ -150,15 +165,10 @@ static _objc_initializing_classes *_fetchInitializingClassList(bool create)
         }
     }
 
-    classes = list->metaclasses;
-    if (classes == nil) {
-        // If _objc_initializing_classes exists, allocate metaclass array, 
-        // even if create == NO.
-        // Allow 4 simultaneous class inits on this thread before realloc.
-        list->classesAllocated = 4;
-        classes = (Class *)
-            calloc(list->classesAllocated, sizeof(Class));
-        list->metaclasses = classes;
+    if (list->metaclasses == nil  &&  create) {
+        list->mask = INITIALIZING_CLASSES_MIN_SIZE - 1;
+        list->metaclasses = (Class *)
+            calloc(INITIALIZING_CLASSES_MIN_SIZE, sizeof(Class));
     }
     return list;
 }
@@ -188,21 +198,41 @@ void _destroyInitializingClassList(struct _objc_initializing_classes *list)
 **********************************************************************/
 bool _thisThreadIsInitializingClass(Class cls)
 {
-    int i;
-
     _objc_initializing_classes *list = _fetchInitializingClassList(NO);
-    if (list) {
-        cls = cls->getMeta();
-        for (i = 0; i < list->classesAllocated; i++) {
-            if (cls == list->metaclasses[i]) return YES;
-        }
+    if (!list  ||  list->count == 0) return NO;
+
+    Class meta = cls->getMeta();
+    for (unsigned i = _initializingClassSlot(list, meta); 
+         list->metaclasses[i] != nil; 
+         i = (i + 1) & list->mask)
+    {
+        if (list->metaclasses[i] == meta) return YES;
     }
 
-    // no list or not found in list
+    // not found in list
     return NO;
 }
 
 
+/***********************************************************************
+* _insertInitializingClass
+* Add meta to the table, which must have a free slot.
+* Returns false if meta is already present.
+**********************************************************************/
+static bool _insertInitializingClass(_objc_initializing_classes *list,
+                                     Class meta)
+{
+    unsigned i = _initializingClassSlot(list, meta);
+    while (list->metaclasses[i] != nil) {
+        if (list->metaclasses[i] == meta) return false;
+        i = (i + 1) & list->mask;
+    }
+    list->metaclasses[i] = meta;
+    list->count++;
+    return true;
+}
+
+
 /***********************************************************************
 * _setThisThreadIsInitializingClass
 * Record that this thread is currently initializing the given class. 
@@ -211,34 +241,25 @@ bool _thisThreadIsInitializingClass(Class cls)
 **********************************************************************/
 static void _setThisThreadIsInitializingClass(Class cls)
 {
-    int i;
     _objc_initializing_classes *list = _fetchInitializingClassList(YES);
-    cls = cls->getMeta();
-  
-    // paranoia: explicitly disallow duplicates
-    for (i = 0; i < list->classesAllocated; i++) {
-        if (cls == list->metaclasses[i]) {
-            _objc_fatal("thread is already initializing this class!");
-            return; // already the initializer
-        }
-    }
-  
-    for (i = 0; i < list->classesAllocated; i++) {
-        if (! list->metaclasses[i]) {
-            list->metaclasses[i] = cls;
-            return;
+    Class meta = cls->getMeta();
+
+    // Keep the table at most half full so probe chains stay short.
+    if ((list->count + 1) * 2 > list->mask + 1) {
+        Class *oldClasses = list->metaclasses;
+        unsigned oldSize = list->mask + 1;
+        list->mask = oldSize * 2 - 1;
+        list->count = 0;
+        list->metaclasses = (Class *)calloc(oldSize * 2, sizeof(Class));
+        for (unsigned i = 0; i < oldSize; i++) {
+            if (oldClasses[i]) _insertInitializingClass(list, oldClasses[i]);
         }
+        free(oldClasses);
     }
 
-    // class list is full - reallocate
-    list->classesAllocated = list->classesAllocated * 2 + 1;
-    list->metaclasses = (Class *) 
-        realloc(list->metaclasses,
-                          list->classesAllocated * sizeof(Class));
-    // zero out the new entries
-    list->metaclasses[i++] = cls;
-    for ( ; i < list->classesAllocated; i++) {
-        list->metaclasses[i] = nil;
+    // paranoia: explicitly disallow duplicates
+    if (!_insertInitializingClass(list, meta)) {
+        _objc_fatal("thread is already initializing this class!");
     }
 }
 
@@ -249,16 +270,34 @@ static void _setThisThreadIsInitializingClass(Class cls)
 **********************************************************************/
 static void _setThisThreadIsNotInitializingClass(Class cls)
 {
-    int i;
-
     _objc_initializing_classes *list = _fetchInitializingClassList(NO);
-    if (list) {
-        cls = cls->getMeta();
-        for (i = 0; i < list->classesAllocated; i++) {
-            if (cls == list->metaclasses[i]) {
-                list->metaclasses[i] = nil;
-                return;
+    if (list  &&  list->count > 0) {
+        Class meta = cls->getMeta();
+        unsigned i = _initializingClassSlot(list, meta);
+        for ( ; list->metaclasses[i] != nil; i = (i + 1) & list->mask) {
+            if (list->metaclasses[i] != meta) continue;
+
+            // Remove it, then shift later members of the same probe 
+            // chain back so lookups never stop early at the hole.
+            list->metaclasses[i] = nil;
+            list->count--;
+            unsigned hole = i;
+            for (unsigned j = (i + 1) & list->mask; 
+                 list->metaclasses[j] != nil; 
+                 j = (j + 1) & list->mask)
+            {
+                unsigned home = _initializingClassSlot(list, list->metaclasses[j]);
+                // Move j into the hole unless its home slot lies 
+                // cyclically in (hole, j].
+                bool stays = (hole <= j) ? (hole < home && home <= j)
+                                         : (hole < home || home <= j);
+                if (!stays) {
+                    list->metaclasses[hole] = list->metaclasses[j];
+                    list->metaclasses[j] = nil;
+                    hole = j;
+                }
             }
+            return;
         }
     }
 
@@ -297,7 +336,11 @@ static void _finishInitializing(Class cls, Class supercls)
 
     // mark this class as fully +initialized
     cls->setInitialized();
-    classInitLock.notifyAll();
+    {
+        monitor_t& waiters = ClassInitWaiters[cls->getMeta()];
+        monitor_locker_t lock(waiters);
+        waiters.notifyAll();
+    }
     _setThisThreadIsNotInitializingClass(cls);
     
     // mark any subclasses that were merely waiting for this class
@@ -371,9 +414,10 @@ void waitForInitializeToComplete(Class cls)
                      "completes", objc_thread_self(), cls->nameForLogging());
     }
 
-    monitor_locker_t lock(classInitLock);
+    monitor_t& waiters = ClassInitWaiters[cls->getMeta()];
+    monitor_locker_t lock(waiters);
     while (!cls->isInitialized()) {
-        classInitLock.wait();
+        waiters.wait();
     }
     asm("");
 }
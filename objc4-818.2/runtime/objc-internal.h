@@ -112,6 +112,16 @@ class_createInstances(Class _Nullable cls, size_t extraBytes,
     OBJC_AVAILABLE(10.7, 4.3, 9.0, 1.0, 2.0)
     OBJC_ARC_UNAVAILABLE;
 
+#if __OBJC2__
+// Allocate the future instances of cls (not of its subclasses) from
+// a slab of same-sized elements with per-thread free lists.
+// class_createInstances() uses it for bulk allocation. Instances are
+// still freed with free(). cls must be realized.
+OBJC_EXPORT void
+_class_setUsesSlabAllocator(Class _Nonnull cls, BOOL slab)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+#endif
+
 // Get the isa pointer written into objects just before being freed.
 OBJC_EXPORT Class _Nonnull
 _objc_getFreedObjectClass(void)
@@ -178,6 +188,13 @@ objc_imp_cache_entry *_Nullable
 class_copyImpCache(Class _Nonnull cls, int * _Nullable outCount)
 	OBJC_AVAILABLE(10.15, 13.0, 13.0, 6.0, 5.0);
 
+// Total number of method cache entries discarded so far by cache flushes
+// (class_addMethod, method_setImplementation, category attachment, etc.)
+OBJC_EXPORT
+size_t
+_objc_flushedCacheBucketCount(void)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
 OBJC_EXPORT
 unsigned long
 sel_hash(SEL _Nullable sel)
@@ -872,6 +889,18 @@ objc_autorelease(id _Nullable obj)
     __asm__("_objc_autorelease")
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
 
+// Retain or release every element of objs[0..count-1].
+// Same as calling objc_retain() or objc_release() on each element, 
+// but side table updates are grouped so each side table lock 
+// is taken at most once per batch. Elements may be nil or tagged pointers.
+OBJC_EXPORT void
+objc_retainArray(id _Nullable const * _Nullable objs, size_t count)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
+OBJC_EXPORT void
+objc_releaseArray(id _Nullable const * _Nullable objs, size_t count)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
 // Prepare a value at +1 for return through a +0 autoreleasing convention.
 OBJC_EXPORT id _Nullable
 objc_autoreleaseReturnValue(id _Nullable obj)
@@ -944,6 +973,76 @@ OBJC_EXPORT void
 _objc_autoreleasePoolPrint(void)
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
 
+// Autorelease pool page statistics, summed over all threads.
+typedef struct {
+    size_t pagesAllocated;  // pages allocated from malloc
+    size_t pagesFreed;      // pages returned to malloc
+    size_t pagesReused;     // page boundary crossings that reused a cached page
+    size_t highWaterPages;  // most pages held by all threads at once
+} objc_autoreleasepool_stats_t;
+
+OBJC_EXPORT void
+_objc_autoreleasePoolGetStatistics(objc_autoreleasepool_stats_t * _Nonnull stats)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
+// Set how many empty pages each thread keeps for reuse when its 
+// autorelease pools are popped. Same as OBJC_POOL_PAGE_CACHE_LIMIT.
+// The default is 1.
+OBJC_EXPORT void
+_objc_autoreleasePoolSetPageCacheLimit(unsigned int limit)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
+// Runtime event counts summed over all threads, since launch or 
+// the last _objc_resetPerformanceCounters(). 
+// The weak table sizes are current values and are not reset.
+typedef struct {
+    size_t classesRealized;     // classes and metaclasses realized
+    size_t lazyRealizations;    // realizations on first use rather than at load
+    size_t cacheMisses;         // method lookups that missed the method cache
+    size_t cacheGrows;          // method caches reallocated larger
+    size_t cacheFlushes;        // method caches erased in whole or in part
+    size_t collectingScans;     // checks for objc_msgSend in progress before freeing caches
+    size_t sideTableOverflows;  // inline retain counts spilled into a side table
+    size_t weakReferents;       // objects that have weak references
+    size_t weakTableCapacity;   // weak table entries allocated
+} objc_perf_counters_t;
+
+OBJC_EXPORT void
+_objc_getPerformanceCounters(objc_perf_counters_t * _Nonnull counters)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
+OBJC_EXPORT void
+_objc_resetPerformanceCounters(void)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
+#if __OBJC2__
+// Method cache misses for cls itself. Counted only when 
+// OBJC_RECORD_CLASS_CACHE_MISSES is set; 0 otherwise.
+OBJC_EXPORT size_t
+_class_getCacheMissCount(Class _Nullable cls)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+#endif
+
+// Applies releases this thread deferred under 
+// OBJC_DEFER_SIDE_TABLE_RELEASES. Objects whose last release was 
+// deferred are deallocated. Does nothing if the option is off.
+OBJC_EXPORT void
+_objc_flushDeferredReleases(void)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
+// Like imp_implementationWithBlock() for each of count blocks, 
+// taking the runtime lock once.
+OBJC_EXPORT void
+_imp_implementationWithBlocks(id _Nonnull const * _Nonnull blocks,
+                              IMP _Nonnull * _Nonnull imps, unsigned count)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
+// Like imp_removeBlock() for each of count IMPs, taking the runtime 
+// lock once. Returns the number of IMPs that were block IMPs.
+OBJC_EXPORT unsigned
+_imp_removeBlocks(IMP _Nullable const * _Nonnull imps, unsigned count)
+    OBJC_AVAILABLE(10.16, 14.0, 14.0, 7.0, 6.0);
+
 OBJC_EXPORT BOOL
 objc_should_deallocate(id _Nonnull object)
     OBJC_AVAILABLE(10.7, 5.0, 9.0, 1.0, 2.0);
@@ -35,4 +35,7 @@
 extern mutex_t runtimeLock;
 extern mutex_t DemangleCacheLock;
 
+// The slab allocator's lock in objc-zalloc.mm is the exception:
+// malloc takes it around fork() through the slab's malloc zone.
+
 #endif
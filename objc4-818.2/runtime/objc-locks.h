@@ -36,6 +36,7 @@
 // and is enforced by lockdebug.
 
 extern monitor_t classInitLock;
+extern StripedMap<monitor_t> ClassInitWaiters;
 extern mutex_t selLock;
 #if CONFIG_USE_CACHE_LOCK
 extern mutex_t cacheUpdateLock;
@@ -45,7 +46,6 @@ extern mutex_t crashlog_lock;
 extern spinlock_t objcMsgLogLock;
 extern mutex_t AltHandlerDebugLock;
 extern mutex_t AssociationsManagerLock;
-extern StripedMap<spinlock_t> PropertyLocks;
 extern StripedMap<spinlock_t> StructLocks;
 extern StripedMap<spinlock_t> CppObjectLocks;
 
@@ -59,6 +59,9 @@ extern void SideTableLocksSucceedLock(const void *oldlock);
 extern void SideTableLocksPrecedeLocks(StripedMap<spinlock_t>& newlocks);
 extern void SideTableLocksSucceedLocks(StripedMap<spinlock_t>& oldlocks);
 
+// Atomic property getters are lock-free but still need resetting after fork.
+extern void PropertyReadersForceResetAll();
+
 #if __OBJC2__
 #include "objc-locks-new.h"
 #else
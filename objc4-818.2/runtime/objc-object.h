@@ -376,6 +376,28 @@ objc_object::initIsa(Class cls, bool nonpointer, UNUSED_WITHOUT_INDEXED_ISA_AND_
     isa = newisa;
 }
 
+// initInstanceIsa() for many new objects of the same class.
+// The isa is built once and copied, unless isa signing
+// makes it depend on each object's address.
+inline void
+objc_object::initInstanceIsas(id *objs, unsigned count, Class cls, bool hasCxxDtor)
+{
+    if (count == 0) return;
+
+#if (__has_feature(ptrauth_calls) || TARGET_OS_SIMULATOR)  &&  \
+    ISA_SIGNING_SIGN_MODE != ISA_SIGNING_SIGN_NONE
+    for (unsigned i = 0; i < count; i++) {
+        objs[i]->initInstanceIsa(cls, hasCxxDtor);
+    }
+#else
+    objs[0]->initInstanceIsa(cls, hasCxxDtor);
+    isa_t newisa = objs[0]->isa;
+    for (unsigned i = 1; i < count; i++) {
+        objs[i]->isa = newisa;
+    }
+#endif
+}
+
 
 inline Class 
 objc_object::changeIsa(Class newCls)
@@ -622,7 +644,7 @@ objc_object::rootRetain(bool tryRetain, objc_object::RRVariant variant)
 {
     if (slowpath(isTaggedPointer())) return (id)this;
 
-    bool sideTableLocked = false;
+    bool sideTableLocked = (variant == RRVariant::FullLocked);
     bool transcribeToSideTable = false;
 
     isa_t oldisa;
@@ -656,13 +678,19 @@ objc_object::rootRetain(bool tryRetain, objc_object::RRVariant variant)
         newisa = oldisa;
         if (slowpath(!newisa.nonpointer)) {
             ClearExclusive(&isa.bits);
+            if (variant == RRVariant::FastOrDefer) return nil;
+            if (variant == RRVariant::FullLocked) {
+                ASSERT(!tryRetain);
+                sidetable_retain_nolock();
+                return (id)this;
+            }
             if (tryRetain) return sidetable_tryRetain() ? (id)this : nil;
             else return sidetable_retain(sideTableLocked);
         }
         // don't check newisa.fast_rr; we already called any RR overrides
         if (slowpath(newisa.isDeallocating())) {
             ClearExclusive(&isa.bits);
-            if (sideTableLocked) {
+            if (sideTableLocked  &&  variant != RRVariant::FullLocked) {
                 ASSERT(variant == RRVariant::Full);
                 sidetable_unlock();
             }
@@ -677,7 +705,11 @@ objc_object::rootRetain(bool tryRetain, objc_object::RRVariant variant)
 
         if (slowpath(carry)) {
             // newisa.extra_rc++ overflowed
-            if (variant != RRVariant::Full) {
+            if (variant == RRVariant::FastOrDefer) {
+                ClearExclusive(&isa.bits);
+                return nil;
+            }
+            if (variant != RRVariant::Full  &&  variant != RRVariant::FullLocked) {
                 ClearExclusive(&isa.bits);
                 return rootRetain_overflow(tryRetain);
             }
@@ -691,13 +723,18 @@ objc_object::rootRetain(bool tryRetain, objc_object::RRVariant variant)
         }
     } while (slowpath(!StoreExclusive(&isa.bits, &oldisa.bits, newisa.bits)));
 
-    if (variant == RRVariant::Full) {
+    if (variant == RRVariant::Full  ||  variant == RRVariant::FullLocked) {
         if (slowpath(transcribeToSideTable)) {
             // Copy the other half of the retain counts to the side table.
             sidetable_addExtraRC_nolock(RC_HALF);
+            objc::countPerfEvent(objc::PerfSideTableOverflows);
         }
 
-        if (slowpath(!tryRetain && sideTableLocked)) sidetable_unlock();
+        if (slowpath(!tryRetain && sideTableLocked  &&  
+                     variant != RRVariant::FullLocked))
+        {
+            sidetable_unlock();
+        }
     } else {
         ASSERT(!transcribeToSideTable);
         ASSERT(!sideTableLocked);
@@ -739,12 +776,54 @@ objc_object::rootReleaseShouldDealloc()
     return rootRelease(false, RRVariant::Fast);
 }
 
+
+// Batched retain/release for objc_retainArray() and objc_releaseArray().
+// Overrides are called directly. Otherwise only the inline fastpaths 
+// are attempted; false means the side table is needed, and the caller 
+// will finish the operation with the side table lock held.
+
+ALWAYS_INLINE bool
+objc_object::retainBatched()
+{
+    ASSERT(!isTaggedPointer());
+
+    if (slowpath(ISA()->hasCustomRR())) {
+        retain();
+        return true;
+    }
+    return rootRetain(false, RRVariant::FastOrDefer) != nil;
+}
+
+ALWAYS_INLINE bool
+objc_object::releaseBatched()
+{
+    ASSERT(!isTaggedPointer());
+
+    if (slowpath(ISA()->hasCustomRR())) {
+        release();
+        return true;
+    }
+    return !rootRelease(true, RRVariant::FastOrDefer);
+}
+
+inline void
+objc_object::rootRetainLocked()
+{
+    rootRetain(false, RRVariant::FullLocked);
+}
+
+inline bool
+objc_object::rootReleaseLocked()
+{
+    return rootRelease(false, RRVariant::FullLocked);
+}
+
 ALWAYS_INLINE bool
 objc_object::rootRelease(bool performDealloc, objc_object::RRVariant variant)
 {
     if (slowpath(isTaggedPointer())) return false;
 
-    bool sideTableLocked = false;
+    bool sideTableLocked = (variant == RRVariant::FullLocked);
 
     isa_t newisa, oldisa;
 
@@ -778,11 +857,16 @@ retry:
         newisa = oldisa;
         if (slowpath(!newisa.nonpointer)) {
             ClearExclusive(&isa.bits);
+            if (variant == RRVariant::FastOrDefer) return true;
+            if (variant == RRVariant::FullLocked) {
+                ASSERT(!performDealloc);
+                return sidetable_release_nolock();
+            }
             return sidetable_release(sideTableLocked, performDealloc);
         }
         if (slowpath(newisa.isDeallocating())) {
             ClearExclusive(&isa.bits);
-            if (sideTableLocked) {
+            if (sideTableLocked  &&  variant != RRVariant::FullLocked) {
                 ASSERT(variant == RRVariant::Full);
                 sidetable_unlock();
             }
@@ -803,7 +887,7 @@ retry:
 
     if (variant == RRVariant::Full) {
         if (slowpath(sideTableLocked)) sidetable_unlock();
-    } else {
+    } else if (variant != RRVariant::FullLocked) {
         ASSERT(!sideTableLocked);
     }
     return false;
@@ -815,7 +899,11 @@ retry:
     newisa = oldisa;
 
     if (slowpath(newisa.has_sidetable_rc)) {
-        if (variant != RRVariant::Full) {
+        if (variant == RRVariant::FastOrDefer) {
+            ClearExclusive(&isa.bits);
+            return true;
+        }
+        if (variant != RRVariant::Full  &&  variant != RRVariant::FullLocked) {
             ClearExclusive(&isa.bits);
             return rootRelease_underflow(performDealloc);
         }
@@ -824,7 +912,11 @@ retry:
 
         if (!sideTableLocked) {
             ClearExclusive(&isa.bits);
-            sidetable_lock();
+            if (slowpath(DeferSideTableReleases)  &&  performDealloc) {
+                if (!sidetable_lockOrDeferRelease()) return false;
+            } else {
+                sidetable_lock();
+            }
             sideTableLocked = true;
             // Need to start over to avoid a race against 
             // the nonpointer -> raw pointer transition.
@@ -877,7 +969,11 @@ retry:
                 sidetable_clearExtraRC_nolock();
 
             if (!didTransitionToDeallocating) {
-                if (slowpath(sideTableLocked)) sidetable_unlock();
+                if (slowpath(sideTableLocked)  &&  
+                    variant != RRVariant::FullLocked)
+                {
+                    sidetable_unlock();
+                }
                 return false;
             }
         }
@@ -892,14 +988,17 @@ deallocate:
     ASSERT(newisa.isDeallocating());
     ASSERT(isa.isDeallocating());
 
-    if (slowpath(sideTableLocked)) sidetable_unlock();
+    if (slowpath(sideTableLocked)  &&  variant != RRVariant::FullLocked) {
+        sidetable_unlock();
+    }
 
     __c11_atomic_thread_fence(__ATOMIC_ACQUIRE);
 
     if (performDealloc) {
         ((void(*)(objc_object *, SEL))objc_msgSend)(this, @selector(dealloc));
     }
-    return true;
+    // FastOrDefer's result reports a deferral, not a deallocation.
+    return variant != RRVariant::FastOrDefer;
 }
 
 
@@ -1025,6 +1124,14 @@ objc_object::initIsa(Class cls, bool, bool)
     initIsa(cls);
 }
 
+inline void
+objc_object::initInstanceIsas(id *objs, unsigned count, Class cls, bool)
+{
+    for (unsigned i = 0; i < count; i++) {
+        objs[i]->initIsa(cls);
+    }
+}
+
 
 inline Class 
 objc_object::changeIsa(Class cls)
@@ -1172,6 +1279,45 @@ objc_object::rootReleaseShouldDealloc()
 }
 
 
+// Batched retain/release for objc_retainArray() and objc_releaseArray().
+// Without nonpointer isa every retain count lives in the side table, 
+// so everything but the overrides is deferred to the locked path.
+
+inline bool
+objc_object::retainBatched()
+{
+    ASSERT(!isTaggedPointer());
+
+    if (fastpath(!ISA()->hasCustomRR())) return false;
+
+    ((id(*)(objc_object *, SEL))objc_msgSend)(this, @selector(retain));
+    return true;
+}
+
+inline bool
+objc_object::releaseBatched()
+{
+    ASSERT(!isTaggedPointer());
+
+    if (fastpath(!ISA()->hasCustomRR())) return false;
+
+    ((void(*)(objc_object *, SEL))objc_msgSend)(this, @selector(release));
+    return true;
+}
+
+inline void
+objc_object::rootRetainLocked()
+{
+    sidetable_retain_nolock();
+}
+
+inline bool
+objc_object::rootReleaseLocked()
+{
+    return sidetable_release_nolock();
+}
+
+
 // Equivalent to [this autorelease], with shortcuts if there is no override
 inline id 
 objc_object::autorelease()
@@ -762,6 +762,14 @@ class mutex_tt : nocopy_t {
         os_unfair_lock_unlock_inline(&mLock);
     }
 
+    bool tryLock() {
+        if (os_unfair_lock_trylock(&mLock)) {
+            lockdebug_mutex_lock(this);
+            return true;
+        }
+        return false;
+    }
+
     void forceReset() {
         lockdebug_mutex_unlock(this);
 
@@ -690,6 +690,7 @@ static void defineLockOrder()
     // on the assumption that fatal errors could be anywhere.
     lockdebug_lock_precedes_lock(&loadMethodLock, &crashlog_lock);
     lockdebug_lock_precedes_lock(&classInitLock, &crashlog_lock);
+    ClassInitWaiters.precedeLock(&crashlog_lock);
 #if __OBJC2__
     lockdebug_lock_precedes_lock(&runtimeLock, &crashlog_lock);
     lockdebug_lock_precedes_lock(&DemangleCacheLock, &crashlog_lock);
@@ -707,13 +708,13 @@ static void defineLockOrder()
     lockdebug_lock_precedes_lock(&AltHandlerDebugLock, &crashlog_lock);
     lockdebug_lock_precedes_lock(&AssociationsManagerLock, &crashlog_lock);
     SideTableLocksPrecedeLock(&crashlog_lock);
-    PropertyLocks.precedeLock(&crashlog_lock);
     StructLocks.precedeLock(&crashlog_lock);
     CppObjectLocks.precedeLock(&crashlog_lock);
 
     // loadMethodLock precedes everything
     // because it is held while +load methods run
     lockdebug_lock_precedes_lock(&loadMethodLock, &classInitLock);
+    ClassInitWaiters.succeedLock(&loadMethodLock);
 #if __OBJC2__
     lockdebug_lock_precedes_lock(&loadMethodLock, &runtimeLock);
     lockdebug_lock_precedes_lock(&loadMethodLock, &DemangleCacheLock);
@@ -731,41 +732,38 @@ static void defineLockOrder()
     lockdebug_lock_precedes_lock(&loadMethodLock, &AltHandlerDebugLock);
     lockdebug_lock_precedes_lock(&loadMethodLock, &AssociationsManagerLock);
     SideTableLocksSucceedLock(&loadMethodLock);
-    PropertyLocks.succeedLock(&loadMethodLock);
     StructLocks.succeedLock(&loadMethodLock);
     CppObjectLocks.succeedLock(&loadMethodLock);
 
-    // PropertyLocks and CppObjectLocks and AssociationManagerLock 
+    // CppObjectLocks and AssociationManagerLock 
     // precede everything because they are held while objc_retain() 
     // or C++ copy are called.
     // (StructLocks do not precede everything because it calls memmove only.)
-    auto PropertyAndCppObjectAndAssocLocksPrecedeLock = [&](const void *lock) {
-        PropertyLocks.precedeLock(lock);
+    auto CppObjectAndAssocLocksPrecedeLock = [&](const void *lock) {
         CppObjectLocks.precedeLock(lock);
         lockdebug_lock_precedes_lock(&AssociationsManagerLock, lock);
     };
 #if __OBJC2__
-    PropertyAndCppObjectAndAssocLocksPrecedeLock(&runtimeLock);
-    PropertyAndCppObjectAndAssocLocksPrecedeLock(&DemangleCacheLock);
+    CppObjectAndAssocLocksPrecedeLock(&runtimeLock);
+    CppObjectAndAssocLocksPrecedeLock(&DemangleCacheLock);
 #else
-    PropertyAndCppObjectAndAssocLocksPrecedeLock(&methodListLock);
-    PropertyAndCppObjectAndAssocLocksPrecedeLock(&classLock);
-    PropertyAndCppObjectAndAssocLocksPrecedeLock(&NXUniqueStringLock);
-    PropertyAndCppObjectAndAssocLocksPrecedeLock(&impLock);
+    CppObjectAndAssocLocksPrecedeLock(&methodListLock);
+    CppObjectAndAssocLocksPrecedeLock(&classLock);
+    CppObjectAndAssocLocksPrecedeLock(&NXUniqueStringLock);
+    CppObjectAndAssocLocksPrecedeLock(&impLock);
 #endif
-    PropertyAndCppObjectAndAssocLocksPrecedeLock(&classInitLock);
-    PropertyAndCppObjectAndAssocLocksPrecedeLock(&selLock);
+    CppObjectAndAssocLocksPrecedeLock(&classInitLock);
+    ClassInitWaiters.succeedLock(&classInitLock);
+    CppObjectAndAssocLocksPrecedeLock(&selLock);
 #if CONFIG_USE_CACHE_LOCK
-    PropertyAndCppObjectAndAssocLocksPrecedeLock(&cacheUpdateLock);
+    CppObjectAndAssocLocksPrecedeLock(&cacheUpdateLock);
 #endif
-    PropertyAndCppObjectAndAssocLocksPrecedeLock(&objcMsgLogLock);
-    PropertyAndCppObjectAndAssocLocksPrecedeLock(&AltHandlerDebugLock);
+    CppObjectAndAssocLocksPrecedeLock(&objcMsgLogLock);
+    CppObjectAndAssocLocksPrecedeLock(&AltHandlerDebugLock);
 
-    SideTableLocksSucceedLocks(PropertyLocks);
     SideTableLocksSucceedLocks(CppObjectLocks);
     SideTableLocksSucceedLock(&AssociationsManagerLock);
 
-    PropertyLocks.precedeLock(&AssociationsManagerLock);
     CppObjectLocks.precedeLock(&AssociationsManagerLock);
     
 #if __OBJC2__
@@ -801,9 +799,9 @@ static void defineLockOrder()
 
     // Striped locks use address order internally.
     SideTableDefineLockOrder();
-    PropertyLocks.defineLockOrder();
     StructLocks.defineLockOrder();
     CppObjectLocks.defineLockOrder();
+    ClassInitWaiters.defineLockOrder();
 }
 // LOCKDEBUG
 #endif
@@ -818,11 +816,11 @@ void _objc_atfork_prepare()
     lockdebug_setInForkPrepare(true);
 
     loadMethodLock.lock();
-    PropertyLocks.lockAll();
     CppObjectLocks.lockAll();
     AssociationsManagerLock.lock();
     SideTableLockAll();
     classInitLock.enter();
+    ClassInitWaiters.forEach([](monitor_t& m) { m.enter(); });
 #if __OBJC2__
     runtimeLock.lock();
     DemangleCacheLock.lock();
@@ -851,7 +849,6 @@ void _objc_atfork_parent()
 
     CppObjectLocks.unlockAll();
     StructLocks.unlockAll();
-    PropertyLocks.unlockAll();
     AssociationsManagerLock.unlock();
     AltHandlerDebugLock.unlock();
     objcMsgLogLock.unlock();
@@ -871,6 +868,7 @@ void _objc_atfork_parent()
     methodListLock.unlock();
     classLock.unlock();
 #endif
+    ClassInitWaiters.forEach([](monitor_t& m) { m.leave(); });
     classInitLock.leave();
 
     lockdebug_assert_no_locks_locked();
@@ -887,7 +885,7 @@ void _objc_atfork_child()
 
     CppObjectLocks.forceResetAll();
     StructLocks.forceResetAll();
-    PropertyLocks.forceResetAll();
+    PropertyReadersForceResetAll();
     AssociationsManagerLock.forceReset();
     AltHandlerDebugLock.forceReset();
     objcMsgLogLock.forceReset();
@@ -907,6 +905,7 @@ void _objc_atfork_child()
     methodListLock.forceReset();
     classLock.forceReset();
 #endif
+    ClassInitWaiters.forEach([](monitor_t& m) { m.forceReset(); });
     classInitLock.forceReset();
 
     lockdebug_assert_no_locks_locked();
@@ -130,6 +130,7 @@ public:
     // initIsa() should be used to init the isa of new objects only.
     // If this object already has an isa, use changeIsa() for correctness.
     // initInstanceIsa(): objects with no custom RR/AWZ
+    // initInstanceIsas(): many new objects of the same class, as above
     // initClassIsa(): class objects
     // initProtocolIsa(): protocol objects
     // initIsa(): other objects
@@ -137,6 +138,7 @@ public:
     void initClassIsa(Class cls /*nonpointer=maybe*/);
     void initProtocolIsa(Class cls /*nonpointer=maybe*/);
     void initInstanceIsa(Class cls, bool hasCxxDtor);
+    static void initInstanceIsas(id *objs, unsigned count, Class cls, bool hasCxxDtor);
 
     // changeIsa() should be used to change the isa of existing objects.
     // If this is a new object, use initIsa() for performance.
@@ -173,6 +175,17 @@ public:
     bool rootReleaseShouldDealloc();
     uintptr_t rootRetainCount();
 
+    // Batched retain/release, used by objc_retainArray/objc_releaseArray
+    // retainBatched()/releaseBatched() return false instead of 
+    // touching the side table; the caller then retries the object with 
+    // rootRetainLocked()/rootReleaseLocked() under its side table lock.
+    // rootReleaseLocked() never calls -dealloc. It returns true if 
+    // the caller should do so after unlocking.
+    bool retainBatched();
+    bool releaseBatched();
+    void rootRetainLocked();
+    bool rootReleaseLocked();
+
     // Implementation of dealloc methods
     bool rootIsDeallocating();
     void clearDeallocating();
@@ -191,10 +204,17 @@ private:
     // - Fast means the fastpaths only
     // - FastOrMsgSend means the fastpaths but checking whether we should call
     //   -retain/-release or Swift, for the usage of objc_{retain,release}
+    // - FastOrDefer means the fastpaths only, but instead of taking the side 
+    //   table lock it gives up and reports it to the caller, for the usage 
+    //   of objc_{retain,release}Array
+    // - FullLocked means the full implementation with the side table lock 
+    //   already held by the caller, and still held on return
     enum class RRVariant {
         Full,
         Fast,
         FastOrMsgSend,
+        FastOrDefer,
+        FullLocked,
     };
 
     // Unified retain count manipulation for nonpointer isa
@@ -210,6 +230,7 @@ private:
 
     void sidetable_lock();
     void sidetable_unlock();
+    bool sidetable_lockOrDeferRelease();
 
     void sidetable_moveExtraRC_nolock(size_t extra_rc, bool isDeallocating, bool weaklyReferenced);
     bool sidetable_addExtraRC_nolock(size_t delta_rc);
@@ -227,9 +248,11 @@ private:
 
     id sidetable_retain(bool locked = false);
     id sidetable_retain_slow(SideTable& table);
+    void sidetable_retain_nolock();
 
     uintptr_t sidetable_release(bool locked = false, bool performDealloc = true);
     uintptr_t sidetable_release_slow(SideTable& table, bool performDealloc = true);
+    bool sidetable_release_nolock();
 
     bool sidetable_tryRetain();
 
@@ -713,6 +736,9 @@ typedef struct {
     const char **classNameLookups;  // for objc_getClass() hooks
     unsigned classNameLookupsAllocated;
     unsigned classNameLookupsUsed;
+    struct SlabCache *slabCache;  // for objc::SlabAllocator
+    struct PerfCounterBlock *perfCounters;  // for _objc_getPerformanceCounters()
+    struct DeferredReleases *deferredReleases;  // for OBJC_DEFER_SIDE_TABLE_RELEASES
 
     // If you add new fields here, don't forget to update 
     // _objc_pthread_destroyspecific()
@@ -722,6 +748,24 @@ typedef struct {
 extern _objc_pthread_data *_objc_fetch_pthread_data(bool create);
 extern void tls_init(void);
 
+// Performance counters, summed by _objc_getPerformanceCounters().
+// Call countPerfEvent() from slow paths only.
+namespace objc {
+enum PerfCounterID {
+    PerfClassesRealized,
+    PerfLazyRealizations,
+    PerfCacheMisses,
+    PerfCacheGrows,
+    PerfCacheFlushes,
+    PerfCollectingScans,
+    PerfSideTableOverflows,
+    PerfCounterCount
+};
+extern void countPerfEvent(PerfCounterID counter);
+};
+// NSObject.mm
+extern void weak_table_getSizes(size_t *referents, size_t *capacity);
+
 // encoding.h
 extern unsigned int encoding_getNumberOfArguments(const char *typedesc);
 extern unsigned int encoding_getSizeOfArguments(const char *typedesc);
@@ -730,10 +774,18 @@ extern void encoding_getReturnType(const char *t, char *dst, size_t dst_len);
 extern char * encoding_copyReturnType(const char *t);
 extern void encoding_getArgumentType(const char *t, unsigned int index, char *dst, size_t dst_len);
 extern char *encoding_copyArgumentType(const char *t, unsigned int index);
+extern void encoding_forgetTypes(const char *t);
+extern void encoding_forgetAllTypes(void);
 
 // sync.h
 extern void _destroySyncCache(struct SyncCache *cache);
 
+// objc-zalloc.mm
+extern void _destroySlabCache(struct SlabCache *cache);
+
+// NSObject.mm
+extern void _destroyDeferredReleases(struct DeferredReleases *buffer);
+
 // arr
 extern void arr_init(void);
 extern id objc_autoreleaseReturnValue(id obj);
@@ -886,108 +938,37 @@ inline void operator delete[](void* p, const std::nothrow_t&) noexcept(true) { f
 
 class TimeLogger {
     uint64_t mStart;
+    bool mPrint;
     bool mRecord;
  public:
-    TimeLogger(bool record = true) 
+    // record measures each step without logging it, 
+    // for callers that keep their own totals.
+    TimeLogger(bool print = true, bool record = false) 
      : mStart(nanoseconds())
-     , mRecord(record) 
+     , mPrint(print)
+     , mRecord(print || record) 
     { }
 
-    void log(const char *msg) {
-        if (mRecord) {
-            uint64_t end = nanoseconds();
-            _objc_inform("%.2f ms: %s", (end - mStart) / 1000000.0, msg);
-            mStart = nanoseconds();
-        }
-    }
-};
-
-enum { CacheLineSize = 64 };
-
-// StripedMap<T> is a map of void* -> T, sized appropriately 
-// for cache-friendly lock striping. 
-// For example, this may be used as StripedMap<spinlock_t>
-// or as StripedMap<SomeStruct> where SomeStruct stores a spin lock.
-template<typename T>
-class StripedMap {
-#if TARGET_OS_IPHONE && !TARGET_OS_SIMULATOR
-    enum { StripeCount = 8 };
-#else
-    enum { StripeCount = 64 };
-#endif
-
-    struct PaddedT {
-        T value alignas(CacheLineSize);
-    };
-
-    PaddedT array[StripeCount];
-
-    static unsigned int indexForPointer(const void *p) {
-        uintptr_t addr = reinterpret_cast<uintptr_t>(p);
-        return ((addr >> 4) ^ (addr >> 9)) % StripeCount;
-    }
-
- public:
-    T& operator[] (const void *p) { 
-        return array[indexForPointer(p)].value; 
-    }
-    const T& operator[] (const void *p) const { 
-        return const_cast<StripedMap<T>>(this)[p]; 
+    // Returns the time since the previous step, or 0 if not recording.
+    uint64_t log(const char *msg) {
+        return log(nil, msg);
     }
 
-    // Shortcuts for StripedMaps of locks.
-    void lockAll() {
-        for (unsigned int i = 0; i < StripeCount; i++) {
-            array[i].value.lock();
+    uint64_t log(const char *prefix, const char *msg) {
+        if (!mRecord) return 0;
+        uint64_t end = nanoseconds();
+        uint64_t elapsed = end - mStart;
+        if (mPrint) {
+            _objc_inform("%.2f ms: %s%s%s", elapsed / 1000000.0, 
+                         prefix ?: "", prefix ? ": " : "", msg);
         }
+        mStart = nanoseconds();
+        return elapsed;
     }
-
-    void unlockAll() {
-        for (unsigned int i = 0; i < StripeCount; i++) {
-            array[i].value.unlock();
-        }
-    }
-
-    void forceResetAll() {
-        for (unsigned int i = 0; i < StripeCount; i++) {
-            array[i].value.forceReset();
-        }
-    }
-
-    void defineLockOrder() {
-        for (unsigned int i = 1; i < StripeCount; i++) {
-            lockdebug_lock_precedes_lock(&array[i-1].value, &array[i].value);
-        }
-    }
-
-    void precedeLock(const void *newlock) {
-        // assumes defineLockOrder is also called
-        lockdebug_lock_precedes_lock(&array[StripeCount-1].value, newlock);
-    }
-
-    void succeedLock(const void *oldlock) {
-        // assumes defineLockOrder is also called
-        lockdebug_lock_precedes_lock(oldlock, &array[0].value);
-    }
-
-    const void *getLock(int i) {
-        if (i < StripeCount) return &array[i].value;
-        else return nil;
-    }
-    
-#if DEBUG
-    StripedMap() {
-        // Verify alignment expectations.
-        uintptr_t base = (uintptr_t)&array[0].value;
-        uintptr_t delta = (uintptr_t)&array[1].value - base;
-        ASSERT(delta % CacheLineSize == 0);
-        ASSERT(base % CacheLineSize == 0);
-    }
-#else
-    constexpr StripedMap() {}
-#endif
 };
 
+#include "objc-stripedmap.h"
+
 
 // DisguisedPtr<T> acts like pointer type T*, except the 
 // stored value is disguised to hide it from tools like `leaks`.
@@ -80,8 +80,8 @@
 #define RW_CONSTRUCTING       (1<<26)
 // class allocated and registered
 #define RW_CONSTRUCTED        (1<<25)
-// available for use; was RW_FINALIZE_ON_MAIN_THREAD
-// #define RW_24 (1<<24)
+// class's instances come from objc::SlabAllocator (not inherited)
+#define RW_SLAB_ALLOCATED     (1<<24)
 // class +load has been called
 #define RW_LOADED             (1<<23)
 #if !SUPPORT_NONPOINTER_ISA
@@ -481,6 +481,7 @@ public:
     void copyCacheNolock(objc_imp_cache_entry *buffer, int len);
     void destroy();
     void eraseNolock(const char *func);
+    void eraseNolock(const char *func, const SEL *sels, uint32_t count);
 
     static void init();
     static void collectNolock(bool collectALot);
@@ -1445,6 +1446,8 @@ class protocol_array_t :
     protocol_array_t(protocol_list_t *l) : Super(l) { }
 };
 
+struct method_index_t;
+
 struct class_rw_ext_t {
     DECLARE_AUTHED_PTR_TEMPLATE(class_ro_t)
     class_ro_t_authed_ptr<const class_ro_t> ro;
@@ -1453,6 +1456,8 @@ struct class_rw_ext_t {
     protocol_array_t protocols;
     char *demangledName;
     uint32_t version;
+    // Merged index of `methods`, built on demand. See getMethodNoSuper_nolock.
+    method_index_t *methodIndex;
 };
 
 struct class_rw_t {
@@ -2044,6 +2049,10 @@ struct objc_class : objc_object {
 
     IMP getLoadMethod();
 
+    bool usesSlabAllocator() {
+        return data()->flags & RW_SLAB_ALLOCATED;
+    }
+
     // Locking: To prevent concurrent realization, hold runtimeLock.
     bool isRealized() const {
         return !isStubClass() && (data()->flags & RW_REALIZED);
@@ -48,6 +48,8 @@ static method_t *search_method_list(const method_list_t *mlist, SEL sel);
 template<typename T> static bool method_lists_contains_any(T *mlists, T *end,
         SEL sels[], size_t selcount);
 static void flushCaches(Class cls, const char *func, bool (^predicate)(Class c));
+static void flushCaches(Class cls, const char *func, const SEL *sels, uint32_t count, bool (^predicate)(Class c));
+static void flushCachesForMethodLists(Class cls, const char *func, method_list_t * const *mlists, uint32_t count);
 static void initializeTaggedPointerObfuscator(void);
 #if SUPPORT_FIXUP
 static void fixupMessageRef(message_ref_t *msg);
@@ -1420,6 +1422,9 @@ attachCategories(Class cls, const locstamped_category_t *cats_list, uint32_t cat
             if (mcount == ATTACH_BUFSIZ) {
                 prepareMethodLists(cls, mlists, mcount, NO, fromBundle, __func__);
                 rwe->methods.attachLists(mlists, mcount);
+                if (flags & ATTACH_EXISTING) {
+                    flushCachesForMethodLists(cls, __func__, mlists, mcount);
+                }
                 mcount = 0;
             }
             mlists[ATTACH_BUFSIZ - ++mcount] = mlist;
@@ -1451,11 +1456,8 @@ attachCategories(Class cls, const locstamped_category_t *cats_list, uint32_t cat
                            NO, fromBundle, __func__);
         rwe->methods.attachLists(mlists + ATTACH_BUFSIZ - mcount, mcount);
         if (flags & ATTACH_EXISTING) {
-            flushCaches(cls, __func__, [](Class c){
-                // constant caches have been dealt with in prepareMethodLists
-                // if the class still is constant here, it's fine to keep
-                return !c->cache.isConstantOptimizedCache();
-            });
+            flushCachesForMethodLists(cls, __func__,
+                                      mlists + ATTACH_BUFSIZ - mcount, mcount);
         }
     }
 
@@ -2617,6 +2619,7 @@ static Class realizeClassWithoutSwift(Class cls, Class previously)
         return cls;
     }
     ASSERT(cls == remapClass(cls));
+    objc::countPerfEvent(objc::PerfClassesRealized);
 
     // fixme verify class is not in an un-dlopened part of the shared cache?
 
@@ -2879,6 +2882,7 @@ static Class
 realizeClassMaybeSwiftMaybeRelock(Class cls, mutex_t& lock, bool leaveLocked)
 {
     lock.assertLocked();
+    objc::countPerfEvent(objc::PerfLazyRealizations);
 
     if (!cls->isSwiftStable_ButAllowLegacyForNow()) {
         // Non-Swift class. Realize it now with the lock still held.
@@ -3078,6 +3082,70 @@ static void flushCaches(Class cls, const char *func, bool (^predicate)(Class))
     }
 }
 
+// Like flushCaches, but only erases the entries for the given selectors.
+// sels need not be sorted or unique.
+static void flushCaches(Class cls, const char *func, const SEL *sels, uint32_t count, bool (^predicate)(Class))
+{
+    runtimeLock.assertLocked();
+#if CONFIG_USE_CACHE_LOCK
+    mutex_locker_t lock(cacheUpdateLock);
+#endif
+
+    if (count == 0) return;
+
+    SEL *sorted = (SEL *)memdup(sels, count * sizeof(SEL));
+    std::sort(sorted, sorted + count, [](SEL a, SEL b) {
+        return (uintptr_t)a < (uintptr_t)b;
+    });
+    count = (uint32_t)(std::unique(sorted, sorted + count) - sorted);
+
+    const auto handler = ^(Class c) {
+        if (predicate(c)) {
+            c->cache.eraseNolock(func, sorted, count);
+        }
+
+        return true;
+    };
+
+    if (cls) {
+        foreach_realized_class_and_subclass(cls, handler);
+    } else {
+        foreach_realized_class_and_metaclass(handler);
+    }
+
+    free(sorted);
+}
+
+// Erase the selectors of newly attached method lists from the caches
+// of cls and its subclasses. Other cached methods are unaffected.
+static void flushCachesForMethodLists(Class cls, const char *func,
+                                      method_list_t * const *mlists, uint32_t count)
+{
+    runtimeLock.assertLocked();
+
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        total += mlists[i]->count;
+    }
+    if (total == 0) return;
+
+    SEL *sels = (SEL *)malloc(total * sizeof(SEL));
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        for (auto& meth : *mlists[i]) {
+            sels[n++] = meth.name();
+        }
+    }
+
+    flushCaches(cls, func, sels, n, [](Class c){
+        // constant caches have been dealt with in prepareMethodLists
+        // if the class still is constant here, it's fine to keep
+        return !c->cache.isConstantOptimizedCache();
+    });
+
+    free(sels);
+}
+
 
 void _objc_flush_caches(Class cls)
 {
@@ -3489,6 +3557,63 @@ readProtocol(protocol_t *newproto, Class protocol_class,
     }
 }
 
+/***********************************************************************
+* ImagePhase
+* Running totals for each step of _read_images(), 
+* logged by OBJC_PRINT_IMAGE_PHASES. 
+* OBJC_PRINT_IMAGE_TIMES logs each step of each call instead.
+* Locking: runtimeLock must be held by the caller.
+**********************************************************************/
+enum ImagePhaseID {
+    ImagePhaseFirstTime,
+    ImagePhaseSelectors,
+    ImagePhaseClasses,
+    ImagePhaseRemapClasses,
+    ImagePhaseMessageRefs,
+    ImagePhaseProtocols,
+    ImagePhaseProtocolRefs,
+    ImagePhaseCategories,
+    ImagePhaseNonLazyClasses,
+    ImagePhaseFutureClasses,
+    ImagePhaseCount
+};
+
+static struct ImagePhase {
+    const char *name;
+    uint64_t nanoseconds;
+    size_t refs;          // for steps that fix up references
+    unsigned runs;
+} ImagePhases[ImagePhaseCount] = {
+    { "first time tasks" },
+    { "fix up selector references" },
+    { "discover classes" },
+    { "remap classes" },
+    { "fix up objc_msgSend_fixup" },
+    { "discover protocols" },
+    { "fix up @protocol references" },
+    { "discover categories" },
+    { "realize non-lazy classes" },
+    { "realize future classes" },
+};
+
+static void logImagePhase(TimeLogger& ts, ImagePhaseID id)
+{
+    ImagePhase& phase = ImagePhases[id];
+    phase.nanoseconds += ts.log("IMAGE TIMES", phase.name);
+    phase.runs++;
+}
+
+static void printImagePhases()
+{
+    for (auto& phase : ImagePhases) {
+        if (!phase.runs) continue;
+        _objc_inform("IMAGE PHASES: %.2f ms total: %s (%zu refs, %u runs)", 
+                     phase.nanoseconds / 1000000.0, phase.name, 
+                     phase.refs, phase.runs);
+    }
+}
+
+
 /***********************************************************************
  * _read_images
  * @dis 对以headerList开头的链表中的头文件进行初始化处理。
@@ -3515,7 +3640,7 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
     size_t resolvedFutureClassCount = 0;
     static bool doneOnce;
     bool launchTime = NO;
-    TimeLogger ts(PrintImageTimes);
+    TimeLogger ts(PrintImageTimes, PrintImagePhases);
 
     runtimeLock.assertLocked();
 
@@ -3599,10 +3724,12 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
         gdb_objc_realized_classes =
             NXCreateMapTable(NXStrValueMapPrototype, namedClassesSize);
 
-        ts.log("IMAGE TIMES: first time tasks");
+        logImagePhase(ts, ImagePhaseFirstTime);
     }
 
     // Fix up @selector references
+    // This stays on the calling thread. dyld calls here with runtimeLock 
+    // held, and the first time before libdispatch is initialized.
     static size_t UnfixedSelectors;
     {
         mutex_locker_t lock(selLock);
@@ -3612,6 +3739,7 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
             bool isBundle = hi->isBundle();
             SEL *sels = _getObjc2SelectorRefs(hi, &count);
             UnfixedSelectors += count;
+            ImagePhases[ImagePhaseSelectors].refs += count;
             for (i = 0; i < count; i++) {
                 const char *name = sel_cname(sels[i]);
                 SEL sel = sel_registerNameNoLock(name, isBundle);
@@ -3622,7 +3750,7 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
         }
     }
 
-    ts.log("IMAGE TIMES: fix up selector references");
+    logImagePhase(ts, ImagePhaseSelectors);
 
     // Discover classes. Fix up unresolved future classes. Mark bundle classes.
     bool hasDyldRoots = dyld_shared_cache_some_image_overridden();
@@ -3654,7 +3782,7 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
         }
     }
 
-    ts.log("IMAGE TIMES: discover classes");
+    logImagePhase(ts, ImagePhaseClasses);
 
     // Fix up remapped classes
     // Class list and nonlazy class list remain unremapped.
@@ -3663,18 +3791,20 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
     if (!noClassesRemapped()) {
         for (EACH_HEADER) {
             Class *classrefs = _getObjc2ClassRefs(hi, &count);
+            ImagePhases[ImagePhaseRemapClasses].refs += count;
             for (i = 0; i < count; i++) {
                 remapClassRef(&classrefs[i]);
             }
             // fixme why doesn't test future1 catch the absence of this?
             classrefs = _getObjc2SuperRefs(hi, &count);
+            ImagePhases[ImagePhaseRemapClasses].refs += count;
             for (i = 0; i < count; i++) {
                 remapClassRef(&classrefs[i]);
             }
         }
     }
 
-    ts.log("IMAGE TIMES: remap classes");
+    logImagePhase(ts, ImagePhaseRemapClasses);
 
 #if SUPPORT_FIXUP
     // Fix up old objc_msgSend_fixup call sites
@@ -3686,12 +3816,13 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
             _objc_inform("VTABLES: repairing %zu unsupported vtable dispatch "
                          "call sites in %s", count, hi->fname());
         }
+        ImagePhases[ImagePhaseMessageRefs].refs += count;
         for (i = 0; i < count; i++) {
             fixupMessageRef(refs+i);
         }
     }
 
-    ts.log("IMAGE TIMES: fix up objc_msgSend_fixup");
+    logImagePhase(ts, ImagePhaseMessageRefs);
 #endif
 
 
@@ -3726,7 +3857,7 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
         }
     }
 
-    ts.log("IMAGE TIMES: discover protocols");
+    logImagePhase(ts, ImagePhaseProtocols);
 
     // Fix up @protocol references
     // Preoptimized images may have the right 
@@ -3739,12 +3870,13 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
         if (launchTime && hi->isPreoptimized())
             continue;
         protocol_t **protolist = _getObjc2ProtocolRefs(hi, &count);
+        ImagePhases[ImagePhaseProtocolRefs].refs += count;
         for (i = 0; i < count; i++) {
             remapProtocolRef(&protolist[i]);
         }
     }
 
-    ts.log("IMAGE TIMES: fix up @protocol references");
+    logImagePhase(ts, ImagePhaseProtocolRefs);
 
     // Discover categories. Only do this after the initial category
     // attachment has been done. For categories present at startup,
@@ -3756,7 +3888,7 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
         }
     }
 
-    ts.log("IMAGE TIMES: discover categories");
+    logImagePhase(ts, ImagePhaseCategories);
 
     // Category discovery MUST BE Late to avoid potential races
     // when other threads call the new category code before
@@ -3787,7 +3919,7 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
         }
     }
 
-    ts.log("IMAGE TIMES: realize non-lazy classes");
+    logImagePhase(ts, ImagePhaseNonLazyClasses);
 
     // Realize newly-resolved future classes, in case CF manipulates them
     if (resolvedFutureClasses) {
@@ -3802,7 +3934,7 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
         free(resolvedFutureClasses);
     }
 
-    ts.log("IMAGE TIMES: realize future classes");
+    logImagePhase(ts, ImagePhaseFutureClasses);
 
     if (DebugNonFragileIvars) {
         realizeAllClasses();
@@ -3868,6 +4000,10 @@ void _read_images(header_info **hList, uint32_t hCount, int totalClasses, int un
                      "pre-optimized", UnfixedProtocolReferences);
     }
 
+    if (PrintImagePhases) {
+        printImagePhases();
+    }
+
 #undef EACH_HEADER
 }
 
@@ -3942,6 +4078,9 @@ void _unload_image(header_info *hi)
     loadMethodLock.assertLocked();
     runtimeLock.assertLocked();
 
+    // The image's method type strings are about to go away.
+    encoding_forgetAllTypes();
+
     // Unload unattached categories and categories waiting for +load.
 
     // Ignore __objc_catlist2. We don't support unloading Swift
@@ -4080,7 +4219,7 @@ _method_setImplementation(Class cls, method_t *m, IMP imp)
     // RR/AWZ updates are slow if cls is nil (i.e. unknown)
     // fixme build list of classes whose Methods are known externally?
 
-    flushCaches(cls, __func__, [sel, old](Class c){
+    flushCaches(cls, __func__, &sel, 1, [sel, old](Class c){
         return c->cache.shouldFlush(sel, old);
     });
 
@@ -4124,7 +4263,8 @@ void method_exchangeImplementations(Method m1, Method m2)
     // Cache updates are slow because class is unknown
     // fixme build list of classes whose Methods are known externally?
 
-    flushCaches(nil, __func__, [sel1, sel2, imp1, imp2](Class c){
+    SEL sels[] = { sel1, sel2 };
+    flushCaches(nil, __func__, sels, 2, [sel1, sel2, imp1, imp2](Class c){
         return c->cache.shouldFlush(sel1, imp1) || c->cache.shouldFlush(sel2, imp2);
     });
 
@@ -6072,6 +6212,103 @@ method_lists_contains_any(T *mlists, T *end,
 }
 
 
+/***********************************************************************
+ * method_index_t
+ * A merged copy of every method in a class's method lists, sorted by
+ * selector, so that a class with many categories can be searched with
+ * one binary search instead of one per attached list.
+ *
+ * Each selector appears once, mapped to the method that a search of the
+ * lists in order would have found, so category overrides are preserved.
+ *
+ * The index remembers the lists array it was built from. attachLists
+ * always replaces the array with a new, longer one, and lists are never
+ * removed, so a different array or count means the index is stale.
+ * Locking: runtimeLock must be held by the caller
+ **********************************************************************/
+struct method_index_t {
+    struct entry_t {
+        SEL name;
+        method_t *meth;
+    };
+
+    const void *lists;
+    uint32_t listCount;
+    uint32_t count;
+    entry_t entries[0];
+
+    static size_t byteSize(uint32_t count) {
+        return sizeof(method_index_t) + count * sizeof(entry_t);
+    }
+
+    bool isCurrent(const method_array_t &methods) const {
+        return lists == (const void *)methods.beginLists()
+            &&  listCount == (uint32_t)(methods.endLists() - methods.beginLists());
+    }
+
+    method_t *lookup(SEL sel) const {
+        uintptr_t key = (uintptr_t)sel;
+        const entry_t *base = entries;
+        for (uint32_t n = count; n != 0; n >>= 1) {
+            const entry_t *probe = base + (n >> 1);
+            uintptr_t probeValue = (uintptr_t)probe->name;
+            if (key == probeValue) return probe->meth;
+            if (key > probeValue) {
+                base = probe + 1;
+                n--;
+            }
+        }
+        return nil;
+    }
+};
+
+// Classes with fewer method lists than this are searched list by list.
+#define METHOD_INDEX_MIN_LISTS 4
+
+static method_index_t *
+buildMethodIndex(const method_array_t &methods)
+{
+    runtimeLock.assertLocked();
+
+    uint32_t total = 0;
+    for (auto mlists = methods.beginLists(), end = methods.endLists();
+         mlists != end;
+         ++mlists)
+    {
+        total += (*mlists)->count;
+    }
+
+    auto index = (method_index_t *)malloc(method_index_t::byteSize(total));
+    index->lists = (const void *)methods.beginLists();
+    index->listCount = (uint32_t)(methods.endLists() - methods.beginLists());
+
+    // Entries in search order, then a stable sort by selector
+    // so the first entry for each selector is the one search would find.
+    uint32_t i = 0;
+    for (auto& meth : methods) {
+        index->entries[i++] = { meth.name(), &meth };
+    }
+    std::stable_sort(index->entries, index->entries + total,
+                     [](const method_index_t::entry_t &a,
+                        const method_index_t::entry_t &b) {
+        return (uintptr_t)a.name < (uintptr_t)b.name;
+    });
+
+    // Drop the shadowed duplicates.
+    uint32_t unique = 0;
+    for (i = 0; i < total; i++) {
+        if (unique == 0  ||
+            index->entries[unique-1].name != index->entries[i].name)
+        {
+            index->entries[unique++] = index->entries[i];
+        }
+    }
+    index->count = unique;
+
+    return index;
+}
+
+
 /***********************************************************************
  * getMethodNoSuper_nolock
  * fixme
@@ -6086,6 +6323,19 @@ getMethodNoSuper_nolock(Class cls, SEL sel)
     // fixme nil cls? 
     // fixme nil sel?
 
+    // Classes with many attached lists use the merged index,
+    // (re)built here if the lists changed since it was last used.
+    auto rwe = cls->data()->ext();
+    if (rwe  &&  rwe->methods.countLists() >= METHOD_INDEX_MIN_LISTS) {
+        method_index_t *index = rwe->methodIndex;
+        if (slowpath(!index  ||  !index->isCurrent(rwe->methods))) {
+            free(index);
+            index = buildMethodIndex(rwe->methods);
+            rwe->methodIndex = index;
+        }
+        return index->lookup(sel);
+    }
+
     auto const methods = cls->data()->methods();
     for (auto mlists = methods.beginLists(),
               end = methods.endLists();
@@ -6346,6 +6596,35 @@ realizeAndInitializeIfNeeded_locked(id inst, Class cls, bool initialize)
     return cls;
 }
 
+/***********************************************************************
+* countCacheMiss
+* Count a method lookup that missed cls's cache. 
+* With OBJC_RECORD_CLASS_CACHE_MISSES, also count it for cls itself.
+* Locking: runtimeLock must be held by the caller.
+**********************************************************************/
+static objc::LazyInitDenseMap<Class, size_t> ClassCacheMisses;
+
+static void countCacheMiss(Class cls)
+{
+    runtimeLock.assertLocked();
+
+    objc::countPerfEvent(objc::PerfCacheMisses);
+    if (slowpath(RecordClassCacheMisses)) {
+        (*ClassCacheMisses.get(true))[cls]++;
+    }
+}
+
+size_t _class_getCacheMissCount(Class cls)
+{
+    if (!cls) return 0;
+    mutex_locker_t lock(runtimeLock);
+    auto *map = ClassCacheMisses.get(false);
+    if (!map) return 0;
+    auto it = map->find(cls);
+    return it == map->end() ? 0 : it->second;
+}
+
+
 /***********************************************************************
 * lookUpImpOrForward / lookUpImpOrForwardTryCache / lookUpImpOrNilTryCache
 * The standard IMP lookup.
@@ -6449,6 +6728,7 @@ IMP lookUpImpOrForward(id inst, SEL sel, Class cls, int behavior)
     // runtimeLock may have been dropped but is now locked again
     runtimeLock.assertLocked();
     curClass = cls;
+    countCacheMiss(cls);
 
     // The code used to lookup the class's cache again right after
     // we take the lock but for the vast majority of the cases
@@ -7046,11 +7326,7 @@ addMethods_finish(Class cls, method_list_t *newlist)
     // If the class being modified has a constant cache,
     // then all children classes are flattened constant caches
     // and need to be flushed as well.
-    flushCaches(cls, __func__, [](Class c){
-        // constant caches have been dealt with in prepareMethodLists
-        // if the class still is constant here, it's fine to keep
-        return !c->cache.isConstantOptimizedCache();
-    });
+    flushCachesForMethodLists(cls, __func__, &newlist, 1);
 }
 
 
@@ -7848,9 +8124,11 @@ static void free_class(Class cls)
 
     if (rwe) {
         for (auto& meth : rwe->methods) {
+            encoding_forgetTypes(meth.types());
             try_free(meth.types());
         }
         rwe->methods.tryFree();
+        free(rwe->methodIndex);
     }
     
     const ivar_list_t *ivars = ro->ivars;
@@ -7988,11 +8266,16 @@ _class_createInstanceFromZone(Class cls, size_t extraBytes, void *zone,
     size = cls->instanceSize(extraBytes);
     if (outAllocatedSize) *outAllocatedSize = size;
 
-    id obj;
+    id obj = nil;
     if (zone) {
         obj = (id)malloc_zone_calloc((malloc_zone_t *)zone, 1, size);
     } else {
-        obj = (id)calloc(1, size);
+        if (slowpath(cls->usesSlabAllocator())  &&
+            objc::SlabAllocator::canAllocate(size))
+        {
+            obj = (id)objc::SlabAllocator::alloc(size);
+        }
+        if (fastpath(!obj)) obj = (id)calloc(1, size);
     }
     if (slowpath(!obj)) {
         if (construct_flags & OBJECT_CONSTRUCT_CALL_BADALLOC) {
@@ -8038,9 +8321,6 @@ _objc_rootAllocWithZone(Class cls, malloc_zone_t *zone __unused)
 * fixme
 * Locking: none
 **********************************************************************/
-#if SUPPORT_NONPOINTER_ISA
-#warning fixme optimize class_createInstances
-#endif
 unsigned 
 class_createInstances(Class cls, size_t extraBytes, 
                       id *results, unsigned num_requested)
@@ -8049,6 +8329,33 @@ class_createInstances(Class cls, size_t extraBytes,
                                           results, num_requested);
 }
 
+
+/***********************************************************************
+* _class_setUsesSlabAllocator
+* Allocate future instances of cls (but not of its subclasses) from
+* objc::SlabAllocator, or stop doing so. Instances bigger than
+* SlabAllocator::maxSize are allocated as usual.
+* Instances can be freed regardless of the current setting, because
+* free() finds the slab's malloc zone from the pointer.
+* Locking: acquires runtimeLock
+**********************************************************************/
+void
+_class_setUsesSlabAllocator(Class cls, BOOL slab)
+{
+    if (!cls) return;
+
+    mutex_locker_t lock(runtimeLock);
+    checkIsKnownClass(cls);
+    ASSERT(cls->isRealized());
+
+    if (slab) {
+        objc::SlabAllocator::init();
+        cls->data()->setFlags(RW_SLAB_ALLOCATED);
+    } else {
+        cls->data()->clearFlags(RW_SLAB_ALLOCATED);
+    }
+}
+
 /***********************************************************************
 * object_copyFromZone
 * fixme
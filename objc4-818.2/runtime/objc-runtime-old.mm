@@ -2376,6 +2376,7 @@ static void unload_mlist(old_method_list *mlist)
 {
     int i;
     for (i = 0; i < mlist->method_count; i++) {
+        encoding_forgetTypes(mlist->method_list[i].method_types);
         try_free(mlist->method_list[i].method_types);
     }
     try_free(mlist);
@@ -2695,6 +2696,9 @@ void _unload_image(header_info *hi)
 {
     loadMethodLock.assertLocked();
 
+    // The image's method type strings are about to go away.
+    encoding_forgetAllTypes();
+
     // Cleanup:
     // Remove image's classes from the class list and free auxiliary data.
     // Remove image's unresolved or loadable categories and free auxiliary data
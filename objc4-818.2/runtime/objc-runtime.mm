@@ -90,6 +90,7 @@ const option_t Settings[] = {
 
 namespace objc {
     int PageCountWarning = 50;  // Default value if the environment variable is not set
+    unsigned PoolPageCacheSize = 1;  // Default value if the environment variable is not set
 }
 
 // objc's key for pthread_getspecific
@@ -342,6 +343,21 @@ void removeHeader(header_info *hi)
 #endif
 }
 
+/***********************************************************************
+* SetPoolPageCacheSize
+* Convert environment variable value to integer value.
+* If the value is valid, set the global PoolPageCacheSize value.
+**********************************************************************/
+void SetPoolPageCacheSize(const char* envvar) {
+    if (envvar) {
+        char *end;
+        long result = strtol(envvar, &end, 10);
+        if (end != envvar  &&  result >= 0  &&  result <= UINT16_MAX) {
+            objc::PoolPageCacheSize = (unsigned)result;
+        }
+    }
+}
+
 /***********************************************************************
 * SetPageCountWarning
 * Convert environment variable value to integer value.
@@ -415,6 +431,11 @@ void environ_init(void)
             continue;
         }
 
+        if (0 == strncmp(*p, "OBJC_POOL_PAGE_CACHE_LIMIT=", 27)) {
+            SetPoolPageCacheSize(*p + 27);
+            continue;
+        }
+
         const char *value = strchr(*p, '=');
         if (!*value) continue;
         value++;
@@ -527,6 +548,128 @@ _objc_pthread_data *_objc_fetch_pthread_data(bool create)
 }
 
 
+/***********************************************************************
+* Performance counters
+* Each thread counts into its own block, so counting is a plain load 
+* and store to a cache line no other thread writes. Blocks are never 
+* freed: an exiting thread leaves its block for the next new thread, 
+* and its counts stay in the totals. Threads without objc pthread data 
+* count atomically into PerfCounterShared instead.
+**********************************************************************/
+struct PerfCounterBlock {
+    PerfCounterBlock *next;  // immutable once the block is published
+    std::atomic<bool> inUse;
+    std::atomic<size_t> counts[objc::PerfCounterCount];
+} __attribute__((aligned(CacheLineSize)));
+
+static std::atomic<PerfCounterBlock *> PerfCounterBlocks;
+static PerfCounterBlock PerfCounterShared;
+static std::atomic<size_t> PerfCounterBaseline[objc::PerfCounterCount];
+
+// Returns nil if this thread has no objc pthread data. Events are counted 
+// from retain and release, some with a side table locked, so this must 
+// not allocate the data, nor resurrect it during thread teardown. 
+// The caller counts into PerfCounterShared instead.
+static PerfCounterBlock *perfCounterBlockForThread()
+{
+    _objc_pthread_data *data = _objc_fetch_pthread_data(false);
+    if (slowpath(!data)) return nil;
+    if (fastpath(data->perfCounters)) return data->perfCounters;
+
+    // Reuse the block of a thread that exited.
+    PerfCounterBlock *block = PerfCounterBlocks.load(std::memory_order_acquire);
+    for (; block; block = block->next) {
+        bool inUse = false;
+        if (!block->inUse.load(std::memory_order_relaxed)  &&  
+            block->inUse.compare_exchange_strong(inUse, true, 
+                                                 std::memory_order_acquire))
+        {
+            break;
+        }
+    }
+
+    if (!block) {
+        // Cache-line aligned so threads don't share lines.
+        if (posix_memalign((void **)&block, CacheLineSize, 
+                           sizeof(PerfCounterBlock)) != 0)
+        {
+            _objc_fatal("could not allocate performance counters");
+        }
+        bzero(block, sizeof(PerfCounterBlock));
+        block->inUse.store(true, std::memory_order_relaxed);
+        PerfCounterBlock *head = PerfCounterBlocks.load(std::memory_order_relaxed);
+        do {
+            block->next = head;
+        } while (!PerfCounterBlocks.compare_exchange_weak(head, block, 
+                                                          std::memory_order_release, 
+                                                          std::memory_order_relaxed));
+    }
+
+    data->perfCounters = block;
+    return block;
+}
+
+static void _destroyPerfCounters(PerfCounterBlock *block)
+{
+    if (block) block->inUse.store(false, std::memory_order_release);
+}
+
+void objc::countPerfEvent(PerfCounterID counter)
+{
+    PerfCounterBlock *block = perfCounterBlockForThread();
+    if (slowpath(!block)) {
+        PerfCounterShared.counts[counter].fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Only this thread writes this block.
+    auto& count = block->counts[counter];
+    count.store(count.load(std::memory_order_relaxed) + 1, 
+                std::memory_order_relaxed);
+}
+
+static void sumPerfCounters(size_t totals[objc::PerfCounterCount])
+{
+    for (unsigned i = 0; i < objc::PerfCounterCount; i++) {
+        totals[i] = PerfCounterShared.counts[i].load(std::memory_order_relaxed);
+    }
+    PerfCounterBlock *block = PerfCounterBlocks.load(std::memory_order_acquire);
+    for (; block; block = block->next) {
+        for (unsigned i = 0; i < objc::PerfCounterCount; i++) {
+            totals[i] += block->counts[i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void _objc_getPerformanceCounters(objc_perf_counters_t *counters)
+{
+    size_t totals[objc::PerfCounterCount];
+    sumPerfCounters(totals);
+    for (unsigned i = 0; i < objc::PerfCounterCount; i++) {
+        totals[i] -= PerfCounterBaseline[i].load(std::memory_order_relaxed);
+    }
+
+    counters->classesRealized = totals[objc::PerfClassesRealized];
+    counters->lazyRealizations = totals[objc::PerfLazyRealizations];
+    counters->cacheMisses = totals[objc::PerfCacheMisses];
+    counters->cacheGrows = totals[objc::PerfCacheGrows];
+    counters->cacheFlushes = totals[objc::PerfCacheFlushes];
+    counters->collectingScans = totals[objc::PerfCollectingScans];
+    counters->sideTableOverflows = totals[objc::PerfSideTableOverflows];
+    weak_table_getSizes(&counters->weakReferents, 
+                        &counters->weakTableCapacity);
+}
+
+void _objc_resetPerformanceCounters(void)
+{
+    size_t totals[objc::PerfCounterCount];
+    sumPerfCounters(totals);
+    for (unsigned i = 0; i < objc::PerfCounterCount; i++) {
+        PerfCounterBaseline[i].store(totals[i], std::memory_order_relaxed);
+    }
+}
+
+
 /***********************************************************************
 * _objc_pthread_destroyspecific
 * Destructor for objc's per-thread data.
@@ -537,6 +680,17 @@ void _objc_pthread_destroyspecific(void *arg)
 {
     _objc_pthread_data *data = (_objc_pthread_data *)arg;
     if (data != NULL) {
+        // Applying the releases this thread deferred runs -dealloc, which 
+        // may use anything destroyed below. Do it first, with the data 
+        // put back in TLS so that -dealloc finds it instead of creating 
+        // new data, and so that releases it defers land in this buffer.
+        if (data->deferredReleases) {
+            tls_set(_objc_pthread_key, data);
+            _destroyDeferredReleases(data->deferredReleases);
+            data->deferredReleases = nil;
+            tls_set(_objc_pthread_key, nil);
+        }
+
         _destroyInitializingClassList(data->initializingClasses);
         _destroySyncCache(data->syncCache);
         _destroyAltHandlerList(data->handlerList);
@@ -546,6 +700,10 @@ void _objc_pthread_destroyspecific(void *arg)
             }
         }
         free(data->classNameLookups);
+#if __OBJC2__
+        _destroySlabCache(data->slabCache);
+#endif
+        _destroyPerfCounters(data->perfCounters);
 
         // add further cleanup here...
 
@@ -26,8 +26,167 @@
 #include "objc-private.h"
 #include "DenseMapExtras.h"
 
-static objc::ExplicitInitDenseSet<const char *> namedSelectors;
 static SEL search_builtins(const char *key);
+static SEL sel_alloc(const char *name, bool copy);
+
+
+/***********************************************************************
+* SelectorTable
+* Open-addressed hash table of the selectors that are not in the 
+* dyld shared cache. Each entry caches its name's hash and length, 
+* so a probe only compares strings when both match.
+*
+* Readers search without selLock. Writers hold selLock. A writer fills 
+* in an entry's hash and length before publishing its name with a 
+* release store, and publishes a grown table the same way. Retired 
+* tables are never freed because a reader may still be searching one; 
+* together they are smaller than the current table. A reader that 
+* misses because it raced with an insertion or a grow retries under 
+* selLock.
+**********************************************************************/
+namespace {
+
+class SelectorTable {
+    struct Entry {
+        const char *name;  // nil means empty
+        uint32_t hash;
+        uint32_t length;
+    };
+
+    struct Data {
+        uint32_t mask;      // capacity - 1; capacity is a power of 2
+        uint32_t occupied;
+        // Entry entries[capacity] follow
+
+        Entry *entries() { return (Entry *)(this + 1); }
+
+        uint32_t indexForHash(uint32_t hash) const {
+            // _objc_strhash() mixes poorly into the low bits.
+            return (hash * 0x9E3779B9u) >> 16 & mask;
+        }
+
+        static Data *create(uint32_t capacity) {
+            Data *data = (Data *)
+                calloc(1, sizeof(Data) + capacity * sizeof(Entry));
+            data->mask = capacity - 1;
+            return data;
+        }
+    };
+
+    explicit_atomic<Data *> _data;
+
+    static const char *loadName(Entry& entry) {
+        return explicit_atomic<const char *>::from_pointer(&entry.name)
+            ->load(std::memory_order_acquire);
+    }
+
+    static void storeName(Entry& entry, const char *name) {
+        explicit_atomic<const char *>::from_pointer(&entry.name)
+            ->store(name, std::memory_order_release);
+    }
+
+    static SEL search(Data *data, const char *name, 
+                      uint32_t hash, uint32_t length)
+    {
+        Entry *entries = data->entries();
+        uint32_t i = data->indexForHash(hash);
+        while (const char *candidate = loadName(entries[i])) {
+            if (entries[i].hash == hash  &&  entries[i].length == length  &&
+                0 == memcmp(candidate, name, length))
+            {
+                return (SEL)candidate;
+            }
+            i = (i + 1) & data->mask;
+        }
+        return nil;
+    }
+
+    // Copy all entries into a table twice the size and publish it.
+    Data *grow(Data *oldData)
+    {
+        selLock.assertLocked();
+
+        uint32_t newCapacity = (oldData->mask + 1) * 2;
+        if (newCapacity == 0) _objc_fatal("too many selectors");
+        Data *newData = Data::create(newCapacity);
+
+        Entry *oldEntries = oldData->entries();
+        Entry *newEntries = newData->entries();
+        for (uint32_t i = 0; i <= oldData->mask; i++) {
+            if (!oldEntries[i].name) continue;
+            uint32_t j = newData->indexForHash(oldEntries[i].hash);
+            while (newEntries[j].name) j = (j + 1) & newData->mask;
+            newEntries[j] = oldEntries[i];
+        }
+        newData->occupied = oldData->occupied;
+
+        // oldData is retired, not freed. See above.
+        _data.store(newData, std::memory_order_release);
+        return newData;
+    }
+
+public:
+    // Hash and length of a selector name, computed in one pass.
+    static uint32_t hash(const char *name, uint32_t *outLength)
+    {
+        uint32_t hash = 0;
+        const char *s = name;
+        for (;;) {
+            int a = *s;
+            if (0 == a) break;
+            hash += (hash << 8) + a;
+            s++;
+        }
+        *outLength = (uint32_t)(s - name);
+        return hash;
+    }
+
+    SelectorTable(size_t expectedCount) : _data(nil)
+    {
+        // Stay under 3/4 full for the expected number of selectors.
+        uint32_t capacity = 64;
+        while (capacity < expectedCount + expectedCount / 3  &&  
+               capacity < (1u << 30))
+        {
+            capacity *= 2;
+        }
+        _data.store(Data::create(capacity), std::memory_order_release);
+    }
+
+    // Safe without selLock. May miss a selector being added concurrently.
+    SEL lookup(const char *name, uint32_t hash, uint32_t length)
+    {
+        return search(_data.load(std::memory_order_acquire), 
+                      name, hash, length);
+    }
+
+    SEL insert(const char *name, uint32_t hash, uint32_t length, bool copy)
+    {
+        selLock.assertLocked();
+
+        Data *data = _data.load(std::memory_order_relaxed);
+        if (SEL result = search(data, name, hash, length)) return result;
+
+        if ((data->occupied + 1) * 4 > (data->mask + 1) * 3) {
+            data = grow(data);
+        }
+
+        Entry *entries = data->entries();
+        uint32_t i = data->indexForHash(hash);
+        while (entries[i].name) i = (i + 1) & data->mask;
+
+        const char *selName = (const char *)sel_alloc(name, copy);
+        entries[i].hash = hash;
+        entries[i].length = length;
+        storeName(entries[i], selName);
+        data->occupied++;
+        return (SEL)selName;
+    }
+};
+
+}
+
+static objc::ExplicitInit<SelectorTable> namedSelectors;
 
 
 /***********************************************************************
@@ -42,7 +201,7 @@ void sel_init(size_t selrefCount)
     }
 #endif
 
-  namedSelectors.init((unsigned)selrefCount);
+    namedSelectors.init(selrefCount);
 
     // Register selectors used by libobjc
 
@@ -85,9 +244,13 @@ BOOL sel_isMapped(SEL sel)
 
     if (sel == search_builtins(name)) return YES;
 
+    uint32_t length;
+    uint32_t hash = SelectorTable::hash(name, &length);
+    if (sel == namedSelectors.get().lookup(name, hash, length)) return YES;
+
+    // Maybe we raced with the insertion of sel. Check again with the lock.
     mutex_locker_t lock(selLock);
-    auto it = namedSelectors.get().find(name);
-    return it != namedSelectors.get().end() && (SEL)*it == sel;
+    return sel == namedSelectors.get().lookup(name, hash, length);
 }
 
 
@@ -112,14 +275,18 @@ static SEL __sel_registerName(const char *name, bool shouldLock, bool copy)
 
     result = search_builtins(name);
     if (result) return result;
-    
+
+    uint32_t length;
+    uint32_t hash = SelectorTable::hash(name, &length);
+
+    // Most registrations find an existing selector without the lock.
+    if (shouldLock) {
+        result = namedSelectors.get().lookup(name, hash, length);
+        if (result) return result;
+    }
+
     conditional_mutex_locker_t lock(selLock, shouldLock);
-	auto it = namedSelectors.get().insert(name);
-	if (it.second) {
-		// No match. Insert.
-		*it.first = (const char *)sel_alloc(name, copy);
-	}
-	return (SEL)*it.first;
+    return namedSelectors.get().insert(name, hash, length, copy);
 }
 
 
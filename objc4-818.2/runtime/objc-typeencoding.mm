@@ -104,10 +104,10 @@ static const char *	SkipFirstType	   (const char *	type)
 
 
 /***********************************************************************
-* encoding_getNumberOfArguments.
+* getNumberOfArguments.
 **********************************************************************/
-unsigned int 
-encoding_getNumberOfArguments(const char *typedesc)
+static unsigned int 
+getNumberOfArguments(const char *typedesc)
 {
     unsigned nargs;
 
@@ -142,10 +142,10 @@ encoding_getNumberOfArguments(const char *typedesc)
 }
 
 /***********************************************************************
-* encoding_getSizeOfArguments.
+* getSizeOfArguments.
 **********************************************************************/
-unsigned 
-encoding_getSizeOfArguments(const char *typedesc)
+static unsigned 
+getSizeOfArguments(const char *typedesc)
 {
     unsigned		stack_size;
 
@@ -164,11 +164,11 @@ encoding_getSizeOfArguments(const char *typedesc)
 
 
 /***********************************************************************
-* encoding_getArgumentInfo.
+* getArgumentInfo.
 **********************************************************************/
-unsigned int 
-encoding_getArgumentInfo(const char *typedesc, unsigned int arg,
-                         const char **type, int *offset)
+static unsigned int 
+getArgumentInfo(const char *typedesc, unsigned int arg,
+                const char **type, int *offset)
 {
     unsigned nargs = 0;
     int self_offset = 0;
@@ -270,11 +270,229 @@ encoding_getArgumentInfo(const char *typedesc, unsigned int arg,
 }
 
 
+/***********************************************************************
+* ParsedTypes
+* Cache of parsed method type strings, keyed by the string's address. 
+* Method type strings don't change once a method list uses them. 
+* Heap copies are forgotten before they are freed (free_class) and 
+* image strings when their image is unloaded (_unload_image).
+*
+* The cache is direct-mapped and never allocates. Each slot is 
+* guarded by a sequence number that is odd while a writer fills it; 
+* readers that see it change discard what they read. Strings with 
+* more than MaxArgs arguments or over 64KB are not cached.
+**********************************************************************/
+namespace {
+
+struct ParsedTypes {
+    static constexpr unsigned MaxArgs = 8;
+
+    struct Arg {
+        uint16_t typeStart;
+        uint16_t typeLength;
+        int32_t offset;
+    };
+
+    std::atomic<uint32_t> seq;
+    uint16_t argCount;
+    uint16_t returnLength;
+    uint32_t sizeOfArguments;
+    const char *types;
+    Arg args[MaxArgs];
+
+    // Fill in everything but seq. Returns false if t can't be cached.
+    bool parse(const char *t) {
+        unsigned count = getNumberOfArguments(t);
+        if (count > MaxArgs  ||  strlen(t) > UINT16_MAX) return false;
+
+        argCount = count;
+        returnLength = SkipFirstType(t) - t;
+        sizeOfArguments = getSizeOfArguments(t);
+        for (unsigned i = 0; i < count; i++) {
+            const char *type;
+            int offset;
+            getArgumentInfo(t, i, &type, &offset);
+            args[i].typeStart = type - t;
+            args[i].typeLength = SkipFirstType(type) - type;
+            args[i].offset = offset;
+        }
+        types = t;
+        return true;
+    }
+};
+
+static constexpr unsigned ParsedTypesCount = 256;
+static ParsedTypes ParsedTypesCache[ParsedTypesCount];
+
+static ParsedTypes& parsedTypesSlot(const char *t)
+{
+    uintptr_t addr = (uintptr_t)t;
+    return ParsedTypesCache[((addr >> 3) ^ (addr >> 11)) % ParsedTypesCount];
+}
+
+// Copy t's parsed form into result. Returns false if it can't be cached.
+static bool lookUpParsedTypes(const char *t, ParsedTypes& result)
+{
+    ParsedTypes& slot = parsedTypesSlot(t);
+
+    uint32_t seq = slot.seq.load(std::memory_order_acquire);
+    if (!(seq & 1)  &&  slot.types == t) {
+        result.argCount = slot.argCount;
+        result.returnLength = slot.returnLength;
+        result.sizeOfArguments = slot.sizeOfArguments;
+        memcpy(result.args, slot.args, sizeof(slot.args));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) == seq) {
+            result.types = t;
+            return true;
+        }
+    }
+
+    // Miss. Parse it, and cache it if nobody else is writing the slot.
+    if (!result.parse(t)) return false;
+
+    if (!(seq & 1)  &&  
+        slot.seq.compare_exchange_strong(seq, seq | 1, 
+                                         std::memory_order_acquire))
+    {
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.argCount = result.argCount;
+        slot.returnLength = result.returnLength;
+        slot.sizeOfArguments = result.sizeOfArguments;
+        memcpy(slot.args, result.args, sizeof(slot.args));
+        slot.types = t;
+        slot.seq.store(seq + 2, std::memory_order_release);
+    }
+    return true;
+}
+
+static void forgetParsedTypes(ParsedTypes& slot, const char *t)
+{
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    for (;;) {
+        if (t  &&  slot.types != t) return;
+        if (seq & 1) {
+            // Another thread is filling the slot. Wait for it.
+            seq = slot.seq.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (slot.seq.compare_exchange_weak(seq, seq | 1, 
+                                           std::memory_order_acquire)) 
+        {
+            break;
+        }
+    }
+    slot.types = nil;
+    slot.seq.store(seq + 2, std::memory_order_release);
+}
+
+}
+
+
+/***********************************************************************
+* encoding_forgetTypes
+* Remove t from the parsed type cache before t is freed.
+**********************************************************************/
+void 
+encoding_forgetTypes(const char *t)
+{
+    if (t) forgetParsedTypes(parsedTypesSlot(t), t);
+}
+
+
+/***********************************************************************
+* encoding_forgetAllTypes
+* Empty the parsed type cache before an image is unloaded.
+**********************************************************************/
+void 
+encoding_forgetAllTypes(void)
+{
+    for (auto& slot : ParsedTypesCache) {
+        forgetParsedTypes(slot, nil);
+    }
+}
+
+
+/***********************************************************************
+* encoding_getNumberOfArguments.
+**********************************************************************/
+unsigned int 
+encoding_getNumberOfArguments(const char *typedesc)
+{
+    ParsedTypes parsed;
+    if (lookUpParsedTypes(typedesc, parsed)) return parsed.argCount;
+    return getNumberOfArguments(typedesc);
+}
+
+
+/***********************************************************************
+* encoding_getSizeOfArguments.
+**********************************************************************/
+unsigned 
+encoding_getSizeOfArguments(const char *typedesc)
+{
+    ParsedTypes parsed;
+    if (lookUpParsedTypes(typedesc, parsed)) return parsed.sizeOfArguments;
+    return getSizeOfArguments(typedesc);
+}
+
+
+/***********************************************************************
+* encoding_getArgumentInfo.
+* Returns arg if the argument exists, and the argument count if not.
+**********************************************************************/
+unsigned int 
+encoding_getArgumentInfo(const char *typedesc, unsigned int arg,
+                         const char **type, int *offset)
+{
+    ParsedTypes parsed;
+    if (!lookUpParsedTypes(typedesc, parsed)) {
+        return getArgumentInfo(typedesc, arg, type, offset);
+    }
+
+    if (arg >= parsed.argCount) {
+        *type = 0;
+        *offset = 0;
+        return parsed.argCount;
+    }
+    *type = typedesc + parsed.args[arg].typeStart;
+    *offset = parsed.args[arg].offset;
+    return arg;
+}
+
+
+// Start and length of a type in t: the return type if index is -1, 
+// otherwise the argument type. Returns false if there is no such argument.
+static bool 
+getTypeRange(const char *t, int index, const char **start, size_t *len)
+{
+    ParsedTypes parsed;
+    if (lookUpParsedTypes(t, parsed)) {
+        if (index < 0) {
+            *start = t;
+            *len = parsed.returnLength;
+            return true;
+        }
+        if ((unsigned)index >= parsed.argCount) return false;
+        *start = t + parsed.args[index].typeStart;
+        *len = parsed.args[index].typeLength;
+        return true;
+    }
+
+    if (index >= 0) {
+        int offset;
+        getArgumentInfo(t, index, &t, &offset);
+        if (!t) return false;
+    }
+    *start = t;
+    *len = SkipFirstType(t) - t;
+    return true;
+}
+
 void 
 encoding_getReturnType(const char *t, char *dst, size_t dst_len)
 {
     size_t len;
-    const char *end;
 
     if (!dst) return;
     if (!t) {
@@ -282,8 +500,7 @@ encoding_getReturnType(const char *t, char *dst, size_t dst_len)
         return;
     }
 
-    end = SkipFirstType(t);
-    len = end - t;
+    getTypeRange(t, -1, &t, &len);
     strncpy(dst, t, MIN(len, dst_len));
     if (len < dst_len) memset(dst+len, 0, dst_len - len);
 }
@@ -296,13 +513,11 @@ char *
 encoding_copyReturnType(const char *t)
 {
     size_t len;
-    const char *end;
     char *result;
 
     if (!t) return NULL;
 
-    end = SkipFirstType(t);
-    len = end - t;
+    getTypeRange(t, -1, &t, &len);
     result = (char *)malloc(len + 1);
     strncpy(result, t, len);
     result[len] = '\0';
@@ -315,24 +530,13 @@ encoding_getArgumentType(const char *t, unsigned int index,
                          char *dst, size_t dst_len)
 {
     size_t len;
-    const char *end;
-    int offset;
 
     if (!dst) return;
-    if (!t) {
+    if (!t  ||  index > INT_MAX  ||  !getTypeRange(t, (int)index, &t, &len)) {
         strncpy(dst, "", dst_len);
         return;
     }
 
-    encoding_getArgumentInfo(t, index, &t, &offset);
-
-    if (!t) {
-        strncpy(dst, "", dst_len);
-        return;
-    }
-
-    end = SkipFirstType(t);
-    len = end - t;
     strncpy(dst, t, MIN(len, dst_len));
     if (len < dst_len) memset(dst+len, 0, dst_len - len);
 }
@@ -346,18 +550,12 @@ char *
 encoding_copyArgumentType(const char *t, unsigned int index)
 {
     size_t len;
-    const char *end;
     char *result;
-    int offset;
-
-    if (!t) return NULL;
 
-    encoding_getArgumentInfo(t, index, &t, &offset);
-
-    if (!t) return NULL;
+    if (!t  ||  index > INT_MAX  ||  !getTypeRange(t, (int)index, &t, &len)) {
+        return NULL;
+    }
 
-    end = SkipFirstType(t);
-    len = end - t;
     result = (char *)malloc(len + 1);
     strncpy(result, t, len);
     result[len] = '\0';
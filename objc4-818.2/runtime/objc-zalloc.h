@@ -120,6 +120,43 @@ void zfree(T *e)
     Zone<T, sizeof(T) % MALLOC_ALIGNMENT == 0>::free(e);
 }
 
+/*
+ * Slab allocator for instances of classes that opted in with
+ * _class_setUsesSlabAllocator().
+ *
+ * Instances are rounded up to MALLOC_ALIGNMENT and carved from large
+ * aligned chunks, one element size per chunk. Freed elements go to a
+ * per-thread cache and then to a shared AtomicQueue for their size.
+ *
+ * The chunks belong to a registered malloc zone, so free(), malloc_size()
+ * and malloc_zone_from_ptr() work on slab instances and the deallocation
+ * path does not need to know where an object came from.
+ */
+class SlabAllocator {
+public:
+    static constexpr size_t maxSize = 256;
+    static constexpr unsigned sizeClasses = maxSize / MALLOC_ALIGNMENT;
+
+    static bool canAllocate(size_t size) {
+        return size != 0  &&  size <= maxSize;
+    }
+
+    // Registers the slab's malloc zone. Must be called before
+    // the first allocation.
+    static void init();
+
+    // Zeroed memory for one instance, or nil if the slab is exhausted.
+    static void *alloc(size_t size);
+
+    // Zeroed memory for up to count instances. Returns how many.
+    static unsigned allocBatch(size_t size, void **results, unsigned count);
+
+    static void free(void *ptr);
+
+    // The element size if ptr is the start of a slab element, 0 otherwise.
+    static size_t size(const void *ptr);
+};
+
 };
 
 #endif
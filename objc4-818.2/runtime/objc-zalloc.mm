@@ -115,6 +115,519 @@ void Zone<T, false>::free(T *ptr)
 }
 
 #if __OBJC2__
+
+/***********************************************************************
+* SlabAllocator
+*
+* Chunks are SlabChunkSize bytes, aligned to their size, and start with
+* a header holding the element size. A pointer's chunk is found by
+* masking, and is known to be ours if it is in SlabChunks, a fixed
+* open-addressed table that is read without locks. Chunks are never
+* returned to the system.
+*
+* slabLock protects carving new elements and the chunk table updates.
+* It is an os_unfair_lock rather than a runtime mutex because malloc
+* takes it around fork() through the zone's force_lock/force_unlock.
+**********************************************************************/
+
+static constexpr size_t SlabChunkShift = 18;
+static constexpr size_t SlabChunkSize = 1UL << SlabChunkShift;  // 256 KB
+static constexpr size_t SlabMaxChunks = 4096;  // table size; 3/4 usable
+static constexpr unsigned SlabCarveBatch = 32;
+static constexpr unsigned SlabThreadCacheLimit = 64;
+
+struct SlabChunkHeader {
+    size_t elementSize;
+    size_t unused;  // keep elements 16-byte aligned
+};
+
+struct SlabSizeClass {
+    AtomicQueue freelist;
+    uintptr_t carveNext;  // protected by slabLock
+    uintptr_t carveEnd;   // protected by slabLock
+};
+
+static os_unfair_lock slabLock = OS_UNFAIR_LOCK_INIT;
+static SlabSizeClass SlabSizeClasses[SlabAllocator::sizeClasses];
+static std::atomic<uintptr_t> SlabChunks[SlabMaxChunks];
+static size_t SlabChunkCount;  // protected by slabLock
+static bool SlabZoneRegistered;  // protected by runtimeLock
+
+static inline unsigned slabSizeClass(size_t size)
+{
+    return (unsigned)((size + MALLOC_ALIGNMENT - 1) / MALLOC_ALIGNMENT) - 1;
+}
+
+static inline size_t slabChunkSlot(uintptr_t base)
+{
+    return (size_t)(((base >> SlabChunkShift) * 0x9E3779B9UL) >> 8)
+        & (SlabMaxChunks - 1);
+}
+
+static bool slabIsChunk(uintptr_t base)
+{
+    for (size_t i = slabChunkSlot(base); ; i = (i + 1) & (SlabMaxChunks - 1)) {
+        uintptr_t chunk = SlabChunks[i].load(std::memory_order_acquire);
+        if (chunk == base) return true;
+        if (chunk == 0) return false;
+    }
+}
+
+// Map a new chunk for elements of the given size class and make it
+// the size class's carving chunk. slabLock must be held.
+static bool slabAddChunk(unsigned sizeClass)
+{
+    if (SlabChunkCount >= SlabMaxChunks / 4 * 3) return false;
+
+    vm_address_t addr = 0;
+    kern_return_t kr =
+        vm_map(mach_task_self(), &addr, SlabChunkSize, SlabChunkSize - 1,
+               VM_FLAGS_ANYWHERE | VM_MAKE_TAG(VM_MEMORY_MALLOC),
+               MEMORY_OBJECT_NULL, 0, FALSE,
+               VM_PROT_DEFAULT, VM_PROT_ALL, VM_INHERIT_DEFAULT);
+    if (kr != KERN_SUCCESS) return false;
+
+    size_t elementSize = (sizeClass + 1) * MALLOC_ALIGNMENT;
+    auto header = (SlabChunkHeader *)addr;
+    header->elementSize = elementSize;
+
+    // The header must be visible before lock-free readers find the chunk.
+    size_t i = slabChunkSlot(addr);
+    while (SlabChunks[i].load(std::memory_order_relaxed) != 0) {
+        i = (i + 1) & (SlabMaxChunks - 1);
+    }
+    SlabChunks[i].store(addr, std::memory_order_release);
+    SlabChunkCount++;
+
+    auto& sc = SlabSizeClasses[sizeClass];
+    size_t count = (SlabChunkSize - sizeof(SlabChunkHeader)) / elementSize;
+    sc.carveNext = addr + sizeof(SlabChunkHeader);
+    sc.carveEnd = sc.carveNext + count * elementSize;
+    return true;
+}
+
+// Carve up to count never-used (and therefore zeroed) elements.
+static unsigned slabCarve(unsigned sizeClass, void **results, unsigned count)
+{
+    auto& sc = SlabSizeClasses[sizeClass];
+    size_t elementSize = (sizeClass + 1) * MALLOC_ALIGNMENT;
+    unsigned n = 0;
+
+    os_unfair_lock_lock(&slabLock);
+    while (n < count) {
+        if (sc.carveNext == sc.carveEnd  &&  !slabAddChunk(sizeClass)) break;
+        results[n++] = (void *)sc.carveNext;
+        sc.carveNext += elementSize;
+    }
+    os_unfair_lock_unlock(&slabLock);
+
+    return n;
+}
+
+} // namespace objc
+
+// Per-thread cache of free slab elements, one list per size class.
+struct SlabCache {
+    void *heads[objc::SlabAllocator::sizeClasses];
+    void *tails[objc::SlabAllocator::sizeClasses];
+    uint16_t counts[objc::SlabAllocator::sizeClasses];
+};
+
+void _destroySlabCache(struct SlabCache *cache)
+{
+    if (!cache) return;
+    for (unsigned i = 0; i < objc::SlabAllocator::sizeClasses; i++) {
+        if (cache->counts[i]) {
+            objc::SlabSizeClasses[i].freelist.push_list(cache->heads[i],
+                                                        cache->tails[i]);
+        }
+    }
+    free(cache);
+}
+
+// Never creates the pthread data itself: the allocator may run during 
+// thread teardown after the data was destroyed. Threads without it 
+// use the shared free lists.
+static SlabCache *slabThreadCache(bool create)
+{
+    _objc_pthread_data *data = _objc_fetch_pthread_data(false);
+    if (!data) return nil;
+    if (!data->slabCache  &&  create) {
+        data->slabCache = (SlabCache *)calloc(1, sizeof(SlabCache));
+    }
+    return data->slabCache;
+}
+
+static inline void *slabCachePop(SlabCache *cache, unsigned sizeClass)
+{
+    void *e = cache->heads[sizeClass];
+    if (e) {
+        cache->heads[sizeClass] = *(void **)e;
+        cache->counts[sizeClass]--;
+    }
+    return e;
+}
+
+namespace objc {
+
+void *SlabAllocator::alloc(size_t size)
+{
+    void *result;
+    return allocBatch(size, &result, 1) ? result : nil;
+}
+
+unsigned SlabAllocator::allocBatch(size_t size, void **results, unsigned count)
+{
+    ASSERT(canAllocate(size));
+    unsigned sizeClass = slabSizeClass(size);
+    size_t elementSize = (sizeClass + 1) * MALLOC_ALIGNMENT;
+    unsigned n = 0;
+
+    // Recycled elements, from this thread first.
+    SlabCache *cache = slabThreadCache(true);
+    while (n < count) {
+        void *e = cache ? slabCachePop(cache, sizeClass) : nil;
+        if (!e) e = SlabSizeClasses[sizeClass].freelist.pop();
+        if (!e) break;
+        bzero(e, elementSize);
+        results[n++] = e;
+    }
+    if (n == count) return n;
+
+    // Fresh elements. Single allocations carve a few extra for this
+    // thread's cache so the lock is not taken every time.
+    if (count - n == 1  &&  cache) {
+        void *carved[SlabCarveBatch];
+        unsigned got = slabCarve(sizeClass, carved, SlabCarveBatch);
+        if (got == 0) return n;
+        results[n++] = carved[0];
+        for (unsigned i = 1; i < got; i++) {
+            *(void **)carved[i] = cache->heads[sizeClass];
+            if (!cache->heads[sizeClass]) cache->tails[sizeClass] = carved[i];
+            cache->heads[sizeClass] = carved[i];
+            cache->counts[sizeClass]++;
+        }
+        return n;
+    }
+
+    return n + slabCarve(sizeClass, results + n, count - n);
+}
+
+void SlabAllocator::free(void *ptr)
+{
+    if (!ptr) return;
+    size_t elementSize = ((SlabChunkHeader *)
+        ((uintptr_t)ptr & ~(SlabChunkSize - 1)))->elementSize;
+    unsigned sizeClass = slabSizeClass(elementSize);
+
+    SlabCache *cache = slabThreadCache(false);
+    if (!cache) {
+        SlabSizeClasses[sizeClass].freelist.push(ptr);
+        return;
+    }
+
+    if (cache->counts[sizeClass] == SlabThreadCacheLimit) {
+        // Hand the whole list to other threads.
+        SlabSizeClasses[sizeClass].freelist.push_list(cache->heads[sizeClass],
+                                                      cache->tails[sizeClass]);
+        cache->heads[sizeClass] = nil;
+        cache->counts[sizeClass] = 0;
+    }
+    *(void **)ptr = cache->heads[sizeClass];
+    if (!cache->heads[sizeClass]) cache->tails[sizeClass] = ptr;
+    cache->heads[sizeClass] = ptr;
+    cache->counts[sizeClass]++;
+}
+
+size_t SlabAllocator::size(const void *ptr)
+{
+    uintptr_t base = (uintptr_t)ptr & ~(SlabChunkSize - 1);
+    uintptr_t first = base + sizeof(SlabChunkHeader);
+    if ((uintptr_t)ptr < first  ||  !slabIsChunk(base)) return 0;
+
+    size_t elementSize = ((SlabChunkHeader *)base)->elementSize;
+    if (((uintptr_t)ptr - first) % elementSize != 0) return 0;
+    return elementSize;
+}
+
+
+/***********************************************************************
+* The slab's malloc zone.
+* Requests the slab can't serve go to the default zone, and free()
+* of that memory finds the default zone by itself.
+**********************************************************************/
+
+static malloc_zone_t *slabDefaultZone()
+{
+    return malloc_default_zone();
+}
+
+static size_t slab_zone_size(malloc_zone_t *, const void *ptr)
+{
+    return SlabAllocator::size(ptr);
+}
+
+static void *slab_zone_calloc(malloc_zone_t *, size_t num, size_t size)
+{
+    size_t total;
+    if (!__builtin_mul_overflow(num, size, &total)  &&
+        SlabAllocator::canAllocate(total))
+    {
+        if (void *result = SlabAllocator::alloc(total)) return result;
+    }
+    return malloc_zone_calloc(slabDefaultZone(), num, size);
+}
+
+static void *slab_zone_malloc(malloc_zone_t *zone, size_t size)
+{
+    return slab_zone_calloc(zone, 1, size);
+}
+
+static void *slab_zone_valloc(malloc_zone_t *, size_t size)
+{
+    return malloc_zone_valloc(slabDefaultZone(), size);
+}
+
+static void *slab_zone_memalign(malloc_zone_t *, size_t alignment, size_t size)
+{
+    return malloc_zone_memalign(slabDefaultZone(), alignment, size);
+}
+
+static void slab_zone_free(malloc_zone_t *, void *ptr)
+{
+    SlabAllocator::free(ptr);
+}
+
+static void slab_zone_free_definite_size(malloc_zone_t *, void *ptr, size_t)
+{
+    SlabAllocator::free(ptr);
+}
+
+static void *slab_zone_realloc(malloc_zone_t *, void *ptr, size_t size)
+{
+    if (!ptr) return malloc_zone_malloc(slabDefaultZone(), size);
+
+    size_t oldSize = SlabAllocator::size(ptr);
+    if (size <= oldSize) return ptr;
+
+    void *result = malloc_zone_malloc(slabDefaultZone(), size);
+    if (result) {
+        memcpy(result, ptr, oldSize);
+        SlabAllocator::free(ptr);
+    }
+    return result;
+}
+
+static unsigned slab_zone_batch_malloc(malloc_zone_t *, size_t size,
+                                       void **results, unsigned count)
+{
+    if (!SlabAllocator::canAllocate(size)) {
+        return malloc_zone_batch_malloc(slabDefaultZone(), size,
+                                        results, count);
+    }
+    return SlabAllocator::allocBatch(size, results, count);
+}
+
+static void slab_zone_batch_free(malloc_zone_t *, void **ptrs, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++) {
+        SlabAllocator::free(ptrs[i]);
+    }
+}
+
+static void slab_zone_destroy(malloc_zone_t *)
+{
+    // The slab zone is never destroyed.
+}
+
+static size_t slab_zone_pressure_relief(malloc_zone_t *, size_t)
+{
+    return 0;
+}
+
+// The registered zone. The enumerator runs in another task, such as
+// heap or leaks, so it finds the slab's tables through the zone.
+struct SlabMallocZone {
+    malloc_zone_t zone;
+    const std::atomic<uintptr_t> *chunks;
+    const SlabSizeClass *sizeClasses;
+};
+
+static SlabMallocZone SlabZone;
+
+static kern_return_t
+slab_zone_default_reader(task_t, vm_address_t address, vm_size_t, void **ptr)
+{
+    *ptr = (void *)address;
+    return KERN_SUCCESS;
+}
+
+// Report every chunk as a region, and every element carved from it as
+// in use. Elements that were carved and later freed are reported too,
+// because the free lists are per-thread and can't be read consistently.
+static kern_return_t
+slab_zone_enumerator(task_t task, void *context, unsigned type_mask,
+                     vm_address_t zone_address, memory_reader_t reader,
+                     vm_range_recorder_t recorder)
+{
+    if (!(type_mask & (MALLOC_PTR_REGION_RANGE_TYPE | 
+                       MALLOC_PTR_IN_USE_RANGE_TYPE)))
+    {
+        return KERN_SUCCESS;
+    }
+    if (!reader) reader = slab_zone_default_reader;
+
+    // The reader may reuse its buffer, so copy out what is used later.
+    SlabMallocZone *zone;
+    kern_return_t kr = reader(task, zone_address, sizeof(*zone), (void **)&zone);
+    if (kr) return kr;
+    vm_address_t chunksAddress = (vm_address_t)zone->chunks;
+    vm_address_t sizeClassesAddress = (vm_address_t)zone->sizeClasses;
+
+    SlabSizeClass *sizeClasses;
+    kr = reader(task, sizeClassesAddress, 
+                sizeof(SlabSizeClasses), (void **)&sizeClasses);
+    if (kr) return kr;
+    uintptr_t carveNext[SlabAllocator::sizeClasses];
+    for (unsigned i = 0; i < SlabAllocator::sizeClasses; i++) {
+        carveNext[i] = sizeClasses[i].carveNext;
+    }
+
+    uintptr_t *remoteChunks;
+    kr = reader(task, chunksAddress, sizeof(SlabChunks), (void **)&remoteChunks);
+    if (kr) return kr;
+    uintptr_t *chunks = (uintptr_t *)malloc(sizeof(SlabChunks));
+    if (!chunks) return KERN_RESOURCE_SHORTAGE;
+    memcpy(chunks, remoteChunks, sizeof(SlabChunks));
+
+    vm_range_t ranges[64];
+    unsigned count = 0;
+
+    for (size_t i = 0; i < SlabMaxChunks; i++) {
+        uintptr_t chunk = chunks[i];
+        if (!chunk) continue;
+
+        if (type_mask & MALLOC_PTR_REGION_RANGE_TYPE) {
+            vm_range_t region = { chunk, SlabChunkSize };
+            recorder(task, context, MALLOC_PTR_REGION_RANGE_TYPE, &region, 1);
+        }
+        if (!(type_mask & MALLOC_PTR_IN_USE_RANGE_TYPE)) continue;
+
+        SlabChunkHeader *header;
+        kr = reader(task, chunk, sizeof(*header), (void **)&header);
+        if (kr) break;
+        size_t elementSize = header->elementSize;
+        if (!SlabAllocator::canAllocate(elementSize)) continue;
+
+        // A size class's current chunk is only carved up to carveNext.
+        uintptr_t first = chunk + sizeof(SlabChunkHeader);
+        uintptr_t end = first + 
+            (SlabChunkSize - sizeof(SlabChunkHeader)) / elementSize * elementSize;
+        uintptr_t next = carveNext[slabSizeClass(elementSize)];
+        if (next >= first  &&  next < end) end = next;
+
+        for (uintptr_t element = first; element < end; element += elementSize) {
+            ranges[count++] = { element, elementSize };
+            if (count == countof(ranges)) {
+                recorder(task, context, MALLOC_PTR_IN_USE_RANGE_TYPE, 
+                         ranges, count);
+                count = 0;
+            }
+        }
+    }
+
+    if (count) {
+        recorder(task, context, MALLOC_PTR_IN_USE_RANGE_TYPE, ranges, count);
+    }
+    free(chunks);
+    return kr;
+}
+
+static size_t slab_zone_good_size(malloc_zone_t *, size_t size)
+{
+    return (size + MALLOC_ALIGNMENT - 1) & ~(size_t)(MALLOC_ALIGNMENT - 1);
+}
+
+static boolean_t slab_zone_check(malloc_zone_t *)
+{
+    return true;
+}
+
+static void slab_zone_print(malloc_zone_t *, boolean_t) { }
+static void slab_zone_log(malloc_zone_t *, void *) { }
+
+static void slab_zone_force_lock(malloc_zone_t *)
+{
+    os_unfair_lock_lock(&slabLock);
+}
+
+static void slab_zone_force_unlock(malloc_zone_t *)
+{
+    os_unfair_lock_unlock(&slabLock);
+}
+
+static void slab_zone_reinit_lock(malloc_zone_t *)
+{
+    slabLock = OS_UNFAIR_LOCK_INIT;
+}
+
+static void slab_zone_statistics(malloc_zone_t *, malloc_statistics_t *stats)
+{
+    bzero(stats, sizeof(*stats));
+    stats->size_allocated = SlabChunkCount * SlabChunkSize;
+}
+
+static boolean_t slab_zone_locked(malloc_zone_t *)
+{
+    if (os_unfair_lock_trylock(&slabLock)) {
+        os_unfair_lock_unlock(&slabLock);
+        return false;
+    }
+    return true;
+}
+
+static malloc_introspection_t SlabZoneIntrospect;
+
+// Locking: runtimeLock must be held by the caller
+void SlabAllocator::init()
+{
+    runtimeLock.assertLocked();
+
+    if (SlabZoneRegistered) return;
+    SlabZoneRegistered = true;
+
+    SlabZoneIntrospect.enumerator = slab_zone_enumerator;
+    SlabZoneIntrospect.good_size = slab_zone_good_size;
+    SlabZoneIntrospect.check = slab_zone_check;
+    SlabZoneIntrospect.print = slab_zone_print;
+    SlabZoneIntrospect.log = slab_zone_log;
+    SlabZoneIntrospect.force_lock = slab_zone_force_lock;
+    SlabZoneIntrospect.force_unlock = slab_zone_force_unlock;
+    SlabZoneIntrospect.statistics = slab_zone_statistics;
+    SlabZoneIntrospect.zone_locked = slab_zone_locked;
+    SlabZoneIntrospect.reinit_lock = slab_zone_reinit_lock;
+
+    SlabZone.zone.size = slab_zone_size;
+    SlabZone.zone.malloc = slab_zone_malloc;
+    SlabZone.zone.calloc = slab_zone_calloc;
+    SlabZone.zone.valloc = slab_zone_valloc;
+    SlabZone.zone.free = slab_zone_free;
+    SlabZone.zone.realloc = slab_zone_realloc;
+    SlabZone.zone.destroy = slab_zone_destroy;
+    SlabZone.zone.zone_name = "ObjCSlabZone";
+    SlabZone.zone.batch_malloc = slab_zone_batch_malloc;
+    SlabZone.zone.batch_free = slab_zone_batch_free;
+    SlabZone.zone.introspect = &SlabZoneIntrospect;
+    SlabZone.zone.version = 8;
+    SlabZone.zone.memalign = slab_zone_memalign;
+    SlabZone.zone.free_definite_size = slab_zone_free_definite_size;
+    SlabZone.zone.pressure_relief = slab_zone_pressure_relief;
+    SlabZone.chunks = SlabChunks;
+    SlabZone.sizeClasses = SlabSizeClasses;
+
+    malloc_zone_register(&SlabZone.zone);
+}
+
 #define ZoneInstantiate(type) \
 	template class Zone<type, sizeof(type) % MALLOC_ALIGNMENT == 0>
 
@@ -0,0 +1,143 @@
+// TEST_CONFIG MEM=mrc
+
+// Atomic object property getters don't take a lock.
+// Getters on many threads must not slow each other down the way
+// spinlock stripes shared by unrelated properties did, and setters
+// racing with getters must never hand out a deallocated value.
+
+#include "test.h"
+#include "testroot.i"
+#include <os/lock.h>
+#include <objc/runtime.h>
+
+#define THREADS 8
+#define GETS 1000000
+#define SETS 100000
+#define STRIPES 64
+
+@interface Holder : TestRoot
+@property (atomic, retain) id value;
+@end
+@implementation Holder
+@synthesize value;
+@end
+
+// The old implementation: retain under a spinlock chosen by address.
+static os_unfair_lock stripes[STRIPES * 16];
+
+static id lockedGet(id *slot)
+{
+    uintptr_t addr = (uintptr_t)slot;
+    os_unfair_lock *lock = &stripes[(((addr >> 4) ^ (addr >> 9)) % STRIPES) * 16];
+    os_unfair_lock_lock(lock);
+    id value = [*slot retain];
+    os_unfair_lock_unlock(lock);
+    return [value autorelease];
+}
+
+static Holder *holders[THREADS];
+
+static void *getAll(void *arg)
+{
+    Holder *holder = holders[(uintptr_t)arg];
+    for (int i = 0; i < GETS / 1000; i++) {
+        @autoreleasepool {
+            for (int j = 0; j < 1000; j++) {
+                testassert(holder.value);
+            }
+        }
+    }
+    return NULL;
+}
+
+static void *lockedGetAll(void *arg)
+{
+    Holder *holder = holders[(uintptr_t)arg];
+    id *slot = (id *)((char *)holder + ivar_getOffset(class_getInstanceVariable([Holder class], "value")));
+    for (int i = 0; i < GETS / 1000; i++) {
+        @autoreleasepool {
+            for (int j = 0; j < 1000; j++) {
+                testassert(lockedGet(slot));
+            }
+        }
+    }
+    return NULL;
+}
+
+static uint64_t timeThreads(void *(*fn)(void *))
+{
+    pthread_t threads[THREADS];
+    uint64_t startTime = mach_absolute_time();
+    for (uintptr_t t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, fn, (void *)t);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    return mach_absolute_time() - startTime;
+}
+
+static volatile bool stop;
+
+static void *setAll(void *arg __unused)
+{
+    for (int i = 0; i < SETS; i++) {
+        id obj = [TestRoot new];
+        holders[0].value = obj;
+        [obj release];
+    }
+    stop = true;
+    return NULL;
+}
+
+static void *getWhileSetting(void *arg __unused)
+{
+    while (!stop) {
+        @autoreleasepool {
+            for (int i = 0; i < 100; i++) {
+                id obj = holders[0].value;
+                testassert([obj retainCount] >= 1);
+            }
+        }
+    }
+    return NULL;
+}
+
+int main()
+{
+    id obj = [TestRoot new];
+    for (int t = 0; t < THREADS; t++) {
+        holders[t] = [Holder new];
+        holders[t].value = obj;
+    }
+    testassertequal([obj retainCount], (unsigned long)THREADS + 1);
+
+    uint64_t lockedTime = timeThreads(&lockedGetAll);
+    uint64_t lockFreeTime = timeThreads(&getAll);
+    testprintf("time: %d threads, %d gets each: spinlock %llu, lock-free %llu\n",
+               THREADS, GETS, lockedTime, lockFreeTime);
+    testassertequal([obj retainCount], (unsigned long)THREADS + 1);
+    timecheck("atomic getters", lockFreeTime, 0, lockedTime * 3 / 2);
+
+    // Setters release old values only after racing getters retain them.
+    TestRootDealloc = 0;
+    pthread_t setter, getters[THREADS - 1];
+    pthread_create(&setter, NULL, &setAll, NULL);
+    for (int t = 0; t < THREADS - 1; t++) {
+        pthread_create(&getters[t], NULL, &getWhileSetting, NULL);
+    }
+    pthread_join(setter, NULL);
+    for (int t = 0; t < THREADS - 1; t++) {
+        pthread_join(getters[t], NULL);
+    }
+    testassertequal(TestRootDealloc, SETS - 1);
+
+    for (int t = 0; t < THREADS; t++) {
+        holders[t].value = nil;
+        [holders[t] release];
+    }
+    testassertequal([obj retainCount], 1ul);
+    [obj release];
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,103 @@
+// TEST_CONFIG MEM=mrc
+
+// Block IMPs are found from their trampoline's page rather than by
+// walking every trampoline page group, so removing blocks does not
+// slow down as more of them are live. Batch creation and removal
+// take the runtime lock once.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+#include <objc/objc-internal.h>
+
+#define COUNT 100000
+
+typedef uintptr_t (*Fn)(id self, SEL _cmd);
+
+static IMP imps[COUNT];
+static id blocks[COUNT];
+
+static void makeBlocks(void)
+{
+    for (uintptr_t i = 0; i < COUNT; i++) {
+        blocks[i] = [^(id self __unused) { return i; } copy];
+    }
+}
+
+static void checkImps(void)
+{
+    for (uintptr_t i = 0; i < COUNT; i++) {
+        testassert(imps[i]);
+        testassertequal(((Fn)imps[i])(nil, @selector(self)), i);
+        if (i % 1000 == 0) {
+            testassert(imp_getBlock(imps[i]) != nil);
+        }
+    }
+}
+
+static uint64_t timeRemoval(unsigned count)
+{
+    uint64_t startTime = mach_absolute_time();
+    for (unsigned i = 0; i < count; i++) {
+        testassert(imp_removeBlock(imps[i]));
+    }
+    return mach_absolute_time() - startTime;
+}
+
+int main()
+{
+    makeBlocks();
+
+    // One at a time.
+    uint64_t startTime = mach_absolute_time();
+    for (unsigned i = 0; i < COUNT; i++) {
+        imps[i] = imp_implementationWithBlock(blocks[i]);
+    }
+    uint64_t createTime = mach_absolute_time() - startTime;
+    checkImps();
+
+    // Removal of the first slots must not get slower as more are live.
+    uint64_t smallTime = timeRemoval(COUNT / 100);
+    startTime = mach_absolute_time();
+    for (unsigned i = COUNT / 100; i < COUNT; i++) {
+        testassert(imp_removeBlock(imps[i]));
+    }
+    uint64_t removeTime = mach_absolute_time() - startTime;
+    testprintf("time: create %llu, remove %llu (first 1%% %llu)\n",
+               createTime, removeTime, smallTime);
+    timecheck("block IMP removal", removeTime, 0, smallTime * 200);
+
+    // Removed IMPs are no longer blocks. Removing twice fails.
+    testassert(imp_getBlock(imps[0]) == nil);
+    testassert(!imp_removeBlock(imps[0]));
+    testassert(!imp_removeBlock((IMP)&main));
+
+    // Freed slots are reused.
+    IMP reused = imp_implementationWithBlock(blocks[0]);
+    testassert(imp_getBlock(reused) != nil);
+    testassert(imp_removeBlock(reused));
+
+    // Batches.
+    startTime = mach_absolute_time();
+    _imp_implementationWithBlocks(blocks, imps, COUNT);
+    uint64_t batchCreateTime = mach_absolute_time() - startTime;
+    checkImps();
+    IMP skipped = imps[1];
+    imps[1] = nil;
+    startTime = mach_absolute_time();
+    unsigned removed = _imp_removeBlocks(imps, COUNT);
+    uint64_t batchRemoveTime = mach_absolute_time() - startTime;
+    testassertequal(removed, (unsigned)COUNT - 1);
+    testprintf("time: batch create %llu, batch remove %llu\n",
+               batchCreateTime, batchRemoveTime);
+    timecheck("batch block IMP creation", batchCreateTime, 0, createTime * 2);
+    testassertequal(_imp_removeBlocks(imps, COUNT), 0u);
+    testassert(imp_removeBlock(skipped));
+
+    // The batch copied the blocks; the originals are still ours.
+    for (unsigned i = 0; i < COUNT; i++) {
+        [blocks[i] release];
+    }
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,139 @@
+// TEST_CONFIG MEM=mrc
+
+// Changing one method only evicts that selector from the method caches
+// of the affected classes. Everything else stays cached.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+#include <objc/message.h>
+#include <objc/objc-internal.h>
+
+#define CLASSES 100
+
+@interface Base : TestRoot @end
+@implementation Base
+-(int)m0 { return 0; }
+-(int)m1 { return 1; }
+-(int)m2 { return 2; }
+-(int)m3 { return 3; }
+-(int)m4 { return 4; }
+-(int)m5 { return 5; }
+-(int)m6 { return 6; }
+-(int)m7 { return 7; }
+@end
+
+static int replacement(id self __unused, SEL _cmd __unused) { return 100; }
+
+static SEL sels[8];
+static Class classes[CLASSES];
+static id objs[CLASSES];
+
+static int call(id obj, SEL sel)
+{
+    return ((int(*)(id, SEL))objc_msgSend)(obj, sel);
+}
+
+static void warm(void)
+{
+    for (int i = 0; i < CLASSES; i++) {
+        for (int s = 0; s < 8; s++) {
+            call(objs[i], sels[s]);
+        }
+    }
+}
+
+static bool isCached(Class cls, SEL sel)
+{
+    int count;
+    bool result = false;
+    objc_imp_cache_entry *ents = class_copyImpCache(cls, &count);
+    for (int i = 0; i < count; i++) {
+        if (ents[i].sel == sel) result = true;
+    }
+    free(ents);
+    return result;
+}
+
+int main()
+{
+    size_t before, flushed;
+
+    sels[0] = @selector(m0); sels[1] = @selector(m1);
+    sels[2] = @selector(m2); sels[3] = @selector(m3);
+    sels[4] = @selector(m4); sels[5] = @selector(m5);
+    sels[6] = @selector(m6); sels[7] = @selector(m7);
+
+    for (int i = 0; i < CLASSES; i++) {
+        char *name;
+        asprintf(&name, "Targeted%d", i);
+        classes[i] = objc_allocateClassPair([Base class], name, 0);
+        objc_registerClassPair(classes[i]);
+        objs[i] = class_createInstance(classes[i], 0);
+        free(name);
+    }
+    warm();
+    testassert(isCached(classes[0], @selector(m3)));
+
+    // method_setImplementation evicts one entry per class.
+    before = _objc_flushedCacheBucketCount();
+    Method m3 = class_getInstanceMethod([Base class], @selector(m3));
+    IMP old = method_setImplementation(m3, (IMP)replacement);
+    flushed = _objc_flushedCacheBucketCount() - before;
+    testprintf("method_setImplementation flushed %zu\n", flushed);
+    testassert(flushed >= CLASSES  &&  flushed <= CLASSES + 1);
+    for (int i = 0; i < CLASSES; i++) {
+        testassert(!isCached(classes[i], @selector(m3)));
+        testassert(isCached(classes[i], @selector(m0)));
+        testassert(isCached(classes[i], @selector(m7)));
+        testassertequal(call(objs[i], @selector(m3)), 100);
+        testassertequal(call(objs[i], @selector(m4)), 4);
+    }
+    method_setImplementation(m3, old);
+    testassertequal(call(objs[0], @selector(m3)), 3);
+
+    // class_addMethod on one subclass evicts the inherited entry there.
+    warm();
+    before = _objc_flushedCacheBucketCount();
+    testassert(class_addMethod(classes[0], @selector(m5), (IMP)replacement, "i@:"));
+    flushed = _objc_flushedCacheBucketCount() - before;
+    testprintf("class_addMethod flushed %zu\n", flushed);
+    testassertequal(flushed, 1ul);
+    testassertequal(call(objs[0], @selector(m5)), 100);
+    testassertequal(call(objs[1], @selector(m5)), 5);
+    testassert(isCached(classes[0], @selector(m6)));
+
+    // A new selector is evicted from negative cache entries too.
+    SEL missing = sel_registerName("targetedMissing");
+    testassert(!class_respondsToSelector(classes[2], missing));
+    testassert(class_addMethod([Base class], missing, (IMP)replacement, "i@:"));
+    testassert(class_respondsToSelector(classes[2], missing));
+    testassertequal(call(objs[2], missing), 100);
+
+    // method_exchangeImplementations evicts both selectors.
+    warm();
+    before = _objc_flushedCacheBucketCount();
+    method_exchangeImplementations(class_getInstanceMethod([Base class], @selector(m1)),
+                                   class_getInstanceMethod([Base class], @selector(m2)));
+    flushed = _objc_flushedCacheBucketCount() - before;
+    testprintf("method_exchangeImplementations flushed %zu\n", flushed);
+    testassert(flushed <= 2 * (CLASSES + 1));
+    testassertequal(call(objs[3], @selector(m1)), 2);
+    testassertequal(call(objs[3], @selector(m2)), 1);
+    testassert(isCached(classes[3], @selector(m0)));
+
+    // _objc_flush_caches still flushes everything.
+    warm();
+    before = _objc_flushedCacheBucketCount();
+    _objc_flush_caches([Base class]);
+    flushed = _objc_flushedCacheBucketCount() - before;
+    testprintf("_objc_flush_caches flushed %zu\n", flushed);
+    testassert(flushed >= CLASSES * 8);
+    testassert(!isCached(classes[0], @selector(m0)));
+
+    for (int i = 0; i < CLASSES; i++) {
+        object_dispose(objs[i]);
+    }
+
+    succeed(__FILE__);
+}
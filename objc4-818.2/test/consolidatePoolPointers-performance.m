@@ -0,0 +1,93 @@
+//TEST_CONFIG MEM=mrc ARCH=x86_64,ARM64,ARM64e
+//TEST_ENV OBJC_DISABLE_AUTORELEASE_COALESCING=NO OBJC_DISABLE_AUTORELEASE_COALESCING_LRU=NO
+
+// Repeated autoreleases of the same object are stored as one
+// (pointer, count) pool entry. Compare page usage and pool pop time
+// against the same number of autoreleases of distinct objects,
+// including autoreleases that land on a full page.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/objc-internal.h>
+
+#define COUNT 1000000
+#define DISTINCT 1000
+
+static size_t pagesInUse(void)
+{
+    objc_autoreleasepool_stats_t stats;
+    _objc_autoreleasePoolGetStatistics(&stats);
+    return stats.pagesAllocated - stats.pagesFreed;
+}
+
+int main()
+{
+    uint64_t startTime;
+    uint64_t sameTime;
+    uint64_t distinctTime;
+    size_t basePages, samePages, distinctPages;
+
+    id obj = [TestRoot new];
+    id *objs = (id *)calloc(DISTINCT, sizeof(id));
+    for (int i = 0; i < DISTINCT; i++) {
+        objs[i] = [TestRoot new];
+    }
+
+    void *outer = objc_autoreleasePoolPush();
+    basePages = pagesInUse();
+
+    // The same object COUNT times.
+    startTime = mach_absolute_time();
+    void *pool = objc_autoreleasePoolPush();
+    for (int i = 0; i < COUNT; i++) {
+        [[obj retain] autorelease];
+    }
+    samePages = pagesInUse();
+    objc_autoreleasePoolPop(pool);
+    sameTime = mach_absolute_time() - startTime;
+
+    // COUNT autoreleases spread round-robin over DISTINCT objects,
+    // which defeats coalescing.
+    startTime = mach_absolute_time();
+    pool = objc_autoreleasePoolPush();
+    for (int i = 0; i < COUNT; i++) {
+        [[objs[i % DISTINCT] retain] autorelease];
+    }
+    distinctPages = pagesInUse();
+    objc_autoreleasePoolPop(pool);
+    distinctTime = mach_absolute_time() - startTime;
+
+    testprintf("same object:      %zu pages, time %llu\n",
+               samePages - basePages, sameTime);
+    testprintf("distinct objects: %zu pages, time %llu\n",
+               distinctPages - basePages, distinctTime);
+
+    // 65535 autoreleases fit in one entry.
+    testassert(samePages - basePages <= 1);
+    testassert(distinctPages - basePages > 100);
+    timecheck("coalesced pool", sameTime, 0, distinctTime);
+
+    // Autoreleasing the top object of a full page again
+    // must not start a new page.
+    pool = objc_autoreleasePoolPush();
+    for (int i = 0; i < DISTINCT; i++) {
+        [[objs[i] retain] autorelease];
+        size_t before = pagesInUse();
+        [[objs[i] retain] autorelease];
+        testassertequal(pagesInUse(), before);
+    }
+    objc_autoreleasePoolPop(pool);
+
+    objc_autoreleasePoolPop(outer);
+
+    testassertequal(TestRootDealloc, 0);
+    for (int i = 0; i < DISTINCT; i++) {
+        testassertequal([objs[i] retainCount], 1ul);
+        [objs[i] release];
+    }
+    [obj release];
+    testassertequal(TestRootDealloc, DISTINCT + 1);
+    free(objs);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,88 @@
+// TEST_CONFIG MEM=mrc
+// TEST_ENV OBJC_DEFER_SIDE_TABLE_RELEASES=YES OBJC_DISABLE_NONPOINTER_ISA=YES
+
+// Releases that find their side table lock busy are buffered per thread
+// and applied later. Whether or not any release is deferred, counts must
+// come out exact once threads flush, exit, or pop their pools, and every
+// object must be deallocated exactly once.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/objc-internal.h>
+
+#define THREADS 8
+#define LOOPS 100000
+#define OBJECTS 64
+
+static id shared;
+static id objects[OBJECTS];
+
+static void *hammer(void *arg)
+{
+    uintptr_t index = (uintptr_t)arg;
+    // Releases are only deferred on threads with objc per-thread data.
+    @synchronized(shared) { }
+    for (int i = 0; i < LOOPS; i++) {
+        [shared retain];
+        [shared release];
+        id obj = objects[(index + i) % OBJECTS];
+        [obj retain];
+        @autoreleasepool {
+            [obj autorelease];
+        }
+    }
+    // The rest of this thread's buffer is applied when it exits.
+    return NULL;
+}
+
+static void *releaseAll(void *arg __unused)
+{
+    @synchronized(shared) { }
+    for (int i = 0; i < OBJECTS; i++) {
+        [objects[i] release];
+    }
+    _objc_flushDeferredReleases();
+    return NULL;
+}
+
+int main()
+{
+    shared = [TestRoot new];
+    for (int i = 0; i < OBJECTS; i++) {
+        objects[i] = [TestRoot new];
+    }
+
+    pthread_t threads[THREADS];
+    for (uintptr_t t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &hammer, (void *)t);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    _objc_flushDeferredReleases();
+    testassertequal([shared retainCount], 1ul);
+    for (int i = 0; i < OBJECTS; i++) {
+        testassertequal([objects[i] retainCount], 1ul);
+    }
+
+    // Last releases on several threads at once, some of which may be
+    // deferred, deallocate every object exactly once.
+    TestRootDealloc = 0;
+    for (int i = 0; i < OBJECTS; i++) {
+        for (int t = 0; t < THREADS - 1; t++) [objects[i] retain];
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &releaseAll, NULL);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    testassertequal(TestRootDealloc, OBJECTS);
+
+    [shared release];
+    _objc_flushDeferredReleases();
+    testassertequal(TestRootDealloc, OBJECTS + 1);
+
+    succeed(__FILE__);
+}
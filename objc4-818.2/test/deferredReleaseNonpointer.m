@@ -0,0 +1,59 @@
+// TEST_CONFIG MEM=mrc
+// TEST_ENV OBJC_DEFER_SIDE_TABLE_RELEASES=YES
+
+// Releases of nonpointer isa objects that underflow their inline retain 
+// count into a busy side table are deferred too. Counts must come out 
+// exact, and the object must be deallocated exactly once.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/objc-internal.h>
+
+#define THREADS 8
+#if __x86_64__
+// x86_64 keeps 8 bits of retain count inline.
+#   define BURST 300
+#   define LOOPS 1000
+#else
+#   define BURST (1 << 20)
+#   define LOOPS 2
+#endif
+
+static id shared;
+
+static void *hammer(void *arg __unused)
+{
+    // Releases are only deferred on threads with objc per-thread data.
+    @synchronized(shared) { }
+    for (int i = 0; i < LOOPS; i++) {
+        // Enough retains to overflow the inline count into the side 
+        // table, so the releases underflow back out of it.
+        for (int j = 0; j < BURST; j++) [shared retain];
+        for (int j = 0; j < BURST; j++) [shared release];
+    }
+    // The rest of this thread's buffer is applied when it exits.
+    return NULL;
+}
+
+int main()
+{
+    shared = [TestRoot new];
+
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &hammer, NULL);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    _objc_flushDeferredReleases();
+    testassertequal([shared retainCount], 1ul);
+
+    TestRootDealloc = 0;
+    [shared release];
+    _objc_flushDeferredReleases();
+    testassertequal(TestRootDealloc, 1);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,37 @@
+/*
+TEST_ENV OBJC_PRINT_IMAGE_PHASES=YES
+
+TEST_RUN_OUTPUT
+(objc\[\d+\]: IMAGE PHASES: .*\n)+OK: imagePhases.m
+END
+
+Every selector reference must end up as the registered selector,
+and OBJC_PRINT_IMAGE_PHASES logs the running totals.
+*/
+
+#include "test.h"
+#include <objc/runtime.h>
+
+// 4^3 = 64 distinct selector references.
+#define S1(x) @selector(x##a), @selector(x##b), @selector(x##c), @selector(x##d)
+#define S2(x) S1(x##a), S1(x##b), S1(x##c), S1(x##d)
+#define S3(x) S2(x##a), S2(x##b), S2(x##c), S2(x##d)
+
+int main()
+{
+    SEL sels[] = { S3(phase) };
+    size_t count = sizeof(sels) / sizeof(sels[0]);
+    testassertequal(count, (size_t)64);
+
+    for (size_t i = 0; i < count; i++) {
+        testassert(sel_isMapped(sels[i]));
+        testassert(sel_registerName(sel_getName(sels[i])) == sels[i]);
+        if (i > 0) testassert(sels[i] != sels[i-1]);
+    }
+    testassert(sels[0] == sel_registerName("phaseaaa"));
+
+    // Selectors the runtime uses must still be the same.
+    testassert(@selector(dealloc) == sel_registerName("dealloc"));
+
+    succeed(__FILE__);
+}
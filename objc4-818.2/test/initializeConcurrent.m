@@ -0,0 +1,130 @@
+// TEST_CONFIG
+
+// initializeConcurrent.m
+// Test +initialize bookkeeping under nesting and concurrency
+// * a thread may message every class in a deep chain of +initialize calls
+// * threads waiting for one class are all released when it finishes
+// * unrelated classes initialize while another +initialize is in progress
+
+#include "test.h"
+#include "testroot.i"
+#include <dispatch/dispatch.h>
+#include <objc/runtime.h>
+
+#define DEPTH 16
+#define WAITERS 8
+#define UNRELATED 200
+
+static int chainState = 0;
+
+#define CHAIN(n, next)                                          \
+    @interface Chain##n : TestRoot @end                         \
+    @implementation Chain##n                                    \
+    +(void)initialize {                                         \
+        testassert(chainState == n);                            \
+        chainState++;                                           \
+        [self method];                                          \
+        next;                                                   \
+        [self method];                                          \
+    }                                                           \
+    +(void)method { }                                           \
+    @end
+
+CHAIN(15, (void)0)
+CHAIN(14, [Chain15 method])
+CHAIN(13, [Chain14 method])
+CHAIN(12, [Chain13 method])
+CHAIN(11, [Chain12 method])
+CHAIN(10, [Chain11 method])
+CHAIN(9,  [Chain10 method])
+CHAIN(8,  [Chain9 method])
+CHAIN(7,  [Chain8 method])
+CHAIN(6,  [Chain7 method])
+CHAIN(5,  [Chain6 method])
+CHAIN(4,  [Chain5 method])
+CHAIN(3,  [Chain4 method])
+CHAIN(2,  [Chain3 method])
+CHAIN(1,  [Chain2 method])
+CHAIN(0,  [Chain1 method])
+
+
+static dispatch_semaphore_t slowStarted;
+static dispatch_semaphore_t slowMayFinish;
+static volatile int slowDone;
+
+@interface Slow : TestRoot @end
+@implementation Slow
++(void)initialize {
+    dispatch_semaphore_signal(slowStarted);
+    dispatch_semaphore_wait(slowMayFinish, DISPATCH_TIME_FOREVER);
+    slowDone = 1;
+}
++(int)method { return slowDone; }
+@end
+
+
+static int unrelatedInitialized;
+
+static void unrelatedInitialize(Class self __unused, SEL _cmd __unused)
+{
+    __c11_atomic_fetch_add((_Atomic(int) *)&unrelatedInitialized, 1,
+                           __ATOMIC_RELAXED);
+}
+
+static void unrelatedMethod(Class self __unused, SEL _cmd __unused) { }
+
+
+static void *waitForSlow(void *arg __unused)
+{
+    // Blocks until +[Slow initialize] finishes on the other thread.
+    testassert([Slow method] == 1);
+    return NULL;
+}
+
+
+int main()
+{
+    // Nested +initialize deeper than the per-thread table's initial size.
+    [Chain0 method];
+    testassertequal(chainState, DEPTH);
+    [Chain0 method];
+    [Chain15 method];
+
+    slowStarted = dispatch_semaphore_create(0);
+    slowMayFinish = dispatch_semaphore_create(0);
+
+    pthread_t initializer;
+    pthread_create(&initializer, NULL, &waitForSlow, NULL);
+    dispatch_semaphore_wait(slowStarted, DISPATCH_TIME_FOREVER);
+
+    pthread_t waiters[WAITERS];
+    for (int i = 0; i < WAITERS; i++) {
+        pthread_create(&waiters[i], NULL, &waitForSlow, NULL);
+    }
+
+    // +[Slow initialize] is in progress and has waiters.
+    // Unrelated classes don't wait for it.
+    for (int i = 0; i < UNRELATED; i++) {
+        char *name;
+        asprintf(&name, "Unrelated%d", i);
+        Class cls = objc_allocateClassPair([TestRoot class], name, 0);
+        class_addMethod(object_getClass(cls), @selector(initialize),
+                        (IMP)unrelatedInitialize, "v@:");
+        class_addMethod(object_getClass(cls), @selector(method),
+                        (IMP)unrelatedMethod, "v@:");
+        objc_registerClassPair(cls);
+        free(name);
+        ((void(*)(Class, SEL))objc_msgSend)(cls, @selector(method));
+    }
+    testassertequal(unrelatedInitialized, UNRELATED);
+    testassert(!slowDone);
+
+    dispatch_semaphore_signal(slowMayFinish);
+    pthread_join(initializer, NULL);
+    for (int i = 0; i < WAITERS; i++) {
+        pthread_join(waiters[i], NULL);
+    }
+    testassert([Slow method] == 1);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,90 @@
+// TEST_CONFIG MEM=mrc
+
+// Method argument queries reuse the parsed type string instead of
+// parsing it on every call. Results must match for methods that are
+// too big to cache, and must not go stale when a method's types are
+// freed and the memory is reused.
+
+#include "test.h"
+#include "testroot.i"
+#include <string.h>
+#include <objc/runtime.h>
+
+#define LOOPS 1000000
+
+typedef struct { double a, b, c; } Big;
+
+@interface Args : TestRoot @end
+@implementation Args
+-(Big)small:(int)a :(Big)b :(id)c { (void)a; (void)c; return b; }
+-(int)large:(int)a :(int)b :(int)c :(int)d :(int)e :(int)f :(int)g :(int)h :(Big)i {
+    (void)b; (void)c; (void)d; (void)e; (void)f; (void)g; (void)h; (void)i;
+    return a;
+}
+@end
+
+static void checkArgs(Method m, unsigned count, const char *last)
+{
+    char buf[128];
+    testassertequal(method_getNumberOfArguments(m), count);
+    char *arg = method_copyArgumentType(m, count - 1);
+    testassert(0 == strcmp(arg, last));
+    free(arg);
+    method_getArgumentType(m, count - 1, buf, sizeof(buf));
+    testassert(0 == strcmp(buf, last));
+    testassert(!method_copyArgumentType(m, count));
+    method_getArgumentType(m, count, buf, sizeof(buf));
+    testassert(0 == strcmp(buf, ""));
+    arg = method_copyReturnType(m);
+    method_getReturnType(m, buf, sizeof(buf));
+    testassert(0 == strcmp(arg, buf));
+    free(arg);
+}
+
+static uint64_t timeQueries(Method m)
+{
+    unsigned count = method_getNumberOfArguments(m);
+    char buf[128];
+    uint64_t startTime = mach_absolute_time();
+    for (int i = 0; i < LOOPS; i++) {
+        testassert(method_getNumberOfArguments(m) == count);
+        method_getArgumentType(m, i % count, buf, sizeof(buf));
+    }
+    return mach_absolute_time() - startTime;
+}
+
+static int imp(id self __unused, SEL _cmd __unused) { return 0; }
+
+int main()
+{
+    Method small = class_getInstanceMethod([Args class], @selector(small:::));
+    Method large = class_getInstanceMethod([Args class], @selector(large:::::::::));
+
+    // Repeated queries return the same answers.
+    for (int i = 0; i < 3; i++) {
+        checkArgs(small, 5, "@");
+        checkArgs(large, 11, "{?=ddd}");
+    }
+    char *ret = method_copyReturnType(small);
+    testassert(0 == strcmp(ret, "{?=ddd}"));
+    free(ret);
+
+    // Types of a disposed class's methods are forgotten.
+    for (int i = 0; i < 100; i++) {
+        Class cls = objc_allocateClassPair([TestRoot class], "ArgsDynamic", 0);
+        char types[32];
+        strcpy(types, i % 2 ? "i@:" : "i@:ii");
+        testassert(class_addMethod(cls, @selector(dynamic), (IMP)imp, types));
+        objc_registerClassPair(cls);
+        Method m = class_getInstanceMethod(cls, @selector(dynamic));
+        testassertequal(method_getNumberOfArguments(m), i % 2 ? 2u : 4u);
+        objc_disposeClassPair(cls);
+    }
+
+    uint64_t smallTime = timeQueries(small);
+    uint64_t largeTime = timeQueries(large);
+    testprintf("time: cached %llu, uncached %llu\n", smallTime, largeTime);
+    timecheck("cached method argument queries", smallTime, 0, largeTime);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,112 @@
+// TEST_CONFIG MEM=mrc
+
+// Uncached method lookup in classes with many attached method lists.
+// Each class_addMethod() and each category attaches another list;
+// lookup cost should not grow with the number of lists, and the
+// merged method index must preserve category override order.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+
+#define MAXLISTS 100
+#define LOOKUPS 100000
+
+static int base_which(id self __unused, SEL _cmd __unused) { return 0; }
+static int list_which(id self __unused, SEL _cmd __unused) { return 1; }
+
+@interface Overridden : TestRoot @end
+@implementation Overridden
+-(int)which { return 0; }
+-(int)base { return 0; }
+@end
+
+@implementation Overridden (Cat1) -(int)which { return 1; } -(int)cat1 { return 1; } @end
+@implementation Overridden (Cat2) -(int)which { return 2; } -(int)cat2 { return 2; } @end
+@implementation Overridden (Cat3) -(int)which { return 3; } -(int)cat3 { return 3; } @end
+@implementation Overridden (Cat4) -(int)which { return 4; } -(int)cat4 { return 4; } @end
+@implementation Overridden (Cat5) -(int)which { return 5; } -(int)cat5 { return 5; } @end
+@implementation Overridden (Cat6) -(int)which { return 6; } -(int)cat6 { return 6; } @end
+
+static SEL sels[MAXLISTS];
+
+static Class classWithLists(int count)
+{
+    static int serial;
+    char *name;
+    asprintf(&name, "MethodIndex%d_%d", count, serial++);
+    Class cls = objc_allocateClassPair([TestRoot class], name, 0);
+    free(name);
+    objc_registerClassPair(cls);
+
+    // One method list per call.
+    for (int i = 0; i < count; i++) {
+        testassert(class_addMethod(cls, sels[i], (IMP)list_which, "i@:"));
+    }
+    return cls;
+}
+
+static uint64_t timeLookups(Class cls, int count)
+{
+    uint64_t startTime = mach_absolute_time();
+    for (int i = 0; i < LOOKUPS; i++) {
+        SEL sel = sels[i % count];
+        Method m = class_getInstanceMethod(cls, sel);
+        testassert(m  &&  method_getName(m) == sel);
+    }
+    return mach_absolute_time() - startTime;
+}
+
+int main()
+{
+    for (int i = 0; i < MAXLISTS; i++) {
+        char *name;
+        asprintf(&name, "methodIndex%d", i);
+        sels[i] = sel_registerName(name);
+        free(name);
+    }
+
+    // Categories shadow the class and each other.
+    // The last category loaded wins.
+    Overridden *obj = [Overridden new];
+    testassertequal([obj which], 6);
+    testassertequal([obj base], 0);
+    testassertequal([obj cat1], 1);
+    testassertequal([obj cat6], 6);
+    Method which = class_getInstanceMethod([Overridden class], @selector(which));
+    testassert(method_getImplementation(which) ==
+               class_getMethodImplementation([Overridden class], @selector(which)));
+    testassert(!class_getInstanceMethod([Overridden class], sels[0]));
+
+    // Lists added after a lookup are found.
+    // class_addMethod does not shadow existing methods.
+    testassert(class_addMethod([Overridden class], sels[0], (IMP)base_which, "i@:"));
+    testassert(method_getImplementation(class_getInstanceMethod([Overridden class], sels[0])) == (IMP)base_which);
+    testassert(!class_addMethod([Overridden class], @selector(which), (IMP)base_which, "i@:"));
+    testassertequal([obj which], 6);
+
+    // Replacing an implementation is seen through the index.
+    IMP old = class_replaceMethod([Overridden class], @selector(which), (IMP)list_which, "i@:");
+    testassert(old);
+    testassertequal([obj which], 1);
+    method_setImplementation(which, old);
+    testassertequal([obj which], 6);
+    [obj release];
+
+    // Time per lookup with 1..MAXLISTS attached lists.
+    Class one = classWithLists(1);
+    Class many = classWithLists(MAXLISTS);
+    for (int lists = 1; lists <= MAXLISTS; lists *= 10) {
+        Class cls = classWithLists(lists);
+        testprintf("time: %d lists, %d lookups: %llu\n",
+                   lists, LOOKUPS, timeLookups(cls, lists));
+    }
+
+    uint64_t oneTime = timeLookups(one, 1);
+    uint64_t manyTime = timeLookups(many, MAXLISTS);
+
+    // Searching every list in turn would be roughly MAXLISTS times slower.
+    timecheck("method lookup with many lists", manyTime, 0, oneTime * 4);
+
+    succeed(__FILE__);
+}
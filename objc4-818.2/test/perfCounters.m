@@ -0,0 +1,113 @@
+// TEST_CONFIG MEM=mrc
+// TEST_ENV OBJC_RECORD_CLASS_CACHE_MISSES=YES
+
+// _objc_getPerformanceCounters() sums runtime event counts over all
+// threads, including threads that have exited.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/runtime.h>
+#include <objc/objc-internal.h>
+
+@interface Counted : TestRoot @end
+@implementation Counted
+-(void)one { }
+-(void)two { }
+@end
+
+static int Serial;
+
+static Class newClass(void)
+{
+    char *name;
+    asprintf(&name, "PerfCounters%d", Serial++);
+    Class cls = objc_allocateClassPair([Counted class], name, 0);
+    objc_registerClassPair(cls);
+    free(name);
+    return cls;
+}
+
+int main()
+{
+    objc_perf_counters_t before, after;
+
+    _objc_getPerformanceCounters(&before);
+    testassert(before.classesRealized > 0);
+
+    // Messaging a new class misses its cache and grows it.
+    Class cls = newClass();
+    id obj = class_createInstance(cls, 0);
+    [obj one];
+    [obj two];
+    [obj one];
+    _objc_getPerformanceCounters(&after);
+    testassert(after.cacheMisses >= before.cacheMisses + 2);
+    testassert(after.classesRealized >= before.classesRealized);
+    testassert(_class_getCacheMissCount(cls) >= 2);
+
+    // Changing a method flushes caches.
+    before = after;
+    class_addMethod([Counted class], @selector(three),
+                    class_getMethodImplementation([Counted class], @selector(one)),
+                    "v@:");
+    class_replaceMethod([Counted class], @selector(one),
+                        class_getMethodImplementation([Counted class], @selector(two)),
+                        "v@:");
+    _objc_getPerformanceCounters(&after);
+    testassert(after.cacheFlushes > before.cacheFlushes);
+
+    // Counts from a thread that exits are kept.
+    before = after;
+    testonthread(^{
+        for (int i = 0; i < 10; i++) {
+            id other = class_createInstance(newClass(), 0);
+            [other one];
+            object_dispose(other);
+        }
+    });
+    _objc_getPerformanceCounters(&after);
+    testassert(after.cacheMisses >= before.cacheMisses + 10);
+    testassert(after.lazyRealizations >= before.lazyRealizations + 10);
+
+    // Counts from a thread that only messages an initialized class, 
+    // and so has no objc per-thread data, are kept too.
+    before = after;
+    testonthread(^{
+        [obj one];
+        [obj two];
+    });
+    _objc_getPerformanceCounters(&after);
+    testassert(after.cacheMisses >= before.cacheMisses + 2);
+
+    // Weak table sizes are current, not cumulative.
+    id weak = nil;
+    _objc_getPerformanceCounters(&before);
+    objc_storeWeak(&weak, obj);
+    _objc_getPerformanceCounters(&after);
+    testassertequal(after.weakReferents, before.weakReferents + 1);
+    testassert(after.weakTableCapacity >= after.weakReferents);
+    objc_storeWeak(&weak, nil);
+    _objc_getPerformanceCounters(&after);
+    testassertequal(after.weakReferents, before.weakReferents);
+
+#if __x86_64__
+    // x86_64 keeps only 8 bits of retain count inline.
+    before = after;
+    id many = [TestRoot new];
+    for (int i = 0; i < 1000; i++) [many retain];
+    _objc_getPerformanceCounters(&after);
+    testassert(after.sideTableOverflows > before.sideTableOverflows);
+    for (int i = 0; i < 1000; i++) [many release];
+    [many release];
+#endif
+
+    // Reset starts the counts over.
+    _objc_resetPerformanceCounters();
+    _objc_getPerformanceCounters(&after);
+    testassertequal(after.cacheMisses, 0ul);
+    testassertequal(after.classesRealized, 0ul);
+    [obj two];
+    object_dispose(obj);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,72 @@
+// TEST_CONFIG MEM=mrc
+// TEST_ENV OBJC_POOL_PAGE_CACHE_LIMIT=8
+
+// Autorelease pool pages emptied by a pop are kept for reuse
+// up to OBJC_POOL_PAGE_CACHE_LIMIT, so pools that repeatedly cross
+// page boundaries stop allocating pages. Page statistics are counted 
+// on every thread.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/objc-internal.h>
+
+// Several pages' worth of distinct objects.
+#define OBJECTS 2000
+#define LOOPS 100
+
+static void fill(void)
+{
+    void *pool = objc_autoreleasePoolPush();
+    for (int i = 0; i < OBJECTS; i++) {
+        [[TestRoot new] autorelease];
+    }
+    objc_autoreleasePoolPop(pool);
+}
+
+int main()
+{
+    objc_autoreleasepool_stats_t before, after;
+
+    void *outer = objc_autoreleasePoolPush();
+
+    // Warm up the cache.
+    fill();
+    _objc_autoreleasePoolGetStatistics(&before);
+    testassert(before.pagesAllocated > 1);
+    testassert(before.highWaterPages > 1);
+
+    for (int i = 0; i < LOOPS; i++) {
+        fill();
+    }
+    _objc_autoreleasePoolGetStatistics(&after);
+
+    // Each fill needs about 4 extra pages, all of which stay cached.
+    testassert(after.pagesAllocated - before.pagesAllocated <= 1);
+    testassert(after.pagesReused - before.pagesReused >= LOOPS);
+    testassert(after.highWaterPages <= before.highWaterPages + 1);
+    testassert(TestRootDealloc == OBJECTS * (LOOPS + 1));
+
+    // With no cache, every fill allocates its pages again.
+    _objc_autoreleasePoolSetPageCacheLimit(0);
+    fill();
+    _objc_autoreleasePoolGetStatistics(&before);
+    fill();
+    _objc_autoreleasePoolGetStatistics(&after);
+    testassert(after.pagesAllocated > before.pagesAllocated);
+    testassert(after.pagesFreed > before.pagesFreed);
+
+    objc_autoreleasePoolPop(outer);
+
+    // Pages are counted on a fresh thread that has done nothing else, 
+    // and so has no other runtime per-thread state.
+    __block objc_autoreleasepool_stats_t threadBefore, threadAfter;
+    testonthread(^{
+        _objc_autoreleasePoolGetStatistics(&threadBefore);
+        fill();
+        _objc_autoreleasePoolGetStatistics(&threadAfter);
+    });
+    testassert(threadAfter.pagesAllocated > threadBefore.pagesAllocated + 1);
+    testassert(threadAfter.pagesFreed > threadBefore.pagesFreed);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,94 @@
+// TEST_CFLAGS -framework Foundation
+// TEST_CONFIG MEM=mrc
+
+// objc_retainArray and objc_releaseArray must behave exactly like
+// objc_retain and objc_release on each element, including nil,
+// tagged pointers, custom RR, and side table overflow.
+
+#include "test.h"
+#include "testroot.i"
+#include <objc/objc-internal.h>
+#import <Foundation/Foundation.h>
+
+#define COUNT 1000
+#define REPEAT 2000
+
+static atomic_int Deallocs;
+
+@interface Deallocator : NSObject @end
+@implementation Deallocator
+-(void)dealloc {
+    atomic_fetch_add_explicit(&Deallocs, 1, memory_order_relaxed);
+    [super dealloc];
+}
+@end
+
+int main()
+{
+    id *objs = (id *)calloc(COUNT, sizeof(id));
+    id *orig = (id *)calloc(COUNT, sizeof(id));
+
+    // Mixed array: objects, nil, and tagged pointers.
+    for (int i = 0; i < COUNT; i++) {
+        switch (i % 4) {
+        case 0: objs[i] = nil; break;
+        case 1: objs[i] = [NSNumber numberWithInt:i]; break;
+        default: objs[i] = [Deallocator new]; break;
+        }
+    }
+    memcpy(orig, objs, COUNT * sizeof(id));
+
+    objc_retainArray(objs, COUNT);
+    for (int i = 0; i < COUNT; i++) {
+        testassert(objs[i] == orig[i]);
+        if (i % 4 >= 2) testassert([objs[i] retainCount] == 2);
+    }
+    objc_releaseArray(objs, COUNT);
+    for (int i = 0; i < COUNT; i++) {
+        if (i % 4 >= 2) testassert([objs[i] retainCount] == 1);
+    }
+    testassert(Deallocs == 0);
+    objc_releaseArray(objs, COUNT);
+    testassert(Deallocs == COUNT / 2);
+
+    // Custom RR goes through the overrides.
+    Deallocs = 0;
+    TestRootRetain = 0;
+    TestRootRelease = 0;
+    for (int i = 0; i < COUNT; i++) {
+        objs[i] = [TestRoot new];
+    }
+    objc_retainArray(objs, COUNT);
+    testassert(TestRootRetain == COUNT);
+    objc_releaseArray(objs, COUNT);
+    testassert(TestRootRelease == COUNT);
+    TestRootDealloc = 0;
+    objc_releaseArray(objs, COUNT);
+    testassert(TestRootDealloc == COUNT);
+
+    // The same object many times overflows into the side table
+    // and borrows back from it.
+    Deallocs = 0;
+    id *same = (id *)calloc(REPEAT, sizeof(id));
+    id obj = [Deallocator new];
+    for (int i = 0; i < REPEAT; i++) {
+        same[i] = obj;
+    }
+    objc_retainArray(same, REPEAT);
+    testassert([obj retainCount] == REPEAT + 1);
+    objc_releaseArray(same, REPEAT);
+    testassert([obj retainCount] == 1);
+    testassert(Deallocs == 0);
+    objc_releaseArray(&obj, 1);
+    testassert(Deallocs == 1);
+
+    // Zero-length and NULL arrays are fine.
+    objc_retainArray(NULL, 0);
+    objc_releaseArray(NULL, 0);
+
+    free(same);
+    free(orig);
+    free(objs);
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,81 @@
+// TEST_CONFIG
+
+// sel_registerName() throughput for dynamically created selector names,
+// single-threaded and across threads. Registering a name that already
+// exists must not serialize on selLock.
+
+#include "test.h"
+#include <objc/runtime.h>
+
+#define NAMES 10000
+#define LOOPS 20
+#define THREADS 8
+
+static char *names[NAMES];
+static SEL sels[NAMES];
+
+static void *registerAll(void *arg __unused)
+{
+    for (int loop = 0; loop < LOOPS; loop++) {
+        for (int i = 0; i < NAMES; i++) {
+            SEL sel = sel_registerName(names[i]);
+            testassert(sel == sels[i]);
+        }
+    }
+    return NULL;
+}
+
+int main()
+{
+    uint64_t startTime;
+    uint64_t oneThreadTime;
+    uint64_t allThreadsTime;
+
+    for (int i = 0; i < NAMES; i++) {
+        asprintf(&names[i], "selPerformance%d:withObject:", i);
+    }
+
+    // First registration creates the selectors.
+    for (int i = 0; i < NAMES; i++) {
+        sels[i] = sel_registerName(names[i]);
+        testassert(sels[i]);
+        testassert(0 == strcmp(sel_getName(sels[i]), names[i]));
+        testassert(sel_isMapped(sels[i]));
+    }
+
+    // Names are copied; the same string at another address is the same SEL.
+    char *copy = strdup(names[0]);
+    testassert(sel_registerName(copy) == sels[0]);
+    testassert(sel_getUid(copy) == sels[0]);
+    free(copy);
+
+    startTime = mach_absolute_time();
+    registerAll(NULL);
+    oneThreadTime = mach_absolute_time() - startTime;
+    testprintf("time: 1 thread, %d lookups: %llu\n",
+               NAMES * LOOPS, oneThreadTime);
+
+    pthread_t threads[THREADS];
+    startTime = mach_absolute_time();
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, &registerAll, NULL);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    allThreadsTime = mach_absolute_time() - startTime;
+    testprintf("time: %d threads, %d lookups: %llu\n",
+               THREADS, THREADS * NAMES * LOOPS, allThreadsTime);
+
+    // THREADS times the work on THREADS threads shouldn't take
+    // THREADS times as long, as it would if every lookup took the lock.
+    // The margin is generous for machines with few cores.
+    timecheck("threaded sel_registerName", allThreadsTime, 0,
+              oneThreadTime * THREADS);
+
+    for (int i = 0; i < NAMES; i++) {
+        free(names[i]);
+    }
+
+    succeed(__FILE__);
+}
@@ -0,0 +1,161 @@
+// TEST_CONFIG MEM=mrc
+
+// Instances of classes opted in with _class_setUsesSlabAllocator()
+// come from the runtime's slab allocator. They must be zeroed,
+// have the right class, report their size through malloc, be
+// enumerated by the slab's malloc zone for heap and leaks, and be
+// freed by the normal dealloc path. Compare allocation time with
+// the same class allocated through calloc.
+
+#include "test.h"
+#include "testroot.i"
+#include <malloc/malloc.h>
+#include <objc/runtime.h>
+#include <objc/objc-internal.h>
+
+#define COUNT 100000
+#define BATCH 100
+
+@interface Slab : TestRoot {
+  @public
+    long a, b, c;
+}
+@end
+@implementation Slab @end
+
+@interface Heap : TestRoot {
+  @public
+    long a, b, c;
+}
+@end
+@implementation Heap @end
+
+@interface SlabSub : Slab @end
+@implementation SlabSub @end
+
+static id objs[BATCH];
+
+static vm_address_t enumTarget;
+static bool enumFoundInUse;
+static bool enumFoundRegion;
+
+static void enumRecorder(task_t task __unused, void *context __unused,
+                         unsigned type, vm_range_t *ranges, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++) {
+        if (enumTarget < ranges[i].address  ||
+            enumTarget >= ranges[i].address + ranges[i].size) continue;
+        if (type == MALLOC_PTR_IN_USE_RANGE_TYPE) {
+            testassertequal(ranges[i].address, enumTarget);
+            enumFoundInUse = true;
+        }
+        if (type == MALLOC_PTR_REGION_RANGE_TYPE) enumFoundRegion = true;
+    }
+}
+
+static uint64_t timeAllocs(Class cls)
+{
+    uint64_t startTime = mach_absolute_time();
+    for (int i = 0; i < COUNT / BATCH; i++) {
+        for (int j = 0; j < BATCH; j++) {
+            objs[j] = class_createInstance(cls, 0);
+        }
+        for (int j = 0; j < BATCH; j++) {
+            object_dispose(objs[j]);
+        }
+    }
+    return mach_absolute_time() - startTime;
+}
+
+static void checkObject(Slab *obj, Class cls)
+{
+    testassert(obj);
+    testassert(object_getClass(obj) == cls);
+    testassertequal(obj->a, 0L);
+    testassertequal(obj->b, 0L);
+    testassertequal(obj->c, 0L);
+    testassert(malloc_size(obj) >= class_getInstanceSize(cls));
+}
+
+int main()
+{
+    [Slab class];
+    [SlabSub class];
+    [Heap class];
+    _class_setUsesSlabAllocator([Slab class], YES);
+
+    // Single allocations are zeroed and freed through dealloc.
+    // Reused memory is zeroed again.
+    TestRootDealloc = 0;
+    for (int i = 0; i < 10; i++) {
+        Slab *obj = [Slab new];
+        checkObject(obj, [Slab class]);
+        obj->a = obj->b = obj->c = -1;
+        testassertequal([obj retainCount], 1ul);
+        [obj retain];
+        [obj release];
+        [obj release];
+    }
+    testassertequal(TestRootDealloc, 10);
+
+    // The flag is not inherited.
+    SlabSub *sub = [SlabSub new];
+    checkObject(sub, [SlabSub class]);
+    [sub release];
+
+    // Bulk allocation sets every isa.
+    unsigned count = class_createInstances([Slab class], 0, objs, BATCH);
+    testassertequal(count, (unsigned)BATCH);
+    for (unsigned i = 0; i < count; i++) {
+        checkObject(objs[i], [Slab class]);
+        for (unsigned j = 0; j < i; j++) {
+            testassert(objs[i] != objs[j]);
+        }
+    }
+    TestRootDealloc = 0;
+    for (unsigned i = 0; i < count; i++) {
+        [objs[i] release];
+    }
+    testassertequal(TestRootDealloc, BATCH);
+
+    // Extra bytes that don't fit in the slab fall back to malloc.
+    Slab *big = class_createInstance([Slab class], 4096);
+    checkObject(big, [Slab class]);
+    object_dispose(big);
+
+    // Objects outlive the opt-in.
+    Slab *survivor = [Slab new];
+    _class_setUsesSlabAllocator([Slab class], NO);
+    Slab *unslabbed = [Slab new];
+    checkObject(survivor, [Slab class]);
+    checkObject(unslabbed, [Slab class]);
+    [survivor release];
+    [unslabbed release];
+    _class_setUsesSlabAllocator([Slab class], YES);
+
+    // The slab's zone reports live objects and the chunks holding them.
+    Slab *enumerated = [Slab new];
+    malloc_zone_t *zone = malloc_zone_from_ptr(enumerated);
+    testassert(zone);
+    testassert(0 == strcmp(malloc_get_zone_name(zone), "ObjCSlabZone"));
+    enumTarget = (vm_address_t)enumerated;
+    kern_return_t kr = zone->introspect->enumerator
+        (mach_task_self(), NULL, 
+         MALLOC_PTR_IN_USE_RANGE_TYPE | MALLOC_PTR_REGION_RANGE_TYPE, 
+         (vm_address_t)zone, NULL, enumRecorder);
+    testassertequal(kr, KERN_SUCCESS);
+    testassert(enumFoundInUse);
+    testassert(enumFoundRegion);
+    [enumerated release];
+
+    // Objects freed on another thread are reused.
+    __block Slab *other = [Slab new];
+    testonthread(^{ [other release]; });
+
+    uint64_t heapTime = timeAllocs([Heap class]);
+    uint64_t slabTime = timeAllocs([Slab class]);
+    testprintf("time: calloc %llu, slab %llu\n", heapTime, slabTime);
+    timecheck("slab allocation", slabTime, 0, heapTime * 2);
+
+    succeed(__FILE__);
+}